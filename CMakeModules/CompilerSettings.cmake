@@ -17,6 +17,17 @@ IF (CMAKE_COMPILER_IS_GNUCC)
   ADD_DEFINITIONS(-fPIC)
 ENDIF()
 
+# C++11 is required for std::thread, std::mutex, and std::atomic
+# (Modeling/ThreadPool.h)
+IF(CMAKE_VERSION VERSION_LESS "3.1")
+  IF(CMAKE_COMPILER_IS_GNUCXX OR CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    SET (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -std=c++11")
+  ENDIF()
+ELSE()
+  SET (CMAKE_CXX_STANDARD 11)
+  SET (CMAKE_CXX_STANDARD_REQUIRED ON)
+ENDIF()
+
 
 # Set full rpath http://www.paraview.org/Wiki/CMake_RPATH_handling
 # (good to have and required with ROS)
@@ -156,4 +156,8 @@ ENDIF(WIN32)
 #  LIST(APPEND KLAMPT_DEFINITIONS "-DHAVE_ROS=1")
 #ENDIF(ROS_FOUND)
 
+# std::thread needs the platform's thread library
+FIND_PACKAGE(Threads REQUIRED)
+SET(KLAMPT_LIBRARIES ${KLAMPT_LIBRARIES} ${CMAKE_THREAD_LIBS_INIT})
+
 LIST(REMOVE_DUPLICATES KLAMPT_INCLUDE_DIRS)
@@ -17,10 +17,6 @@ static inline double round(double val) { return floor(val + 0.5); }
 //defined in ODESimulator.cpp
 bool HasContact(dBodyID a);
 
-//defined in ODESimulator.cpp
-///Will produce bogus o1 and o2 vectors
-void GetContacts(dBodyID a,vector<ODEContactList>& contacts);
-
 //emulates a process that discretizes a continuous value into a digital one
 //with resolution resolution, and variance variance
 Real Discretize(Real value,Real resolution,Real variance)
@@ -489,7 +485,7 @@ void ContactSensor::Simulate(ControlledRobotSimulator* robot,WorldSimulation* si
   }
   //look through contacts
   vector<ODEContactList> contacts;
-  GetContacts(body,contacts);
+  sim->odesim.GetContacts(body,contacts);
   Vector3 xlocal,flocal;
   for(size_t i=0;i<contacts.size();i++) {
     for(size_t j=0;j<contacts[i].points.size();j++) {
@@ -64,6 +64,27 @@ bool XmlODESettings::GetSettings(ODESimulator& sim)
     int maxContacts;
     if(c->QueryValueAttribute("maxContacts",&maxContacts)==TIXML_SUCCESS)
       sim.GetSettings().maxContacts = maxContacts;
+    int collisionThreads;
+    if(c->QueryValueAttribute("collisionThreads",&collisionThreads)==TIXML_SUCCESS)
+      sim.GetSettings().collisionThreads = collisionThreads;
+    int contactCaching;
+    if(c->QueryValueAttribute("contactCaching",&contactCaching)==TIXML_SUCCESS)
+      sim.GetSettings().contactCaching = contactCaching;
+    double contactCacheTolerance;
+    if(c->QueryValueAttribute("contactCacheTranslationTolerance",&contactCacheTolerance)==TIXML_SUCCESS)
+      sim.GetSettings().contactCacheTranslationTolerance = contactCacheTolerance;
+    if(c->QueryValueAttribute("contactCacheRotationTolerance",&contactCacheTolerance)==TIXML_SUCCESS)
+      sim.GetSettings().contactCacheRotationTolerance = contactCacheTolerance;
+    int autoDisable;
+    if(c->QueryValueAttribute("autoDisable",&autoDisable)==TIXML_SUCCESS)
+      sim.GetSettings().autoDisable = autoDisable;
+    double autoDisableValue;
+    if(c->QueryValueAttribute("autoDisableLinearThreshold",&autoDisableValue)==TIXML_SUCCESS)
+      sim.GetSettings().autoDisableLinearThreshold = autoDisableValue;
+    if(c->QueryValueAttribute("autoDisableAngularThreshold",&autoDisableValue)==TIXML_SUCCESS)
+      sim.GetSettings().autoDisableAngularThreshold = autoDisableValue;
+    if(c->QueryValueAttribute("autoDisableTime",&autoDisableValue)==TIXML_SUCCESS)
+      sim.GetSettings().autoDisableTime = autoDisableValue;
     int boundaryLayer,adaptiveTimeStepping,rigidObjectCollisions,robotSelfCollisions,robotRobotCollisions;
     if(c->QueryValueAttribute("boundaryLayer",&boundaryLayer)==TIXML_SUCCESS) {
       printf("XML simulator: warning, boundary layer settings don't have an effect after world is loaded\n");
@@ -0,0 +1,331 @@
+#include "Planning/SelfTest.h"
+#include "Simulation/SelfTest.h"
+#include "Planning/RobotCSpace.h"
+#include "Simulation/WorldSimulation.h"
+#include "IO/XmlWorld.h"
+#include "IO/XmlODE.h"
+#include <KrisLibrary/utils/stringutils.h>
+#include <string.h>
+#include <stdlib.h>
+
+const char* USAGE_STRING = "USAGE: SelfTest test world_file [test arguments]\n\
+Tests:\n\
+  simulation world [jobs] [duration] [threads]: checks that rollouts run\n\
+     concurrently match rollouts run one at a time, bit for bit.\n\
+  batch world [jobs] [duration] [max threads]: times WorldSimulationPool\n\
+     batches with 1,2,4,... threads.\n\
+  snapshot world [reps] [duration]: checks that restoring a snapshot\n\
+     reproduces the same trajectory, and times Snapshot vs ReadState.\n\
+  contactcache world [duration]: checks that contact caching does not\n\
+     change the simulation.\n\
+  allocations world [duration]: checks that replaying a simulation does not\n\
+     grow the contact buffers.\n\
+  feasibility world [configs] [max threads]: checks ParallelIsFeasible\n\
+     against serial checking of robot 0's configurations.\n\
+  edges world [edges] [length] [max threads]: checks ParallelEdgeChecker\n\
+     against BisectionEpsilonEdgePlanner on robot 0's edges.\n\
+  advancement world [edges] [length]: compares the exact conservative\n\
+     advancement edge checker with bisection on robot 0's edges.\n\
+  lazy world [queries] [iterations]: plans for robot 0 with the lazy PRM\n\
+     and RRT planners and rechecks their paths.\n\
+  reuse world [cycles] [cycle time]: checks that DynamicHybridTreePlanner\n\
+     and DynamicRRTPlanner re-root their trees along the path robot 0\n\
+     executes.\n\
+  timescaling world path [bisections]: compares the SLP and reachability\n\
+     time-scaling solvers on robot 0's milestone file, e.g.\n\
+     data/motions/athlete_flex.path.\n\
+  interpolation world path [xtol]: interpolates the constrained sections of\n\
+     robot 0's MultiPath with and without Jacobian reuse, e.g.\n\
+     data/motions/hubo_sway_path.xml.\n\
+  cache world [configs] [repeats] [radius]: checks robot 0's configurations\n\
+     and perturbations of them with and without the feasibility cache.\n\
+  evaluation world [milestones] [times]: compares DynamicPath::Evaluate with\n\
+     EvaluateBatch on a path through random configurations of robot 0.\n\
+  nearest world [configs] [queries]: compares GNATIndex with brute force\n\
+     nearest neighbors on random configurations of robot 0.\n\
+  broadphase world [configs]: times robot 0's environment collision and\n\
+     distance queries by brute force and through the broad phase.\n\
+  spin world [configs]: checks the configuration distance and the\n\
+     nearest-neighbor metric on robot 0's spin joints.\n\
+";
+
+bool LoadWorld(const char* fn,XmlWorld& xmlWorld,RobotWorld& world)
+{
+  const char* ext=FileExtension(fn);
+  if(0==strcmp(ext,"xml")) {
+    if(!xmlWorld.Load(fn)) {
+      printf("Error loading world file %s\n",fn);
+      return false;
+    }
+    if(!xmlWorld.GetWorld(world)) {
+      printf("Error loading world from %s\n",fn);
+      return false;
+    }
+    return true;
+  }
+  return world.LoadElement(fn) >= 0;
+}
+
+//optional argument i, or the default if it is not given
+Real ArgOrDefault(int argc,char** argv,int i,Real defaultValue)
+{
+  if(i < argc) return atof(argv[i]);
+  return defaultValue;
+}
+
+//sets up a simulator on world with the default controllers and the
+//world file's simulation settings
+void InitSimulation(XmlWorld& xmlWorld,RobotWorld& world,WorldSimulation& sim)
+{
+  sim.Init(&world);
+  sim.robotControllers.resize(world.robots.size());
+  for(size_t i=0;i<sim.robotControllers.size();i++) {
+    Robot* robot=world.robots[i];
+    sim.SetController(i,MakeDefaultController(robot));
+    sim.controlSimulators[i].sensors.MakeDefault(robot);
+  }
+  TiXmlElement* e=xmlWorld.GetElement("simulation");
+  if(e) {
+    XmlSimulationSettings s(e);
+    if(!s.GetSettings(sim)) {
+      fprintf(stderr,"Warning, simulation settings not read correctly\n");
+    }
+  }
+}
+
+//robot 0's configuration space in world, with the world's collision
+//geometries and default planner settings set up
+struct PlanningSpace
+{
+  PlanningSpace(RobotWorld& world)
+    :cspace(InitPlanning(world,settings),0,&settings)
+  {}
+
+  static RobotWorld& InitPlanning(RobotWorld& world,WorldPlannerSettings& settings)
+  {
+    world.InitCollisions();
+    settings.InitializeDefault(world);
+    return world;
+  }
+
+  WorldPlannerSettings settings;
+  SingleRobotCSpace cspace;
+};
+
+//a path through numMilestones random configurations of the space's robot,
+//under its velocity and acceleration bounds
+bool MakeRandomPath(SingleRobotCSpace& cspace,int numMilestones,ParabolicRamp::DynamicPath& path)
+{
+  Robot* robot = cspace.GetRobot();
+  vector<ParabolicRamp::Vector> milestones(numMilestones);
+  Config q;
+  for(int i=0;i<numMilestones;i++) {
+    cspace.Sample(q);
+    milestones[i] = q;
+  }
+  path.Init(robot->velMax,robot->accMax);
+  return path.SetMilestones(milestones);
+}
+
+int TestSimulation(XmlWorld& xmlWorld,RobotWorld& world,int argc,char** argv)
+{
+  int numJobs = (int)ArgOrDefault(argc,argv,3,16);
+  Real duration = ArgOrDefault(argc,argv,4,1.0);
+  int numThreads = (int)ArgOrDefault(argc,argv,5,4);
+  WorldSimulation sim;
+  InitSimulation(xmlWorld,world,sim);
+  return TestConcurrentSimulation(sim,numJobs,duration,numThreads) ? 0 : 1;
+}
+
+int TestBatch(XmlWorld& xmlWorld,RobotWorld& world,int argc,char** argv)
+{
+  int numJobs = (int)ArgOrDefault(argc,argv,3,64);
+  Real duration = ArgOrDefault(argc,argv,4,1.0);
+  int maxThreads = (int)ArgOrDefault(argc,argv,5,8);
+  WorldSimulation sim;
+  InitSimulation(xmlWorld,world,sim);
+  TestSimulationPoolScaling(sim,numJobs,duration,maxThreads);
+  return 0;
+}
+
+int TestSnapshot(XmlWorld& xmlWorld,RobotWorld& world,int argc,char** argv)
+{
+  int numReps = (int)ArgOrDefault(argc,argv,3,1000);
+  Real duration = ArgOrDefault(argc,argv,4,1.0);
+  WorldSimulation sim;
+  InitSimulation(xmlWorld,world,sim);
+  //get the robots into contact first
+  sim.Advance(0.5);
+  return TestSimulationSnapshots(sim,numReps,duration) ? 0 : 1;
+}
+
+int TestContactCache(XmlWorld& xmlWorld,RobotWorld& world,int argc,char** argv)
+{
+  Real duration = ArgOrDefault(argc,argv,3,2.0);
+  WorldSimulation sim;
+  InitSimulation(xmlWorld,world,sim);
+  return TestContactCaching(sim,duration) ? 0 : 1;
+}
+
+int TestAllocations(XmlWorld& xmlWorld,RobotWorld& world,int argc,char** argv)
+{
+  Real duration = ArgOrDefault(argc,argv,3,1.0);
+  WorldSimulation sim;
+  InitSimulation(xmlWorld,world,sim);
+  //get the robots into contact first
+  sim.Advance(0.5);
+  return TestStepAllocations(sim,duration) ? 0 : 1;
+}
+
+int TestFeasibility(RobotWorld& world,int argc,char** argv)
+{
+  int numConfigs = (int)ArgOrDefault(argc,argv,3,10000);
+  int maxThreads = (int)ArgOrDefault(argc,argv,4,8);
+  PlanningSpace space(world);
+  return TestParallelFeasibility(space.cspace,numConfigs,maxThreads) ? 0 : 1;
+}
+
+int TestEdges(RobotWorld& world,int argc,char** argv)
+{
+  int numEdges = (int)ArgOrDefault(argc,argv,3,1000);
+  Real radius = ArgOrDefault(argc,argv,4,0.5);
+  int maxThreads = (int)ArgOrDefault(argc,argv,5,8);
+  PlanningSpace space(world);
+  return TestParallelEdgeChecking(space.cspace,numEdges,radius,maxThreads) ? 0 : 1;
+}
+
+int TestAdvancement(RobotWorld& world,int argc,char** argv)
+{
+  int numEdges = (int)ArgOrDefault(argc,argv,3,1000);
+  Real radius = ArgOrDefault(argc,argv,4,0.5);
+  PlanningSpace space(world);
+  return TestConservativeAdvancement(space.cspace,numEdges,radius) ? 0 : 1;
+}
+
+int TestLazy(RobotWorld& world,int argc,char** argv)
+{
+  int numQueries = (int)ArgOrDefault(argc,argv,3,10);
+  int maxIters = (int)ArgOrDefault(argc,argv,4,1000);
+  PlanningSpace space(world);
+  return TestLazyPlanning(space.cspace,numQueries,maxIters) ? 0 : 1;
+}
+
+int TestReuse(RobotWorld& world,int argc,char** argv)
+{
+  int numCycles = (int)ArgOrDefault(argc,argv,3,20);
+  Real cycleTime = ArgOrDefault(argc,argv,4,0.1);
+  PlanningSpace space(world);
+  return TestTreeReuse(space.cspace,numCycles,cycleTime) ? 0 : 1;
+}
+
+int TestTimeScaling(RobotWorld& world,int argc,char** argv)
+{
+  if(argc < 4) {
+    printf("%s",USAGE_STRING);
+    return 1;
+  }
+  int maxBisections = (int)ArgOrDefault(argc,argv,4,3);
+  return TestTimeScalingSolvers(*world.robots[0],argv[3],maxBisections) ? 0 : 1;
+}
+
+int TestInterpolation(RobotWorld& world,int argc,char** argv)
+{
+  if(argc < 4) {
+    printf("%s",USAGE_STRING);
+    return 1;
+  }
+  Real xtol = ArgOrDefault(argc,argv,4,0.05);
+  return TestConstrainedInterpolation(*world.robots[0],argv[3],xtol) ? 0 : 1;
+}
+
+int TestCache(RobotWorld& world,int argc,char** argv)
+{
+  int numConfigs = (int)ArgOrDefault(argc,argv,3,1000);
+  int numRepeats = (int)ArgOrDefault(argc,argv,4,10);
+  Real radius = ArgOrDefault(argc,argv,5,1e-3);
+  PlanningSpace space(world);
+  return TestFeasibilityCache(space.cspace,numConfigs,numRepeats,radius) ? 0 : 1;
+}
+
+int TestEvaluation(RobotWorld& world,int argc,char** argv)
+{
+  int numMilestones = (int)ArgOrDefault(argc,argv,3,20);
+  int numTimes = (int)ArgOrDefault(argc,argv,4,100000);
+  PlanningSpace space(world);
+  ParabolicRamp::DynamicPath path;
+  if(!MakeRandomPath(space.cspace,numMilestones,path)) {
+    printf("Unable to make a path through the milestones\n");
+    return 1;
+  }
+  return TestBatchEvaluation(path,numTimes) ? 0 : 1;
+}
+
+int TestNearest(RobotWorld& world,int argc,char** argv)
+{
+  int numConfigs = (int)ArgOrDefault(argc,argv,3,10000);
+  int numQueries = (int)ArgOrDefault(argc,argv,4,1000);
+  PlanningSpace space(world);
+  return TestNearestNeighborIndex(space.cspace,numConfigs,numQueries) ? 0 : 1;
+}
+
+int TestBroadPhase(RobotWorld& world,int argc,char** argv)
+{
+  int numConfigs = (int)ArgOrDefault(argc,argv,3,1000);
+  PlanningSpace space(world);
+  return TestBroadPhaseQueries(space.cspace,numConfigs) ? 0 : 1;
+}
+
+int TestSpin(RobotWorld& world,int argc,char** argv)
+{
+  int numConfigs = (int)ArgOrDefault(argc,argv,3,1000);
+  PlanningSpace space(world);
+  return TestSpinJointDistance(space.cspace,numConfigs) ? 0 : 1;
+}
+
+int main(int argc,char** argv)
+{
+  if(argc < 3) {
+    printf("%s",USAGE_STRING);
+    return 0;
+  }
+  XmlWorld xmlWorld;
+  RobotWorld world;
+  if(!LoadWorld(argv[2],xmlWorld,world)) return 1;
+  if(0==strcmp(argv[1],"simulation"))
+    return TestSimulation(xmlWorld,world,argc,argv);
+  if(0==strcmp(argv[1],"batch"))
+    return TestBatch(xmlWorld,world,argc,argv);
+  if(0==strcmp(argv[1],"snapshot"))
+    return TestSnapshot(xmlWorld,world,argc,argv);
+  if(0==strcmp(argv[1],"contactcache"))
+    return TestContactCache(xmlWorld,world,argc,argv);
+  if(0==strcmp(argv[1],"allocations"))
+    return TestAllocations(xmlWorld,world,argc,argv);
+  if(0==strcmp(argv[1],"feasibility"))
+    return TestFeasibility(world,argc,argv);
+  if(0==strcmp(argv[1],"edges"))
+    return TestEdges(world,argc,argv);
+  if(0==strcmp(argv[1],"advancement"))
+    return TestAdvancement(world,argc,argv);
+  if(0==strcmp(argv[1],"lazy"))
+    return TestLazy(world,argc,argv);
+  if(0==strcmp(argv[1],"reuse"))
+    return TestReuse(world,argc,argv);
+  if(0==strcmp(argv[1],"timescaling"))
+    return TestTimeScaling(world,argc,argv);
+  if(0==strcmp(argv[1],"interpolation"))
+    return TestInterpolation(world,argc,argv);
+  if(0==strcmp(argv[1],"cache"))
+    return TestCache(world,argc,argv);
+  if(0==strcmp(argv[1],"evaluation"))
+    return TestEvaluation(world,argc,argv);
+  if(0==strcmp(argv[1],"nearest"))
+    return TestNearest(world,argc,argv);
+  if(0==strcmp(argv[1],"broadphase"))
+    return TestBroadPhase(world,argc,argv);
+  if(0==strcmp(argv[1],"spin"))
+    return TestSpin(world,argc,argv);
+  fprintf(stderr,"Unknown test %s\n",argv[1]);
+  printf("%s",USAGE_STRING);
+  return 1;
+}
@@ -3,17 +3,41 @@
 #include <KrisLibrary/math/random.h>
 #include <KrisLibrary/math/differentiation.h>
 #include <KrisLibrary/utils/AnyCollection.h>
+#include <KrisLibrary/utils/stringutils.h>
 #include "Planning/TimeScaling.h"
 #include "Planning/RobotTimeScaling.h"
 #include "Planning/RobotConstrainedInterpolator.h"
 #include "Planning/ContactTimeScaling.h"
 #include "Contact/Utils.h"
 #include "Modeling/MultiPath.h"
+#include "Modeling/ThreadPool.h"
 #include <KrisLibrary/Timer.h>
 #include <fstream>
+#include <sstream>
+#include <string.h>
 using namespace std;
 using namespace Math3D;
 
+/** @brief Timing and constraint activity of one retimed path, reported in the
+ * batch mode summary.  Times are in seconds.
+ */
+struct TrajOptStats
+{
+  TrajOptStats()
+    :loadTime(0),interpolateTime(0),constraintTime(0),optimizeTime(0),totalTime(0),
+     numSegments(0),duration(0),numVelocityLimited(0),numConstraintLimited(0),numActiveConstraints(0)
+  {}
+
+  Real loadTime,interpolateTime,constraintTime,optimizeTime,totalTime;
+  ///number of segments of the interpolated path
+  int numSegments;
+  ///execution time of the optimized trajectory
+  Real duration;
+  ///number of grid points at the velocity limit, grid segments limited by
+  ///a constraint plane, and active constraint planes in total
+  int numVelocityLimited,numConstraintLimited,numActiveConstraints;
+};
+
 /** @brief Completely interpolates, optimizes, and time-scales the
  * given MultiPath to satisfy its contact constraints.
  *
@@ -37,6 +61,9 @@ using namespace Math3D;
  * - savePath: if true, saves the interpolated MultiPath to disk.
  * - saveConstraints: if true, saves the time scaling convex program constraints
  *   to disk.
+ * - numThreads: the number of threads used to compute the colocation point
+ *   constraints.
+ * - stats: if non-NULL, the timing and constraint activity are returned here.
  * 
  * Return value is true if interpolation / time scaling was successful.
  * Failure indicates that the milestones could not be interpolated, or 
@@ -50,7 +77,9 @@ bool ContactOptimizeMultipath(Robot& robot,const MultiPath& path,
 			      Real frictionRobustness=0.0,
 			      Real forceRobustness=0.0,
 			      bool savePath = true,
-			      bool saveConstraints = false)
+			      bool saveConstraints = false,
+			      int numThreads = 1,
+			      TrajOptStats* stats = NULL)
 {
   Assert(torqueRobustness < 1.0);
   Assert(frictionRobustness < 1.0);
@@ -67,6 +96,10 @@ bool ContactOptimizeMultipath(Robot& robot,const MultiPath& path,
   for(size_t i=0;i<ipath.sections.size();i++)
     ns += ipath.sections[i].milestones.size()-1;
   printf("Interpolated at resolution %g to %d segments, time %g\n",interpTol,ns,timer.ElapsedTime());
+  if(stats) {
+    stats->numSegments = ns;
+    stats->interpolateTime = timer.ElapsedTime();
+  }
   if(savePath)
   {
     cout<<"Saving interpolated geometric path to temp.xml"<<endl;
@@ -85,7 +118,12 @@ bool ContactOptimizeMultipath(Robot& robot,const MultiPath& path,
   scaling.frictionRobustness = frictionRobustness;
   scaling.torqueLimitScale = 1.0-torqueRobustness;
   scaling.forceRobustness = forceRobustness;
+  scaling.numThreads = numThreads;
+  //multipliers give the constraint activity
+  scaling.computeLagrangeMultipliers = (stats != NULL);
   res=scaling.SetParams(ipath,divs);
+  Real constraintTime = timer.ElapsedTime();
+  if(stats) stats->constraintTime = constraintTime;
 
   /*
   scaling.SetPath(ipath,divs);
@@ -121,6 +159,19 @@ bool ContactOptimizeMultipath(Robot& robot,const MultiPath& path,
     return false;
   }
   printf("Time scaling solved in time %g, execution time %g\n",timer.ElapsedTime(),scaling.traj.timeScaling.times.back());
+  if(stats) {
+    stats->optimizeTime = timer.ElapsedTime()-constraintTime;
+    stats->duration = scaling.traj.timeScaling.times.back();
+    for(size_t i=0;i<scaling.variableLagrangeMultipliers.size();i++)
+      if(scaling.variableLagrangeMultipliers[i] != 0) stats->numVelocityLimited++;
+    for(size_t i=0;i<scaling.constraintLagrangeMultipliers.size();i++) {
+      int numActive = 0;
+      for(size_t j=0;j<scaling.constraintLagrangeMultipliers[i].size();j++)
+	if(scaling.constraintLagrangeMultipliers[i][j] != 0) numActive++;
+      if(numActive > 0) stats->numConstraintLimited++;
+      stats->numActiveConstraints += numActive;
+    }
+  }
   //scaling.Check(ipath);
 
   traj = scaling.traj;
@@ -142,6 +193,10 @@ public:
     //(*this)["forceRobustness"]=5;
     (*this)["outputPath"] = string("trajopt.path");
     (*this)["outputDt"] = 0.1;
+    (*this)["numThreads"] = 1;
+    //batch mode only
+    (*this)["batchThreads"] = 4;
+    (*this)["summaryFile"] = string("trajopt_summary.json");
   }
   bool read(const char* fn) {
     ifstream in(fn,ios::in);
@@ -153,36 +208,48 @@ public:
   }
 };
 
-void ContactOptimizeMultipath(const char* robfile,const char* pathfile,const char* settingsfile = NULL)
+/** @brief The values of a ContactOptimizeSettings.  Read once so that the
+ * batch mode threads don't share the AnyCollection.
+ */
+struct ContactOptimizeParams
 {
-  ContactOptimizeSettings settings;
-  if(settingsfile != NULL) {
-    if(!settings.read(settingsfile)) {
-      printf("Unable to read settings file %s\n",settingsfile);
-      return;
-    }
+  void Get(ContactOptimizeSettings& settings) {
+    xtol=Real(settings["xtol"]);
+    numdivs = int(settings["numdivs"]);
+    ignoreForces = bool(settings["ignoreForces"]);
+    torqueRobustness = Real(settings["torqueRobustness"]);
+    frictionRobustness = Real(settings["frictionRobustness"]);
+    forceRobustness = Real(settings["forceRobustness"]);
+    settings["outputPath"].as(outputPath);
+    outputDt = Real(settings["outputDt"]);
+    numThreads = int(settings["numThreads"]);
   }
-  Real xtol=Real(settings["xtol"]);
-  int numdivs = int(settings["numdivs"]);
-  bool ignoreForces = bool(settings["ignoreForces"]);
-  Real torqueRobustness = Real(settings["torqueRobustness"]);
-  Real frictionRobustness = Real(settings["frictionRobustness"]);
-  Real forceRobustness = Real(settings["forceRobustness"]);
-  string outputPath;
-  settings["outputPath"].as(outputPath);
-  Real outputDt = Real(settings["outputDt"]);
 
-  Robot robot;
-  if(!robot.Load(robfile)) {
-    printf("Unable to load robot file %s\n",robfile);
-    return;
-  }
+  Real xtol;
+  int numdivs;
+  bool ignoreForces;
+  Real torqueRobustness,frictionRobustness,forceRobustness;
+  string outputPath;
+  Real outputDt;
+  int numThreads;
+};
 
+/** @brief Loads, retimes, and saves the MultiPath in pathfile to outputPath.
+ *
+ * If interactive is false, the user is not prompted about suspicious stances
+ * and the interpolated path and constraint plot are not saved, since they
+ * would be overwritten by the other paths of a batch.  If stats is non-NULL,
+ * the timing and constraint activity are returned there.
+ */
+bool RetimeMultipathFile(Robot& robot,const char* pathfile,const ContactOptimizeParams& params,const string& outputPath,bool interactive=true,TrajOptStats* stats=NULL)
+{
+  Timer timer;
   MultiPath path;
   if(!path.Load(pathfile)) {
     printf("Unable to load path file %s\n",pathfile);
-    return;
+    return false;
   }
+  if(stats) stats->loadTime = timer.ElapsedTime();
 
   //double check friction
   for(size_t i=0;i<path.sections.size();i++) {
@@ -202,23 +269,29 @@ void ContactOptimizeMultipath(const char* robfile,const char* pathfile,const cha
 	}
     }
     path.SetStance(s,i);
-    if(numContacts == 0 && !ignoreForces && robot.joints[0].type == RobotJoint::Floating) {
+    if(numContacts == 0 && !params.ignoreForces && robot.joints[0].type == RobotJoint::Floating) {
       printf("Warning, no contacts given in stance %d for floating-base robot\n",i);
       printf("Should set ignoreForces = true in trajopt.settings if you wish\n");
       printf("to ignore contact force constraints.\n");
-      printf("Press enter to continue...\n");
-      getchar();
+      if(interactive) {
+	printf("Press enter to continue...\n");
+	getchar();
+      }
     }
   }
 
   TimeScaledBezierCurve opttraj;
-  if(ignoreForces) {
-    bool res=GenerateAndTimeOptimizeMultiPath(robot,path,xtol,outputDt);
+  if(params.ignoreForces) {
+    bool res=GenerateAndTimeOptimizeMultiPath(robot,path,params.xtol,params.outputDt);
     if(!res) {
       printf("Time optimization failed\n");
-      return;
+      return false;
     }
     Assert(path.HasTiming());
+    if(stats) {
+      stats->optimizeTime = timer.ElapsedTime()-stats->loadTime;
+      stats->duration = path.Duration();
+    }
     cout<<"Saving dynamically optimized path to "<<outputPath<<endl;
     ofstream out(outputPath.c_str(),ios::out);
     for(size_t i=0;i<path.sections.size();i++) {
@@ -229,14 +302,15 @@ void ContactOptimizeMultipath(const char* robfile,const char* pathfile,const cha
   }
   else {
     
-    bool res=ContactOptimizeMultipath(robot,path,xtol,
-				 numdivs,opttraj,
-				 torqueRobustness,
-				 frictionRobustness,
-				 forceRobustness);
+    bool res=ContactOptimizeMultipath(robot,path,params.xtol,
+				 params.numdivs,opttraj,
+				 params.torqueRobustness,
+				 params.frictionRobustness,
+				 params.forceRobustness,
+				 interactive,false,params.numThreads,stats);
     if(!res) {
       printf("Time optimization failed\n");
-      return;
+      return false;
     }
     RobotCSpace cspace(robot);
     RobotGeodesicManifold manifold(robot);
@@ -245,25 +319,187 @@ void ContactOptimizeMultipath(const char* robfile,const char* pathfile,const cha
       opttraj.path.segments[i].manifold = &manifold;
     }
     vector<Config> milestones;
-    opttraj.GetDiscretizedPath(outputDt,milestones);
+    opttraj.GetDiscretizedPath(params.outputDt,milestones);
     cout<<"Saving dynamically optimized path to "<<outputPath<<endl;
     ofstream out(outputPath.c_str(),ios::out);
     for(size_t i=0;i<milestones.size();i++) {
-      out<<i*outputDt<<"\t"<<milestones[i]<<endl;
+      out<<i*params.outputDt<<"\t"<<milestones[i]<<endl;
     }
     out.close();
 
-    printf("Plotting vel/acc constraints to trajopt_plot.csv...\n");
-    opttraj.Plot("trajopt_plot.csv",robot.velMin,robot.velMax,-1.0*robot.accMax,robot.accMax);
+    if(interactive) {
+      printf("Plotting vel/acc constraints to trajopt_plot.csv...\n");
+      opttraj.Plot("trajopt_plot.csv",robot.velMin,robot.velMax,-1.0*robot.accMax,robot.accMax);
+    }
   }
+  if(stats) stats->totalTime = timer.ElapsedTime();
+  return true;
+}
+
+void ContactOptimizeMultipath(const char* robfile,const char* pathfile,const char* settingsfile = NULL)
+{
+  ContactOptimizeSettings settings;
+  if(settingsfile != NULL) {
+    if(!settings.read(settingsfile)) {
+      printf("Unable to read settings file %s\n",settingsfile);
+      return;
+    }
+  }
+  ContactOptimizeParams params;
+  params.Get(settings);
+
+  Robot robot;
+  if(!robot.Load(robfile)) {
+    printf("Unable to load robot file %s\n",robfile);
+    return;
+  }
+
+  RetimeMultipathFile(robot,pathfile,params,params.outputPath);
+}
+
+struct BatchJob
+{
+  string pathFile,outputFile;
+  bool success;
+  TrajOptStats stats;
+};
+
+class BatchRetimeBody : public ParallelForBody
+{
+public:
+  BatchRetimeBody(const Robot& robot,int numThreads,const ContactOptimizeParams& _params,vector<BatchJob>& _jobs)
+    :robots(numThreads,robot),params(_params),jobs(_jobs)
+  {}
+  virtual bool operator ()(int i,int thread)
+  {
+    BatchJob& job = jobs[i];
+    job.success = RetimeMultipathFile(robots[thread],job.pathFile.c_str(),params,job.outputFile,false,&job.stats);
+    return true;
+  }
+
+  //the interpolation and time scaling change the robot's configuration, so
+  //each thread has its own copy
+  vector<Robot> robots;
+  const ContactOptimizeParams& params;
+  vector<BatchJob>& jobs;
+};
+
+/** @brief Retimes all the MultiPaths listed in a manifest file, loading the
+ * robot only once.
+ *
+ * Each line of the manifest gives a MultiPath file, optionally followed by
+ * the output file.  The default output for foo.xml is foo_opt.path.  Blank
+ * lines and lines starting with # are skipped.
+ *
+ * The paths are retimed by settings["batchThreads"] threads, each with its
+ * own copy of the robot.  The time scaling LPs only run concurrently if
+ * GLPK gives each thread its own environment (see
+ * CustomTimeScaling::LPReentrant); otherwise they are solved one at a time
+ * and the speedup comes from the interpolation and constraints.  The
+ * timing and constraint activity of every path are written to the JSON file
+ * settings["summaryFile"].
+ *
+ * Returns the number of paths that failed.
+ */
+int BatchContactOptimizeMultipath(const char* robfile,const char* manifestfile,const char* settingsfile = NULL)
+{
+  ContactOptimizeSettings settings;
+  if(settingsfile != NULL) {
+    if(!settings.read(settingsfile)) {
+      printf("Unable to read settings file %s\n",settingsfile);
+      return -1;
+    }
+  }
+  ContactOptimizeParams params;
+  params.Get(settings);
+  int batchThreads = int(settings["batchThreads"]);
+  string summaryFile;
+  settings["summaryFile"].as(summaryFile);
+
+  vector<BatchJob> jobs;
+  ifstream in(manifestfile,ios::in);
+  if(!in) {
+    printf("Unable to read manifest file %s\n",manifestfile);
+    return -1;
+  }
+  string line;
+  while(getline(in,line)) {
+    stringstream ss(line);
+    BatchJob job;
+    if(!(ss>>job.pathFile) || job.pathFile[0]=='#') continue;
+    if(!(ss>>job.outputFile)) {
+      job.outputFile = job.pathFile;
+      StripExtension(job.outputFile);
+      job.outputFile += "_opt.path";
+    }
+    job.success = false;
+    jobs.push_back(job);
+  }
+  in.close();
+
+  Timer timer;
+  Robot robot;
+  if(!robot.Load(robfile)) {
+    printf("Unable to load robot file %s\n",robfile);
+    return -1;
+  }
+  Real robotLoadTime = timer.ElapsedTime();
+
+  batchThreads = Max(1,Min(batchThreads,(int)jobs.size()));
+  printf("Retiming %d paths on %d threads\n",(int)jobs.size(),batchThreads);
+  ThreadPool pool(batchThreads,CustomTimeScaling::InitLPThread,CustomTimeScaling::ExitLPThread);
+  BatchRetimeBody body(robot,batchThreads,params,jobs);
+  pool.ParallelFor(0,(int)jobs.size(),body);
+  Real totalTime = timer.ElapsedTime();
+
+  int numFailed = 0;
+  AnyCollection summary;
+  summary["robot"] = string(robfile);
+  summary["manifest"] = string(manifestfile);
+  summary["batchThreads"] = batchThreads;
+  summary["robotLoadTime"] = robotLoadTime;
+  summary["totalTime"] = totalTime;
+  summary["paths"].resize(jobs.size());
+  for(size_t i=0;i<jobs.size();i++) {
+    const TrajOptStats& stats = jobs[i].stats;
+    AnyCollection& entry = summary["paths"][(int)i];
+    entry["file"] = jobs[i].pathFile;
+    entry["output"] = jobs[i].outputFile;
+    entry["success"] = jobs[i].success;
+    entry["loadTime"] = stats.loadTime;
+    entry["interpolateTime"] = stats.interpolateTime;
+    entry["constraintTime"] = stats.constraintTime;
+    entry["optimizeTime"] = stats.optimizeTime;
+    entry["totalTime"] = stats.totalTime;
+    entry["numSegments"] = stats.numSegments;
+    entry["duration"] = stats.duration;
+    entry["numVelocityLimited"] = stats.numVelocityLimited;
+    entry["numConstraintLimited"] = stats.numConstraintLimited;
+    entry["numActiveConstraints"] = stats.numActiveConstraints;
+    if(!jobs[i].success) numFailed++;
+  }
+  summary["numFailed"] = numFailed;
+  printf("Retimed %d of %d paths in time %g, saving summary to %s\n",(int)jobs.size()-numFailed,(int)jobs.size(),totalTime,summaryFile.c_str());
+  ofstream out(summaryFile.c_str(),ios::out);
+  out<<summary<<endl;
+  out.close();
+  return numFailed;
 }
 
 
 int main(int argc, char** argv)
 {
   Robot::disableGeometryLoading = true;
+  if(argc >= 4 && 0==strcmp(argv[1],"-batch")) {
+    const char* settingsFile = NULL;
+    if(argc >= 5)
+      settingsFile = argv[4];
+    int numFailed = BatchContactOptimizeMultipath(argv[2],argv[3],settingsFile);
+    return (numFailed == 0 ? 0 : 1);
+  }
   if(argc < 3) {
     printf("Usage: TrajOpt robot multipath [settings]\n");
+    printf("       TrajOpt -batch robot manifest [settings]\n");
     printf("Saving settings template to trajopt_default.settings...\n");
     ContactOptimizeSettings settings;
     ofstream out("trajopt_default.settings",ios::out);
@@ -31,6 +31,7 @@
 #include "DynamicPath.h"
 #include <KrisLibrary/Timer.h>
 #include "Config.h"
+#include "ThreadPool.h"
 #include <KrisLibrary/math/math.h>
 #include <KrisLibrary/math/infnan.h>
 #include <assert.h>
@@ -172,6 +173,56 @@ void DynamicPath::Accel(Real t,Vector& ddx) const
   }
 }
 
+//Evaluates the positions or derivatives of the path at the sorted times ts,
+//with the same segment and boundary conventions as Evaluate / Derivative
+void EvaluatePathBatch(const vector<ParabolicRampND>& ramps,const vector<Real>& ts,vector<Real>& out,bool derivative)
+{
+  PARABOLIC_RAMP_ASSERT(!ramps.empty());
+  int d = (int)ramps.front().x0.size();
+  int n = (int)ts.size();
+  out.resize(n*d);
+  if(d == 0) return;
+  const Vector& xstart = (derivative ? ramps.front().dx0 : ramps.front().x0);
+  const Vector& xend = (derivative ? ramps.back().dx1 : ramps.back().x1);
+  int k=0;
+  for(;k<n && ts[k]<0;k++)
+    copy(xstart.begin(),xstart.end(),out.begin()+k*d);
+  ParabolicRampNDBatch batch;
+  vector<Real> u;
+  size_t seg=0;
+  Real start=0;
+  while(k<n) {
+    while(seg<ramps.size() && ts[k] > start+ramps[seg].endTime) {
+      start += ramps[seg].endTime;
+      seg++;
+    }
+    if(seg == ramps.size()) break;
+    Real end = start+ramps[seg].endTime;
+    u.resize(0);
+    int k2=k;
+    for(;k2<n && ts[k2]<=end;k2++) {
+      PARABOLIC_RAMP_ASSERT(k2 == 0 || ts[k2] >= ts[k2-1]);
+      u.push_back(ts[k2]-start);
+    }
+    batch.Set(ramps[seg]);
+    if(derivative) batch.Derivative(&u[0],k2-k,&out[k*d]);
+    else batch.Evaluate(&u[0],k2-k,&out[k*d]);
+    k = k2;
+  }
+  for(;k<n;k++)
+    copy(xend.begin(),xend.end(),out.begin()+k*d);
+}
+
+void DynamicPath::EvaluateBatch(const vector<Real>& ts,vector<Real>& x) const
+{
+  EvaluatePathBatch(ramps,ts,x,false);
+}
+
+void DynamicPath::DerivativeBatch(const vector<Real>& ts,vector<Real>& dx) const
+{
+  EvaluatePathBatch(ramps,ts,dx,true);
+}
+
 bool DynamicPath::SolveMinTime(const Vector& x0,const Vector& dx0,const Vector& x1,const Vector& dx1)
 {
   if(xMin.empty()) {
@@ -782,6 +833,150 @@ int DynamicPath::Shortcut(int numIters,RampFeasibilityChecker& check,RandomNumbe
   return shortcuts;
 }
 
+struct ShortcutCandidate
+{
+  Real t1,t2,u1,u2;
+  int i1,i2;
+  bool feasible;
+  Real savings;
+  std::vector<ParabolicRampND> ramps;
+};
+
+//sorts candidates by decreasing savings, ties broken by the order drawn
+struct ShortcutSavingsOrder
+{
+  ShortcutSavingsOrder(const vector<ShortcutCandidate>& _candidates) : candidates(_candidates) {}
+  bool operator () (int a,int b) const {
+    if(candidates[a].savings != candidates[b].savings)
+      return candidates[a].savings > candidates[b].savings;
+    return a < b;
+  }
+  const vector<ShortcutCandidate>& candidates;
+};
+
+void CheckShortcut(const DynamicPath& path,DynamicPath& intermediate,RampFeasibilityChecker& check,ShortcutCandidate& c)
+{
+  c.feasible = false;
+  Vector x0,x1,dx0,dx1;
+  path.ramps[c.i1].Evaluate(c.u1,x0);
+  path.ramps[c.i2].Evaluate(c.u2,x1);
+  path.ramps[c.i1].Derivative(c.u1,dx0);
+  path.ramps[c.i2].Derivative(c.u2,dx1);
+  if(!intermediate.SolveMinTime(x0,dx0,x1,dx1)) return;
+  c.savings = (c.t2-c.t1)-intermediate.GetTotalTime();
+  if(c.savings <= 0) return;
+  for(size_t i=0;i<intermediate.ramps.size();i++)
+    if(!check.Check(intermediate.ramps[i])) return;
+  c.ramps = intermediate.ramps;
+  c.feasible = true;
+}
+
+//checks candidate k with the checker and scratch path of the calling thread
+struct ShortcutCheckBody : public ParallelForBody
+{
+  virtual bool operator ()(int k,int thread)
+  {
+    CheckShortcut(*path,intermediates[thread],*(*checks)[thread],(*candidates)[k]);
+    return true;
+  }
+
+  const DynamicPath* path;
+  const vector<RampFeasibilityChecker*>* checks;
+  vector<DynamicPath> intermediates;
+  vector<ShortcutCandidate>* candidates;
+};
+
+int DynamicPath::ParallelShortcut(int numIters,const vector<RampFeasibilityChecker*>& checks,RandomNumberGeneratorBase* rng,int batchSize)
+{
+  PARABOLIC_RAMP_ASSERT(!checks.empty());
+  int numThreads = (int)checks.size();
+  if(batchSize <= 0) batchSize = 4*numThreads;
+  int shortcuts = 0;
+  vector<Real> rampStartTime;
+  vector<ShortcutCandidate> candidates;
+  vector<int> order;
+  //the threads are started once and check every batch
+  ThreadPool pool(numThreads);
+  ShortcutCheckBody body;
+  body.path = this;
+  body.checks = &checks;
+  body.candidates = &candidates;
+  body.intermediates.resize(numThreads);
+  for(int k=0;k<numThreads;k++) {
+    body.intermediates[k].Init(velMax,accMax);
+    if(!xMin.empty()) body.intermediates[k].SetJointLimits(xMin,xMax);
+  }
+  for(int iters=0;iters<numIters;) {
+    rampStartTime.resize(ramps.size());
+    Real endTime=0;
+    for(size_t i=0;i<ramps.size();i++) {
+      rampStartTime[i] = endTime;
+      endTime += ramps[i].endTime;
+    }
+    //draw the batch serially so that it only depends on rng
+    candidates.resize(0);
+    for(int k=0;k<batchSize && iters<numIters;k++,iters++) {
+      ShortcutCandidate c;
+      c.t1=rng->Rand()*endTime;
+      c.t2=rng->Rand()*endTime;
+      if(c.t1 > c.t2) Swap(c.t1,c.t2);
+      c.i1 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),c.t1)-rampStartTime.begin()-1;
+      c.i2 = std::upper_bound(rampStartTime.begin(),rampStartTime.end(),c.t2)-rampStartTime.begin()-1;
+      if(c.i1 == c.i2) continue; //same ramp
+      c.u1 = Min(c.t1-rampStartTime[c.i1],ramps[c.i1].endTime);
+      c.u2 = Min(c.t2-rampStartTime[c.i2],ramps[c.i2].endTime);
+      c.feasible = false;
+      c.savings = 0;
+      candidates.push_back(c);
+    }
+    if(candidates.empty()) continue;
+
+    pool.ParallelFor(0,(int)candidates.size(),body);
+
+    //pick the best shortcuts that don't share ramps
+    order.resize(0);
+    for(size_t k=0;k<candidates.size();k++)
+      if(candidates[k].feasible) order.push_back((int)k);
+    if(order.empty()) continue;
+    sort(order.begin(),order.end(),ShortcutSavingsOrder(candidates));
+    vector<int> committed;
+    for(size_t k=0;k<order.size();k++) {
+      const ShortcutCandidate& c = candidates[order[k]];
+      bool overlap = false;
+      for(size_t j=0;j<committed.size();j++) {
+        const ShortcutCandidate& d = candidates[committed[j]];
+        if(c.i1 <= d.i2 && d.i1 <= c.i2) { overlap = true; break; }
+      }
+      if(!overlap) committed.push_back(order[k]);
+    }
+    //apply from last to first, so the ramp indices of the earlier ones stay
+    //valid
+    vector<pair<int,int> > byStart(committed.size());
+    for(size_t j=0;j<committed.size();j++)
+      byStart[j] = pair<int,int>(candidates[committed[j]].i1,committed[j]);
+    sort(byStart.begin(),byStart.end());
+    for(int j=(int)byStart.size()-1;j>=0;j--) {
+      const ShortcutCandidate& c = candidates[byStart[j].second];
+      ramps[c.i1].TrimBack(ramps[c.i1].endTime-c.u1);
+      ramps[c.i1].x1 = c.ramps.front().x0;
+      ramps[c.i1].dx1 = c.ramps.front().dx0;
+      ramps[c.i2].TrimFront(c.u2);
+      ramps[c.i2].x0 = c.ramps.back().x1;
+      ramps[c.i2].dx0 = c.ramps.back().dx1;
+      ramps.erase(ramps.begin()+c.i1+1,ramps.begin()+c.i2);
+      ramps.insert(ramps.begin()+c.i1+1,c.ramps.begin(),c.ramps.end());
+      shortcuts++;
+    }
+
+    //check for consistency
+    for(size_t i=0;i+1<ramps.size();i++) {
+      PARABOLIC_RAMP_ASSERT(ramps[i].x1 == ramps[i+1].x0);
+      PARABOLIC_RAMP_ASSERT(ramps[i].dx1 == ramps[i+1].dx0);
+    }
+  }
+  return shortcuts;
+}
+
 int DynamicPath::ShortCircuit(RampFeasibilityChecker& check)
 {
   int shortcuts=0;
@@ -101,6 +101,22 @@ class RandomNumberGeneratorBase
   virtual Real Rand() { return Math::Rand(); }
 };
 
+/** @brief A seeded random number generator (the 48-bit linear congruential
+ * generator of drand48) with its own state, so that several threads can
+ * draw repeatable sequences without sharing the global generator.
+ */
+class SeededRandomNumberGenerator : public RandomNumberGeneratorBase
+{
+ public:
+  SeededRandomNumberGenerator(unsigned long seed=0) { Seed(seed); }
+  void Seed(unsigned long seed) { state = ((unsigned long long)seed << 16) | 0x330e; }
+  virtual Real Rand() {
+    state = (state*0x5deece66dull + 0xb) & 0xffffffffffffull;
+    return Real(state)/281474976710656.0;
+  }
+  unsigned long long state;
+};
+
 
 /** @brief A bounded-velocity, bounded-acceleration trajectory consisting
  * of parabolic ramps.
@@ -128,6 +144,11 @@ class DynamicPath
   void Evaluate(Real t,Vector& x) const;
   void Derivative(Real t,Vector& dx) const;
   void Accel(Real t,Vector& ddx) const;
+  /// Evaluates the path at the sorted times ts into the row-major
+  /// ts.size() x d array x.  Walks the ramps in order rather than searching
+  /// for the segment of each time.
+  void EvaluateBatch(const std::vector<Real>& ts,std::vector<Real>& x) const;
+  void DerivativeBatch(const std::vector<Real>& ts,std::vector<Real>& dx) const;
   bool SolveMinTime(const Vector& x0,const Vector& dx0,const Vector& x1,const Vector& dx1);
   bool SolveMinAccel(const Vector& x0,const Vector& dx0,const Vector& x1,const Vector& dx1,Real endTime);
   bool SetMilestones(const std::vector<Vector>& x);
@@ -140,6 +161,15 @@ class DynamicPath
   bool TryShortcut(Real t1,Real t2,RampFeasibilityChecker& check);
   int Shortcut(int numIters,RampFeasibilityChecker& check);
   int Shortcut(int numIters,RampFeasibilityChecker& check,RandomNumberGeneratorBase* rng);
+  /// Shortcutting on checks.size() threads, thread k checking with
+  /// checks[k], so each checker must be usable independently of the others.
+  /// The threads are started once per call and reused for every batch.
+  /// Candidate pairs are drawn from rng in batches of batchSize (default
+  /// 4 per thread) and checked in parallel.  The successful shortcuts of a
+  /// batch are committed greedily in order of decreasing time savings,
+  /// skipping those that share a ramp with one already committed.  The
+  /// result depends only on rng and the checkers, not on thread timing.
+  int ParallelShortcut(int numIters,const std::vector<RampFeasibilityChecker*>& checks,RandomNumberGeneratorBase* rng,int batchSize=0);
   int ShortCircuit(RampFeasibilityChecker& check);
   /// leadTime: the amount of time before this path should be executable
   /// padTime: an approximate bound on the time it takes to check a shortcut
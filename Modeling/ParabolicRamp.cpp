@@ -2321,6 +2321,20 @@ void ParabolicRampND::Accel(Real t,Vector& x) const
     x[j]=ramps[j].Accel(t);
 }
 
+void ParabolicRampND::EvaluateBatch(const Real* ts,int n,Real* x) const
+{
+  ParabolicRampNDBatch batch;
+  batch.Set(*this);
+  batch.Evaluate(ts,n,x);
+}
+
+void ParabolicRampND::DerivativeBatch(const Real* ts,int n,Real* dx) const
+{
+  ParabolicRampNDBatch batch;
+  batch.Set(*this);
+  batch.Derivative(ts,n,dx);
+}
+
 void ParabolicRampND::Output(Real dt,std::vector<Vector>& path) const
 {
   PARABOLIC_RAMP_ASSERT(!ramps.empty());
@@ -2355,6 +2369,67 @@ void ParabolicRampND::Output(Real dt,std::vector<Vector>& path) const
   */
 }
 
+void ParabolicRampNDBatch::Set(const ParabolicRampND& ramp)
+{
+  d = (int)ramp.ramps.size();
+  x0.resize(d); dx0.resize(d); x1.resize(d); dx1.resize(d);
+  tswitch1.resize(d); tswitch2.resize(d); ttotal.resize(d);
+  a1.resize(d); v.resize(d); a2.resize(d);
+  xswitch.resize(d);
+  for(int j=0;j<d;j++) {
+    const ParabolicRamp1D& r = ramp.ramps[j];
+    x0[j] = r.x0; dx0[j] = r.dx0; x1[j] = r.x1; dx1[j] = r.dx1;
+    tswitch1[j] = r.tswitch1; tswitch2[j] = r.tswitch2; ttotal[j] = r.ttotal;
+    a1[j] = r.a1; v[j] = r.v; a2[j] = r.a2;
+    xswitch[j] = r.x0 + 0.5*r.a1*r.tswitch1*r.tswitch1 + r.dx0*r.tswitch1;
+  }
+}
+
+//Same cases as ParabolicRamp1D::Evaluate and Derivative, but all pieces are
+//computed and the result is selected, which compiles to blends rather than
+//branches
+void ParabolicRampNDBatch::Evaluate(const Real* ts,int n,Real* x) const
+{
+  if(d == 0) return;
+  const Real* px0=&x0[0],*pdx0=&dx0[0],*px1=&x1[0],*pdx1=&dx1[0];
+  const Real* pt1=&tswitch1[0],*pt2=&tswitch2[0],*pT=&ttotal[0];
+  const Real* pa1=&a1[0],*pv=&v[0],*pa2=&a2[0],*pxs=&xswitch[0];
+  for(int i=0;i<n;i++) {
+    Real t = ts[i];
+    Real* xi = x+i*d;
+    for(int j=0;j<d;j++) {
+      Real tmT = t - pT[j];
+      Real p0 = px0[j] + 0.5*pa1[j]*t*t + pdx0[j]*t;
+      Real p1 = pxs[j] + (t-pt1[j])*pv[j];
+      Real p2 = px1[j] + 0.5*pa2[j]*tmT*tmT + pdx1[j]*tmT;
+      Real p = (t >= pT[j] ? px1[j] : p2);
+      p = (t < pt2[j] ? p1 : p);
+      p = (t < pt1[j] ? p0 : p);
+      xi[j] = (t < 0 ? px0[j] : p);
+    }
+  }
+}
+
+void ParabolicRampNDBatch::Derivative(const Real* ts,int n,Real* dx) const
+{
+  if(d == 0) return;
+  const Real* pdx0=&dx0[0],*pdx1=&dx1[0];
+  const Real* pt1=&tswitch1[0],*pt2=&tswitch2[0],*pT=&ttotal[0];
+  const Real* pa1=&a1[0],*pv=&v[0],*pa2=&a2[0];
+  for(int i=0;i<n;i++) {
+    Real t = ts[i];
+    Real* dxi = dx+i*d;
+    for(int j=0;j<d;j++) {
+      Real tmT = t - pT[j];
+      Real p0 = pa1[j]*t + pdx0[j];
+      Real p2 = pa2[j]*tmT + pdx1[j];
+      Real p = (t >= pT[j] ? pdx1[j] : p2);
+      p = (t < pt2[j] ? pv[j] : p);
+      p = (t < pt1[j] ? p0 : p);
+      dxi[j] = (t < 0 ? pdx0[j] : p);
+    }
+  }
+}
 
 void ParabolicRampND::Dilate(Real timeScale)
 {
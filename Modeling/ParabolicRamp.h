@@ -120,6 +120,10 @@ class ParabolicRampND
   void Evaluate(Real t,Vector& x) const;
   void Derivative(Real t,Vector& dx) const;
   void Accel(Real t,Vector& ddx) const;
+  /// Evaluates the ramp at the n times ts, writing row i of the row-major
+  /// n x d array x (d = ramps.size()) with the configuration at ts[i]
+  void EvaluateBatch(const Real* ts,int n,Real* x) const;
+  void DerivativeBatch(const Real* ts,int n,Real* dx) const;
   void Output(Real dt,std::vector<Vector>& path) const;
   void Dilate(Real timeScale);
   void TrimFront(Real tcut);
@@ -139,6 +143,30 @@ class ParabolicRampND
   std::vector<ParabolicRamp1D> ramps;
 };
 
+/** @brief The 1D ramps of a ParabolicRampND laid out as one array per
+ * coefficient, for evaluating many times at once.
+ *
+ * Evaluate and Derivative compute every piece of the ramps and select the
+ * right one without branching, so that the loop over dimensions can be
+ * vectorized.  The results are the same as ParabolicRamp1D's.
+ */
+class ParabolicRampNDBatch
+{
+ public:
+  void Set(const ParabolicRampND& ramp);
+  /// Writes the configurations at the n times ts into the rows of the
+  /// row-major n x d array x
+  void Evaluate(const Real* ts,int n,Real* x) const;
+  void Derivative(const Real* ts,int n,Real* dx) const;
+
+  int d;
+  Vector x0,dx0,x1,dx1;
+  Vector tswitch1,tswitch2,ttotal;
+  Vector a1,v,a2;
+  /// Position at tswitch1
+  Vector xswitch;
+};
+
 /// Computes a min-time ramp from (x0,v0) to (x1,v1) under the given
 /// acceleration, velocity, and x bounds.  Returns true if successful.
 bool SolveMinTimeBounded(Real x0,Real v0,Real x1,Real v1,
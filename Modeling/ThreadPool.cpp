@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+using namespace std;
+
+ThreadPool::ThreadPool(int numThreads,void (*_threadInit)(),void (*_threadExit)())
+  :threadInit(_threadInit),threadExit(_threadExit),generation(0),numBusy(0),quit(false),body(NULL),end(0),chunkSize(1),next(0),stopped(false)
+{
+  Start(numThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+  Stop();
+}
+
+void ThreadPool::Resize(int numThreads)
+{
+  if(numThreads < 1) numThreads = 1;
+  if(numThreads == NumThreads()) return;
+  std::lock_guard<std::mutex> lock(runMutex);
+  Stop();
+  Start(numThreads);
+}
+
+void ThreadPool::Start(int numThreads)
+{
+  quit = false;
+  for(int k=1;k<numThreads;k++)
+    workers.push_back(std::thread(&ThreadPool::WorkerLoop,this,k,generation));
+}
+
+void ThreadPool::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    quit = true;
+  }
+  wake.notify_all();
+  for(size_t k=0;k<workers.size();k++)
+    workers[k].join();
+  workers.clear();
+}
+
+//seen is the generation at Start, so that a loop posted before this thread
+//gets going is not missed
+void ThreadPool::WorkerLoop(int thread,int seen)
+{
+  if(threadInit) threadInit();
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(poolMutex);
+      while(!quit && generation == seen)
+	wake.wait(lock);
+      if(quit) break;
+      seen = generation;
+    }
+    RunChunks(thread);
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      numBusy--;
+      if(numBusy == 0) finished.notify_all();
+    }
+  }
+  if(threadExit) threadExit();
+}
+
+void ThreadPool::RunChunks(int thread)
+{
+  while(!stopped) {
+    int start = next.fetch_add(chunkSize);
+    if(start >= end) break;
+    int stop = (end-start > chunkSize ? start+chunkSize : end);
+    for(int i=start;i<stop;i++) {
+      if(!(*body)(i,thread)) {
+	stopped = true;
+	break;
+      }
+    }
+  }
+}
+
+bool ThreadPool::ParallelFor(int begin,int _end,ParallelForBody& _body,int _chunkSize)
+{
+  if(_end <= begin) return true;
+  if(_chunkSize < 1) _chunkSize = 1;
+  std::lock_guard<std::mutex> runLock(runMutex);
+  if(workers.empty() || _end-begin <= _chunkSize) {
+    for(int i=begin;i<_end;i++)
+      if(!_body(i,0)) return false;
+    return true;
+  }
+  body = &_body;
+  end = _end;
+  chunkSize = _chunkSize;
+  next = begin;
+  stopped = false;
+  {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    numBusy = (int)workers.size();
+    generation++;
+  }
+  wake.notify_all();
+  RunChunks(0);
+  {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    while(numBusy > 0)
+      finished.wait(lock);
+  }
+  body = NULL;
+  return !stopped;
+}
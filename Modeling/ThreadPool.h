@@ -0,0 +1,79 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/** @ingroup Modeling
+ * @brief The loop body run by ThreadPool::ParallelFor.
+ *
+ * Called as body(i,thread) for each index i, where thread in
+ * [0,pool.NumThreads()) identifies the calling thread so that the body can
+ * keep per-thread workspaces.  Return false to stop handing out the
+ * remaining indices; calls that already started still finish.
+ */
+class ParallelForBody
+{
+public:
+  virtual ~ParallelForBody() {}
+  virtual bool operator ()(int i,int thread)=0;
+};
+
+/** @ingroup Modeling
+ * @brief A fixed set of worker threads that run ParallelFor loops.
+ *
+ * The threads are started once and sleep between loops, so a loop costs a
+ * wakeup rather than a thread creation per call.  The thread that calls
+ * ParallelFor works on the loop as thread 0 and the workers are threads
+ * 1,...,NumThreads()-1.
+ *
+ * If threadInit is given, each worker calls it once when it starts, and
+ * threadExit once before it quits.  This sets up per-thread library state,
+ * e.g., ODE's collider data.
+ *
+ * Indices are handed out in chunks of chunkSize from a shared counter, so
+ * the assignment of indices to threads varies from run to run.  Bodies
+ * that need repeatable results should write into per-index outputs.
+ *
+ * Loops on one pool run one at a time, and a body must not start a loop on
+ * the pool that is running it.
+ */
+class ThreadPool
+{
+public:
+  ThreadPool(int numThreads=1,void (*threadInit)()=NULL,void (*threadExit)()=NULL);
+  ~ThreadPool();
+  int NumThreads() const { return (int)workers.size()+1; }
+  ///Stops the workers and starts numThreads-1 new ones, if the count changed
+  void Resize(int numThreads);
+  ///Runs body(i,thread) for i in [begin,end) and returns once all calls
+  ///have finished.  Returns false if the body stopped the loop.
+  bool ParallelFor(int begin,int end,ParallelForBody& body,int chunkSize=1);
+
+private:
+  void Start(int numThreads);
+  void Stop();
+  void WorkerLoop(int thread,int seen);
+  void RunChunks(int thread);
+
+  void (*threadInit)();
+  void (*threadExit)();
+  std::vector<std::thread> workers;
+  //serializes ParallelFor calls
+  std::mutex runMutex;
+  //guards generation, numBusy, and quit
+  std::mutex poolMutex;
+  std::condition_variable wake,finished;
+  int generation,numBusy;
+  bool quit;
+  //the current loop
+  ParallelForBody* body;
+  int end,chunkSize;
+  std::atomic<int> next;
+  std::atomic<bool> stopped;
+};
+
+#endif
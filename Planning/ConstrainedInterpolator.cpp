@@ -58,9 +58,6 @@ int DebugCurve(const GeneralizedCubicBezierCurve& c,Real duration)
       printf("x0 %g, x1 %g, x2 %g, x3 %g\n",c.x0[j],c.x1[j],c.x2[j],c.x3[j]);
       printf("duration %g\n",duration);
       printf("Deriv bounds %g %g, accel bounds %g %g\n",vmin[j],vmax[j],amin[j],amax[j]);
-
-      printf("Press enter to continue\n");
-      getchar();
       return j;
     }
   }
@@ -203,8 +200,60 @@ void ConditionMiddleTangent(GeneralizedCubicBezierCurve& c1,GeneralizedCubicBezi
   */
 }
 
+BroydenProjector::BroydenProjector(VectorFieldFunction* _C)
+  :C(_C),tolf(1e-4),numSolves(0),numFailures(0),numIters(0)
+{}
+
+bool BroydenProjector::Solve(Vector& x,Matrix& J,int maxIters)
+{
+  numSolves++;
+  if(J.m != C->NumDimensions() || J.n != x.n) {
+    //the estimate is for a different constraint or set of variables
+    numFailures++;
+    return false;
+  }
+  f.resize(J.m);
+  fnew.resize(J.m);
+  (*C)(x,f);
+  Real err = f.maxAbsElement();
+  for(int iters=0;iters<maxIters && err > tolf;iters++) {
+    numIters++;
+    //least-norm solution of the linearized constraint J dx = -f
+    if(!svd.set(J)) break;
+    svd.backSub(f,dx);
+    dx.inplaceNegative();
+    xnew.add(x,dx);
+    if(!bmin.empty()) {
+      for(int i=0;i<xnew.n;i++)
+	xnew(i) = Clamp(xnew(i),bmin(i),bmax(i));
+      dx.sub(xnew,x);
+    }
+    Real dx2 = dx.normSquared();
+    if(dx2 == 0) break;
+    (*C)(xnew,fnew);
+    Real newErr = fnew.maxAbsElement();
+    if(newErr >= err) break;
+    //rank-1 update so that J dx = fnew - f
+    J.mul(dx,y);
+    y.inplaceNegative();
+    y += fnew;
+    y -= f;
+    y /= dx2;
+    for(int i=0;i<J.m;i++)
+      for(int j=0;j<J.n;j++)
+	J(i,j) += y(i)*dx(j);
+    x = xnew;
+    f = fnew;
+    err = newErr;
+  }
+  if(err <= tolf) return true;
+  numFailures++;
+  return false;
+}
+
+
 ConstrainedInterpolator::ConstrainedInterpolator(CSpace* _space,VectorFieldFunction* _constraint)
-  :space(_space),constraint(_constraint),inequalities(NULL),maxNewtonIters(10),ftol(1e-4),xtol(1e-3),maxGrowth(0.9),solver(_constraint)
+  :space(_space),constraint(_constraint),inequalities(NULL),maxNewtonIters(10),ftol(1e-4),xtol(1e-3),maxGrowth(0.9),reuseJacobians(false),solver(_constraint),projector(_constraint)
 {}
 
 
@@ -226,11 +275,47 @@ bool ConstrainedInterpolator::Project(Config& x)
   return true;
 }
 
+void ConstrainedInterpolator::ConstraintJacobian(const Config& x,Matrix& J)
+{
+  constraint->PreEval(x);
+  constraint->Jacobian(x,J);
+}
+
+bool ConstrainedInterpolator::ProjectFrom(Config& x,Matrix& J)
+{
+  //the quasi-Newton step doesn't handle inequalities; leave them to Project
+  if(inequalities) return false;
+  if(!constraint) return true;
+  projector.C = constraint;
+  projector.tolf = ftol;
+  if(!xmin.empty()) {
+    projector.bmin.setRef(xmin);
+    projector.bmax.setRef(xmax);
+  }
+  return projector.Solve(x,J,maxNewtonIters);
+}
+
+bool ConstrainedInterpolator::ProjectMidpoint(Config& x,const Matrix& Ja,const Matrix& Jb,Matrix& Jx)
+{
+  Config x0 = x;
+  if(Ja.m == Jb.m && Ja.n == Jb.n) {
+    Jx.add(Ja,Jb);
+    Jx.inplaceMul(0.5);
+    if(ProjectFrom(x,Jx)) return true;
+  }
+  //fall back to the full Newton solver from the original midpoint
+  x = x0;
+  if(!Project(x)) return false;
+  ConstraintJacobian(x,Jx);
+  return true;
+}
+
 struct Segment
 {
   inline bool operator < (const Segment& s) const { return length<s.length; }
   
   list<Config>::iterator prev;
+  list<Matrix>::iterator prevJ;
   Real length;
 };
 
@@ -254,20 +339,39 @@ bool ConstrainedInterpolator::Make(const Config& qa,const Config& qb,vector<Conf
   list<Config> lpath;
   lpath.push_back(qa);
   lpath.push_back(qb);
+  //constraint Jacobians at the points of lpath, if reuseJacobians is set
+  list<Matrix> ljac;
+  if(reuseJacobians) {
+    ljac.resize(2);
+    ConstraintJacobian(qb,ljac.back());
+    //the cached Jacobian is only reused if it was taken at qa and has the
+    //dimensions of the current constraint
+    if(cachedX.n == qa.n && cachedX.isEqual(qa,0) && cachedJ.m == ljac.back().m && cachedJ.n == ljac.back().n)
+      ljac.front() = cachedJ;
+    else
+      ConstraintJacobian(qa,ljac.front());
+  }
   priority_queue<Segment,vector<Segment> > q;
   Segment s;
   s.prev = lpath.begin();
+  s.prevJ = ljac.begin();
   s.length = space->Distance(qa,qb);
   q.push(s);
 
   Config x;
+  Matrix Jx;
   while(!q.empty()) {
     s=q.top(); q.pop();
     if(s.length <= xtol) continue;
     list<Config>::iterator a = s.prev;
     list<Config>::iterator b=a; b++;
+    list<Matrix>::iterator ja = s.prevJ, jb = s.prevJ;
+    if(reuseJacobians) jb++;
     space->Midpoint(*a,*b,x);
-    if(!Project(x)) {
+    bool res;
+    if(reuseJacobians) res = ProjectMidpoint(x,*ja,*jb,Jx);
+    else res = Project(x);
+    if(!res) {
       cout<<"Unable to project "<<x<<endl;
       cout<<"Midpoint "<<*a<<" -> "<<*b<<endl;
       return false;
@@ -278,6 +382,8 @@ bool ConstrainedInterpolator::Make(const Config& qa,const Config& qb,vector<Conf
     }
 
     list<Config>::iterator m=lpath.insert(b,x);
+    list<Matrix>::iterator jm = jb;
+    if(reuseJacobians) jm = ljac.insert(jb,Jx);
 
     //insert the split segments back in the queue
     Real l1=space->Distance(*a,x);
@@ -291,13 +397,19 @@ bool ConstrainedInterpolator::Make(const Config& qa,const Config& qb,vector<Conf
       return false;
     }
     s.prev = a;
+    s.prevJ = ja;
     s.length = l1;
     if(s.length > xtol) q.push(s);
 
     s.prev = m;
+    s.prevJ = jm;
     s.length = l2;
     if(s.length > xtol) q.push(s);
   }
+  if(reuseJacobians) {
+    cachedX = qb;
+    cachedJ = ljac.back();
+  }
 
   //read out the path
   path.resize(lpath.size());
@@ -321,11 +433,12 @@ struct Segment2
   inline bool operator < (const Segment2& s) const { return length<s.length; }
   
   list<pair<GeneralizedCubicBezierCurve,double> >::iterator prev;
+  list<Matrix>::iterator prevJ;
   Real length;
 };
 
 SmoothConstrainedInterpolator::SmoothConstrainedInterpolator(CSpace* _space,VectorFieldFunction* _constraint)
-  :space(_space),manifold(NULL),constraint(_constraint),inequalities(NULL),maxNewtonIters(10),ftol(1e-4),xtol(1e-3),maxGrowth(0.9),solver(_constraint)
+  :space(_space),manifold(NULL),constraint(_constraint),inequalities(NULL),maxNewtonIters(10),ftol(1e-4),xtol(1e-3),maxGrowth(0.9),reuseJacobians(false),solver(_constraint),projector(_constraint)
 {}
 
 bool SmoothConstrainedInterpolator::Make(const Config& a,const Config& b,
@@ -396,19 +509,36 @@ bool SmoothConstrainedInterpolator::Make(const Config& qa,const Vector& da,const
   ConditionTangents(curve);
 #endif
   lpath.push_back(pair<GeneralizedCubicBezierCurve,double>(curve,1.0));
+  //constraint Jacobians at the start of each curve of lpath and at qb, if
+  //reuseJacobians is set
+  list<Matrix> ljac;
+  if(reuseJacobians) {
+    ljac.resize(2);
+    ConstraintJacobian(qb,ljac.back());
+    //the cached Jacobian is only reused if it was taken at qa and has the
+    //dimensions of the current constraint
+    if(cachedX.n == qa.n && cachedX.isEqual(qa,0) && cachedJ.m == ljac.back().m && cachedJ.n == ljac.back().n)
+      ljac.front() = cachedJ;
+    else
+      ConstraintJacobian(qa,ljac.front());
+  }
   priority_queue<Segment2,vector<Segment2> > q;
   Segment2 s;
   s.prev = lpath.begin();
+  s.prevJ = ljac.begin();
   s.length = curve.OuterLength();
   q.push(s);
 
   GeneralizedCubicBezierCurve c1(space,manifold),c2(space,manifold);
   Config x,v;
+  Matrix Jx;
   while(!q.empty()) {
     s=q.top(); q.pop();
     if(s.length <= xtol) continue;
     list<pair<GeneralizedCubicBezierCurve,double> >::iterator c = s.prev;
     list<pair<GeneralizedCubicBezierCurve,double> >::iterator n = c; ++n;
+    list<Matrix>::iterator jc = s.prevJ, jn = s.prevJ;
+    if(reuseJacobians) ++jn;
 
     /*
     //optimize end tangents to release tension
@@ -437,7 +567,10 @@ bool SmoothConstrainedInterpolator::Make(const Config& qa,const Vector& da,const
     //cout<<"Depth: "<<c->second<<endl;
     //cout<<"Bspline midpoint: "<<x<<", "<<v<<endl;
     //cout<<"Original point :"<<x<<endl;
-    if(!Project(x)) {
+    bool res;
+    if(reuseJacobians) res = ProjectMidpoint(x,*jc,*jn,Jx);
+    else res = Project(x);
+    if(!res) {
       ConstraintValue(x,temp);
       if(verbose) cout<<"Projection of point "<<x<<" failed, "<<" error "<<temp.maxAbsElement()<<endl;
       return false;
@@ -599,6 +732,8 @@ bool SmoothConstrainedInterpolator::Make(const Config& qa,const Vector& da,const
     c->first = c1;
     c->second = 0.5*origDuration;
     list<pair<GeneralizedCubicBezierCurve,double> >::iterator m=lpath.insert(n,pair<GeneralizedCubicBezierCurve,double>(c2,0.5*origDuration));
+    list<Matrix>::iterator jm = jn;
+    if(reuseJacobians) jm = ljac.insert(jn,Jx);
     /*
     Assert(c->second == m->second);
     m--;
@@ -638,13 +773,19 @@ bool SmoothConstrainedInterpolator::Make(const Config& qa,const Vector& da,const
     }
     */
     s.prev = c;
+    s.prevJ = jc;
     s.length = l1;
     if(s.length > xtol) q.push(s);
 
     s.prev = m;
+    s.prevJ = jm;
     s.length = l2;
     if(s.length > xtol) q.push(s);
   }
+  if(reuseJacobians) {
+    cachedX = qb;
+    cachedJ = ljac.back();
+  }
 
 #if CONDITION_LEAF_TANGENTS
   for(list<pair<GeneralizedCubicBezierCurve,double> >::iterator i=lpath.begin();i!=lpath.end();i++) {
@@ -736,6 +877,41 @@ bool SmoothConstrainedInterpolator::Project(Config& x)
   return true;
 }
 
+void SmoothConstrainedInterpolator::ConstraintJacobian(const Config& x,Matrix& J)
+{
+  constraint->PreEval(x);
+  constraint->Jacobian(x,J);
+}
+
+bool SmoothConstrainedInterpolator::ProjectFrom(Config& x,Matrix& J)
+{
+  //the quasi-Newton step doesn't handle inequalities; leave them to Project
+  if(inequalities) return false;
+  if(!constraint) return true;
+  projector.C = constraint;
+  projector.tolf = ftol;
+  if(!xmin.empty()) {
+    projector.bmin.setRef(xmin);
+    projector.bmax.setRef(xmax);
+  }
+  return projector.Solve(x,J,maxNewtonIters);
+}
+
+bool SmoothConstrainedInterpolator::ProjectMidpoint(Config& x,const Matrix& Ja,const Matrix& Jb,Matrix& Jx)
+{
+  Config x0 = x;
+  if(Ja.m == Jb.m && Ja.n == Jb.n) {
+    Jx.add(Ja,Jb);
+    Jx.inplaceMul(0.5);
+    if(ProjectFrom(x,Jx)) return true;
+  }
+  //fall back to the full Newton solver from the original midpoint
+  x = x0;
+  if(!Project(x)) return false;
+  ConstraintJacobian(x,Jx);
+  return true;
+}
+
 
 
 
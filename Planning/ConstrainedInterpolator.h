@@ -4,8 +4,39 @@
 #include <KrisLibrary/math/function.h>
 #include <KrisLibrary/planning/GeneralizedBezierCurve.h>
 #include <KrisLibrary/optimization/Newton.h>
+#include <KrisLibrary/math/SVDecomposition.h>
 using namespace std;
 
+/** @ingroup Planning
+ * @brief Projects a point onto the constraint C(x)=0 with Newton steps that
+ * use an estimate J of the Jacobian of C, refined by Broyden rank-1 updates,
+ * rather than evaluating the Jacobian at every iterate.
+ *
+ * Intended to be started with the Jacobian of nearby points already on the
+ * constraint, such as the neighbors of a bisection midpoint.  Solve gives up
+ * as soon as a step fails to reduce the constraint error, in which case the
+ * caller should fall back to a full Newton solver.
+ */
+class BroydenProjector
+{
+ public:
+  BroydenProjector(VectorFieldFunction* C=NULL);
+  ///Projects x, returns true if max_i |C_i(x)| <= tolf within maxIters
+  ///steps.  J is updated to an estimate of the Jacobian at the new x.
+  bool Solve(Vector& x,Matrix& J,int maxIters);
+
+  VectorFieldFunction* C;
+  Vector bmin,bmax;   ///< if set, x is kept within these bounds
+  Real tolf;
+
+  //statistics
+  int numSolves,numFailures,numIters;
+
+  //temp
+  Vector f,fnew,dx,xnew,y;
+  RobustSVD<Real> svd;
+};
+
 /** @ingroup Planning
  * @brief Construct a polyline between a and b such that each point is near
  * the constraint C(x)=0.
@@ -23,6 +54,17 @@ using namespace std;
  * add to the total length of the path.  That is, when going from x1 to x2, the projected midpoint
  * xm is checked so that d(x1,xm) + d(xm,x2) <= (1+maxGrowth)d(x1,x2).
  * To ensure convergence this parameter should be < 1 (default 0.9).
+ *
+ * If reuseJacobians is true (default false), each midpoint is first
+ * projected by a BroydenProjector starting from the average of the
+ * constraint Jacobians at the segment's endpoints, and the resulting
+ * Jacobian estimate is kept for the midpoint's own subsegments.  Project is
+ * only called if that fails, or if inequalities are set.  The projected
+ * milestones may differ from those of Project, within ftol of the
+ * constraint.  The Jacobian at the end of one Make call is reused at the
+ * start of the next if it begins at the same configuration and has the
+ * same dimensions.  TestConstrainedInterpolation in Planning/SelfTest
+ * compares the two modes.
  */
 class ConstrainedInterpolator
 {
@@ -32,6 +74,14 @@ class ConstrainedInterpolator
   bool Make(const Config& a,const Config& b,vector<Config>& path,bool checkConstraints=false);
   virtual void ConstraintValue(const Config& x,Vector& v);
   virtual bool Project(Config& x);
+  ///Evaluates the Jacobian used by ProjectFrom at x
+  virtual void ConstraintJacobian(const Config& x,Matrix& J);
+  ///Projects x using the Jacobian estimate J, which is updated to an
+  ///estimate at the result
+  virtual bool ProjectFrom(Config& x,Matrix& J);
+  ///Projects the midpoint x of a segment whose endpoints have Jacobians
+  ///Ja and Jb, returns the Jacobian at x in Jx
+  bool ProjectMidpoint(Config& x,const Matrix& Ja,const Matrix& Jb,Matrix& Jx);
 
   CSpace* space;
   VectorFieldFunction* constraint;
@@ -40,9 +90,14 @@ class ConstrainedInterpolator
   int maxNewtonIters;
   Real ftol,xtol;
   Real maxGrowth;
+  bool reuseJacobians;
 
   //temp: solver
   Optimization::NewtonRoot solver;
+  BroydenProjector projector;
+  //Jacobian at the end of the last Make
+  Config cachedX;
+  Matrix cachedJ;
 };
 
 /** @ingroup Planning
@@ -67,6 +122,9 @@ class ConstrainedInterpolator
  * x1 to x2, the projected midpoint
  * xm is checked so that d(x1,xm), d(xm,x2) <= (1+maxGrowth)/2 d(x1,x2).
  * To ensure convergence this parameter should be < 1 (default 0.9).
+ *
+ * reuseJacobians works as in ConstrainedInterpolator.  This saves the most
+ * in MultiSmoothInterpolate, where consecutive Make calls share endpoints.
  */
 class SmoothConstrainedInterpolator
 {
@@ -82,6 +140,14 @@ class SmoothConstrainedInterpolator
   virtual void ConstraintValue(const Config& x,Vector& v);
   virtual bool Project(Config& x);
   virtual bool ProjectVelocity(const Config& x,Config& v);
+  ///Evaluates the Jacobian used by ProjectFrom at x
+  virtual void ConstraintJacobian(const Config& x,Matrix& J);
+  ///Projects x using the Jacobian estimate J, which is updated to an
+  ///estimate at the result
+  virtual bool ProjectFrom(Config& x,Matrix& J);
+  ///Projects the midpoint x of a segment whose endpoints have Jacobians
+  ///Ja and Jb, returns the Jacobian at x in Jx
+  bool ProjectMidpoint(Config& x,const Matrix& Ja,const Matrix& Jb,Matrix& Jx);
 
   CSpace* space;
   GeodesicManifold* manifold;
@@ -91,9 +157,14 @@ class SmoothConstrainedInterpolator
   int maxNewtonIters;
   Real ftol,xtol;
   Real maxGrowth;
+  bool reuseJacobians;
 
   //temp: solver
   Optimization::NewtonRoot solver;
+  BroydenProjector projector;
+  //Jacobian at the end of the last Make
+  Config cachedX;
+  Matrix cachedJ;
 };
 
 /// @ingroup Planning
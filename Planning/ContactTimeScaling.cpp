@@ -5,195 +5,187 @@
 #include <KrisLibrary/optimization/LinearProgram.h>
 #include <KrisLibrary/optimization/GLPKInterface.h>
 #include <KrisLibrary/geometry/PolytopeProjection.h>
+#include <KrisLibrary/utils/threadutils.h>
 using namespace Math3D;
 using namespace Optimization;
 
 #define TEST_NO_CONTACT 0
 
+/** @brief Computes the constraint planes of colocation points on its own
+ * copy of the robot's dynamics, so that points can be evaluated on
+ * separate threads.
+ *
+ * Each point writes only its own entries of ds2ddsConstraintNormals etc,
+ * and its planes don't depend on the other points, so the result is the
+ * same for any number of threads.
+ */
+class ColocationWorker
+{
+public:
+  ColocationWorker(const Robot& _robot)
+    :robot(_robot),ne(robot),feasible(true)
+  {}
+  virtual ~ColocationWorker() {}
+  ///Computes the planes of colocation point i, returns false if infeasible
+  virtual bool Eval(int i)=0;
 
+  RobotDynamics3D robot;
+  NewtonEulerSolver ne;
+  bool feasible;
+};
 
-ZMPTimeScaling::ZMPTimeScaling(Robot& robot)
-  :CustomTimeScaling(robot)
+//projects the feasible set of lp onto its first two variables.  Uses GLPK.
+static void ProjectPolytope(const LinearProgram_Sparse& lp,Geometry::UnboundedPolytope2D& poly)
 {
+  Geometry::PolytopeProjection2D proj(lp);
+  proj.Solve(poly);
 }
 
-void ZMPTimeScaling::SetParams(const MultiPath& path,const vector<Real>& colocationParams,
-          const vector<Vector2>& supportPoly,Real groundHeight)
+class ColocationBody : public ParallelForBody
 {
-  Assert(path.sections.size()==1);
-  vector<ConvexPolygon2D> sps(1);
-  sps[0].vertices = supportPoly;
-  if(!sps[0].isValid()) {
-    FatalError("Convex hull must be given in CCW order\n");
+public:
+  ColocationBody(vector<ColocationWorker*>& _workers) : workers(_workers) {}
+  virtual bool operator ()(int i,int thread)
+  {
+    if(!workers[thread]->Eval(i)) workers[thread]->feasible = false;
+    return true;
   }
-  vector<Real> groundHeights(1);
-  groundHeights[0] = groundHeight;
-  SetParams(path,colocationParams,sps,groundHeights);
-}
 
-void ZMPTimeScaling::SetParams(const MultiPath& path,const vector<Real>& paramDivs,const vector<ConvexPolygon2D>& supportPolys,const vector<Real>& groundHeights)
+  vector<ColocationWorker*>& workers;
+};
+
+///Evaluates the points [begin,end) on pool, with one worker per thread of
+///the pool.  Each thread takes a contiguous block of points, so that
+///ContactColocationWorker rarely changes sections.  Returns false if any
+///point is infeasible.
+bool EvalColocationPoints(ThreadPool& pool,vector<ColocationWorker*>& workers,int begin,int end)
 {
-  Robot& robot = cspace.robot;
-  Assert(path.sections.size()==supportPolys.size());
-  Assert(path.sections.size()==groundHeights.size());
-  this->supportPolys = supportPolys;
-  this->groundHeights = groundHeights;
-  CustomTimeScaling::SetPath(path,paramDivs);
-  CustomTimeScaling::SetDefaultBounds();
-  CustomTimeScaling::SetStartStop();
-  NewtonEulerSolver ne(robot);
-  for(size_t i=0;i<xs.size();i++) {
-    Vector3 cm,dcm0,ddcm0;
-    GetCOMDerivs(robot,xs[i],dxs[i],ddxs[i],cm,dcm0,ddcm0,ne);
-    int s = paramSections[i];
-    //ZMP.x = cm.x - (cm.z - groundHeights[s])/9.8 * ddcm.x 
-    //ZMP.y = cm.y - (cm.z - groundHeights[s])/9.8 * ddcm.y
-    //ddcm = ddcm0*ds2 + dcm0*dds
-    Real ddcmScale = (cm.z - groundHeights[s])/9.8;
-    Plane2D p;
-    for(size_t j=0;j<supportPolys[s].vertices.size();j++) {
-      supportPolys[s].getPlane(j,p);
-      //p.normal.x * ZMP.x + p.normal.y * ZMP.y <= p.offset
-      //p.normal.x * (cm.x - ddcmScale * ddcm.x ) + p.normal.y * (cm.y - ddcmScale * ddcm.y ) <= p.offset
-      //(-p.normal.x * ddcmScale * ddcm0.x - p.normal.y * ddcmScale * ddcm0.y)*ds2 
-      //  + (-p.normal.x * ddcmScale * dcm0.x - p.normal.y * ddcmScale * dcm0.y)*dds 
-      //  <= p.offset - p.normal.x * cm.x - p.normal.y * cm.y)
-      Real ds2term = - p.normal.x * ddcmScale * ddcm0.x - p.normal.y * ddcmScale * ddcm0.y;
-      Real ddsterm = - p.normal.x * ddcmScale * dcm0.x - p.normal.y * ddcmScale * dcm0.y;
-      ds2ddsConstraintNormals[i].push_back(Vector2(ds2term,ddsterm));
-      ds2ddsConstraintOffsets[i].push_back(p.offset - p.normal.x * cm.x - p.normal.y * cm.y);
-      if(saveConstraintNames) {
-        stringstream ss;
-        ss<<"sp_"<<s<<"_"<<j;
-        ds2ddsConstraintNames[i].push_back(ss.str());
-      }
-    }
-  }
+  Assert((int)workers.size() == pool.NumThreads());
+  int nt = (int)workers.size();
+  for(int k=0;k<nt;k++)
+    workers[k]->feasible = true;
+  ColocationBody body(workers);
+  pool.ParallelFor(begin,end,body,Max(1,(end-begin+nt-1)/nt));
+  bool feasible = true;
+  for(int k=0;k<nt;k++)
+    if(!workers[k]->feasible) feasible = false;
+  return feasible;
 }
 
-TorqueTimeScaling::TorqueTimeScaling(Robot& robot)
-  :CustomTimeScaling(robot),torqueLimitShift(0),torqueLimitScale(1)
-{}
-
-void TorqueTimeScaling::SetParams(const MultiPath& path,const vector<Real>& colocationParams)
+class TorqueColocationWorker : public ColocationWorker
 {
-  Robot& robot = cspace.robot;
-  CustomTimeScaling::SetPath(path,colocationParams);
-  CustomTimeScaling::SetDefaultBounds();
-  CustomTimeScaling::SetStartStop();
-
-  NewtonEulerSolver ne(robot);
-  //kinetic energy, coriolis force, gravity
-  Vector3 gravity(0,0,-9.8);
-  Matrix B;
-  Vector C,G;
-  //coefficients of time scaling
-  Vector a,b,c;
-  for(size_t i=0;i<paramDivs.size();i++) {
-    robot.UpdateConfig(xs[i]);
-    robot.dq = dxs[i];
+public:
+  TorqueColocationWorker(TorqueTimeScaling* _scaling)
+    :ColocationWorker(_scaling->cspace.robot),scaling(_scaling)
+  {}
+  virtual bool Eval(int i)
+  {
+    TorqueTimeScaling& s = *scaling;
+    //kinetic energy, coriolis force, gravity
+    Vector3 gravity(0,0,-9.8);
+    robot.UpdateConfig(s.xs[i]);
+    robot.dq = s.dxs[i];
     ne.CalcKineticEnergyMatrix(B);
     ne.CalcResidualTorques(C);
     robot.GetGravityTorques(gravity,G);
-    ne.MulKineticEnergyMatrix(dxs[i],a);
-    ne.MulKineticEnergyMatrix(ddxs[i],b);
+    ne.MulKineticEnergyMatrix(s.dxs[i],a);
+    ne.MulKineticEnergyMatrix(s.ddxs[i],b);
     b += C;
     c = G;
     //Torque is given by a*dds + b*ds^2 + c = t
     for(int j=0;j<robot.torqueMax.n;j++) {
-      Real tmax = robot.torqueMax(j)*torqueLimitScale + torqueLimitShift;
+      Real tmax = robot.torqueMax(j)*s.torqueLimitScale + s.torqueLimitShift;
       if(tmax < 0) tmax=0;
       //b*ds^2 + a*dds <= tmax - c
       //-b*ds^2 - a*dds <= tmax + c
-      ds2ddsConstraintNormals[i].push_back(Vector2(b(j),a(j)));
-      ds2ddsConstraintOffsets[i].push_back(tmax-c(j));
-      ds2ddsConstraintNormals[i].push_back(Vector2(-b(j),-a(j)));
-      ds2ddsConstraintOffsets[i].push_back(tmax+c(j));
-      if(saveConstraintNames) {
+      s.ds2ddsConstraintNormals[i].push_back(Vector2(b(j),a(j)));
+      s.ds2ddsConstraintOffsets[i].push_back(tmax-c(j));
+      s.ds2ddsConstraintNormals[i].push_back(Vector2(-b(j),-a(j)));
+      s.ds2ddsConstraintOffsets[i].push_back(tmax+c(j));
+      if(s.saveConstraintNames) {
         stringstream ss;
         ss<<"tmax_"<<j;
-        ds2ddsConstraintNames[i].push_back(ss.str());
+        s.ds2ddsConstraintNames[i].push_back(ss.str());
       }
-      if(saveConstraintNames) {
+      if(s.saveConstraintNames) {
         stringstream ss;
         ss<<"tmin_"<<j;
-        ds2ddsConstraintNames[i].push_back(ss.str());
+        s.ds2ddsConstraintNames[i].push_back(ss.str());
       }
     }
+    return true;
   }
-}
-
 
-ContactTimeScaling::ContactTimeScaling(Robot& robot)
-  :CustomTimeScaling(robot),torqueLimitShift(0),torqueLimitScale(1.0),frictionRobustness(0),forceRobustness(0)
-{
-}
+  TorqueTimeScaling* scaling;
+  //coefficients of time scaling
+  Matrix B;
+  Vector C,G,a,b,c;
+};
 
-bool ContactTimeScaling::SetParams(const MultiPath& path,const vector<Real>& paramDivs,int numFCEdges)
+class ContactColocationWorker : public ColocationWorker
 {
-  Robot& robot = cspace.robot;
-  CustomTimeScaling::SetPath(path,paramDivs);
-  CustomTimeScaling::SetDefaultBounds();
-  CustomTimeScaling::SetStartStop();
-
-  ContactFormation formation;
-  int oldSection = -1;
-  LinearProgram_Sparse lp;
-  NewtonEulerSolver ne(robot);
-  //kinetic energy, coriolis force, gravity
-  Vector3 gravity(0,0,-9.8);
-  Vector C,G;
-  //coefficients of time scaling
-  Vector a,b,c;
-  bool feasible=true;
-  for(size_t i=0;i<paramDivs.size();i++) {
-    Assert(paramSections[i] >= 0 && paramSections[i] < (int)path.sections.size());
-    if(paramSections[i] != oldSection) {
-      //reconstruct LP for the contacts in this section
-      Stance stance;
-      path.GetStance(stance,paramSections[i]);
-      ToContactFormation(stance,formation);
-      for(size_t j=0;j<formation.contacts.size();j++)
-	for(size_t k=0;k<formation.contacts[j].size();k++) {
-	  Assert(formation.contacts[j][k].kFriction > 0);
-	  Assert(frictionRobustness < 1.0);
-	  formation.contacts[j][k].kFriction *= (1.0-frictionRobustness);
-	}
+public:
+  ContactColocationWorker(ContactTimeScaling* _scaling,const MultiPath& _path,int _numFCEdges)
+    :ColocationWorker(_scaling->cspace.robot),scaling(_scaling),path(_path),numFCEdges(_numFCEdges),section(-1)
+  {}
+  //sets up lpBase with the friction cones of the contacts in section s
+  void SetSection(int s)
+  {
+    ContactTimeScaling& cs = *scaling;
+    Stance stance;
+    path.GetStance(stance,s);
+    ToContactFormation(stance,formation);
+    for(size_t j=0;j<formation.contacts.size();j++)
+      for(size_t k=0;k<formation.contacts[j].size();k++) {
+	Assert(formation.contacts[j][k].kFriction > 0);
+	Assert(cs.frictionRobustness < 1.0);
+	formation.contacts[j][k].kFriction *= (1.0-cs.frictionRobustness);
+      }
 
-      //now formulate the LP.  Variable 0 is dds, variable 1 is ds^2
-      //rows 1-n are torque max
-      //rows n+1 - 2n are acceleration max
-      //rows 2n+1 + 2n+numFCEdges*nc are the force constraints
-      //vel max is encoded in the velocity variable
-      int n = (int)robot.links.size();
-      int nc = formation.numContactPoints();
+    //now formulate the LP.  Variable 0 is dds, variable 1 is ds^2
+    //rows 1-n are torque max
+    //rows n+1 - 2n are acceleration max
+    //rows 2n+1 + 2n+numFCEdges*nc are the force constraints
+    //vel max is encoded in the velocity variable
+    int n = (int)robot.links.size();
+    int nc = formation.numContactPoints();
 #if TEST_NO_CONTACT
-      nc = 0;
+    nc = 0;
 #endif // TEST_NO_CONTACT
-      lp.Resize(n*2+numFCEdges*nc,2+3*nc);
-      lp.A.setZero();
-      lp.c.setZero();
-      //fill out wrench matrix FC*f <= 0
+    lpBase.Resize(n*2+numFCEdges*nc,2+3*nc);
+    lpBase.A.setZero();
+    lpBase.c.setZero();
+    //fill out wrench matrix FC*f <= 0
 #if !TEST_NO_CONTACT
-      SparseMatrix FC;
-      GetFrictionConePlanes(formation,numFCEdges,FC);
-      lp.A.copySubMatrix(n*2,2,FC);
-      for(int j=0;j<FC.m;j++)
-	lp.p(n*2+j) = -forceRobustness;
+    SparseMatrix FC;
+    GetFrictionConePlanes(formation,numFCEdges,FC);
+    lpBase.A.copySubMatrix(n*2,2,FC);
+    for(int j=0;j<FC.m;j++)
+      lpBase.p(n*2+j) = -cs.forceRobustness;
 #endif // !TEST_NO_CONTACT
 
-      lp.l(0) = 0.0;
-      lp.l(1) = -Inf;
-
-      oldSection = paramSections[i];
-    }
+    lpBase.l(0) = 0.0;
+    lpBase.l(1) = -Inf;
+    section = s;
+  }
+  virtual bool Eval(int i)
+  {
+    ContactTimeScaling& cs = *scaling;
+    const Robot& orig = cs.cspace.robot;
+    Assert(cs.paramSections[i] >= 0 && cs.paramSections[i] < (int)path.sections.size());
+    if(cs.paramSections[i] != section)
+      SetSection(cs.paramSections[i]);
+    //start from the section's LP so the rows don't depend on prior points
+    lp = lpBase;
     //configuration specific 
-    robot.UpdateConfig(xs[i]);
-    robot.dq = dxs[i];
+    //kinetic energy, coriolis force, gravity
+    Vector3 gravity(0,0,-9.8);
+    robot.UpdateConfig(cs.xs[i]);
+    robot.dq = cs.dxs[i];
     ne.CalcResidualTorques(C);
     robot.GetGravityTorques(gravity,G);
-    ne.MulKineticEnergyMatrix(dxs[i],a);
-    ne.MulKineticEnergyMatrix(ddxs[i],b);
+    ne.MulKineticEnergyMatrix(cs.dxs[i],a);
+    ne.MulKineticEnergyMatrix(cs.ddxs[i],b);
     b += C;
     c = G;
 
@@ -201,7 +193,7 @@ bool ContactTimeScaling::SetParams(const MultiPath& path,const vector<Real>& par
     for(int j=0;j<a.n;j++) {
       lp.A(j,0) = b(j);
       lp.A(j,1) = a(j);
-      Real tmax = robot.torqueMax(j)*torqueLimitScale+torqueLimitShift;
+      Real tmax = robot.torqueMax(j)*cs.torqueLimitScale+cs.torqueLimitShift;
       if(tmax < 0) tmax=0;
       lp.p(j) = tmax-c(j);
       lp.q(j) = -tmax-c(j);
@@ -244,63 +236,164 @@ bool ContactTimeScaling::SetParams(const MultiPath& path,const vector<Real>& par
 
     //fill out acceleration constraint |ddx*ds^2 + dx*dds| <= amax
     for(int j=0;j<a.n;j++) {
-      lp.q(a.n+j) = -robot.accMax(j);
-      lp.p(a.n+j) = robot.accMax(j);
-      lp.A(a.n+j,0) = ddxs[i][j];
-      lp.A(a.n+j,1) = dxs[i][j];
+      lp.q(a.n+j) = -orig.accMax(j);
+      lp.p(a.n+j) = orig.accMax(j);
+      lp.A(a.n+j,0) = cs.ddxs[i][j];
+      lp.A(a.n+j,1) = cs.dxs[i][j];
     }
 
     //compute upper bounds from vel and acc max
     lp.u(0) = Inf; lp.u(1) = Inf;
     for(int j=0;j<a.n;j++) {
-      if(dxs[i][j] < 0)
-	lp.u(0) = Min(lp.u(0),Sqr(robot.velMin(j)/dxs[i][j]));
+      if(cs.dxs[i][j] < 0)
+	lp.u(0) = Min(lp.u(0),Sqr(robot.velMin(j)/cs.dxs[i][j]));
       else
-	lp.u(0) = Min(lp.u(0),Sqr(robot.velMax(j)/dxs[i][j]));
+	lp.u(0) = Min(lp.u(0),Sqr(robot.velMax(j)/cs.dxs[i][j]));
     }
 
     //expand polytope
-    Geometry::PolytopeProjection2D proj(lp);
     Geometry::UnboundedPolytope2D poly;
-    proj.Solve(poly);
+    if(CustomTimeScaling::LPReentrant())
+      ProjectPolytope(lp,poly);
+    else {
+      ScopedLock lock(CustomTimeScaling::lpMutex);
+      ProjectPolytope(lp,poly);
+    }
+    bool feasible = true;
     if(poly.vertices.empty()) {
       //problem is infeasible?
       printf("Problem is infeasible at segment %d\n",i);
-      cout<<"x = "<<xs[i]<<endl;
-      cout<<"dx = "<<dxs[i]<<endl;
-      cout<<"ddx = "<<ddxs[i]<<endl;
+      cout<<"x = "<<cs.xs[i]<<endl;
+      cout<<"dx = "<<cs.dxs[i]<<endl;
+      cout<<"ddx = "<<cs.ddxs[i]<<endl;
       lp.Print(cout);
-      getchar();
       feasible=false;
     }
-    /*
-    if(i == 49) {
-      cout<<"x = "<<xs[i]<<endl;
-      cout<<"dx = "<<dxs[i]<<endl;
-      cout<<"ddx = "<<ddxs[i]<<endl;
-      lp.Print(cout);
-      cout<<"Result: "<<endl;
-      for(size_t j=0;j<poly.planes.size();j++) 
-	cout<<poly.planes[j].normal.x<<" ds^2 + "<<poly.planes[j].normal.y<<" dds <= "<<poly.planes[j].offset<<endl;
-      cout<<"Vertices: "<<endl;
-      for(size_t j=0;j<poly.vertices.size();j++) {
-	cout<<poly.vertices[j]<<endl;
+    cs.ds2ddsConstraintNormals[i].resize(poly.planes.size());
+    cs.ds2ddsConstraintOffsets[i].resize(poly.planes.size());
+    for(size_t j=0;j<poly.planes.size();j++) {
+      cs.ds2ddsConstraintNormals[i][j] = poly.planes[j].normal;
+      cs.ds2ddsConstraintOffsets[i][j] = poly.planes[j].offset;
+      if(cs.saveConstraintNames) {
+        stringstream ss;
+        ss<<"projected_constraint_plane_"<<j;
+        cs.ds2ddsConstraintNames[i].push_back(ss.str());
       }
-      getchar();
     }
-    */
-    ds2ddsConstraintNormals[i].resize(poly.planes.size());
-    ds2ddsConstraintOffsets[i].resize(poly.planes.size());
-    for(size_t j=0;j<poly.planes.size();j++) {
-      ds2ddsConstraintNormals[i][j] = poly.planes[j].normal;
-      ds2ddsConstraintOffsets[i][j] = poly.planes[j].offset;
+    return feasible;
+  }
+
+  ContactTimeScaling* scaling;
+  const MultiPath& path;
+  int numFCEdges;
+  int section;
+  ContactFormation formation;
+  LinearProgram_Sparse lpBase,lp;
+  //coefficients of time scaling
+  Vector C,G,a,b,c;
+};
+
+
+
+ZMPTimeScaling::ZMPTimeScaling(Robot& robot)
+  :CustomTimeScaling(robot)
+{
+}
+
+void ZMPTimeScaling::SetParams(const MultiPath& path,const vector<Real>& colocationParams,
+          const vector<Vector2>& supportPoly,Real groundHeight)
+{
+  Assert(path.sections.size()==1);
+  vector<ConvexPolygon2D> sps(1);
+  sps[0].vertices = supportPoly;
+  if(!sps[0].isValid()) {
+    FatalError("Convex hull must be given in CCW order\n");
+  }
+  vector<Real> groundHeights(1);
+  groundHeights[0] = groundHeight;
+  SetParams(path,colocationParams,sps,groundHeights);
+}
+
+void ZMPTimeScaling::SetParams(const MultiPath& path,const vector<Real>& paramDivs,const vector<ConvexPolygon2D>& supportPolys,const vector<Real>& groundHeights)
+{
+  Robot& robot = cspace.robot;
+  Assert(path.sections.size()==supportPolys.size());
+  Assert(path.sections.size()==groundHeights.size());
+  this->supportPolys = supportPolys;
+  this->groundHeights = groundHeights;
+  CustomTimeScaling::SetPath(path,paramDivs);
+  CustomTimeScaling::SetDefaultBounds();
+  CustomTimeScaling::SetStartStop();
+  NewtonEulerSolver ne(robot);
+  for(size_t i=firstChangedPoint;i<xs.size();i++) {
+    Vector3 cm,dcm0,ddcm0;
+    GetCOMDerivs(robot,xs[i],dxs[i],ddxs[i],cm,dcm0,ddcm0,ne);
+    int s = paramSections[i];
+    //ZMP.x = cm.x - (cm.z - groundHeights[s])/9.8 * ddcm.x 
+    //ZMP.y = cm.y - (cm.z - groundHeights[s])/9.8 * ddcm.y
+    //ddcm = ddcm0*ds2 + dcm0*dds
+    Real ddcmScale = (cm.z - groundHeights[s])/9.8;
+    Plane2D p;
+    for(size_t j=0;j<supportPolys[s].vertices.size();j++) {
+      supportPolys[s].getPlane(j,p);
+      //p.normal.x * ZMP.x + p.normal.y * ZMP.y <= p.offset
+      //p.normal.x * (cm.x - ddcmScale * ddcm.x ) + p.normal.y * (cm.y - ddcmScale * ddcm.y ) <= p.offset
+      //(-p.normal.x * ddcmScale * ddcm0.x - p.normal.y * ddcmScale * ddcm0.y)*ds2 
+      //  + (-p.normal.x * ddcmScale * dcm0.x - p.normal.y * ddcmScale * dcm0.y)*dds 
+      //  <= p.offset - p.normal.x * cm.x - p.normal.y * cm.y)
+      Real ds2term = - p.normal.x * ddcmScale * ddcm0.x - p.normal.y * ddcmScale * ddcm0.y;
+      Real ddsterm = - p.normal.x * ddcmScale * dcm0.x - p.normal.y * ddcmScale * dcm0.y;
+      ds2ddsConstraintNormals[i].push_back(Vector2(ds2term,ddsterm));
+      ds2ddsConstraintOffsets[i].push_back(p.offset - p.normal.x * cm.x - p.normal.y * cm.y);
       if(saveConstraintNames) {
         stringstream ss;
-        ss<<"projected_constraint_plane_"<<j;
+        ss<<"sp_"<<s<<"_"<<j;
         ds2ddsConstraintNames[i].push_back(ss.str());
       }
     }
   }
+}
+
+TorqueTimeScaling::TorqueTimeScaling(Robot& robot)
+  :CustomTimeScaling(robot),torqueLimitShift(0),torqueLimitScale(1)
+{}
+
+void TorqueTimeScaling::SetParams(const MultiPath& path,const vector<Real>& colocationParams)
+{
+  CustomTimeScaling::SetPath(path,colocationParams);
+  CustomTimeScaling::SetDefaultBounds();
+  CustomTimeScaling::SetStartStop();
+
+  colocationPool.Resize(numThreads);
+  int nt = colocationPool.NumThreads();
+  vector<ColocationWorker*> workers(nt);
+  for(int k=0;k<nt;k++)
+    workers[k] = new TorqueColocationWorker(this);
+  EvalColocationPoints(colocationPool,workers,firstChangedPoint,(int)paramDivs.size());
+  for(int k=0;k<nt;k++)
+    delete workers[k];
+}
+
+
+ContactTimeScaling::ContactTimeScaling(Robot& robot)
+  :CustomTimeScaling(robot),torqueLimitShift(0),torqueLimitScale(1.0),frictionRobustness(0),forceRobustness(0)
+{
+}
+
+bool ContactTimeScaling::SetParams(const MultiPath& path,const vector<Real>& paramDivs,int numFCEdges)
+{
+  CustomTimeScaling::SetPath(path,paramDivs);
+  CustomTimeScaling::SetDefaultBounds();
+  CustomTimeScaling::SetStartStop();
+
+  colocationPool.Resize(numThreads);
+  int nt = colocationPool.NumThreads();
+  vector<ColocationWorker*> workers(nt);
+  for(int k=0;k<nt;k++)
+    workers[k] = new ContactColocationWorker(this,path,numFCEdges);
+  bool feasible = EvalColocationPoints(colocationPool,workers,firstChangedPoint,(int)paramDivs.size());
+  for(int k=0;k<nt;k++)
+    delete workers[k];
   //done!
   return feasible;
 }
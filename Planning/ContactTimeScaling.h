@@ -5,13 +5,20 @@
 #include "Modeling/MultiPath.h"
 #include "Modeling/Robot.h"
 #include "RobotCSpace.h"
+#include "Modeling/ThreadPool.h"
 #include <KrisLibrary/math3d/Polygon2D.h>
+#include <KrisLibrary/utils/threadutils.h>
 
 /** @brief A base class for a time scaling with colocation point constraints.
  * Subclasses should fill in dsmax, ds2ddsConstraintNormals, and
  * ds2ddsConstraintOffsets before Optimize is called.
  *
  * Output is given in traj.
+ *
+ * For editing the end of a long path, set reuseConstraints to true.  Then
+ * calling SetPath/SetParams on the edited path only recomputes the
+ * constraints of the colocation points from firstChangedPoint onward, and
+ * OptimizeFrom re-solves only the time scaling after the edit.
  */
 class CustomTimeScaling
 {
@@ -29,10 +36,34 @@ class CustomTimeScaling
   void SetDefaultBounds();
   ///Runs the optimizer with the custom constraints
   bool Optimize();
+  ///Re-optimizes only the part of the time scaling after the grid point
+  ///preceding param, keeping the previous solution in traj before it.  The
+  ///kept part also ends before the first colocation point whose parameter,
+  ///velocity bound, or constraint planes differ from those of the previous
+  ///solve.  Falls back to Optimize if there is no usable previous solution
+  ///or if the rest of the path can't be scaled from it.
+  ///
+  ///The result is optimal for the rest of the path given the kept part.  It
+  ///is not globally optimal if the kept rates were held back by constraints
+  ///that the edit loosened, so if the re-solved part would be faster with a
+  ///larger rate at its start, this also falls back to Optimize.
+  bool OptimizeFrom(Real param);
   ///Returns true if the time scaling derivatives are feasible under the current constraints
   bool IsFeasible(const vector<Real>& ds) const;
   ///After running Optimize, prints out all the active constraints 
   void PrintActiveConstraints(ostream& out);
+  ///Helper for OptimizeFrom: the number of leading colocation points whose
+  ///parameter, velocity bound, and constraint planes are the same as in the
+  ///last successful solve
+  int NumUnchangedPoints() const;
+  ///Helper for Optimize and OptimizeFrom: records the grid, velocity bounds,
+  ///and constraint planes of a successful solve, copying only the entries
+  ///from the colocation point first onward
+  void SaveSolvedConstraints(int first);
+  ///Helper for SetPath: sets firstChangedPoint by comparing to the previous
+  ///colocation points and clears the constraints from there onward
+  void ResetConstraints(const vector<Real>& oldParamDivs,const vector<int>& oldParamSections,
+			const vector<Vector>& oldxs,const vector<Vector>& olddxs,const vector<Vector>& oldddxs);
 
   RobotCSpace cspace;
   RobotGeodesicManifold manifold;
@@ -55,6 +86,38 @@ class CustomTimeScaling
   bool saveConstraintNames;
   vector<vector<string> > ds2ddsConstraintNames;
 
+  ///If true, SetPath keeps the constraint planes of the leading colocation
+  ///points whose parameter, section, and path derivatives are the same as
+  ///in the previous call (default false).  Only valid if the stances and
+  ///the other settings of the subclass are also unchanged at those points.
+  bool reuseConstraints;
+  ///Set by SetPath to the first colocation point whose constraint planes
+  ///need to be computed.  0 unless reuseConstraints is true.
+  int firstChangedPoint;
+  ///Number of threads used by TorqueTimeScaling and ContactTimeScaling to
+  ///compute the colocation point constraints (default 1).  Each thread works
+  ///on a contiguous block of points with its own copy of the robot, and the
+  ///constraints are identical for any number of threads.
+  int numThreads;
+  ///The threads that compute the colocation point constraints, kept between
+  ///calls to SetParams.  Each worker sets up its own GLPK environment.
+  ThreadPool colocationPool;
+  ///LPs solved on threads that share a GLPK environment take turns on this
+  ///mutex.  The time scaling SLP holds it from its first GLPK call until
+  ///the solver is destroyed, and the constraint projections of
+  ///ContactTimeScaling hold it for each projection.  Callers need not lock
+  ///it themselves.
+  static Mutex lpMutex;
+  ///True if GLPK gives each thread its own environment (GLPK >= 4.50 built
+  ///with thread-local storage), so that LPs need not lock lpMutex.  Tested
+  ///on a new thread at the first call.
+  static bool LPReentrant();
+  ///Set up and free the calling thread's GLPK environment if environments
+  ///are thread-local.  Pass them as the threadInit and threadExit of thread
+  ///pools whose workers solve time scaling LPs.
+  static void InitLPThread();
+  static void ExitLPThread();
+
   ///Whether the lagrange multipliers of a solution are requested
   bool computeLagrangeMultipliers;
   ///Lagrange multipliers for each velocity^2 variable's velocity^2 limit.
@@ -65,6 +128,17 @@ class CustomTimeScaling
   ///which the execution time would be reduced if the constraint plane is
   ///shifted outward.
   vector<vector<Real> > constraintLagrangeMultipliers;
+
+  ///The grid, velocity bounds, and constraint planes of the last successful
+  ///solve, which OptimizeFrom compares against
+  vector<Real> solvedParamDivs,solvedDsmax;
+  vector<vector<Vector2> > solvedConstraintNormals;
+  vector<vector<Real> > solvedConstraintOffsets;
+  ///The GLPK basis of the last successful solve: the variables at their
+  ///velocity bounds and the active constraints of each segment.  Used by
+  ///OptimizeFrom to warm-start the re-solve.
+  vector<int> solvedVelocityLimited;
+  vector<vector<int> > solvedActiveConstraints;
 };
 
 /** @brief A time scaling with torque constraints |t| <= tmax.
@@ -0,0 +1,126 @@
+#include "EdgeCheckCache.h"
+#include <math.h>
+using namespace std;
+
+EdgeCheckCache::EdgeCheckCache(Real _resolution,size_t _maxEntries)
+  :resolution(_resolution),maxEntries(_maxEntries)
+{
+  ClearStats();
+}
+
+bool EdgeCheckCache::SyncEnvironment(const vector<Geometry::AnyCollisionGeometry3D*>& geoms)
+{
+  if(!env.Update(geoms)) return false;
+  if(!lru.empty()) numInvalidations++;
+  lru.clear();
+  index.clear();
+  return true;
+}
+
+void EdgeCheckCache::MakeKey(const Config& a,const Config& b,int obstacle)
+{
+  key.resize(a.n);
+  kb.resize(b.n);
+  for(int i=0;i<a.n;i++) key[i] = (int)floor(a(i)/resolution);
+  for(int i=0;i<b.n;i++) kb[i] = (int)floor(b(i)/resolution);
+  //an edge and its reverse share a key
+  if(kb < key) key.swap(kb);
+  key.insert(key.end(),kb.begin(),kb.end());
+  key.push_back(obstacle);
+}
+
+int EdgeCheckCache::Lookup(const Config& a,const Config& b,int obstacle)
+{
+  MakeKey(a,b,obstacle);
+  map<vector<int>,EntryList::iterator>::iterator i = index.find(key);
+  if(i == index.end()) {
+    numMisses++;
+    return -1;
+  }
+  numHits++;
+  //move to the front of the LRU list
+  lru.splice(lru.begin(),lru,i->second);
+  return (lru.front().visible ? 1 : 0);
+}
+
+void EdgeCheckCache::Insert(const Config& a,const Config& b,int obstacle,bool visible)
+{
+  MakeKey(a,b,obstacle);
+  map<vector<int>,EntryList::iterator>::iterator i = index.find(key);
+  if(i != index.end()) {
+    i->second->visible = visible;
+    lru.splice(lru.begin(),lru,i->second);
+    return;
+  }
+  if(maxEntries > 0 && lru.size() >= maxEntries) {
+    index.erase(lru.back().key);
+    lru.pop_back();
+    numEvictions++;
+  }
+  lru.push_front(Entry());
+  lru.front().key = key;
+  lru.front().visible = visible;
+  index[key] = lru.begin();
+}
+
+void EdgeCheckCache::Clear()
+{
+  lru.clear();
+  index.clear();
+  env.Clear();
+  ClearStats();
+}
+
+void EdgeCheckCache::ClearStats()
+{
+  numHits = numMisses = numEvictions = numInvalidations = 0;
+}
+
+Real EdgeCheckCache::HitRate() const
+{
+  if(numHits+numMisses == 0) return 0;
+  return Real(numHits)/Real(numHits+numMisses);
+}
+
+
+
+CachedEdgePlanner::CachedEdgePlanner(EdgePlanner* _e,EdgeCheckCache* _cache,int _obstacle)
+  :e(_e),cache(_cache),obstacle(_obstacle),checked(0)
+{}
+
+bool CachedEdgePlanner::IsVisible()
+{
+  if(checked != 0) return checked > 0;
+  int res = cache->Lookup(e->Start(),e->Goal(),obstacle);
+  if(res < 0) {
+    res = (e->IsVisible() ? 1 : 0);
+    cache->Insert(e->Start(),e->Goal(),obstacle,res != 0);
+  }
+  checked = (res ? 1 : -1);
+  return checked > 0;
+}
+
+EdgePlanner* CachedEdgePlanner::Copy() const
+{
+  CachedEdgePlanner* copy = new CachedEdgePlanner(e->Copy(),cache,obstacle);
+  copy->checked = checked;
+  return copy;
+}
+
+EdgePlanner* CachedEdgePlanner::ReverseCopy() const
+{
+  CachedEdgePlanner* copy = new CachedEdgePlanner(e->ReverseCopy(),cache,obstacle);
+  copy->checked = checked;
+  return copy;
+}
+
+
+
+CachedEdgeCSpace::CachedEdgeCSpace(CSpace* baseSpace,Real resolution,size_t maxEntries)
+  :PiggybackCSpace(baseSpace),cache(resolution,maxEntries)
+{}
+
+EdgePlanner* CachedEdgeCSpace::LocalPlanner(const Config& a,const Config& b)
+{
+  return new CachedEdgePlanner(PiggybackCSpace::LocalPlanner(a,b),&cache);
+}
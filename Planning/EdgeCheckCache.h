@@ -0,0 +1,109 @@
+#ifndef EDGE_CHECK_CACHE_H
+#define EDGE_CHECK_CACHE_H
+
+#include "FeasibilityCache.h"
+#include <KrisLibrary/planning/EdgePlanner.h>
+#include <KrisLibrary/planning/CSpaceHelpers.h>
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <list>
+#include <map>
+#include <vector>
+
+/** @ingroup Planning
+ * @brief A bounded LRU cache of edge visibility results, for whole edges
+ * and for single obstacles of an explicit cspace.
+ *
+ * Edges are keyed on their endpoints quantized to a grid of the given
+ * resolution, so that an edge rebuilt from interpolated or reversed
+ * milestones finds its entry, and an edge and its reverse share one.
+ * As with FeasibilityCache, edges whose endpoints share grid cells share a
+ * result.
+ *
+ * Results are only valid for the environment they were computed in.
+ * SyncEnvironment() clears the cache when the environment geometries or
+ * their transforms change; spaces without world geometry should Clear()
+ * it themselves when their obstacles change.
+ */
+class EdgeCheckCache
+{
+public:
+  EdgeCheckCache(Real resolution=1e-6,size_t maxEntries=100000);
+  ///Clears the cache if the geometries or their transforms differ from the
+  ///last call.  Returns true if the cache was cleared.
+  bool SyncEnvironment(const std::vector<Geometry::AnyCollisionGeometry3D*>& geoms);
+  ///Returns 1 if the edge a->b was found visible w.r.t. the given obstacle
+  ///(-1 for all obstacles), 0 if not, and -1 if it hasn't been checked.
+  int Lookup(const Config& a,const Config& b,int obstacle=-1);
+  void Insert(const Config& a,const Config& b,int obstacle,bool visible);
+  void Clear();
+  ///Resets the statistics but keeps the entries
+  void ClearStats();
+  Real HitRate() const;
+  size_t Size() const { return lru.size(); }
+
+  Real resolution;
+  size_t maxEntries;
+  int numHits,numMisses,numEvictions,numInvalidations;
+
+private:
+  struct Entry
+  {
+    std::vector<int> key;
+    bool visible;
+  };
+  typedef std::list<Entry> EntryList;
+  void MakeKey(const Config& a,const Config& b,int obstacle);
+
+  EntryList lru;  //most recently used first
+  std::map<std::vector<int>,EntryList::iterator> index;
+  std::vector<int> key,kb;
+  EnvironmentStamp env;
+};
+
+/** @ingroup Planning
+ * @brief An edge planner that looks up the result of the edge in an
+ * EdgeCheckCache before checking it with the edge planner it wraps, and
+ * stores the result afterwards.
+ *
+ * Lazy planners (LazyRoadmapPlanner, lazyprm*, lazyrrg*) validate the
+ * edges of each candidate path, and the edges of a candidate that failed
+ * elsewhere come up again on the next one.  With this wrapper each is
+ * only checked once.
+ */
+class CachedEdgePlanner : public EdgePlanner
+{
+public:
+  ///Takes ownership of e
+  CachedEdgePlanner(EdgePlanner* e,EdgeCheckCache* cache,int obstacle=-1);
+  virtual ~CachedEdgePlanner() {}
+  virtual bool IsVisible();
+  virtual void Eval(Real u,Config& x) const { e->Eval(u,x); }
+  virtual const Config& Start() const { return e->Start(); }
+  virtual const Config& Goal() const { return e->Goal(); }
+  virtual CSpace* Space() const { return e->Space(); }
+  virtual EdgePlanner* Copy() const;
+  virtual EdgePlanner* ReverseCopy() const;
+
+  SmartPointer<EdgePlanner> e;
+  EdgeCheckCache* cache;
+  int obstacle;
+  int checked;
+};
+
+/** @ingroup Planning
+ * @brief A cspace that forwards to baseSpace, with an edge cache of its
+ * own: LocalPlanner wraps the base space's edges in CachedEdgePlanners.
+ *
+ * Gives each plan its own cache over a shared space, so that creating or
+ * destroying one plan doesn't affect the others.
+ */
+class CachedEdgeCSpace : public PiggybackCSpace
+{
+public:
+  CachedEdgeCSpace(CSpace* baseSpace,Real resolution=1e-6,size_t maxEntries=100000);
+  virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b);
+
+  EdgeCheckCache cache;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "FeasibilityCache.h"
+#include <math.h>
+using namespace std;
+
+FeasibilityCache::FeasibilityCache(Real _resolution,size_t _maxEntries)
+  :resolution(_resolution),maxEntries(_maxEntries)
+{
+  ClearStats();
+}
+
+bool EnvironmentStamp::Update(const vector<Geometry::AnyCollisionGeometry3D*>& _geoms)
+{
+  bool changed = (_geoms != geoms);
+  if(!changed) {
+    for(size_t i=0;i<geoms.size();i++) {
+      RigidTransform T = geoms[i]->GetTransform();
+      if(!transforms[i].R.isEqual(T.R) || !transforms[i].t.isEqual(T.t)) {
+        changed = true;
+        break;
+      }
+    }
+  }
+  if(!changed) return false;
+  geoms = _geoms;
+  transforms.resize(geoms.size());
+  for(size_t i=0;i<geoms.size();i++)
+    transforms[i] = geoms[i]->GetTransform();
+  return true;
+}
+
+void EnvironmentStamp::Clear()
+{
+  geoms.clear();
+  transforms.clear();
+}
+
+bool FeasibilityCache::SyncEnvironment(const vector<Geometry::AnyCollisionGeometry3D*>& geoms)
+{
+  if(!env.Update(geoms)) return false;
+  if(!lru.empty()) numInvalidations++;
+  lru.clear();
+  index.clear();
+  return true;
+}
+
+void FeasibilityCache::MakeKey(const Config& x)
+{
+  key.resize(x.n);
+  for(int i=0;i<x.n;i++)
+    key[i] = (int)floor(x(i)/resolution);
+}
+
+FeasibilityCache::Entry* FeasibilityCache::Find(const Config& x)
+{
+  MakeKey(x);
+  map<vector<int>,EntryList::iterator>::iterator i = index.find(key);
+  if(i == index.end()) return NULL;
+  //move to the front of the LRU list
+  lru.splice(lru.begin(),lru,i->second);
+  return &lru.front();
+}
+
+FeasibilityCache::Entry& FeasibilityCache::FindOrInsert(const Config& x)
+{
+  Entry* e = Find(x);
+  if(e) return *e;
+  if(maxEntries > 0 && lru.size() >= maxEntries) {
+    index.erase(lru.back().key);
+    lru.pop_back();
+    numEvictions++;
+  }
+  lru.push_front(Entry());
+  lru.front().key = key;
+  lru.front().feasible = -1;
+  index[key] = lru.begin();
+  return lru.front();
+}
+
+int FeasibilityCache::LookupFeasible(const Config& x)
+{
+  Entry* e = Find(x);
+  if(!e || e->feasible < 0) {
+    numMisses++;
+    return -1;
+  }
+  numHits++;
+  return e->feasible;
+}
+
+bool FeasibilityCache::LookupObstacles(const Config& x,vector<bool>& infeasible)
+{
+  Entry* e = Find(x);
+  if(!e || e->infeasible.empty()) {
+    numMisses++;
+    return false;
+  }
+  numHits++;
+  infeasible = e->infeasible;
+  return true;
+}
+
+void FeasibilityCache::InsertFeasible(const Config& x,bool feasible)
+{
+  FindOrInsert(x).feasible = (feasible ? 1 : 0);
+}
+
+void FeasibilityCache::InsertObstacles(const Config& x,const vector<bool>& infeasible)
+{
+  Entry& e = FindOrInsert(x);
+  e.infeasible = infeasible;
+  e.feasible = 1;
+  for(size_t i=0;i<infeasible.size();i++)
+    if(infeasible[i]) { e.feasible = 0; break; }
+}
+
+void FeasibilityCache::Clear()
+{
+  lru.clear();
+  index.clear();
+  env.Clear();
+  ClearStats();
+}
+
+void FeasibilityCache::ClearStats()
+{
+  numHits = numMisses = numEvictions = numInvalidations = 0;
+}
+
+Real FeasibilityCache::HitRate() const
+{
+  if(numHits+numMisses == 0) return 0;
+  return Real(numHits)/Real(numHits+numMisses);
+}
@@ -0,0 +1,86 @@
+#ifndef FEASIBILITY_CACHE_H
+#define FEASIBILITY_CACHE_H
+
+#include <KrisLibrary/planning/CSpace.h>
+#include <KrisLibrary/math3d/primitives.h>
+#include <KrisLibrary/geometry/AnyGeometry.h>
+#include <list>
+#include <map>
+#include <vector>
+using namespace Math;
+using namespace Math3D;
+
+/** @ingroup Planning
+ * @brief Remembers a set of environment geometries and their transforms,
+ * to tell when collision results computed against them have gone stale.
+ */
+class EnvironmentStamp
+{
+public:
+  ///Returns true if geoms or their transforms differ from the last call,
+  ///and remembers the new ones
+  bool Update(const std::vector<Geometry::AnyCollisionGeometry3D*>& geoms);
+  void Clear();
+
+  std::vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  std::vector<RigidTransform> transforms;
+};
+
+/** @ingroup Planning
+ * @brief A bounded LRU cache of feasibility test results, keyed on
+ * configurations quantized to a grid of the given resolution.
+ *
+ * All configurations in a grid cell share one entry, so the cache trades
+ * exactness for speed: a configuration within a cell width of one that was
+ * checked gets that one's result.  With the resolution set to the
+ * collision epsilon this is the same approximation that the bisection edge
+ * checkers already make.
+ *
+ * An entry holds the result of an overall feasibility test, the per-obstacle
+ * results of CheckObstacles, or both.  Results are only valid for the
+ * environment they were computed in; SyncEnvironment() compares the current
+ * environment geometries and their transforms to the ones seen last and
+ * clears the cache if any changed.
+ */
+class FeasibilityCache
+{
+public:
+  FeasibilityCache(Real resolution=1e-3,size_t maxEntries=10000);
+  ///Clears the cache if the geometries or their transforms differ from the
+  ///last call.  Returns true if the cache was cleared.
+  bool SyncEnvironment(const std::vector<Geometry::AnyCollisionGeometry3D*>& geoms);
+  ///Returns 1 if x was found feasible, 0 if infeasible, and -1 if unknown
+  int LookupFeasible(const Config& x);
+  ///Returns true and fills out infeasible if CheckObstacles results are known
+  bool LookupObstacles(const Config& x,std::vector<bool>& infeasible);
+  void InsertFeasible(const Config& x,bool feasible);
+  void InsertObstacles(const Config& x,const std::vector<bool>& infeasible);
+  void Clear();
+  ///Resets the statistics but keeps the entries
+  void ClearStats();
+  Real HitRate() const;
+  size_t Size() const { return lru.size(); }
+
+  Real resolution;
+  size_t maxEntries;
+  int numHits,numMisses,numEvictions,numInvalidations;
+
+private:
+  struct Entry
+  {
+    std::vector<int> key;
+    int feasible;
+    std::vector<bool> infeasible;
+  };
+  typedef std::list<Entry> EntryList;
+  void MakeKey(const Config& x);
+  Entry* Find(const Config& x);
+  Entry& FindOrInsert(const Config& x);
+
+  EntryList lru;  //most recently used first
+  std::map<std::vector<int>,EntryList::iterator> index;
+  std::vector<int> key;
+  EnvironmentStamp env;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "LazyRoadmapPlanner.h"
+#include <algorithm>
+#include <queue>
+using namespace std;
+
+LazyRoadmapPlanner::LazyRoadmapPlanner(CSpace* _space,Mode _mode)
+  :space(_space),mode(_mode),knn(10),connectionThreshold(Inf),delta(0.1),
+   numIterations(0),numEdgeChecks(0),numPrunedEdges(0),numSearches(0)
+{}
+
+int LazyRoadmapPlanner::AddNode(const Config& q,int parent)
+{
+  int i = (int)milestones.size();
+  milestones.push_back(q);
+  edges.resize(edges.size()+1);
+  parents.push_back(parent);
+  trees.push_back(parent < 0 ? i : trees[parent]);
+  return i;
+}
+
+void LazyRoadmapPlanner::AddEdge(int i,int j)
+{
+  Edge e;
+  e.length = space->Distance(milestones[i],milestones[j]);
+  e.checked = false;
+  e.target = j;
+  edges[i].push_back(e);
+  e.target = i;
+  edges[j].push_back(e);
+}
+
+LazyRoadmapPlanner::Edge* LazyRoadmapPlanner::FindEdge(int i,int j)
+{
+  for(size_t k=0;k<edges[i].size();k++)
+    if(edges[i][k].target == j) return &edges[i][k];
+  return NULL;
+}
+
+void LazyRoadmapPlanner::RemoveEdge(int i,int j)
+{
+  for(size_t k=0;k<edges[i].size();k++)
+    if(edges[i][k].target == j) { edges[i].erase(edges[i].begin()+k); break; }
+  for(size_t k=0;k<edges[j].size();k++)
+    if(edges[j][k].target == i) { edges[j].erase(edges[j].begin()+k); break; }
+}
+
+void LazyRoadmapPlanner::Prune(int i,int j)
+{
+  numPrunedEdges++;
+  RemoveEdge(i,j);
+  if(mode != RRT) return;
+  int child = -1;
+  if(parents[j] == i) child = j;
+  else if(parents[i] == j) child = i;
+  //an edge between two trees has nothing hanging from it
+  if(child < 0) return;
+  //milestones come after their parents, so one pass finds the subtree
+  int n = (int)milestones.size();
+  vector<bool> removed(n,false);
+  for(int k=child;k<n;k++) {
+    if(k == child || (parents[k] >= 0 && removed[parents[k]]))
+      removed[k] = true;
+  }
+  for(int k=child;k<n;k++) {
+    if(!removed[k]) continue;
+    while(!edges[k].empty())
+      RemoveEdge(k,edges[k].back().target);
+    parents[k] = -1;
+    trees[k] = -1;
+  }
+}
+
+int LazyRoadmapPlanner::Nearest(const Config& q,int excludeTree) const
+{
+  int best = -1;
+  Real dbest = Inf;
+  for(size_t i=0;i<milestones.size();i++) {
+    if(trees[i] < 0 || trees[i] == excludeTree) continue;
+    Real d = space->Distance(milestones[i],q);
+    if(d < dbest) {
+      dbest = d;
+      best = (int)i;
+    }
+  }
+  return best;
+}
+
+int LazyRoadmapPlanner::AddMilestone(const Config& q)
+{
+  if(!space->IsFeasible(q)) return -1;
+  int i = AddNode(q,-1);
+  if(mode == PRM) {
+    //connect to the nearest milestones, unchecked
+    vector<pair<Real,int> > neighbors;
+    for(int j=0;j<i;j++) {
+      Real d = space->Distance(milestones[j],q);
+      if(d <= connectionThreshold) neighbors.push_back(pair<Real,int>(d,j));
+    }
+    if(knn > 0 && (int)neighbors.size() > knn) {
+      partial_sort(neighbors.begin(),neighbors.begin()+knn,neighbors.end());
+      neighbors.resize(knn);
+    }
+    for(size_t k=0;k<neighbors.size();k++)
+      AddEdge(i,neighbors[k].second);
+  }
+  return i;
+}
+
+void LazyRoadmapPlanner::PlanMore()
+{
+  numIterations++;
+  Config q;
+  space->Sample(q);
+  if(mode == PRM) {
+    AddMilestone(q);
+  }
+  else {
+    int n = Nearest(q,-1);
+    if(n < 0) return;
+    Real d = space->Distance(milestones[n],q);
+    Config x;
+    if(d > delta) space->Interpolate(milestones[n],q,delta/d,x);
+    else x = q;
+    if(!space->IsFeasible(x)) return;
+    int i = AddNode(x,n);
+    AddEdge(n,i);
+    int m = Nearest(x,trees[i]);
+    if(m >= 0 && space->Distance(milestones[m],x) <= connectionThreshold)
+      AddEdge(i,m);
+  }
+  if(milestones.size() >= 2 && !IsConnected(0,1)) {
+    vector<int> path;
+    SearchAndValidate(0,1,path);
+  }
+}
+
+bool LazyRoadmapPlanner::ShortestPath(int ma,int mb,bool checkedOnly,vector<int>& path) const
+{
+  path.resize(0);
+  int n = (int)milestones.size();
+  if(ma < 0 || ma >= n || mb < 0 || mb >= n) return false;
+  vector<Real> d(n,Inf);
+  vector<int> prev(n,-1);
+  priority_queue<pair<Real,int>,vector<pair<Real,int> >,greater<pair<Real,int> > > q;
+  d[ma] = 0;
+  q.push(pair<Real,int>(0,ma));
+  while(!q.empty()) {
+    Real di = q.top().first;
+    int i = q.top().second;
+    q.pop();
+    if(di > d[i]) continue;
+    if(i == mb) break;
+    for(size_t k=0;k<edges[i].size();k++) {
+      const Edge& e = edges[i][k];
+      if(checkedOnly && !e.checked) continue;
+      if(di + e.length < d[e.target]) {
+        d[e.target] = di + e.length;
+        prev[e.target] = i;
+        q.push(pair<Real,int>(d[e.target],e.target));
+      }
+    }
+  }
+  if(IsInf(d[mb])) return false;
+  for(int i=mb;i!=-1;i=prev[i])
+    path.push_back(i);
+  reverse(path.begin(),path.end());
+  return true;
+}
+
+bool LazyRoadmapPlanner::SearchAndValidate(int ma,int mb,vector<int>& path)
+{
+  while(ShortestPath(ma,mb,false,path)) {
+    numSearches++;
+    bool valid = true;
+    for(size_t k=0;k+1<path.size();k++) {
+      int i=path[k],j=path[k+1];
+      Edge* e = FindEdge(i,j);
+      if(e->checked) continue;
+      numEdgeChecks++;
+      SmartPointer<EdgePlanner> ep(space->LocalPlanner(milestones[i],milestones[j]));
+      if(!ep->IsVisible()) {
+        Prune(i,j);
+        valid = false;
+        break;
+      }
+      e->checked = true;
+      FindEdge(j,i)->checked = true;
+    }
+    if(valid) return true;
+  }
+  return false;
+}
+
+bool LazyRoadmapPlanner::IsConnected(int ma,int mb) const
+{
+  vector<int> path;
+  return ShortestPath(ma,mb,true,path);
+}
+
+void LazyRoadmapPlanner::GetPath(int ma,int mb,MilestonePath& path)
+{
+  path.edges.resize(0);
+  vector<int> p;
+  if(!ShortestPath(ma,mb,true,p)) return;
+  for(size_t k=0;k+1<p.size();k++)
+    path.edges.push_back(SmartPointer<EdgePlanner>(space->LocalPlanner(milestones[p[k]],milestones[p[k+1]])));
+}
+
+int LazyRoadmapPlanner::NumComponents() const
+{
+  int n = (int)milestones.size();
+  vector<bool> visited(n,false);
+  vector<int> stack;
+  int numComponents = 0;
+  for(int i=0;i<n;i++) {
+    if(visited[i] || trees[i] < 0) continue;
+    numComponents++;
+    visited[i] = true;
+    stack.push_back(i);
+    while(!stack.empty()) {
+      int j = stack.back();
+      stack.pop_back();
+      for(size_t k=0;k<edges[j].size();k++) {
+        int t = edges[j][k].target;
+        if(!visited[t]) {
+          visited[t] = true;
+          stack.push_back(t);
+        }
+      }
+    }
+  }
+  return numComponents;
+}
+
+void LazyRoadmapPlanner::GetRoadmap(RoadmapPlanner& roadmap) const
+{
+  for(size_t i=0;i<milestones.size();i++)
+    roadmap.roadmap.AddNode(milestones[i]);
+  for(size_t i=0;i<milestones.size();i++) {
+    for(size_t k=0;k<edges[i].size();k++) {
+      int j = edges[i][k].target;
+      if((int)i < j)
+        roadmap.roadmap.AddEdge((int)i,j,SmartPointer<EdgePlanner>(space->LocalPlanner(milestones[i],milestones[j])));
+    }
+  }
+}
+
+void LazyRoadmapPlanner::GetStats(PropertyMap& stats) const
+{
+  stats.set("numIterations",numIterations);
+  stats.set("numMilestones",(int)milestones.size());
+  stats.set("numEdgeChecks",numEdgeChecks);
+  stats.set("numPrunedEdges",numPrunedEdges);
+  stats.set("numSearches",numSearches);
+}
+
+//the factory's lazy type for type, or "" if there is none
+static string FactoryLazyType(const string& type)
+{
+  if(type == "prm*" || type == "lazyprm*") return "lazyprm*";
+  if(type == "rrt*" || type == "rrg*" || type == "lazyrrg*") return "lazyrrg*";
+  return "";
+}
+
+MotionPlannerInterface* CreateLazyPlanner(MotionPlannerFactory& factory,CSpace* space)
+{
+  if(factory.type == "prm" || factory.type == "rrt") {
+    LazyRoadmapPlanner* planner = new LazyRoadmapPlanner(space,(factory.type == "prm" ? LazyRoadmapPlanner::PRM : LazyRoadmapPlanner::RRT));
+    planner->knn = factory.knn;
+    planner->connectionThreshold = factory.connectionThreshold;
+    planner->delta = factory.perturbationRadius;
+    return planner;
+  }
+  string type = FactoryLazyType(factory.type);
+  if(type.empty()) return NULL;
+  MotionPlannerFactory lazyFactory = factory;
+  lazyFactory.type = type;
+  return lazyFactory.Create(space);
+}
+
+MotionPlannerInterface* CreateLazyPlanner(MotionPlannerFactory& factory,CSpace* space,const Config& qstart,CSpace* goalSet)
+{
+  string type = FactoryLazyType(factory.type);
+  if(type.empty()) return NULL;
+  MotionPlannerFactory lazyFactory = factory;
+  lazyFactory.type = type;
+  return lazyFactory.Create(space,qstart,goalSet);
+}
@@ -0,0 +1,109 @@
+#ifndef LAZY_ROADMAP_PLANNER_H
+#define LAZY_ROADMAP_PLANNER_H
+
+#include <KrisLibrary/planning/AnyMotionPlanner.h>
+#include <vector>
+
+/** @ingroup Planning
+ * @brief A lazy PRM / lazy RRT planner: milestones are checked when they
+ * are sampled, but edges are only checked once they lie on a candidate
+ * path.
+ *
+ * Each iteration grows the roadmap without checking the new edges.  In PRM
+ * mode a sample is connected to its knn nearest milestones (or to those
+ * within connectionThreshold if knn = 0).  In RRT mode the milestone
+ * nearest to a sample is extended toward it by at most delta, and the new
+ * milestone is connected to the nearest milestone of the other trees if
+ * it lies within connectionThreshold; milestones added with AddMilestone
+ * are the roots of the trees.
+ *
+ * Whenever milestones 0 and 1 are joined by unchecked and visible edges,
+ * the shortest such path is validated edge by edge.  An edge that fails is
+ * removed, along with (in RRT mode) the subtree hanging from it, and the
+ * search is repeated until a path is validated or none is left.  IsSolved()
+ * and IsConnected() only count validated edges.
+ *
+ * Edges come from space->LocalPlanner, and each is checked at most once.
+ * Wrap the space in a CachedEdgeCSpace, or use SingleRobotCSpace's lazy
+ * mode, so that edges rebuilt by other code (e.g., the edges of the path
+ * returned by GetPath) are not checked again.
+ *
+ * Nearest milestones are found by brute force, so iterations take time
+ * linear in the number of milestones.
+ */
+class LazyRoadmapPlanner : public MotionPlannerInterface
+{
+public:
+  enum Mode { PRM, RRT };
+
+  LazyRoadmapPlanner(CSpace* space,Mode mode=PRM);
+  virtual ~LazyRoadmapPlanner() {}
+  virtual bool CanAddMilestone() const { return true; }
+  ///Adds q as a new tree root if it's feasible, and returns its index.
+  ///Returns -1 if it's infeasible.
+  virtual int AddMilestone(const Config& q);
+  virtual void PlanMore();
+  virtual int NumIterations() const { return numIterations; }
+  virtual int NumMilestones() const { return (int)milestones.size(); }
+  ///Number of components of the roadmap, counting unchecked edges
+  virtual int NumComponents() const;
+  ///True if ma and mb are joined by validated edges
+  virtual bool IsConnected(int ma,int mb) const;
+  virtual void GetPath(int ma,int mb,MilestonePath& path);
+  ///Gives the milestones and all edges that haven't failed, checked or not
+  virtual void GetRoadmap(RoadmapPlanner& roadmap) const;
+  virtual void GetStats(PropertyMap& stats) const;
+
+  ///Finds the shortest path from ma to mb over edges that haven't failed,
+  ///checks its unchecked edges, removes the first that fails, and repeats.
+  ///Returns true and the milestones of the path if one is validated.
+  bool SearchAndValidate(int ma,int mb,std::vector<int>& path);
+
+  CSpace* space;
+  Mode mode;
+  ///PRM mode: number of nearest milestones to connect to, or 0 to connect
+  ///to all within connectionThreshold
+  int knn;
+  ///PRM mode: maximum edge length.  RRT mode: maximum length of the edges
+  ///that join two trees.
+  Real connectionThreshold;
+  ///RRT mode: maximum extension length
+  Real delta;
+
+  //statistics
+  int numIterations,numEdgeChecks,numPrunedEdges,numSearches;
+
+private:
+  struct Edge
+  {
+    int target;
+    Real length;
+    bool checked;
+  };
+  int AddNode(const Config& q,int parent);
+  void AddEdge(int i,int j);
+  void RemoveEdge(int i,int j);
+  Edge* FindEdge(int i,int j);
+  //removes the edge i-j, and in RRT mode the subtree below it
+  void Prune(int i,int j);
+  //shortest path over the live edges (all, or only the checked ones)
+  bool ShortestPath(int ma,int mb,bool checkedOnly,std::vector<int>& path) const;
+  int Nearest(const Config& q,int excludeTree) const;
+
+  std::vector<Config> milestones;
+  std::vector<std::vector<Edge> > edges;
+  //RRT mode: the parent of each milestone (-1 for roots and removed
+  //milestones) and the root of its tree (-1 once removed)
+  std::vector<int> parents,trees;
+};
+
+///Creates a lazy planner with the settings of factory: LazyRoadmapPlanner
+///for the prm and rrt types, and the factory's lazyprm* and lazyrrg* for
+///prm* and rrt*/rrg*.  Lazy types are created as they are.  Returns NULL
+///if the type has no lazy version.
+MotionPlannerInterface* CreateLazyPlanner(MotionPlannerFactory& factory,CSpace* space);
+///Same, for planning from qstart to a goal set.  Only the factory's lazy
+///planners support goal sets.
+MotionPlannerInterface* CreateLazyPlanner(MotionPlannerFactory& factory,CSpace* space,const Config& qstart,CSpace* goalSet);
+
+#endif
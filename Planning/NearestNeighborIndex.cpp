@@ -0,0 +1,310 @@
+#include "NearestNeighborIndex.h"
+#include <KrisLibrary/errors.h>
+#include <KrisLibrary/math/angle.h>
+#include <queue>
+#include <functional>
+using namespace std;
+
+CSpaceNNMetric::CSpaceNNMetric(CSpace* _space)
+  :space(_space)
+{}
+
+Real CSpaceNNMetric::Distance(const Config& a,const Config& b)
+{
+  return space->Distance(a,b);
+}
+
+WeightedInfNNMetric::WeightedInfNNMetric(const Vector& _weights,const vector<int>& _angles)
+  :weights(_weights),angles(_angles)
+{}
+
+Real WeightedInfNNMetric::Distance(const Config& a,const Config& b)
+{
+  Assert(a.n == weights.n && b.n == weights.n);
+  Real dmax = 0;
+  size_t k = 0;
+  for(int i=0;i<a.n;i++) {
+    if(k < angles.size() && angles[k] == i) {
+      dmax = Max(dmax,weights(i)*Abs(AngleDiff(AngleNormalize(a(i)),AngleNormalize(b(i)))));
+      k++;
+    }
+    else
+      dmax = Max(dmax,weights(i)*Abs(a(i)-b(i)));
+  }
+  return dmax;
+}
+
+class MetricCostFunction : public NNCostFunction
+{
+public:
+  virtual Real Cost(void* data,Real distance) { return distance; }
+};
+
+NearestNeighborIndex::NearestNeighborIndex(SmartPointer<NNMetric> _metric)
+  :metric(_metric),numDistanceEvaluations(0),numCostEvaluations(0)
+{}
+
+void* NearestNeighborIndex::Nearest(const Config& x,Real& dist)
+{
+  MetricCostFunction f;
+  return Search(x,f,dist);
+}
+
+
+
+BruteForceNNIndex::BruteForceNNIndex(SmartPointer<NNMetric> metric)
+  :NearestNeighborIndex(metric)
+{}
+
+void BruteForceNNIndex::Clear()
+{
+  points.clear();
+  data.clear();
+  indices.clear();
+}
+
+void BruteForceNNIndex::Insert(const Config& x,void* d)
+{
+  map<void*,int>::iterator i=indices.find(d);
+  if(i != indices.end()) {
+    points[i->second] = x;
+    return;
+  }
+  indices[d] = (int)points.size();
+  points.push_back(x);
+  data.push_back(d);
+}
+
+bool BruteForceNNIndex::Remove(void* d)
+{
+  map<void*,int>::iterator i=indices.find(d);
+  if(i == indices.end()) return false;
+  //move the last point into the hole
+  int k=i->second;
+  indices.erase(i);
+  if(k+1 != (int)points.size()) {
+    points[k] = points.back();
+    data[k] = data.back();
+    indices[data[k]] = k;
+  }
+  points.resize(points.size()-1);
+  data.resize(data.size()-1);
+  return true;
+}
+
+void* BruteForceNNIndex::Search(const Config& x,NNCostFunction& f,Real& cost)
+{
+  cost = Inf;
+  void* best = NULL;
+  for(size_t i=0;i<points.size();i++) {
+    Real d=metric->Distance(x,points[i]);
+    numDistanceEvaluations++;
+    if(d >= cost) continue;
+    Real c=f.Cost(data[i],d);
+    numCostEvaluations++;
+    if(c < cost) {
+      cost = c;
+      best = data[i];
+    }
+  }
+  return best;
+}
+
+
+
+GNATIndex::Node::~Node()
+{
+  for(size_t i=0;i<bucket.size();i++) delete bucket[i];
+  for(size_t i=0;i<pivots.size();i++) delete pivots[i];
+  for(size_t i=0;i<children.size();i++) delete children[i];
+}
+
+GNATIndex::GNATIndex(SmartPointer<NNMetric> metric,int _degree,int _maxLeafSize)
+  :NearestNeighborIndex(metric),degree(_degree),maxLeafSize(Max(_maxLeafSize,_degree)),root(NULL),numRemovedPivots(0)
+{
+  Assert(degree >= 2);
+}
+
+GNATIndex::~GNATIndex()
+{
+  delete root;
+}
+
+void GNATIndex::Clear()
+{
+  delete root;
+  root = NULL;
+  points.clear();
+  numRemovedPivots = 0;
+}
+
+void GNATIndex::Insert(const Config& x,void* data)
+{
+  Remove(data);
+  Point* p = new Point;
+  p->x = x;
+  p->data = data;
+  p->removed = false;
+  p->leaf = NULL;
+  points[data] = p;
+  if(!root) root = new Node;
+  InsertPoint(root,p);
+}
+
+void GNATIndex::InsertPoint(Node* node,Point* p)
+{
+  vector<Real> d;
+  while(!node->children.empty()) {
+    int k=(int)node->pivots.size();
+    d.resize(k);
+    int closest=0;
+    for(int i=0;i<k;i++) {
+      d[i] = metric->Distance(p->x,node->pivots[i]->x);
+      numDistanceEvaluations++;
+      if(d[i] < d[closest]) closest=i;
+    }
+    for(int i=0;i<k;i++) {
+      node->rmin[i*k+closest] = Min(node->rmin[i*k+closest],d[i]);
+      node->rmax[i*k+closest] = Max(node->rmax[i*k+closest],d[i]);
+    }
+    node = node->children[closest];
+  }
+  p->leaf = node;
+  node->bucket.push_back(p);
+  if((int)node->bucket.size() > maxLeafSize) Split(node);
+}
+
+void GNATIndex::Split(Node* node)
+{
+  vector<Point*> pts;
+  swap(pts,node->bucket);
+  int n=(int)pts.size();
+  int k=Min(degree,n);
+  //pick spread out pivots by farthest-point selection, remembering the
+  //distances from each pivot to each point
+  vector<vector<Real> > dist(k,vector<Real>(n));
+  vector<Real> mindist(n,Inf);
+  vector<bool> isPivot(n,false);
+  int next=0;
+  for(int i=0;i<k;i++) {
+    isPivot[next] = true;
+    node->pivots.push_back(pts[next]);
+    pts[next]->leaf = NULL;
+    int far=-1;
+    for(int m=0;m<n;m++) {
+      if(isPivot[m]) { dist[i][m] = 0; continue; }
+      dist[i][m] = metric->Distance(pts[next]->x,pts[m]->x);
+      numDistanceEvaluations++;
+      mindist[m] = Min(mindist[m],dist[i][m]);
+      if(far < 0 || mindist[m] > mindist[far]) far=m;
+    }
+    if(far < 0) { k=i+1; break; }
+    next = far;
+  }
+  node->children.resize(k);
+  for(int j=0;j<k;j++) node->children[j] = new Node;
+  node->rmin.resize(k*k,Inf);
+  node->rmax.resize(k*k,-Inf);
+  for(int m=0;m<n;m++) {
+    if(isPivot[m]) continue;
+    int closest=0;
+    for(int i=1;i<k;i++)
+      if(dist[i][m] < dist[closest][m]) closest=i;
+    for(int i=0;i<k;i++) {
+      node->rmin[i*k+closest] = Min(node->rmin[i*k+closest],dist[i][m]);
+      node->rmax[i*k+closest] = Max(node->rmax[i*k+closest],dist[i][m]);
+    }
+    pts[m]->leaf = node->children[closest];
+    node->children[closest]->bucket.push_back(pts[m]);
+  }
+  for(int j=0;j<k;j++)
+    if((int)node->children[j]->bucket.size() > maxLeafSize)
+      Split(node->children[j]);
+}
+
+bool GNATIndex::Remove(void* data)
+{
+  map<void*,Point*>::iterator i=points.find(data);
+  if(i == points.end()) return false;
+  Point* p = i->second;
+  points.erase(i);
+  if(p->leaf) {
+    vector<Point*>& bucket = p->leaf->bucket;
+    for(size_t j=0;j<bucket.size();j++)
+      if(bucket[j] == p) {
+	bucket[j] = bucket.back();
+	bucket.resize(bucket.size()-1);
+	break;
+      }
+    delete p;
+  }
+  else {
+    //pivots are still needed to route searches
+    p->removed = true;
+    numRemovedPivots++;
+    if(numRemovedPivots > points.size()) Rebuild();
+  }
+  return true;
+}
+
+void GNATIndex::Rebuild()
+{
+  vector<Config> x;
+  vector<void*> data;
+  x.reserve(points.size());
+  data.reserve(points.size());
+  for(map<void*,Point*>::const_iterator i=points.begin();i!=points.end();i++) {
+    x.push_back(i->second->x);
+    data.push_back(i->first);
+  }
+  Clear();
+  for(size_t i=0;i<x.size();i++)
+    Insert(x[i],data[i]);
+}
+
+void* GNATIndex::Search(const Config& x,NNCostFunction& f,Real& cost)
+{
+  cost = Inf;
+  void* best = NULL;
+  if(!root) return NULL;
+  typedef pair<Real,Node*> QueueItem;
+  priority_queue<QueueItem,vector<QueueItem>,greater<QueueItem> > q;
+  q.push(QueueItem(0,root));
+  vector<Real> d;
+  while(!q.empty()) {
+    Real lb = q.top().first;
+    Node* node = q.top().second;
+    q.pop();
+    if(lb >= cost) break;
+    for(size_t i=0;i<node->bucket.size();i++) {
+      Point* p=node->bucket[i];
+      Real dp=metric->Distance(x,p->x);
+      numDistanceEvaluations++;
+      if(dp >= cost) continue;
+      Real c=f.Cost(p->data,dp);
+      numCostEvaluations++;
+      if(c < cost) { cost=c; best=p->data; }
+    }
+    int k=(int)node->pivots.size();
+    if(k == 0) continue;
+    d.resize(k);
+    for(int i=0;i<k;i++) {
+      Point* p=node->pivots[i];
+      d[i] = metric->Distance(x,p->x);
+      numDistanceEvaluations++;
+      if(p->removed || d[i] >= cost) continue;
+      Real c=f.Cost(p->data,d[i]);
+      numCostEvaluations++;
+      if(c < cost) { cost=c; best=p->data; }
+    }
+    for(int j=0;j<k;j++) {
+      Real clb = lb;
+      for(int i=0;i<k && clb < cost;i++) {
+	clb = Max(clb,node->rmin[i*k+j]-d[i]);
+	clb = Max(clb,d[i]-node->rmax[i*k+j]);
+      }
+      if(clb < cost) q.push(QueueItem(clb,node->children[j]));
+    }
+  }
+  return best;
+}
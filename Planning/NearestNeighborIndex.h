@@ -0,0 +1,172 @@
+#ifndef PLANNING_NEAREST_NEIGHBOR_INDEX_H
+#define PLANNING_NEAREST_NEIGHBOR_INDEX_H
+
+#include <KrisLibrary/planning/CSpace.h>
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <map>
+#include <vector>
+using namespace Math;
+
+/** @ingroup Planning
+ * @brief The distance function used to organize a NearestNeighborIndex.
+ *
+ * It must be symmetric and satisfy the triangle inequality, otherwise the
+ * pruning done by the index may miss the nearest point.
+ */
+class NNMetric
+{
+public:
+  virtual ~NNMetric() {}
+  virtual Real Distance(const Config& a,const Config& b)=0;
+};
+
+/** @ingroup Planning
+ * @brief Uses the distance function of a CSpace.  With a SingleRobotCSpace
+ * this accounts for spin and floating joints and for the distanceWeights
+ * in WorldPlannerSettings.
+ */
+class CSpaceNNMetric : public NNMetric
+{
+public:
+  CSpaceNNMetric(CSpace* space);
+  virtual Real Distance(const Config& a,const Config& b);
+
+  CSpace* space;
+};
+
+/** @ingroup Planning
+ * @brief The weighted L-infinity distance max_i w_i |a_i-b_i|.
+ *
+ * With w_i = 1/vmax_i, this is a lower bound on the duration of any
+ * trajectory between a and b that respects the velocity bounds vmax, which
+ * lets the dynamic planners search on the exact parabolic ramp times.
+ * Weights of 0 ignore a coordinate.
+ *
+ * The coordinates listed in angles (in increasing order), such as those of
+ * spin joints, are compared by their difference wrapped to [-pi,pi], as
+ * SingleRobotCSpace::Distance does.  The wrapped difference is never
+ * larger, so the duration bound still holds.
+ */
+class WeightedInfNNMetric : public NNMetric
+{
+public:
+  WeightedInfNNMetric(const Vector& weights,const std::vector<int>& angles=std::vector<int>());
+  virtual Real Distance(const Config& a,const Config& b);
+
+  Vector weights;
+  std::vector<int> angles;
+};
+
+/** @ingroup Planning
+ * @brief A cost used to rank the points of a NearestNeighborIndex.
+ *
+ * The cost of a point must be no less than its metric distance to the
+ * query, which is passed in.  Return Inf to reject a point.
+ */
+class NNCostFunction
+{
+public:
+  virtual ~NNCostFunction() {}
+  virtual Real Cost(void* data,Real distance)=0;
+};
+
+/** @ingroup Planning
+ * @brief Base class for nearest-neighbor structures over configurations
+ * with incremental insertion and removal.  Points are identified by a
+ * user data pointer, typically a tree node.
+ */
+class NearestNeighborIndex
+{
+public:
+  NearestNeighborIndex(SmartPointer<NNMetric> metric=NULL);
+  virtual ~NearestNeighborIndex() {}
+  virtual void Clear()=0;
+  ///Adds a point.  If data is already present it is replaced.
+  virtual void Insert(const Config& x,void* data)=0;
+  ///Removes the point with the given data, returns false if not present
+  virtual bool Remove(void* data)=0;
+  virtual size_t Size() const=0;
+  ///Returns the data of the point with the least cost to x, or NULL if all
+  ///points are rejected.  The cost is returned in cost.
+  virtual void* Search(const Config& x,NNCostFunction& f,Real& cost)=0;
+  ///Returns the data of the closest point under the metric, or NULL if the
+  ///index is empty
+  void* Nearest(const Config& x,Real& dist);
+
+  SmartPointer<NNMetric> metric;
+  //statistics
+  int numDistanceEvaluations,numCostEvaluations;
+};
+
+/** @ingroup Planning
+ * @brief Linear scan.  Useful as a reference and for small trees.
+ */
+class BruteForceNNIndex : public NearestNeighborIndex
+{
+public:
+  BruteForceNNIndex(SmartPointer<NNMetric> metric=NULL);
+  virtual void Clear();
+  virtual void Insert(const Config& x,void* data);
+  virtual bool Remove(void* data);
+  virtual size_t Size() const { return points.size(); }
+  virtual void* Search(const Config& x,NNCostFunction& f,Real& cost);
+
+  std::vector<Config> points;
+  std::vector<void*> data;
+  std::map<void*,int> indices;
+};
+
+/** @ingroup Planning
+ * @brief A geometric near-neighbor access tree (GNAT), a metric tree that
+ * supports incremental insertion and removal.
+ *
+ * Each internal node holds up to degree pivot points and one subtree per
+ * pivot, along with the range of distances from every pivot to the points
+ * of every subtree.  Searches visit subtrees in order of the lower bound
+ * given by these ranges and stop once the bound exceeds the best cost found.
+ *
+ * Leaf points are removed immediately.  Removed pivots stay in the tree to
+ * route queries until they outnumber the live points, at which point the
+ * tree is rebuilt.
+ */
+class GNATIndex : public NearestNeighborIndex
+{
+public:
+  GNATIndex(SmartPointer<NNMetric> metric=NULL,int degree=8,int maxLeafSize=16);
+  virtual ~GNATIndex();
+  virtual void Clear();
+  virtual void Insert(const Config& x,void* data);
+  virtual bool Remove(void* data);
+  virtual size_t Size() const { return points.size(); }
+  virtual void* Search(const Config& x,NNCostFunction& f,Real& cost);
+  void Rebuild();
+
+  int degree,maxLeafSize;
+
+private:
+  struct Node;
+  struct Point
+  {
+    Config x;
+    void* data;
+    bool removed;
+    Node* leaf;   //NULL if this is a pivot
+  };
+  struct Node
+  {
+    ~Node();
+    std::vector<Point*> bucket;
+    std::vector<Point*> pivots;
+    std::vector<Node*> children;
+    //distance range from pivot i to the points under child j, at i*k+j
+    std::vector<Real> rmin,rmax;
+  };
+  void InsertPoint(Node* node,Point* p);
+  void Split(Node* node);
+
+  Node* root;
+  std::map<void*,Point*> points;
+  size_t numRemovedPivots;
+};
+
+#endif
@@ -204,6 +204,106 @@ bool WorldPlannerSettings::CheckCollision(RobotWorld& world,int id1,int id2,Real
   }
 }
 
+WorldBroadPhaseCache::WorldBroadPhaseCache()
+  :sortedIDsChanged(false),numRefits(0)
+{}
+
+void WorldBroadPhaseCache::Clear()
+{
+  geoms.clear();
+  transforms.clear();
+  bbs.clear();
+  sortedIDs.clear();
+  sortedIDsChanged = false;
+}
+
+const AABB3D& WorldBroadPhaseCache::GetAABB(int id,AnyCollisionGeometry3D* geom)
+{
+  if(id >= (int)geoms.size()) {
+    geoms.resize(id+1,NULL);
+    transforms.resize(id+1);
+    bbs.resize(id+1);
+  }
+  RigidTransform T = geom->GetTransform();
+  if(geoms[id] != geom || !transforms[id].R.isEqual(T.R) || !transforms[id].t.isEqual(T.t)) {
+    if(geoms[id] == NULL) {
+      sortedIDs.push_back(id);
+      sortedIDsChanged = true;
+    }
+    geoms[id] = geom;
+    transforms[id] = T;
+    bbs[id] = geom->GetAABB();
+    numRefits++;
+  }
+  return bbs[id];
+}
+
+//orders box indices by their lower x coordinate
+struct LowerXOrder
+{
+  LowerXOrder(const vector<AABB3D>& _bbs) : bbs(_bbs) {}
+  bool operator () (int a,int b) const { return bbs[a].bmin.x < bbs[b].bmin.x; }
+  const vector<AABB3D>& bbs;
+};
+
+void WorldBroadPhaseCache::Overlaps(const vector<int>& ids,size_t n1,Real margin,vector<pair<int,int> >& pairs)
+{
+  pairs.resize(0);
+  bool bipartite = (n1 < ids.size());
+  //map the IDs to their index in the query
+  queryIndex.resize(geoms.size(),-1);
+  bool repeated = false;
+  for(size_t i=0;i<ids.size();i++) {
+    if(queryIndex[ids[i]] >= 0) repeated = true;
+    else queryIndex[ids[i]] = (int)i;
+  }
+  order.resize(0);
+  if(repeated) {
+    //an ID in both sets has one entry in sortedIDs, so sort the query
+    //on its own
+    for(size_t i=0;i<ids.size();i++) order.push_back((int)i);
+    queryBBs.resize(ids.size());
+    for(size_t i=0;i<ids.size();i++) queryBBs[i] = bbs[ids[i]];
+    sort(order.begin(),order.end(),LowerXOrder(queryBBs));
+  }
+  else {
+    if(sortedIDsChanged) {
+      sort(sortedIDs.begin(),sortedIDs.end(),LowerXOrder(bbs));
+      sortedIDsChanged = false;
+    }
+    else {
+      //insertion sort, nearly linear since the order rarely changes
+      for(size_t a=1;a<sortedIDs.size();a++) {
+	int id = sortedIDs[a];
+	Real x = bbs[id].bmin.x;
+	size_t b = a;
+	for(;b > 0 && bbs[sortedIDs[b-1]].bmin.x > x;b--)
+	  sortedIDs[b] = sortedIDs[b-1];
+	sortedIDs[b] = id;
+      }
+    }
+    for(size_t a=0;a<sortedIDs.size();a++)
+      if(queryIndex[sortedIDs[a]] >= 0) order.push_back(queryIndex[sortedIDs[a]]);
+  }
+  for(size_t i=0;i<ids.size();i++) queryIndex[ids[i]] = -1;
+
+  //sweep along x; the boxes that start before i ends are the x-overlaps
+  for(size_t a=0;a<order.size();a++) {
+    int i=order[a];
+    const AABB3D& bi=bbs[ids[i]];
+    for(size_t b=a+1;b<order.size();b++) {
+      int j=order[b];
+      const AABB3D& bj=bbs[ids[j]];
+      if(bj.bmin.x > bi.bmax.x + margin) break;
+      if(bipartite && ((size_t)i < n1) == ((size_t)j < n1)) continue;
+      if(bj.bmin.y > bi.bmax.y + margin || bi.bmin.y > bj.bmax.y + margin) continue;
+      if(bj.bmin.z > bi.bmax.z + margin || bi.bmin.z > bj.bmax.z + margin) continue;
+      if(i < j) pairs.push_back(pair<int,int>(i,j));
+      else pairs.push_back(pair<int,int>(j,i));
+    }
+  }
+}
+
 void GetGeometries(RobotWorld& world,const vector<int>& ids,vector<Geometry::AnyCollisionGeometry3D*>& geoms,vector<int>& activeids)
 {
   geoms.reserve(ids.size());
@@ -237,90 +337,38 @@ pair<int,int> WorldPlannerSettings::CheckCollision(RobotWorld& world,const vecto
   vector<Geometry::AnyCollisionGeometry3D*> geoms;
   vector<int> activeids;
   GetGeometries(world,ids,geoms,activeids);
-
-  Vector3 d(tol*0.5); //adjustment
-  vector<AABB3D> bbs(geoms.size());
-  for(size_t i=0;i<geoms.size();i++) {
-    bbs[i]=geoms[i]->GetAABB();
-    bbs[i].bmin -= d;
-    bbs[i].bmax += d;
-  }
-
-  for(size_t i=0;i<activeids.size();i++) {
-    for(size_t j=i+1;j<activeids.size();j++) {
-      if(collisionEnabled(activeids[i],activeids[j]) || collisionEnabled(activeids[i],activeids[i])) {
-        if(bbs[i].intersects(bbs[j])) {
-          if(::CheckCollision(geoms[i],geoms[j],tol)){
-            // std::cout << "collision: " << activeids.at(i) << " and " << activeids.at(j)  << " tol: " << tol << std::endl;
-            return pair<int,int>(activeids[i],activeids[j]);
-          }
-        }
-      }
-    }
-  }
-  return pair<int,int>(-1,-1);
+  WorldBroadPhaseCache cache;
+  return CheckCollision(cache,geoms,activeids,geoms.size(),tol);
 }
 
 pair<int,int> WorldPlannerSettings::CheckCollision(RobotWorld& world,const vector<int>& ids1,const vector<int>& ids2,Real tol)
 {
-  //first, get all the geometries
-  vector<Geometry::AnyCollisionGeometry3D*> geoms1,geoms2;
-  vector<int> activeids1,activeids2;
-  GetGeometries(world,ids1,geoms1,activeids1);
-  GetGeometries(world,ids2,geoms2,activeids2);
-
-  Vector3 d(tol*0.5); //adjustment
-  vector<AABB3D> bbs1(geoms1.size()),bbs2(geoms2.size());
-  for(size_t i=0;i<geoms1.size();i++) {
-    bbs1[i]=geoms1[i]->GetAABB();
-    bbs1[i].bmin -= d;
-    bbs1[i].bmax += d;
-  }
-  for(size_t i=0;i<geoms2.size();i++) {
-    bbs2[i]=geoms2[i]->GetAABB();
-    bbs2[i].bmin -= d;
-    bbs2[i].bmax += d;
-  }
-
-  //quick reject: anything in set2 that doesn't intersect entire set1 bb can be erased from consideration
-  AABB3D bb;
-  bb.minimize();
-  for(size_t i=0;i<bbs1.size();i++)
-    bb.setUnion(bbs1[i]);
-  for(size_t i=0;i<bbs2.size();i++)
-    if(!bbs2[i].intersects(bb)) { //erase
-      activeids2[i] = activeids2.back();
-      geoms2[i] = geoms2.back();
-      bbs2[i] = bbs2.back();
-      activeids2.resize(activeids2.size()-1);
-      geoms2.resize(geoms2.size()-1);
-      bbs2.resize(bbs2.size()-1);
-      i--;
-    }
-  bb.minimize();
-  for(size_t i=0;i<bbs2.size();i++)
-    bb.setUnion(bbs2[i]);
-  for(size_t i=0;i<bbs1.size();i++)
-    if(!bbs1[i].intersects(bb)) { //erase
-      activeids1[i] = activeids1.back();
-      geoms1[i] = geoms1.back();
-      bbs1[i] = bbs1.back();
-      activeids1.resize(activeids1.size()-1);
-      geoms1.resize(geoms1.size()-1);
-      bbs1.resize(bbs1.size()-1);
-      i--;
-    }
-  
-
-  for(size_t i=0;i<activeids1.size();i++) {
-    for(size_t j=0;j<activeids2.size();j++) {
-      if(collisionEnabled(activeids1[i],activeids2[j]) || collisionEnabled(activeids2[j],activeids1[i])) {
-        if(bbs1[i].intersects(bbs2[j])) {
-          if(::CheckCollision(geoms1[i],geoms2[j],tol))
-            return pair<int,int>(activeids1[i],activeids2[j]);
-        }
-      }
-    }
+  //first, get all the geometries.  Set 1 goes first in geoms, then set 2
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  vector<int> activeids;
+  GetGeometries(world,ids1,geoms,activeids);
+  size_t n1 = geoms.size();
+  GetGeometries(world,ids2,geoms,activeids);
+  if(n1 == 0 || n1 == geoms.size()) return pair<int,int>(-1,-1);
+  WorldBroadPhaseCache cache;
+  return CheckCollision(cache,geoms,activeids,n1,tol);
+}
+
+pair<int,int> WorldPlannerSettings::CheckCollision(WorldBroadPhaseCache& cache,const vector<Geometry::AnyCollisionGeometry3D*>& geoms,const vector<int>& activeids,size_t n1,Real tol) const
+{
+  for(size_t i=0;i<geoms.size();i++)
+    cache.GetAABB(activeids[i],geoms[i]);
+
+  vector<pair<int,int> >& pairs = cache.queryPairs;
+  cache.Overlaps(activeids,n1,tol,pairs);
+  bool bipartite = (n1 < geoms.size());
+  for(size_t k=0;k<pairs.size();k++) {
+    int i=pairs[k].first, j=pairs[k].second;
+    bool enabled;
+    if(bipartite) enabled = collisionEnabled(activeids[i],activeids[j]) || collisionEnabled(activeids[j],activeids[i]);
+    else enabled = collisionEnabled(activeids[i],activeids[j]) || collisionEnabled(activeids[i],activeids[i]);
+    if(enabled && ::CheckCollision(geoms[i],geoms[j],tol))
+      return pair<int,int>(activeids[i],activeids[j]);
   }
   return pair<int,int>(-1,-1);
 }
@@ -366,72 +414,25 @@ bool WorldPlannerSettings::CheckCollision(RobotWorld& world,AnyCollisionGeometry
 
 Real WorldPlannerSettings::DistanceLowerBound(RobotWorld& world,int id1,int id2,Real eps,Real bound)
 {
-  Real minDist = bound;
-  if(id2 < 0) {  //check all
-    for(int i=0;i<collisionEnabled.n;i++) {
-      minDist = Min(minDist,DistanceLowerBound(world,id1,i,eps,minDist));
-    }
-    return minDist;
-  }
+  if(id2 >= 0 && !collisionEnabled(id1,id2)) return Inf;
+  //query the two sets through the broad phase.  With id2 < 0, the other
+  //set is everything, and the robots stand for their links
+  vector<int> ids1(1,id1),ids2;
+  if(id2 >= 0) ids2.push_back(id2);
   else {
-    if(!collisionEnabled(id1,id2)) return Inf;
-    int index1,index2;
-    index1 = world.IsRobot(id1);
-    index2 = world.IsRobot(id2);
-    //check for robot collision
-    if(index1 >= 0) {
-      Robot* robot = world.robots[index1];
-      if(index2 >= 0) {
-	Robot* robot2 = world.robots[index2];
-	for(size_t j=0;j<robot->links.size();j++)
-	  for(size_t k=0;k<robot2->links.size();k++)
-	    if(collisionEnabled(world.RobotLinkID(index1,j),world.RobotLinkID(index2,k))) {
-	      minDist = Min(minDist,::DistanceLowerBound(robot->geometry[j],robot2->geometry[k],eps,minDist));
-	    }
-      }
-      else {
-	for(size_t j=0;j<robot->links.size();j++)
-	  if(collisionEnabled(world.RobotLinkID(index1,j),id2)) {
-	    minDist = Min(minDist,DistanceLowerBound(world,robot->geometry[j],id2,eps,minDist));
-	  }
-      }
-      return minDist;
-    }
-    else if(index2 >= 0) {
-      Robot* robot2 = world.robots[index2];
-      for(size_t j=0;j<robot2->links.size();j++)
-	if(collisionEnabled(id1,world.RobotLinkID(index2,j))) {
-	  minDist = Min(minDist,DistanceLowerBound(world,robot2->geometry[j],id1,eps,minDist));
-	}
-    }
-    //non-robots
-    index1 = world.IsTerrain(id1);
-    if(index1 >= 0) {
-      return DistanceLowerBound(world,world.terrains[index1]->geometry,id2,eps,minDist);
-    }
-    index1 = world.IsRigidObject(id1);
-    if(index1 >= 0) {
-      RigidObject* obj = world.rigidObjects[index1];
-      if(obj->geometry.Empty()) return false;
-      obj->geometry->SetTransform(obj->T);
-      return DistanceLowerBound(world,obj->geometry,id2,eps,minDist);
-    }
-    pair<int,int> linkid = world.IsRobotLink(id1);
-    if(linkid.first >= 0) {
-      assert(linkid.first < (int)world.robots.size());
-      Robot* robot = world.robots[linkid.first];
-      assert(linkid.second >= 0 && linkid.second < (int)robot->links.size());
-      Real d=DistanceLowerBound(world,robot->geometry[linkid.second],id2,eps,minDist);
-      //printf("Link %d on robot %d to object %d has distance %g\n",linkid.second,linkid.first,id2,d);
-      //printf("Object %s\n",world.GetName(id2).c_str());
-      //if(d<=0) {
-      //Assert(CheckCollision(world,robot->geometry[linkid.second],id2,0));
-	//printf("It collides!\n");
-      //}
-      return d;
-    }
-    return Inf;
+    for(size_t i=0;i<world.terrains.size();i++)
+      ids2.push_back(world.TerrainID(i));
+    for(size_t i=0;i<world.rigidObjects.size();i++)
+      ids2.push_back(world.RigidObjectID(i));
+    for(size_t i=0;i<world.robots.size();i++)
+      ids2.push_back(world.RobotID(i));
+  }
+  //the rigid object geometries may not have been moved to the objects
+  for(size_t i=0;i<world.rigidObjects.size();i++) {
+    RigidObject* obj = world.rigidObjects[i];
+    if(!obj->geometry.Empty()) obj->geometry->SetTransform(obj->T);
   }
+  return DistanceLowerBound(world,ids1,ids2,eps,bound);
 }
 
 Real WorldPlannerSettings::DistanceLowerBound(RobotWorld& world,AnyCollisionGeometry3D* mesh,int id,Real eps,Real bound)
@@ -521,97 +522,65 @@ Real WorldPlannerSettings::DistanceLowerBound(RobotWorld& world,const vector<int
   vector<Geometry::AnyCollisionGeometry3D*> geoms;
   vector<int> activeids;
   GetGeometries(world,ids,geoms,activeids);
-
-  vector<AABB3D> bbs(geoms.size());
-  for(size_t i=0;i<geoms.size();i++) {
-    bbs[i]=geoms[i]->GetAABB();
-  }
-
-  //reduce upper bound based on upper bound on inter-object distance
-  for(size_t i=0;i<activeids.size();i++) {
-    for(size_t j=i+1;j<activeids.size();j++) {
-      if(!collisionEnabled(activeids[i],activeids[j])) continue;
-      Real maxd=MaxDistance(bbs[i],bbs[j]);
-      if(maxd < bound) bound=maxd;
-    }
-  }
-  //hopefully sorting pairs is cheaper than collision testing
-  vector<pair<Real,pair<int,int> > > sorter;
-  for(size_t i=0;i<activeids.size();i++) {
-    for(size_t j=i+1;j<activeids.size();j++) {
-      if(!collisionEnabled(activeids[i],activeids[j])) continue;
-      Real d=bbs[i].distance(bbs[j]);
-      if(d > bound) continue;
-      sorter.push_back(pair<Real,pair<int,int> >(d,pair<int,int>(i,j)));
-    }
-  }
-  sort(sorter.begin(),sorter.end());
-  for(size_t i=0;i<sorter.size();i++) {
-    if(sorter[i].first > bound) break;
-    int a = sorter[i].second.first;
-    int b = sorter[i].second.second;
-    Real d=::DistanceLowerBound(geoms[a],geoms[b],eps,bound);
-    if(d < bound) {
-      bound = d;
-      if(closest1 && closest2) {
-	*closest1 = activeids[a];
-	*closest2 = activeids[b];
-      }
-    }
-  }
-  return bound;
+  WorldBroadPhaseCache cache;
+  return DistanceLowerBound(cache,geoms,activeids,geoms.size(),eps,bound,closest1,closest2);
 }
 
 Real WorldPlannerSettings::DistanceLowerBound(RobotWorld& world,const vector<int>& ids1,const vector<int>& ids2,Real eps,Real bound,int* closest1,int* closest2)
 {
-  //first, get all the geometries
-  vector<Geometry::AnyCollisionGeometry3D*> geoms1,geoms2;
-  vector<int> activeids1,activeids2;
-  GetGeometries(world,ids1,geoms1,activeids1);
-  GetGeometries(world,ids2,geoms2,activeids2);
-
-  vector<AABB3D> bbs1(geoms1.size()),bbs2(geoms2.size());
-  for(size_t i=0;i<geoms1.size();i++) {
-    bbs1[i]=geoms1[i]->GetAABB();
-  }
-  for(size_t i=0;i<geoms2.size();i++) {
-    bbs2[i]=geoms2[i]->GetAABB();
-  }
+  //first, get all the geometries.  Set 1 goes first in geoms, then set 2
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  vector<int> activeids;
+  GetGeometries(world,ids1,geoms,activeids);
+  size_t n1 = geoms.size();
+  GetGeometries(world,ids2,geoms,activeids);
+  if(n1 == 0 || n1 == geoms.size()) return bound;
+  WorldBroadPhaseCache cache;
+  return DistanceLowerBound(cache,geoms,activeids,n1,eps,bound,closest1,closest2);
+}
 
-  //reduce upper bound based on upper bound on inter-object distance
-  for(size_t i=0;i<activeids1.size();i++) {
-    for(size_t j=0;j<activeids2.size();j++) {
-      if(!collisionEnabled(activeids1[i],activeids2[j])) continue;
-      Real maxd=MaxDistance(bbs1[i],bbs2[j]);
-      if(maxd < bound) bound=maxd;
-    }
+Real WorldPlannerSettings::DistanceLowerBound(WorldBroadPhaseCache& cache,const vector<Geometry::AnyCollisionGeometry3D*>& geoms,const vector<int>& activeids,size_t n1,Real eps,Real bound,int* closest1,int* closest2) const
+{
+  const vector<AABB3D>& bbs = cache.bbs;
+  for(size_t i=0;i<geoms.size();i++)
+    cache.GetAABB(activeids[i],geoms[i]);
+
+  //only the pairs whose boxes are within the bound can be closer than it
+  vector<pair<int,int> >& pairs = cache.queryPairs;
+  cache.Overlaps(activeids,n1,bound,pairs);
+  //reduce upper bound based on upper bound on inter-object distance.  The
+  //pairs left out by the broad phase are farther than the bound, so they
+  //can't reduce it
+  for(size_t k=0;k<pairs.size();k++) {
+    int i=pairs[k].first, j=pairs[k].second;
+    if(!collisionEnabled(activeids[i],activeids[j])) continue;
+    Real maxd=MaxDistance(bbs[activeids[i]],bbs[activeids[j]]);
+    if(maxd < bound) bound=maxd;
   }
   //hopefully sorting pairs is cheaper than collision testing
   vector<pair<Real,pair<int,int> > > sorter;
-  for(size_t i=0;i<activeids1.size();i++) {
-    for(size_t j=0;j<activeids2.size();j++) {
-      if(!collisionEnabled(activeids1[i],activeids2[j])) continue;
-      Real d=bbs1[i].distance(bbs2[j]);
-      if(d > bound) continue;
-      sorter.push_back(pair<Real,pair<int,int> >(d,pair<int,int>(i,j)));
-    }
+  for(size_t k=0;k<pairs.size();k++) {
+    int i=pairs[k].first, j=pairs[k].second;
+    if(!collisionEnabled(activeids[i],activeids[j])) continue;
+    Real d=bbs[activeids[i]].distance(bbs[activeids[j]]);
+    if(d > bound) continue;
+    sorter.push_back(pair<Real,pair<int,int> >(d,pairs[k]));
   }
   sort(sorter.begin(),sorter.end());
   for(size_t i=0;i<sorter.size();i++) {
     if(sorter[i].first > bound) break;
     int a = sorter[i].second.first;
     int b = sorter[i].second.second;
-    Real d=::DistanceLowerBound(geoms1[a],geoms2[b],eps,bound);
+    Real d=::DistanceLowerBound(geoms[a],geoms[b],eps,bound);
     if(d < bound) {
       bound = d;
       if(closest1 && closest2) {
-	*closest1 = activeids1[a];
-	*closest2 = activeids2[b];
+	*closest1 = activeids[a];
+	*closest2 = activeids[b];
       }
     }
   }
   return bound;
-
 }
 
 void WorldPlannerSettings::EnumerateCollisionPairs(RobotWorld& world,vector<pair<int,int> >& pairs) const
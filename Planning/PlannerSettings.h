@@ -31,12 +31,67 @@ struct TerrainPlannerSettings
   PropertyMap properties;  ///<other properties
 };
 
+/** @brief Caches the bounding boxes of world geometries between collision
+ * queries, and finds overlapping boxes by sweep-and-prune.
+ *
+ * The box of a geometry is recomputed only when its transform (or the
+ * geometry itself) has changed since the last query, so geometries that
+ * don't move between queries, like the terrains and objects during single
+ * robot planning, are only refit once.  If a geometry's data is changed
+ * in place, call Clear().
+ *
+ * The IDs of all cached boxes are kept in one list sorted by the boxes'
+ * lower x coordinates, which each query re-sorts by insertion sort.  The
+ * boxes move little from one query to the next, so this takes close to
+ * linear time, and queries on different sets of IDs share the list.
+ *
+ * Not thread-safe; threads that query concurrently should each pass their
+ * own cache to WorldPlannerSettings.
+ */
+struct WorldBroadPhaseCache
+{
+  WorldBroadPhaseCache();
+  void Clear();
+  ///Returns the bounding box of the geometry with the given world ID,
+  ///refitting it if the geometry has moved
+  const AABB3D& GetAABB(int id,Geometry::AnyCollisionGeometry3D* geom);
+  ///Finds the pairs (i,j), i<j, of the geometries with the given world
+  ///IDs whose boxes are within margin of one another.  The boxes must have
+  ///been updated with GetAABB.  If n1 < ids.size(), ids [0,n1) and
+  ///[n1,ids.size()) are two sets and only pairs with i in the first set and
+  ///j in the second are returned.
+  void Overlaps(const vector<int>& ids,size_t n1,Real margin,vector<pair<int,int> >& pairs);
+
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;  //indexed by world ID #
+  vector<RigidTransform> transforms;
+  vector<AABB3D> bbs;
+  vector<int> sortedIDs;    //cached IDs, by lower x coordinate
+  bool sortedIDsChanged;    //true if IDs were added since the last sort
+  int numRefits;
+  //temporary storage for queries
+  vector<int> queryIndex;   //indexed by world ID #, -1 if not queried
+  vector<int> order;
+  vector<AABB3D> queryBBs;
+  vector<pair<int,int> > queryPairs;
+};
+
+///Appends the non-empty collision geometries of the given world IDs to
+///geoms, and their IDs to activeids.  Robots are expanded into their links.
+void GetGeometries(RobotWorld& world,const vector<int>& ids,vector<Geometry::AnyCollisionGeometry3D*>& geoms,vector<int>& activeids);
+
 /** @brief A structure containing settings that should be used for collision
  * detection, contact solving, etc.  Also performs modified collision
  * checking with enabled/disabled collision checking between different objects.
  * 
  * Make sure to call world.UpdateGeometry() before using the CheckCollision and
  * DistanceLowerBound routines.
+ *
+ * The set-based CheckCollision and DistanceLowerBound routines, and the
+ * DistanceLowerBound routine on world IDs, only test the pairs whose
+ * bounding boxes overlap.  The routines that take a RobotWorld fit the
+ * boxes anew on each call and keep no state between calls.  Callers that
+ * query repeatedly should keep their own WorldBroadPhaseCache, one per
+ * thread, and call the routines that take one.
  */
 struct WorldPlannerSettings
 {
@@ -86,6 +141,19 @@ struct WorldPlannerSettings
   ///pair that yielded the minimum distance.
   Real DistanceLowerBound(RobotWorld& world,const vector<int>& ids1,const vector<int>& ids2,Real eps=0,Real bound=Inf,int* closest1=NULL,int* closest2=NULL);
 
+  ///Checks collisions among explicitly given geometries, whose world IDs
+  ///are given in ids.  If n1 < geoms.size(), only the pairs between
+  ///geometries [0,n1) and [n1,geoms.size()) are checked, otherwise all pairs
+  ///are.  Returns the ids of the first colliding pair, or (-1,-1).
+  ///
+  ///Only cache is modified, so several threads may call this at once as
+  ///long as each passes its own cache and doesn't move the geometries that
+  ///other threads are using.
+  pair<int,int> CheckCollision(WorldBroadPhaseCache& cache,const vector<Geometry::AnyCollisionGeometry3D*>& geoms,const vector<int>& ids,size_t n1,Real tol=0) const;
+  ///Same as the above, but returns the distance lower bound between the
+  ///geometries.
+  Real DistanceLowerBound(WorldBroadPhaseCache& cache,const vector<Geometry::AnyCollisionGeometry3D*>& geoms,const vector<int>& ids,size_t n1,Real eps=0,Real bound=Inf,int* closest1=NULL,int* closest2=NULL) const;
+
   ///Returns a list of object IDs that can potentially collide
   void EnumerateCollisionPairs(RobotWorld& world,vector<pair<int,int> >& pairs) const;
   ///Enumerates all potentially colliding pairs of ids contained in 
@@ -0,0 +1,132 @@
+#include "PlanningTimeDatabase.h"
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+
+PlanningTimeDistribution::PlanningTimeDistribution()
+  :numFailures(0),numTimeouts(0)
+{}
+
+void PlanningTimeDistribution::Add(Real time,bool success,bool timeout)
+{
+  if(success) successTimes.push_back(time);
+  else if(timeout) {
+    numTimeouts++;
+    timeoutTimes.push_back(time);
+  }
+  else numFailures++;
+}
+
+Real PlanningTimeDistribution::SuccessQuantile(Real quantile) const
+{
+  if(successTimes.empty()) return -1;
+  //(time, 0 for a success or 1 for a timeout), so that at equal times the
+  //successes come first and the timeouts are still at risk
+  vector<pair<Real,int> > times;
+  for(size_t i=0;i<successTimes.size();i++)
+    times.push_back(pair<Real,int>(successTimes[i],0));
+  for(size_t i=0;i<timeoutTimes.size();i++)
+    times.push_back(pair<Real,int>(timeoutTimes[i],1));
+  sort(times.begin(),times.end());
+  //Kaplan-Meier estimate of the probability of no solution by time t
+  Real survival = 1;
+  size_t numAtRisk = times.size();
+  size_t i=0;
+  while(i < times.size()) {
+    size_t j=i;
+    int numSolved = 0;
+    while(j < times.size() && times[j].first == times[i].first) {
+      if(times[j].second == 0) numSolved++;
+      j++;
+    }
+    if(numSolved > 0) {
+      survival *= 1.0 - Real(numSolved)/Real(numAtRisk);
+      if(1.0 - survival >= quantile - 1e-12) return times[i].first;
+    }
+    numAtRisk -= j-i;
+    i = j;
+  }
+  return -1;
+}
+
+
+PlanningTimeDatabase::PlanningTimeDatabase()
+  :maxSamples(1000),minSamples(10)
+{}
+
+bool PlanningTimeDatabase::Load(const char* fn)
+{
+  ifstream in(fn,ios::in);
+  if(!in) {
+    fprintf(stderr,"PlanningTimeDatabase::Load: could not open %s\n",fn);
+    return false;
+  }
+  distributions.clear();
+  string key;
+  while(getline(in,key)) {
+    if(key.empty()) continue;
+    PlanningTimeDistribution& d = distributions[key];
+    int n,m;
+    in >> n >> d.numFailures >> d.numTimeouts >> m;
+    if(!in || n < 0 || m < 0) {
+      fprintf(stderr,"PlanningTimeDatabase::Load: error reading entry %s\n",key.c_str());
+      return false;
+    }
+    d.successTimes.resize(n);
+    for(int i=0;i<n;i++)
+      in >> d.successTimes[i];
+    d.timeoutTimes.resize(m);
+    for(int i=0;i<m;i++)
+      in >> d.timeoutTimes[i];
+    if(!in) {
+      fprintf(stderr,"PlanningTimeDatabase::Load: error reading times of entry %s\n",key.c_str());
+      return false;
+    }
+    while(d.successTimes.size() > maxSamples)
+      d.successTimes.pop_front();
+    while(d.timeoutTimes.size() > maxSamples)
+      d.timeoutTimes.pop_front();
+    //skip the rest of the line
+    getline(in,key);
+  }
+  return true;
+}
+
+bool PlanningTimeDatabase::Save(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) {
+    fprintf(stderr,"PlanningTimeDatabase::Save: could not open %s for writing\n",fn);
+    return false;
+  }
+  for(map<string,PlanningTimeDistribution>::const_iterator i=distributions.begin();i!=distributions.end();i++) {
+    const PlanningTimeDistribution& d = i->second;
+    out<<i->first<<endl;
+    out<<d.successTimes.size()<<" "<<d.numFailures<<" "<<d.numTimeouts<<" "<<d.timeoutTimes.size();
+    for(size_t j=0;j<d.successTimes.size();j++)
+      out<<" "<<d.successTimes[j];
+    for(size_t j=0;j<d.timeoutTimes.size();j++)
+      out<<" "<<d.timeoutTimes[j];
+    out<<endl;
+  }
+  return true;
+}
+
+void PlanningTimeDatabase::Add(const string& key,Real time,bool success,bool timeout)
+{
+  PlanningTimeDistribution& d = distributions[key];
+  d.Add(time,success,timeout);
+  while(d.successTimes.size() > maxSamples)
+    d.successTimes.pop_front();
+  while(d.timeoutTimes.size() > maxSamples)
+    d.timeoutTimes.pop_front();
+}
+
+Real PlanningTimeDatabase::SuccessQuantile(const string& key,Real quantile) const
+{
+  map<string,PlanningTimeDistribution>::const_iterator i=distributions.find(key);
+  if(i == distributions.end()) return -1;
+  if(i->second.successTimes.size()+i->second.timeoutTimes.size() < minSamples) return -1;
+  return i->second.SuccessQuantile(quantile);
+}
@@ -0,0 +1,63 @@
+#ifndef PLANNING_TIME_DATABASE_H
+#define PLANNING_TIME_DATABASE_H
+
+#include <KrisLibrary/math/math.h>
+#include <deque>
+#include <map>
+#include <string>
+using namespace Math;
+using namespace std;
+
+/** @ingroup Planning
+ * @brief The planning times observed for one kind of planning problem.
+ *
+ * A success time is the time a cycle took to find its first feasible path.
+ * A timeout time is the time a cycle ran without finding one, which only
+ * says that the time to a solution is longer (it is right-censored).  The
+ * most recent times of each kind are kept, up to maxSamples of them, along
+ * with counts of failed and timed out cycles.
+ */
+struct PlanningTimeDistribution
+{
+  PlanningTimeDistribution();
+  void Add(Real time,bool success,bool timeout);
+  ///Returns the time by which a cycle finds a solution with probability
+  ///quantile, from the Kaplan-Meier estimate over the success and timeout
+  ///times.  Returns -1 if the estimate never reaches quantile, e.g., if
+  ///too many cycles timed out.
+  Real SuccessQuantile(Real quantile) const;
+
+  deque<Real> successTimes,timeoutTimes;
+  int numFailures,numTimeouts;
+};
+
+/** @ingroup Planning
+ * @brief Planning time distributions keyed on a string, typically the
+ * objective type and the world, that can be saved and loaded so that they
+ * persist across runs.  Used by the Learning protocol of RealTimePlanner.
+ *
+ * The file format is text, with two lines per key: the key itself, then
+ * the number of success times, the number of failures, the number of
+ * timeouts, the number of timeout times, then the success times and the
+ * timeout times from oldest to newest.
+ */
+class PlanningTimeDatabase
+{
+public:
+  PlanningTimeDatabase();
+  bool Load(const char* fn);
+  bool Save(const char* fn) const;
+  void Add(const string& key,Real time,bool success,bool timeout=false);
+  ///Returns the time by which a cycle for key finds a solution with
+  ///probability quantile (see PlanningTimeDistribution), or -1 if fewer
+  ///than minSamples success and timeout times are known
+  Real SuccessQuantile(const string& key,Real quantile) const;
+
+  ///Maximum number of success times, and of timeout times, kept per key
+  size_t maxSamples;
+  ///Minimum number of success and timeout times needed for a prediction
+  size_t minSamples;
+  map<string,PlanningTimeDistribution> distributions;
+};
+
+#endif
@@ -5,7 +5,7 @@ using namespace std;
 
 
 RampCSpaceAdaptor::RampCSpaceAdaptor(CSpace* _cspace,const Vector& _velMax,const Vector& _accMax)
-  :cspace(_cspace),velMax(_velMax),accMax(_accMax),visibilityTolerance(1e-3)
+  :cspace(_cspace),velMax(_velMax),accMax(_accMax),visibilityTolerance(1e-3),rng(NULL)
 {}
 
 bool RampCSpaceAdaptor::IsFeasible(const Config& q,const Config& dq)
@@ -34,8 +34,10 @@ void RampCSpaceAdaptor::Sample(State& s)
   q.setRef(s,0,1,velMax.size());
   dq.setRef(s,velMax.size(),1,velMax.size());
   cspace->Sample(q);
-  for(int i=0;i<dq.n;i++)
-    dq(i) =Rand(-velMax[i],velMax[i]);
+  for(int i=0;i<dq.n;i++) {
+    if(rng) dq(i) = velMax[i]*(2.0*rng->Rand()-1.0);
+    else dq(i) =Rand(-velMax[i],velMax[i]);
+  }
 }
 
 EdgePlanner* RampCSpaceAdaptor::LocalPlanner(const State& a,const State& b)
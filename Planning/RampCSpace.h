@@ -28,6 +28,9 @@ public:
   std::vector<Real> qMin,qMax;
   std::vector<Real> velMax,accMax;
   Real visibilityTolerance;
+  ///If non-NULL, sampled velocities come from this generator rather than
+  ///the global one.  Not owned.
+  ParabolicRamp::RandomNumberGeneratorBase* rng;
 };
 
 
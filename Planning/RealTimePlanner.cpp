@@ -6,7 +6,10 @@
 #include <KrisLibrary/math/random.h>
 #include <KrisLibrary/math/differentiation.h>
 #include <KrisLibrary/optimization/Minimization.h>
+#include <KrisLibrary/utils/AnyCollection.h>
 #include <string.h>
+#include <algorithm>
+#include <map>
 #include <typeinfo>
 
 
@@ -75,6 +78,10 @@ int IsVisible(EdgePlanner* e,Timer& timer,Real cutoff,int numStepsPerCheck=5)
   return (e->IsVisible()?1:0);
 }
 
+RealTimePlannerStats::RealTimePlannerStats()
+  :numCycles(0),numSuccesses(0),numTimeouts(0),numFailures(0),numWins(0)
+{}
+
 RealTimePlanner::RealTimePlanner()
   :protocol(ExponentialBackoff),currentSplitTime(0.1),currentPadding(0.01),
    currentExternalPadding(0.01),
@@ -85,6 +92,8 @@ RealTimePlanner::RealTimePlanner()
   pathStartTime = 0;
   cognitiveMultiplier = 1.0;
   acceptTimeOverruns = false;
+  learningQuantile = 0.9;
+  plannerStats.resize(1);
 }
 
 RealTimePlanner::~RealTimePlanner()
@@ -96,12 +105,99 @@ void RealTimePlanner::SetSpace(SingleRobotCSpace* space)
 {
   if(planner) {
     planner->Init(space,space->GetRobot(),space->settings);
+    for(size_t k=0;k<parallelPlanners.size();k++)
+      InitParallelPlanner((int)k,space);
   }
   else {
     fprintf(stderr,"RealTimePlanner::SetSpace: warning, underlying planner not set\n");
   }
 }
 
+void RealTimePlanner::AddParallelPlanner(const SmartPointer<DynamicMotionPlannerBase>& p)
+{
+  SingleRobotCSpace* space = NULL;
+  if(planner) space = dynamic_cast<SingleRobotCSpace*>(planner->cspace);
+  if(!space) {
+    fprintf(stderr,"RealTimePlanner::AddParallelPlanner: call SetSpace with a SingleRobotCSpace first\n");
+    return;
+  }
+  parallelPlanners.push_back(p);
+  parallelRobots.resize(parallelPlanners.size());
+  parallelSpaces.resize(parallelPlanners.size());
+  plannerStats.resize(parallelPlanners.size()+1);
+  InitParallelPlanner((int)parallelPlanners.size()-1,space);
+  parallelPool.Resize((int)parallelPlanners.size()+1);
+}
+
+void RealTimePlanner::InitParallelPlanner(int k,SingleRobotCSpace* space)
+{
+  //the space's robot copy and generator are shared with its planner, which
+  //only uses them from its own thread
+  parallelSpaces[k] = space->CloneForThread(new ParabolicRamp::SeededRandomNumberGenerator(k+1));
+  parallelRobots[k] = parallelSpaces[k]->threadRobot;
+  DynamicMotionPlannerBase* p = parallelPlanners[k];
+  p->Init(parallelSpaces[k],parallelRobots[k],planner->settings);
+  p->rng = parallelSpaces[k]->rng;
+  p->qMin = planner->qMin;
+  p->qMax = planner->qMax;
+  p->velMax = planner->velMax;
+  p->accMax = planner->accMax;
+  //copy the objective on the next update
+  parallelGoal = NULL;
+}
+
+//copies the objective to the parallel planners if it has changed
+void RealTimePlanner::UpdateParallelGoals()
+{
+  if(parallelGoal == planner->goal) return;
+  parallelGoal = planner->goal;
+  AnyCollection msg;
+  bool saved = (planner->goal && planner->goal->TypeString() && SavePlannerObjective(planner->goal,msg));
+  if(planner->goal && !saved)
+    fprintf(planner->flog,"RealTimePlanner: objective can't be copied, parallel planners are idle\n");
+  for(size_t k=0;k<parallelPlanners.size();k++) {
+    if(saved) parallelPlanners[k]->SetGoal(LoadPlannerObjective(msg,parallelRobots[k]));
+    else parallelPlanners[k]->SetGoal(NULL);
+  }
+}
+
+struct ParallelPlanData
+{
+  DynamicMotionPlannerBase* planner;
+  ParabolicRamp::DynamicPath path;
+  int res;
+  //planTime is the time PlanFrom took, solutionTime the time to its first
+  //feasible path or -1 if it found none
+  Real planTime,solutionTime;
+};
+
+static void RunPlanner(ParallelPlanData& d,Real cutoff)
+{
+  Timer timer;
+  d.planner->StartSolutionClock();
+  d.res = d.planner->PlanFrom(d.path,cutoff);
+  d.planTime = timer.ElapsedTime();
+  d.solutionTime = d.planner->firstSolutionTime;
+  //planners that return as soon as they find a path don't mark it
+  if(d.solutionTime < 0 && d.res == DynamicMotionPlannerBase::Success)
+    d.solutionTime = d.planTime;
+}
+
+//runs PlanFrom for each planner that has an objective
+struct ParallelPlanBody : public ParallelForBody
+{
+  vector<ParallelPlanData>* data;
+  Real cutoff;
+
+  virtual bool operator ()(int i,int thread) {
+    ParallelPlanData& d = (*data)[i];
+    //the main planner (i = 0) always plans
+    if(i > 0 && !d.planner->goal) return true;
+    RunPlanner(d,cutoff);
+    return true;
+  }
+};
+
 SmartPointer<PlannerObjectiveBase> RealTimePlanner::Objective() const
 {
   if(!planner) return NULL;
@@ -144,6 +240,14 @@ bool RealTimePlanner::PlanUpdate(Real tglobal,Real& splitTime,Real& planTime)
   }
   assert(!currentPath.ramps.empty());
   assert(currentPath.IsValid());
+  if(protocol == Learning && timeDatabase) {
+    //budget the planner the time within which it usually succeeded
+    Real t = timeDatabase->SuccessQuantile(PlanningTimeKey(),learningQuantile);
+    if(t >= 0) {
+      currentSplitTime = t+currentPadding+currentExternalPadding;
+      fprintf(planner->flog,"Learned planning time %g, setting split time to %g\n",t,currentSplitTime);
+    }
+  }
   if(currentSplitTime < currentPadding+currentExternalPadding+0.001) {
     currentSplitTime=currentPadding+currentExternalPadding+0.001;
   }
@@ -173,17 +277,79 @@ bool RealTimePlanner::PlanUpdate(Real tglobal,Real& splitTime,Real& planTime)
   fprintf(planner->flog,"***** Planning for time %gs (split %g, padding %g, ext %g)*********\n",(currentSplitTime-currentPadding-currentExternalPadding)*cognitiveMultiplier,currentSplitTime,currentPadding,currentExternalPadding);
 
   timer.Reset();
-  planner->stopPlanning = false;
-  planner->SetTime(currentSplitTime);
-  int res=planner->PlanFrom(after,(currentSplitTime-currentPadding-currentExternalPadding)*cognitiveMultiplier);
+  Real cutoff = (currentSplitTime-currentPadding-currentExternalPadding)*cognitiveMultiplier;
+  //plan with planner (pdata[0]) and the parallel planners from the same
+  //split point
+  UpdateParallelGoals();
+  vector<ParallelPlanData> pdata(parallelPlanners.size()+1);
+  for(size_t k=0;k<pdata.size();k++) {
+    pdata[k].planner = (k==0 ? (DynamicMotionPlannerBase*)planner : (DynamicMotionPlannerBase*)parallelPlanners[k-1]);
+    pdata[k].path = after;
+    pdata[k].res = DynamicMotionPlannerBase::Failure;
+    pdata[k].planTime = 0;
+    pdata[k].solutionTime = -1;
+    pdata[k].planner->stopPlanning = false;
+    pdata[k].planner->SetTime(currentSplitTime);
+  }
+  if(parallelPlanners.empty())
+    RunPlanner(pdata[0],cutoff);
+  else {
+    ParallelPlanBody body;
+    body.data = &pdata;
+    body.cutoff = cutoff;
+    parallelPool.ParallelFor(0,(int)pdata.size(),body);
+  }
+  int res = pdata[0].res;
+  after = pdata[0].path;
   planTime = timer.ElapsedTime()/cognitiveMultiplier;
 
+  //pick the lowest cost path among those that succeeded or timed out
+  plannerStats.resize(parallelPlanners.size()+1);
+  int winner = -1;
+  Real bestCost = Inf;
+  for(size_t k=0;k<pdata.size();k++) {
+    int kres = pdata[k].res;
+    if(k > 0 && !parallelPlanners[k-1]->goal) continue;
+    RealTimePlannerStats& stats = plannerStats[k];
+    stats.numCycles++;
+    stats.planTimeStats.collect(pdata[k].planTime/cognitiveMultiplier);
+    if(kres==DynamicMotionPlannerBase::Failure) { stats.numFailures++; continue; }
+    if(kres==DynamicMotionPlannerBase::Success) stats.numSuccesses++;
+    else stats.numTimeouts++;
+    Real cost = planner->EvaluatePathCost(pdata[k].path,currentSplitTime);
+    if(winner < 0 || cost < bestCost) {
+      winner = (int)k;
+      bestCost = cost;
+    }
+  }
+  if(winner >= 0) {
+    plannerStats[winner].numWins++;
+    if(winner > 0) {
+      fprintf(planner->flog,"Parallel planner %d chosen, cost %g\n",winner-1,bestCost);
+      res = pdata[winner].res;
+      after = pdata[winner].path;
+    }
+  }
+
   fprintf(planner->flog,"***** Planning took time %gs *********\n",timer.ElapsedTime());
   //printf("Planning took time %g\n",planTime);
   //collect statistics
   if(res==DynamicMotionPlannerBase::Failure) planFailTimeStats.collect(planTime);
   else if(res==DynamicMotionPlannerBase::Success) planSuccessTimeStats.collect(planTime);
   else if(res==DynamicMotionPlannerBase::Timeout) planTimeoutTimeStats.collect(planTime);
+  if(timeDatabase) {
+    //anytime planners run to the cutoff whatever they find, so record the
+    //time until a feasible path was first available.  A cycle in which
+    //none was found only says that it takes longer than planTime.
+    Real solutionTime = -1;
+    for(size_t k=0;k<pdata.size();k++)
+      if(pdata[k].solutionTime >= 0 && (solutionTime < 0 || pdata[k].solutionTime < solutionTime))
+        solutionTime = pdata[k].solutionTime;
+    if(solutionTime >= 0)
+      timeDatabase->Add(PlanningTimeKey(),solutionTime/cognitiveMultiplier,true);
+    else
+      timeDatabase->Add(PlanningTimeKey(),planTime,false,res==DynamicMotionPlannerBase::Timeout);
+  }
 
   //now decide whether to update the path 
   bool updatePath = false;
@@ -211,7 +377,10 @@ bool RealTimePlanner::PlanUpdate(Real tglobal,Real& splitTime,Real& planTime)
   //update currentSplitTime and currentPadding
   if(protocol == Constant) { // do nothing 
   }
-  else if(protocol == ExponentialBackoff) {
+  else if(protocol == ExponentialBackoff || protocol == Learning) {
+    //Learning uses this until there are enough samples to predict the
+    //planning time, after which the split time is overridden at the start
+    //of each update
     //update currentPadding
     if(planTime > splitTime-currentExternalPadding) {
       currentSplitTime += currentPadding;
@@ -241,15 +410,6 @@ bool RealTimePlanner::PlanUpdate(Real tglobal,Real& splitTime,Real& planTime)
       fprintf(planner->flog,"Failure, setting split time to %g\n",currentSplitTime); 
     }
   }
-  else if(protocol == Learning) {
-    //TODO
-    /*
-      if(planSuccessTimeStats.number()==0)
-      currentSplitTime *= 2.0;
-      else
-      currentSplitTime = 
-    */
-  }
 
   if(updatePath) {
     for(size_t i=0;i<after.ramps.size();i++)
@@ -305,6 +465,16 @@ bool RealTimePlanner::PlanUpdate(Real tglobal,Real& splitTime,Real& planTime)
     return false;
 }
 
+string RealTimePlanner::PlanningTimeKey() const
+{
+  string type = "none";
+  if(planner && planner->goal) {
+    if(planner->goal->TypeString()) type = planner->goal->TypeString();
+    else type = "custom";
+  }
+  return type+" "+worldName;
+}
+
 void RealTimePlanner::MarkSendFailure()
 {
   currentSplitTime += currentExternalPadding;
@@ -728,7 +898,7 @@ Real RealTimePlanningThread::ObjectiveValue()
 
 
 DynamicMotionPlannerBase::DynamicMotionPlannerBase()
-  :robot(NULL),settings(NULL),cspace(NULL),tstart(0)
+  :robot(NULL),settings(NULL),cspace(NULL),tstart(0),firstSolutionTime(-1),rng(NULL)
 {
   flog = stdout;
 }
@@ -803,6 +973,23 @@ bool DynamicMotionPlannerBase::StopPlanning()
   return true;
 }
 
+Real DynamicMotionPlannerBase::RandomFraction()
+{
+  if(rng) return rng->Rand();
+  return Rand();
+}
+
+void DynamicMotionPlannerBase::StartSolutionClock()
+{
+  firstSolutionTime = -1;
+  solutionTimer.Reset();
+}
+
+void DynamicMotionPlannerBase::MarkSolutionFound()
+{
+  if(firstSolutionTime < 0) firstSolutionTime = solutionTimer.ElapsedTime();
+}
+
 int DynamicMotionPlannerBase::Shortcut(ParabolicRamp::DynamicPath& path,Real timeLimit)
 {
   if(timeLimit <= 0) return 0;
@@ -817,8 +1004,8 @@ int DynamicMotionPlannerBase::Shortcut(ParabolicRamp::DynamicPath& path,Real tim
   CSpaceFeasibilityChecker feas(cspace);
   ParabolicRamp::RampFeasibilityChecker checker(&feas,pathEpsilon);
   while(timer.ElapsedTime() < timeLimit && !stopPlanning) {
-    Real t1 = Sqr(Rand())*path.GetTotalTime();
-    Real t2 = Sqr(Rand())*path.GetTotalTime();
+    Real t1 = Sqr(RandomFraction())*path.GetTotalTime();
+    Real t2 = Sqr(RandomFraction())*path.GetTotalTime();
     if(path.TryShortcut(t1,t2,checker))
       num++;
   }
@@ -870,8 +1057,8 @@ int DynamicMotionPlannerBase::SmartShortcut(Real tstart,ParabolicRamp::DynamicPa
   vector<Real> x0,x1,dx0,dx1;
   while(timer.ElapsedTime() < timeLimit) {
     if(stopPlanning) return num;
-    Real t1 = Sqr(Rand())*(startTimes.back()-startTimes.front());
-    Real t2 = Sqr(Rand())*(startTimes.back()-startTimes.front());
+    Real t1 = Sqr(RandomFraction())*(startTimes.back()-startTimes.front());
+    Real t2 = Sqr(RandomFraction())*(startTimes.back()-startTimes.front());
     if(t1 > t2) swap(t1,t2);
 
     i1 = path.GetSegment(t1,u1);
@@ -1178,9 +1365,71 @@ int DynamicPerturbationIKPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real
 
 
 
+//Collects the nodes of a subtree
+template <class Node>
+struct CollectSubtreeCallback : public Graph::CallbackBase<Node*>
+{
+  virtual void Visit(Node* n) { nodes.push_back(n); }
+  vector<Node*> nodes;
+};
+
+//Gives the index a metric that lower-bounds ramp durations, if it doesn't
+//have one already.  Spin joints are compared by their wrapped difference,
+//as in SingleRobotCSpace::Distance.
+static void InitRampNNIndex(SmartPointer<NearestNeighborIndex>& nnIndex,const ParabolicRamp::Vector& velMax,Robot* robot)
+{
+  if(nnIndex->metric != NULL) return;
+  Vector w((int)velMax.size(),Zero);
+  for(size_t i=0;i<velMax.size();i++)
+    if(velMax[i] > 0) w(i) = 1.0/velMax[i];
+  vector<int> angles;
+  if(robot) {
+    for(size_t i=0;i<robot->joints.size();i++)
+      if(robot->joints[i].type == RobotJoint::Spin)
+	angles.push_back(robot->joints[i].linkIndex);
+    sort(angles.begin(),angles.end());
+  }
+  nnIndex->metric = new WeightedInfNNMetric(w,angles);
+}
+
+//Returns true if path is what remains of prev after following it for some
+//time, which is returned in tshift
+static bool FollowsPath(const ParabolicRamp::DynamicPath& prev,const ParabolicRamp::DynamicPath& path,Real& tshift)
+{
+  tshift = prev.GetTotalTime()-path.GetTotalTime();
+  if(tshift < -1e-5) return false;
+  if(tshift < 0) tshift = 0;
+  ParabolicRamp::Vector x,dx;
+  prev.Evaluate(tshift,x);
+  prev.Derivative(tshift,dx);
+  return Vector(x).isEqual(Vector(path.ramps.front().x0),1e-5) &&
+    Vector(dx).isEqual(Vector(path.ramps.front().dx0),1e-5) &&
+    Vector(prev.ramps.back().x1).isEqual(Vector(path.ramps.back().x1),1e-5);
+}
+
+//Moves the start of ramp to x0,dx0, which it may miss by numerical errors
+static void SetRampStart(ParabolicRamp::ParabolicRampND& ramp,const ParabolicRamp::Vector& x0,const ParabolicRamp::Vector& dx0)
+{
+  ramp.x0 = x0;
+  ramp.dx0 = dx0;
+  for(size_t i=0;i<ramp.ramps.size();i++) {
+    ramp.ramps[i].x0 = x0[i];
+    ramp.ramps[i].dx0 = dx0[i];
+  }
+}
+
 DynamicRRTPlanner::DynamicRRTPlanner()
-  : delta(0.3),smoothTime(0.5),ikSolveProbability(0.5)
-{}
+  : delta(0.3),smoothTime(0.5),ikSolveProbability(0.5),reuseTree(true),reuseMaxDelta(0.1),treeEnd(NULL)
+{
+  nnIndex = new GNATIndex;
+}
+
+void DynamicRRTPlanner::Init(CSpace* space,Robot* robot,WorldPlannerSettings* settings)
+{
+  DynamicMotionPlannerBase::Init(space,robot,settings);
+  //edges checked in a prior space can't be reused
+  treeEnd = NULL;
+}
 
 void DynamicRRTPlanner::SetGoal(SmartPointer<PlannerObjectiveBase> newgoal)
 {
@@ -1240,11 +1489,80 @@ RRTPlanner::Node* DynamicRRTPlanner::TryIKExtend(RRTPlanner::Node* node,bool sea
   //add a node in the rrt tree
   State x=MakeState(qik);
   if(search) {
-    RRTPlanner::Node* closest = rrt->ClosestMilestone(x);
-    return ((TreeRoadmapPlanner*)((RRTPlanner*)rrt))->Extend(closest,x);
+    RRTPlanner::Node* closest = Closest(x);
+    return Extend(closest,x);
   }
   else
-    return ((TreeRoadmapPlanner*)((RRTPlanner*)rrt))->Extend(node,x);
+    return Extend(node,x);
+}
+
+RRTPlanner::Node* DynamicRRTPlanner::AddMilestone(const State& x)
+{
+  RRTPlanner::Node* n=rrt->AddMilestone(x);
+  if(nnIndex != NULL) {
+    Config q;
+    q.setRef(n->x,0,1,n->x.n/2);
+    nnIndex->Insert(q,n);
+  }
+  return n;
+}
+
+RRTPlanner::Node* DynamicRRTPlanner::Extend(RRTPlanner::Node* node,const State& x)
+{
+  RRTPlanner::Node* n=((TreeRoadmapPlanner*)((RRTPlanner*)rrt))->Extend(node,x);
+  if(n && nnIndex != NULL) {
+    Config q;
+    q.setRef(n->x,0,1,n->x.n/2);
+    nnIndex->Insert(q,n);
+  }
+  return n;
+}
+
+RRTPlanner::Node* DynamicRRTPlanner::SplitEdge(RRTPlanner::Node* p,RRTPlanner::Node* n,Real u)
+{
+  RRTPlanner::Node* s=rrt->SplitEdge(p,n,u);
+  if(s && nnIndex != NULL) {
+    Config q;
+    q.setRef(s->x,0,1,s->x.n/2);
+    nnIndex->Insert(q,s);
+  }
+  return s;
+}
+
+void DynamicRRTPlanner::DeleteSubtree(RRTPlanner::Node* n)
+{
+  if(nnIndex != NULL) {
+    CollectSubtreeCallback<RRTPlanner::Node> callback;
+    n->DFS(callback);
+    for(size_t i=0;i<callback.nodes.size();i++)
+      nnIndex->Remove(callback.nodes[i]);
+  }
+  rrt->DeleteSubtree(n);
+}
+
+//The ramp duration from a node's state to a target state
+struct RRTRampTimeCost : public NNCostFunction
+{
+  RRTRampTimeCost(RampCSpaceAdaptor* _space,const State& _x) :space(_space),x(_x) {}
+  virtual Real Cost(void* data,Real distance) {
+    return space->Distance(((RRTPlanner::Node*)data)->x,x);
+  }
+
+  RampCSpaceAdaptor* space;
+  const State& x;
+};
+
+RRTPlanner::Node* DynamicRRTPlanner::Closest(const State& x)
+{
+  if(nnIndex == NULL) return rrt->ClosestMilestone(x);
+  Config q;
+  q.setRef(x,0,1,x.n/2);
+  RRTRampTimeCost f(stateSpace,x);
+  Real cost;
+  RRTPlanner::Node* n=(RRTPlanner::Node*)nnIndex->Search(q,f,cost);
+  //no node reaches x with a valid ramp, fall back to the default choice
+  if(!n) return rrt->ClosestMilestone(x);
+  return n;
 }
 
 Real DynamicRRTPlanner::EvaluateNodePathCost(RRTPlanner::Node* n) 
@@ -1285,7 +1603,7 @@ bool DynamicRRTPlanner::CheckPath(RRTPlanner::Node* n,vector<RRTPlanner::Node*>&
       for(size_t i=0;i<ndelete.size();i++)
 	if(ndelete[i]==temp || ndelete[i]->hasAncestor(temp)) ndelete[i]=NULL; 
       //delete the subtree
-      rrt->DeleteSubtree(temp);
+      DeleteSubtree(temp);
       return false;
     }
     else {
@@ -1296,6 +1614,75 @@ bool DynamicRRTPlanner::CheckPath(RRTPlanner::Node* n,vector<RRTPlanner::Node*>&
   return true;
 }
 
+void DynamicRRTPlanner::InitTree(const ParabolicRamp::DynamicPath& path)
+{
+  rrt = NULL;
+  //create new RRT tree
+  rrt = new RRTPlanner(stateSpace);
+  if(nnIndex != NULL) nnIndex->Clear();
+
+  existingNodes.resize(0);
+  //initialize tree with existing path
+  RRTPlanner::Node* n=AddMilestone(MakeState(path.ramps[0].x0,path.ramps[0].dx0));
+  existingNodes.push_back(n);
+  //extending path destinations
+  for(size_t i=0;i<path.ramps.size();i++) {
+    n = Extend(n,MakeState(path.ramps[i].x1,path.ramps[i].dx1));
+    //sometimes there's an error with SolveMinTime...
+    ((RampEdgePlanner*)((EdgePlanner*)n->edgeFromParent()))->path.ramps.resize(1,path.ramps[i]);
+    Assert(path.ramps[i].IsValid());
+    Assert(((RampEdgePlanner*)((EdgePlanner*)n->edgeFromParent()))->IsValid());
+    existingNodes.push_back(n);
+  }
+}
+
+bool DynamicRRTPlanner::RerootTree(const ParabolicRamp::DynamicPath& path)
+{
+  if(!reuseTree || rrt == NULL || treeEnd == NULL || treeGoal == NULL) return false;
+  if((PlannerObjectiveBase*)goal != (PlannerObjectiveBase*)treeGoal) {
+    Real d=goal->Delta(treeGoal);
+    if(!(d <= reuseMaxDelta)) {
+      fprintf(flog,"Objective changed by %g, not reusing tree\n",d);
+      return false;
+    }
+  }
+  Real tshift;
+  if(!FollowsPath(treePath,path,tshift)) {
+    fprintf(flog,"Start is not on the last returned path, not reusing tree\n");
+    return false;
+  }
+
+  //the old tree is kept alive until its subtree is copied
+  SmartPointer<RRTPlanner> oldTree = rrt;
+  RRTPlanner::Node* oldEnd = treeEnd;
+  InitTree(path);
+  RRTPlanner::Node* end = existingNodes.back();
+  CollectSubtreeCallback<RRTPlanner::Node> callback;
+  oldEnd->DFS(callback);
+  map<RRTPlanner::Node*,RRTPlanner::Node*> copies;
+  copies[oldEnd] = end;
+  //parents are visited before their children
+  for(size_t i=0;i<callback.nodes.size();i++) {
+    RRTPlanner::Node* c = callback.nodes[i];
+    if(c == oldEnd) continue;
+    map<RRTPlanner::Node*,RRTPlanner::Node*>::iterator p = copies.find(c->getParent());
+    if(p == copies.end()) continue;
+    RRTPlanner::Node* n = Extend(p->second,c->x);
+    if(!n) continue;
+    //keep the ramps of the old edge rather than the new local plan
+    RampEdgePlanner* e = (RampEdgePlanner*)((EdgePlanner*)n->edgeFromParent());
+    e->path = ((RampEdgePlanner*)((EdgePlanner*)c->edgeFromParent()))->path;
+    if(p->second == end)
+      SetRampStart(e->path.ramps.front(),path.ramps.back().x1,path.ramps.back().dx1);
+    copies[c] = n;
+  }
+  fprintf(flog,"Kept %d nodes beyond the end of the path\n",(int)copies.size()-1);
+  treeGoal = goal;
+  treePath = path;
+  treeEnd = end;
+  return true;
+}
+
 int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
 {
   if (!goal) return Failure;
@@ -1305,6 +1692,7 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
     stateSpace->qMin=qMin;
     stateSpace->qMax=qMax;
     stateSpace->visibilityTolerance = settings->robotSettings[0].collisionEpsilon;
+    stateSpace->rng = rng;
   }
 
 
@@ -1312,6 +1700,7 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
   Timer timer;
   if(goal->TerminalCost(tstart+path.GetTotalTime(),path.ramps.back().x1,path.ramps.back().dx1) < 1e-3) {
     fprintf(flog,"Already at solution, doing shortcutting...\n");
+    MarkSolutionFound();
     Shortcut(path,cutoff);
     Assert(path.IsValid());
     return Success;
@@ -1321,74 +1710,84 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
   Real bestPathCost = EvaluatePathCost(path);
   fprintf(flog,"*** Total cost %g, terminal cost %g ***\n",bestPathCost,goal->TerminalCost(0.0,path.ramps.back().x1,path.ramps.back().dx1));
 
-  rrt = NULL;
-  //create new RRT tree
-  rrt = new RRTPlanner(stateSpace);
-
-  existingNodes.resize(0);
+  if(nnIndex != NULL) InitRampNNIndex(nnIndex,velMax,robot);
+  bool reused = RerootTree(path);
+  if(reused) fprintf(flog,"Reusing tree from the last cycle\n");
+  else InitTree(path);
+  //the tree only follows the returned path once PlanFrom returns
+  treeEnd = NULL;
+  if(stopPlanning) return Timeout;
 
-  //printf("Adding old path...\n");
-  //initialize tree with existing path
-  RRTPlanner::Node* n=rrt->AddMilestone(MakeState(path.ramps[0].x0,path.ramps[0].dx0));
-  if(!stateSpace->IsFeasible(n->x)) {
+  RRTPlanner::Node* root = existingNodes.front();
+  assert(root == rrt->milestones[0]);
+  if(!stateSpace->IsFeasible(root->x)) {
     fprintf(flog,"Warning, start state is infeasible!\n");
   }
-  RRTPlanner::Node* root = n;
-  assert(root == rrt->milestones[0]);
-  existingNodes.push_back(n);
   vector<RRTPlanner::Node*> iknodes;
   RRTPlanner::Node* nik = NULL;
   //check the ik extension
   if(ikSolveProbability > 0)
-    nik=TryIKExtend(n,false);
+    nik=TryIKExtend(root,false);
   if(nik && EvaluateNodePathCost(nik) < bestPathCost) {
     if(nik->edgeFromParent()->IsVisible()) {  //only need to check path to parent assuming an already feasible path
       Assert(((RampEdgePlanner*)((EdgePlanner*)nik->edgeFromParent()))->IsValid());
       bestNode = nik;
+      MarkSolutionFound();
       bestPathCost = EvaluateNodePathCost(nik);
     }
     else {
       //fprintf(flog,"Deleted subtree derived from path ik %d\n",0);
-      rrt->DeleteSubtree(nik);
+      DeleteSubtree(nik);
       //assert(root == rrt->milestones[0]);
     }
   }
-  //extending path destinations
-  for(size_t i=0;i<path.ramps.size();i++) {
-    n = ((TreeRoadmapPlanner*)rrt)->Extend(n,MakeState(path.ramps[i].x1,path.ramps[i].dx1));
-    //sometimes there's an error with SolveMinTime...
-    ((RampEdgePlanner*)((EdgePlanner*)n->edgeFromParent()))->path.ramps.resize(1,path.ramps[i]);
-    Assert(path.ramps[i].IsValid());
-    Assert(((RampEdgePlanner*)((EdgePlanner*)n->edgeFromParent()))->IsValid());
-    /*
-    if(!n->edgeFromParent()->IsVisible()) {
-      fprintf(flog,"Prior path edge %d became infeasible\n",i);
-      rrt->DeleteSubtree(n);
-      assert(root == rrt->milestones[0]);
-      break;
+  //check the ik extension at the end of the path
+  RRTPlanner::Node* n = existingNodes.back();
+  if(ikSolveProbability > 0 && n != root && bestNode == NULL) {
+    nik=(RandomFraction()<ikSolveProbability?TryIKExtend(n,false):NULL);
+    if(nik && EvaluateNodePathCost(nik) < bestPathCost) {
+      if(nik->edgeFromParent()->IsVisible()) {
+	Assert(((RampEdgePlanner*)((EdgePlanner*)nik->edgeFromParent()))->IsValid());
+	bestNode = nik;
+	MarkSolutionFound();
+	bestPathCost = EvaluateNodePathCost(nik);
+      }
+      else {
+	DeleteSubtree(nik);
+      }
     }
-    */
-
-    existingNodes.push_back(n);
-    //fprintf(flog,"Node %d \n",i+1);
-
-    if(ikSolveProbability > 0 && i+1 == path.ramps.size() && bestNode == NULL) {
-      //check the ik extension
-      nik=(RandBool(ikSolveProbability)?TryIKExtend(n,false):NULL);
-      //if(nik) fprintf(flog,"IK node %d\n",i+1);
-      if(nik && EvaluateNodePathCost(nik) < bestPathCost) {
-	if(nik->edgeFromParent()->IsVisible()) {
-	  Assert(((RampEdgePlanner*)((EdgePlanner*)nik->edgeFromParent()))->IsValid());
-	  bestNode = nik;
-	  bestPathCost = EvaluateNodePathCost(nik);
-	}
-	else {
-	  //fprintf(flog,"Deleted subtree derived from path ik %d\n",i);
-	  rrt->DeleteSubtree(nik);
+  }
+  if(reused) {
+    //nodes kept from the last cycle that end at rest may already improve
+    //on the path.  The cheapest one is checked; if that fails its subtree
+    //is deleted and the next cheapest is tried.
+    while(true) {
+      if(stopPlanning) return Timeout;
+      RRTPlanner::Node* c = NULL;
+      Real cCost = bestPathCost;
+      for(size_t i=0;i<rrt->milestones.size();i++) {
+	RRTPlanner::Node* m = rrt->milestones[i];
+	if(find(existingNodes.begin(),existingNodes.end(),m) != existingNodes.end()) continue;
+	Vector dq;
+	dq.setRef(m->x,m->x.n/2,1,m->x.n/2);
+	if(!dq.isZero()) continue;
+	Real cost = EvaluateNodePathCost(m);
+	if(cost < cCost) {
+	  c = m;
+	  cCost = cost;
 	}
       }
+      if(!c) break;
+      vector<RRTPlanner::Node*> delnodes;
+      if(CheckPath(c,delnodes,timer,cutoff)) {
+	bestNode = c;
+	MarkSolutionFound();
+	bestPathCost = cCost;
+	fprintf(flog,"Kept node improves cost to %g\n",bestPathCost);
+	break;
+      }
+      if(timer.ElapsedTime() >= cutoff) return Timeout;
     }
-    if(stopPlanning) return Timeout;
   }
   //sanity check
   for(size_t i=0;i<existingNodes.size();i++) {
@@ -1433,7 +1832,7 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
     cspace->Sample(dest);
     x=MakeState(dest);
     //pick closest milestone, step in that direction
-    closest=rrt->ClosestMilestone(x);
+    closest=Closest(x);
     q.setRef(closest->x,0,1,dest.n);
     Real dist=cspace->Distance(q,dest);
     if(dist > delta) {
@@ -1444,24 +1843,25 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
     q.setRef(x,0,1,dest.n);
     if(!cspace->IsFeasible(q)) continue;
 
-    RRTPlanner::Node* n=((TreeRoadmapPlanner*)((RRTPlanner*)rrt))->Extend(closest,x);
+    RRTPlanner::Node* n=Extend(closest,x);
 
     //add a dynamic point in the middle
-    RRTPlanner::Node* n2 = rrt->SplitEdge(n->getParent(),n,0.5); 
+    RRTPlanner::Node* n2 = SplitEdge(n->getParent(),n,0.5); 
     if(!stateSpace->IsFeasible(n2->x)) {
       //fprintf(flog,"SplitEdge failed\n");
-      rrt->DeleteSubtree(n2);
+      DeleteSubtree(n2);
       continue;
     }
     //fix up the split paths
     
-    nik=(RandBool(ikSolveProbability)?TryIKExtend(n):NULL);
+    nik=(RandomFraction()<ikSolveProbability?TryIKExtend(n):NULL);
     if(nik && EvaluateNodePathCost(nik) < bestPathCost) {
       //fprintf(flog,"Actual cost %g <=> %g\n",EvaluateNodePathCost(nik),bestPathCost);
       vector<RRTPlanner::Node*> delnodes(1,n);
       if(CheckPath(nik,delnodes,timer,cutoff)) {
 	//fprintf(flog,"Extend + IK succeeded to a feasible node\n");
 	bestNode = nik;
+	MarkSolutionFound();
 	bestPathCost = EvaluateNodePathCost(nik);
 	
 	while(nik->getParent() != NULL) {
@@ -1492,6 +1892,7 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
       if(CheckPath(n,delnodes,timer,cutoff)) {
 	//fprintf(flog,"Extend succeeded to a feasible node\n");
 	bestNode = n;
+	MarkSolutionFound();
 	bestPathCost = EvaluateNodePathCost(n);
 	
 	while(n->getParent() != NULL) {
@@ -1598,6 +1999,10 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
     Assert(path.IsValid());
     Shortcut(path,cutoff-timer.ElapsedTime());
     assert(path.IsValid());
+    //smoothing keeps the endpoint, so the next cycle can keep its subtree
+    treeGoal = goal;
+    treePath = path;
+    treeEnd = bestNode;
     return Success;
   }
   fprintf(flog,"Devoting %g seconds to smoothing old path\n",cutoff-timer.ElapsedTime());
@@ -1605,6 +2010,9 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
   Assert(path.IsValid());
   Shortcut(path,cutoff-timer.ElapsedTime());
   assert(path.IsValid());
+  treeGoal = goal;
+  treePath = path;
+  treeEnd = existingNodes.back();
   return Timeout;
 }
 
@@ -1625,8 +2033,17 @@ int DynamicRRTPlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cutoff)
 
 
 DynamicHybridTreePlanner::DynamicHybridTreePlanner()
-  : delta(0.3),smoothTime(0.5),ikSolveProbability(0.5)
-{}
+  : delta(0.3),smoothTime(0.5),ikSolveProbability(0.5),reuseTree(true),reuseMaxDelta(0.1)
+{
+  nnIndex = new GNATIndex;
+}
+
+void DynamicHybridTreePlanner::Init(CSpace* space,Robot* robot,WorldPlannerSettings* settings)
+{
+  DynamicMotionPlannerBase::Init(space,robot,settings);
+  //edges checked in a prior space can't be reused
+  treeBranch.resize(0);
+}
 
 void DynamicHybridTreePlanner::SetGoal(SmartPointer<PlannerObjectiveBase> newgoal)
 {
@@ -1678,9 +2095,152 @@ DynamicHybridTreePlanner::Node* DynamicHybridTreePlanner::AddChild(Node* node,Sm
   c->sumPathCost = node->sumPathCost + c->edgeFromParent().cost;
   c->terminalCost = goal->TerminalCost(c->t,c->q,c->dq);
   c->totalCost = c->sumPathCost+c->terminalCost;
+  if(nnIndex != NULL) nnIndex->Insert(c->q,c);
   return c;
 }
 
+void DynamicHybridTreePlanner::DeleteSubtree(Node* n)
+{
+  if(nnIndex != NULL) {
+    CollectSubtreeCallback<Node> callback;
+    n->DFS(callback);
+    for(size_t i=0;i<callback.nodes.size();i++)
+      nnIndex->Remove(callback.nodes[i]);
+  }
+  n->getParent()->eraseChild(n);
+}
+
+void DynamicHybridTreePlanner::UpdateSubtree(Node* n)
+{
+  CollectSubtreeCallback<Node> callback;
+  n->DFS(callback);
+  //parents are visited before their children
+  for(size_t i=0;i<callback.nodes.size();i++) {
+    Node* c = callback.nodes[i];
+    Node* p = c->getParent();
+    if(p) {
+      c->edgeFromParent().cost = goal->IncrementalCost(p->t,c->edgeFromParent().e->path);
+      c->t = p->t+c->edgeFromParent().e->Duration();
+      c->depth = p->depth+1;
+      c->sumPathCost = p->sumPathCost + c->edgeFromParent().cost;
+      //nodes in the middle of a split edge can't be stopped at
+      if(!IsInf(c->terminalCost))
+	c->terminalCost = goal->TerminalCost(c->t,c->q,c->dq);
+      c->totalCost = c->sumPathCost+c->terminalCost;
+    }
+    if(nnIndex != NULL) nnIndex->Insert(c->q,c);
+  }
+}
+
+bool DynamicHybridTreePlanner::RerootTree(const ParabolicRamp::DynamicPath& path,vector<Node*>& pathNodes)
+{
+  pathNodes.resize(0);
+  if(!reuseTree || root == NULL || treeBranch.empty() || treeGoal == NULL) return false;
+  if((PlannerObjectiveBase*)goal != (PlannerObjectiveBase*)treeGoal) {
+    Real d=goal->Delta(treeGoal);
+    if(!(d <= reuseMaxDelta)) {
+      fprintf(flog,"Objective changed by %g, not reusing tree\n",d);
+      return false;
+    }
+  }
+  //the new start should be tshift along the last returned path
+  Real tshift;
+  if(!FollowsPath(treePath,path,tshift)) {
+    fprintf(flog,"Start is not on the last returned path, not reusing tree\n");
+    return false;
+  }
+
+  //find the branch edge containing the new start
+  size_t k=1;
+  Real t=0;
+  for(;k<treeBranch.size();k++) {
+    Real d=treeBranch[k]->edgeFromParent().e->Duration();
+    if(tshift < t+d) break;
+    t += d;
+  }
+  Node* newRoot;
+  if(k == treeBranch.size() || tshift-t < 1e-8) {
+    //the new start is at a node of the branch, which becomes the root and
+    //keeps its other children
+    newRoot = treeBranch[k-1];
+    if(newRoot->getParent()) newRoot->getParent()->detachChild(newRoot);
+    for(size_t i=k;i<treeBranch.size();i++)
+      pathNodes.push_back(treeBranch[i]);
+  }
+  else {
+    //split the edge at the new start and hang the rest of it off the root
+    Node* c = treeBranch[k];
+    ParabolicRamp::DynamicPath before,after;
+    c->edgeFromParent().e->path.Split(tshift-t,before,after);
+    //there may be numerical errors in using after
+    SetRampStart(after.ramps.front(),path.ramps.front().x0,path.ramps.front().dx0);
+    c->getParent()->detachChild(c);
+    newRoot = new Node;
+    newRoot->addChild(c);
+    c->edgeFromParent().e->path = after;
+    for(size_t i=k;i<treeBranch.size();i++)
+      pathNodes.push_back(treeBranch[i]);
+  }
+  //deletes the nodes that the time shift made unreachable
+  if(newRoot != (Node*)root) root = newRoot;
+  root->t = tstart;
+  root->q = path.ramps[0].x0;
+  root->dq = path.ramps[0].dx0;
+  root->sumPathCost = 0.0;
+  root->terminalCost = goal->TerminalCost(root->t,root->q,root->dq);
+  root->totalCost = root->terminalCost;
+  root->reachable = true;
+  root->depth = 0;
+  if(nnIndex != NULL) nnIndex->Clear();
+  UpdateSubtree(root);
+  //the environment may have moved since the kept edges were checked, so
+  //they are checked again before a path through them is used
+  CollectSubtreeCallback<Node> callback;
+  root->DFS(callback);
+  for(size_t i=0;i<callback.nodes.size();i++)
+    if(callback.nodes[i] != (Node*)root) callback.nodes[i]->reachable = false;
+
+  treeGoal = goal;
+  treePath = path;
+  treeBranch.assign(1,newRoot);
+  treeBranch.insert(treeBranch.end(),pathNodes.begin(),pathNodes.end());
+  return true;
+}
+
+void DynamicHybridTreePlanner::SetReturnedBranch(const ParabolicRamp::DynamicPath& path,Node* n,bool smoothed)
+{
+  treeGoal = goal;
+  treePath = path;
+  treeBranch.resize(0);
+  if(!smoothed) {
+    while(n != NULL) {
+      treeBranch.push_back(n);
+      n = n->getParent();
+    }
+    reverse(treeBranch.begin(),treeBranch.end());
+    return;
+  }
+  //smoothing keeps the endpoint, so n's subtree can be moved to the end of
+  //a new branch that follows path
+  if(n == (Node*)root || path.ramps.empty()) return;
+  if(!Vector(path.ramps.back().x1).isEqual(n->q,1e-5) || !Vector(path.ramps.back().dx1).isEqual(n->dq,1e-5)) return;
+  Node* p = root;
+  vector<Node*> branch(1,p);
+  for(size_t i=0;i+1<path.ramps.size();i++) {
+    p = AddChild(p,path.ramps[i]);
+    if(!p) return;
+    p->reachable = true;
+    branch.push_back(p);
+  }
+  n->getParent()->detachChild(n);
+  p->addChild(n);
+  n->edgeFromParent().e = new RampEdgePlanner(stateSpace,path.ramps.back());
+  n->reachable = true;
+  UpdateSubtree(n);
+  branch.push_back(n);
+  swap(treeBranch,branch);
+}
+
 class TrackingRampFunction : public ScalarFieldFunction
 {
 public:
@@ -1979,7 +2539,7 @@ bool DynamicHybridTreePlanner::CheckPath(Node* n,Timer& timer,Real cutoff,Node**
     else if (res == 0) {
       //delete the subtree
       Node* p=temp->getParent();
-      p->eraseChild(temp);
+      DeleteSubtree(temp);
       if(split) *split = p;
       return false;
     }
@@ -2011,6 +2571,18 @@ struct ClosestCallback : public Graph::CallbackBase<DynamicHybridTreePlanner::No
     fill(ramp.dx1.begin(),ramp.dx1.end(),0.0);
   }
 
+  //returns the min-time ramp duration from n to q, or Inf if n is outside
+  //the cost branch
+  Real RampTime(DynamicHybridTreePlanner::Node* n) {
+    if(n->sumPathCost > costBranch) return Inf;
+    assert(n->q(0) == 0.0);
+    assert(n->dq(0) == 0.0);
+    copy(n->q.begin(),n->q.end(),ramp.x0.begin());
+    copy(n->dq.begin(),n->dq.end(),ramp.dx0.begin());
+    if(!ramp.SolveMinTime(space->accMax,space->velMax)) return Inf;
+    return ramp.endTime;
+  }
+
   void Visit(DynamicHybridTreePlanner::Node* n) {
     /*
     if(n->q.distance(q) < closestDist) {
@@ -2019,23 +2591,33 @@ struct ClosestCallback : public Graph::CallbackBase<DynamicHybridTreePlanner::No
     }
     return;
     */
-    if(n->sumPathCost > costBranch) return;
-    assert(n->q(0) == 0.0);
-    assert(n->dq(0) == 0.0);
-    copy(n->q.begin(),n->q.end(),ramp.x0.begin());
-    copy(n->dq.begin(),n->dq.end(),ramp.dx0.begin());
-    if(!ramp.SolveMinTime(space->accMax,space->velMax)) return;
-    if(ramp.endTime < closestDist) {
-      closestDist = ramp.endTime;
+    Real t = RampTime(n);
+    if(t < closestDist) {
+      closestDist = t;
       closest = n;
     }
   }
 };
 
+//Adapts ClosestCallback for searches of the nearest-neighbor index
+struct ClosestCostFunction : public NNCostFunction
+{
+  ClosestCostFunction(ClosestCallback& _callback) :callback(_callback) {}
+  virtual Real Cost(void* data,Real distance) {
+    return callback.RampTime((DynamicHybridTreePlanner::Node*)data);
+  }
+
+  ClosestCallback& callback;
+};
+
 DynamicHybridTreePlanner::Node* DynamicHybridTreePlanner::Closest(const Config& q,Real costBranch)
 {
   ClosestCallback callback(stateSpace,q);
   callback.costBranch = costBranch;
+  if(nnIndex != NULL) {
+    ClosestCostFunction f(callback);
+    return (Node*)nnIndex->Search(q,f,callback.closestDist);
+  }
   root->DFS(callback);
   return callback.closest;
 }
@@ -2098,6 +2680,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     stateSpace->qMax = qMax;
     assert((int)path.velMax.size() == (int)robot->q.size());
     stateSpace->visibilityTolerance = settings->robotSettings[0].collisionEpsilon;
+    stateSpace->rng = rng;
   }
 
   Assert(path.IsValid());
@@ -2124,15 +2707,33 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
   if(!stateSpace->IsFeasible(path.ramps[0].x0,path.ramps[0].dx0)) {
     fprintf(flog,"Warning, start state is infeasible!\n");
   }
-  root=new Node;
-  root->t = tstart;
-  root->q = path.ramps[0].x0;
-  root->dq = path.ramps[0].dx0;
-  root->sumPathCost = 0.0;
-  root->terminalCost = goal->TerminalCost(root->t,root->q,root->dq);
-  root->totalCost = root->terminalCost;
-  root->reachable = true;
-  root->depth = 0;
+  if(nnIndex != NULL) InitRampNNIndex(nnIndex,velMax,robot);
+  vector<Node*> pathNodes;
+  bool reused = RerootTree(path,pathNodes);
+  if(reused && !pathNodes.empty() && !CheckPath(pathNodes.back(),timer,cutoff)) {
+    if(timer.ElapsedTime() >= cutoff) return Timeout;
+    //the environment moved onto the kept path, treat it as a new path
+    fprintf(flog,"Kept path is no longer feasible, not reusing tree\n");
+    reused = false;
+    pathNodes.resize(0);
+  }
+  if(reused) {
+    fprintf(flog,"Reusing tree from the last cycle\n");
+  }
+  else {
+    treeBranch.resize(0);
+    root=new Node;
+    if(nnIndex != NULL) nnIndex->Clear();
+    root->t = tstart;
+    root->q = path.ramps[0].x0;
+    root->dq = path.ramps[0].dx0;
+    root->sumPathCost = 0.0;
+    root->terminalCost = goal->TerminalCost(root->t,root->q,root->dq);
+    root->totalCost = root->terminalCost;
+    root->reachable = true;
+    root->depth = 0;
+    if(nnIndex != NULL) nnIndex->Insert(root->q,root);
+  }
 
   vector<Node*> iknodes;
   //check the ik extension
@@ -2146,6 +2747,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
       nik->reachable = true;
       Assert(nik->edgeFromParent().e->path.IsValid());
       bestNode = nik;
+      MarkSolutionFound();
       bestTotalCost = nik->totalCost;
       fprintf(flog,"Optimization of current state succeeded\n");
 
@@ -2157,23 +2759,55 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     }
     else if(res == 0) {
       fprintf(flog,"Optimization of current state failed to yield feasible path\n");
-      root->eraseChild(nik);
+      DeleteSubtree(nik);
       numIKExistingUnreachable++;
     }
     else return Timeout;
   }
   else
     fprintf(flog,"Optimization of current state failed\n");
+  if(reused) {
+    //nodes kept from the last cycle may already improve on the path.  The
+    //cheapest one is checked; if that fails its subtree is deleted and the
+    //next cheapest is tried.
+    while(true) {
+      if(stopPlanning) return Timeout;
+      CollectSubtreeCallback<Node> callback;
+      root->DFS(callback);
+      Node* c = NULL;
+      for(size_t i=0;i<callback.nodes.size();i++)
+	if(callback.nodes[i] != (Node*)root && callback.nodes[i]->totalCost < bestTotalCost && (!c || callback.nodes[i]->totalCost < c->totalCost))
+	  c = callback.nodes[i];
+      if(!c) break;
+      if(CheckPath(c,timer,cutoff)) {
+	bestNode = c;
+	MarkSolutionFound();
+	bestTotalCost = c->totalCost;
+	fprintf(flog,"Kept node improves cost to %g\n",bestTotalCost);
+	break;
+      }
+      if(timer.ElapsedTime() >= cutoff) return Timeout;
+    }
+  }
   //extending path destinations
   Node* n = root;
-  for(size_t i=0;i<path.ramps.size();i++) {
+  if(!reused) {
+    for(size_t i=0;i<path.ramps.size();i++) {
+      if(stopPlanning) return Timeout;
+      Node* c = AddChild(n,path.ramps[i]);
+      if(!c) {
+	fprintf(flog,"Warning, failure to add child for existing path\n");
+	continue;
+      }
+      n = c;
+      pathNodes.push_back(n);
+    }
+    SetReturnedBranch(path,n,false);
+  }
+  for(size_t i=0;i<pathNodes.size();i++) {
     if(stopPlanning) return Timeout;
 
-    n = AddChild(n,path.ramps[i]);
-    if(!n) {
-      fprintf(flog,"Warning, failure to add child for existing path\n");
-      continue;
-    }
+    n = pathNodes[i];
     n->reachable = true;
     numExistingNodes++;
     /*
@@ -2183,8 +2817,8 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     }
     */
 
-    //if((i%3 == 1 || i+1 == path.ramps.size()) && bestNode == NULL) {
-    if(ikSolveProbability > 0 && (i%3 == 1 || i+1 == path.ramps.size())) {
+    //if((i%3 == 1 || i+1 == pathNodes.size()) && bestNode == NULL) {
+    if(ikSolveProbability > 0 && (i%3 == 1 || i+1 == pathNodes.size())) {
       //check the ik extension
       //nik=(RandBool(ikSolveProbability)?TryIKExtend(n,true):NULL);
       //nik=TryIKExtend(n,true);
@@ -2195,6 +2829,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
 	numIKExistingImprove++;
 	if(CheckPath(nik,timer,cutoff)) {
 	  bestNode = nik;
+	  MarkSolutionFound();
 	  bestTotalCost = nik->totalCost;
 
 	  Node* ntemp = bestNode;
@@ -2245,7 +2880,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     n = ExtendToward(dest,bestTotalCost);
     if(n == NULL) continue;
     if(n->sumPathCost > bestTotalCost) {
-      n->getParent()->eraseChild(n);
+      DeleteSubtree(n);
       continue;
     }
 
@@ -2255,7 +2890,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     Node* n2 = SplitEdge(n->getParent(),n,0.5); 
     if(!cspace->IsFeasible(n2->q)) {
       //fprintf(flog,"SplitEdge failed\n");
-      n2->getParent()->eraseChild(n2);
+      DeleteSubtree(n2);
       numFailSplitNodes++;
       continue;
     }
@@ -2268,6 +2903,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
       if(CheckPath(n,timer,cutoff)) {
 	//fprintf(flog,"Extend succeeded to a feasible node\n");
 	bestNode = n;
+	MarkSolutionFound();
 	bestTotalCost = n->totalCost;
       }
       else {
@@ -2279,7 +2915,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     
     //It looks like setting search=true is detremental in some narrow passages
     //nik=(RandBool(ikSolveProbability)?TryIKExtend(n,true):NULL);
-    nik=(RandBool(ikSolveProbability)?TryIKExtend(n,false):NULL);
+    nik=(RandomFraction()<ikSolveProbability?TryIKExtend(n,false):NULL);
     if(nik) {
       //fprintf(flog,"IK to node with cost %g, best is %g\n",nik->totalCost,bestTotalCost);
       numIKNodes++;
@@ -2296,6 +2932,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
       if(CheckPath(nik,timer,cutoff,&split)) {
 	//fprintf(flog,"Extend + IK succeeded to a feasible node\n");
 	bestNode = nik;
+	MarkSolutionFound();
 	bestTotalCost = nik->totalCost;
       }
       else {
@@ -2317,6 +2954,7 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
 	      if(c->edgeFromParent().e->IsVisible()) {
 		fprintf(flog,"Braking worked!\n");
 		bestNode = c;
+		MarkSolutionFound();
 		bestTotalCost = c->totalCost;
 	      }
 	      else {
@@ -2344,11 +2982,13 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
     fprintf(flog,"Failed to improve upon old path\n");
     Assert(path.IsValid());
     Real t=timer.ElapsedTime();
+    int numShortcuts = 0;
     if(cutoff > t) {
       fprintf(flog,"Devoting %g seconds to smoothing old path\n",cutoff-t);
-      SmartShortcut(tstart,path,cutoff-t);
+      numShortcuts = SmartShortcut(tstart,path,cutoff-t);
       Assert(path.IsValid());
     }
+    SetReturnedBranch(path,(pathNodes.empty() ? (Node*)root : pathNodes.back()),numShortcuts > 0);
     return Timeout;
   }
 
@@ -2390,13 +3030,15 @@ int DynamicHybridTreePlanner::PlanFrom(ParabolicRamp::DynamicPath& path,Real cut
   Assert(Vector(path.ramps.back().dx1).isZero());
 
   Assert(path.IsValid());
+  int numShortcuts = 0;
   if(cutoff > timer.ElapsedTime()) {
     Vector xold = path.ramps.back().x1;
     fprintf(flog,"Devoting %g seconds to smoothing new path\n",cutoff-timer.ElapsedTime());
-    SmartShortcut(tstart,path,cutoff-timer.ElapsedTime());
+    numShortcuts = SmartShortcut(tstart,path,cutoff-timer.ElapsedTime());
     assert(path.IsValid());
     assert(xold == Vector(path.ramps.back().x1));
   }
+  SetReturnedBranch(path,bestNode,numShortcuts > 0);
   return Success;
 }
 
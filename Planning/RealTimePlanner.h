@@ -5,6 +5,7 @@
 #include "PlannerSettings.h"
 #include "PlannerObjective.h"
 #include "RampCSpace.h"
+#include "PlanningTimeDatabase.h"
 #include "Modeling/DynamicPath.h"
 #include <KrisLibrary/utils/StatCollector.h>
 #include <KrisLibrary/utils/threadutils.h>
@@ -92,6 +93,16 @@ class DynamicMotionPlannerBase
   ///returns the terminal cost for a path ending at q at time tEnd
   Real EvaluateTerminalCost(const Config& q,Real tEnd);
 
+  ///Uniform random number in [0,1), from rng if it is set
+  Real RandomFraction();
+
+  ///Clears firstSolutionTime and restarts its clock.  Called before
+  ///PlanFrom.
+  void StartSolutionClock();
+  ///Anytime planners call this from PlanFrom whenever they find a feasible
+  ///path that improves on the start path.  Records the time of the first.
+  void MarkSolutionFound();
+
   Robot* robot;
   WorldPlannerSettings* settings;
   CSpace* cspace;
@@ -109,6 +120,16 @@ class DynamicMotionPlannerBase
 
   //log file
   FILE* flog;
+
+  //time from StartSolutionClock to the first MarkSolutionFound, or -1 if
+  //no solution has been found
+  Real firstSolutionTime;
+  Timer solutionTimer;
+
+  //if non-NULL, the planner's random choices (shortcut times, IK
+  //extensions) come from this generator rather than the global one.  Not
+  //owned by the planner.
+  ParabolicRamp::RandomNumberGeneratorBase* rng;
 };
 
 
@@ -130,6 +151,18 @@ class SendPathCallbackBase
 };
 
 
+/** @brief Statistics on the planning cycles of one of the planners of a
+ * RealTimePlanner.
+ */
+struct RealTimePlannerStats
+{
+  RealTimePlannerStats();
+  int numCycles,numSuccesses,numTimeouts,numFailures;
+  ///Number of cycles in which this planner's path was chosen
+  int numWins;
+  StatCollector planTimeStats;
+};
+
 /** @ingroup Planning
  * @brief A real-time planner. Supports constant time-stepping or
  * adaptive time-stepping
@@ -185,6 +218,21 @@ class SendPathCallbackBase
  *   }
  * }
  * @endcode
+ *
+ * Parallel planning: after SetSpace, AddParallelPlanner adds planners that
+ * plan on their own threads at the same time as planner, from the same
+ * split point and with the same time budget.  These may be other planner
+ * types, or more instances of a randomized planner like DynamicRRTPlanner
+ * to act as random restarts.  Each gets a copy of the robot, a
+ * SingleRobotCSpace::CloneForThread() copy of the space, and a copy of the
+ * objective bound to its robot (made with SavePlannerObjective /
+ * LoadPlannerObjective, so custom objective types are planned for by
+ * planner alone).  Each copy of the space samples from its own seeded
+ * generator, which the parallel planner also uses for its own random
+ * choices; random draws made inside KrisLibrary (e.g., IK restarts) still
+ * use the global generator.  The planners run on parallelPool.  Of the
+ * paths returned with Success or Timeout, the one with the lowest PathCost
+ * under the objective is sent.
  */
 class RealTimePlanner
 {
@@ -195,6 +243,10 @@ public:
   ///Convenience fn: will set up the planner's robot, space, settings pointers
   void SetSpace(SingleRobotCSpace* space);
 
+  ///Adds a planner that plans concurrently with planner.  Call after
+  ///SetSpace.
+  void AddParallelPlanner(const SmartPointer<DynamicMotionPlannerBase>& p);
+
   ///Should be called at the start to initialize the start configuration
   void SetConstantPath(const Config& q);
   ///If the robot's path has changed for a reason outside of the planner's
@@ -218,6 +270,8 @@ public:
   /// Tells the planner to stop, when called from an external thread.
   bool StopPlanning() { 
     if(!planner) return true;
+    for(size_t i=0;i<parallelPlanners.size();i++)
+      parallelPlanners[i]->StopPlanning();
     return planner->StopPlanning(); 
   }
 
@@ -230,6 +284,17 @@ public:
   /// The underlying planing algorithm
   SmartPointer<DynamicMotionPlannerBase> planner;
 
+  /// Planners that run concurrently with planner, see AddParallelPlanner.
+  /// parallelRobots and parallelSpaces are their private copies of the
+  /// robot and space, and parallelGoal is the objective that their
+  /// objectives were copied from.  parallelPool has a thread for planner
+  /// and one for each parallel planner.
+  vector<SmartPointer<DynamicMotionPlannerBase> > parallelPlanners;
+  vector<SmartPointer<Robot> > parallelRobots;
+  vector<SmartPointer<SingleRobotCSpace> > parallelSpaces;
+  SmartPointer<PlannerObjectiveBase> parallelGoal;
+  ThreadPool parallelPool;
+
   /// Set the current path before planning, using SetConstantPath or SetCurrentPath
   Real pathStartTime; 
   ParabolicRamp::DynamicPath currentPath;
@@ -245,13 +310,38 @@ public:
   /// instances that overrun their alloted time to still update the path.
   bool acceptTimeOverruns;
 
+  /// Constant: the split time is fixed.  ExponentialBackoff: the split
+  /// time shrinks after successes and grows after timeouts.  Learning: the
+  /// split time gives the planners the time by which, in past cycles with
+  /// the current objective type and world, they found a solution with
+  /// probability learningQuantile (see PlanningTimeDatabase).  Learning
+  /// falls back to ExponentialBackoff until enough times are known, or
+  /// while too many cycles time out for the quantile to be estimated.
   enum SplitUpdateProtocol { Constant, ExponentialBackoff, Learning };
   SplitUpdateProtocol protocol;
   Real currentSplitTime,currentPadding,currentExternalPadding;
   Real maxPadding;
 
+  /// If set, each cycle is recorded here under PlanningTimeKey(): the time
+  /// until the first of the planners found a feasible path, or if none did,
+  /// the cycle's planning time as a timeout.  Load it at startup and save
+  /// it at shutdown to keep the statistics across runs.
+  SmartPointer<PlanningTimeDatabase> timeDatabase;
+  /// Identifies the world in PlanningTimeKey()
+  string worldName;
+  Real learningQuantile;
+  /// Returns the objective type and the world name
+  string PlanningTimeKey() const;
+
   ///Statistics captured on planning times, depending on PlanMore output.
   StatCollector planFailTimeStats,planSuccessTimeStats,planTimeoutTimeStats;
+  ///Statistics for each planner: plannerStats[0] is for planner, and
+  ///plannerStats[k] for parallelPlanners[k-1]
+  vector<RealTimePlannerStats> plannerStats;
+
+protected:
+  void InitParallelPlanner(int k,SingleRobotCSpace* space);
+  void UpdateParallelGoals();
 };
 
 /** @brief An interface to a planning thread.
@@ -2,6 +2,7 @@
 #define REAL_TIME_RRT_PLANNER_H
 
 #include "RealTimePlanner.h"
+#include "NearestNeighborIndex.h"
 #include <KrisLibrary/planning/MotionPlanner.h>
 
 /** @brief Dynamic RRT planner -- not recently tested
@@ -11,10 +12,26 @@ class DynamicRRTPlanner : public DynamicMotionPlannerBase
 public:
   DynamicRRTPlanner();
   virtual ~DynamicRRTPlanner() {  }
+  virtual void Init(CSpace* space,Robot* robot,WorldPlannerSettings* settings);
   virtual void SetGoal(SmartPointer<PlannerObjectiveBase> newgoal);
   Vector& MakeState(const Config& q,const Config& dq);
   Vector& MakeState(const Config& q);
   RRTPlanner::Node* TryIKExtend(RRTPlanner::Node* node,bool search=true);
+  //tree modifications that keep nnIndex up to date
+  RRTPlanner::Node* AddMilestone(const State& x);
+  RRTPlanner::Node* Extend(RRTPlanner::Node* node,const State& x);
+  RRTPlanner::Node* SplitEdge(RRTPlanner::Node* p,RRTPlanner::Node* n,Real u);
+  void DeleteSubtree(RRTPlanner::Node* n);
+  //finds the closest node to the state x
+  RRTPlanner::Node* Closest(const State& x);
+  //starts a new tree whose existingNodes follow path
+  void InitTree(const ParabolicRamp::DynamicPath& path);
+  //if the start of path lies on the path returned by the last call to
+  //PlanFrom and the objective has changed little, starts a new tree along
+  //path and copies the subtree grown beyond the end of the returned path
+  //onto its end.  The copied edges are not assumed feasible.  Returns
+  //false if the tree can't be reused, in which case it is left alone.
+  bool RerootTree(const ParabolicRamp::DynamicPath& path);
 
   //perform lazy collision checking of the path up to n
   //ndelete allows you to check if any nodes are deleted
@@ -29,12 +46,26 @@ public:
   Real delta;
   Real smoothTime;
   Real ikSolveProbability;
+  ///Index used to find the closest node.  Its metric must be a lower bound
+  ///on the ramp duration between configurations; if it is not set, the
+  ///velocity-scaled L-infinity distance is used.  Set to NULL to search
+  ///the tree exhaustively.
+  SmartPointer<NearestNeighborIndex> nnIndex;
+  ///If true, the tree is kept across calls to PlanFrom, see
+  ///DynamicHybridTreePlanner::reuseTree
+  bool reuseTree;
+  Real reuseMaxDelta;
 
   //temporary state
   int iteration;
   SmartPointer<RRTPlanner> rrt;
   vector<RRTPlanner::Node*> existingNodes;
   Vector tempV;
+  //the objective the tree was built for, the path last returned by
+  //PlanFrom, and the tree node at its end
+  SmartPointer<PlannerObjectiveBase> treeGoal;
+  ParabolicRamp::DynamicPath treePath;
+  RRTPlanner::Node* treeEnd;
 };
 
 /** @brief The preferred dynamic sampling-based planner for realtime planning.
@@ -62,6 +93,7 @@ public:
 
   DynamicHybridTreePlanner();
   virtual ~DynamicHybridTreePlanner() {  }
+  virtual void Init(CSpace* space,Robot* robot,WorldPlannerSettings* settings);
   virtual void SetGoal(SmartPointer<PlannerObjectiveBase> newgoal);
   Node* AddChild(Node* node,const Config& q);
   Node* AddChild(Node* node,const ParabolicRamp::ParabolicRampND& ramp);
@@ -77,6 +109,22 @@ public:
   Node* ExtendToward(const Config& q,Real costBranch=Inf);
   //splits an edge p->n in the tree at interpolant u
   Node* SplitEdge(Node* p,Node* n,Real u);
+  //removes n and its descendants from the tree
+  void DeleteSubtree(Node* n);
+  //recomputes the times and costs of the descendants of n, and re-adds
+  //them to nnIndex
+  void UpdateSubtree(Node* n);
+  //if the start of path lies on the path returned by the last call to
+  //PlanFrom and the objective has changed little, re-roots the tree at the
+  //start of path, discarding the nodes that are no longer reachable.
+  //The kept nodes other than the root are marked unreachable, so their
+  //edges are checked against the current environment before use.
+  //On success returns true and fills out the nodes along path.
+  bool RerootTree(const ParabolicRamp::DynamicPath& path,vector<Node*>& pathNodes);
+  //records that path, which PlanFrom is about to return, follows the
+  //branch of the tree ending at n.  If smoothed is true, the branch is
+  //replaced with the ramps of path and n's subtree is moved onto it.
+  void SetReturnedBranch(const ParabolicRamp::DynamicPath& path,Node* n,bool smoothed);
 
   //perform lazy collision checking of the path up to n
   //split can be set to a pointer to retrieve the last reachable
@@ -89,11 +137,23 @@ public:
   Real delta;
   Real smoothTime;
   Real ikSolveProbability;
+  ///Index used by Closest, see DynamicRRTPlanner::nnIndex
+  SmartPointer<NearestNeighborIndex> nnIndex;
+  ///If true, the tree is kept across calls to PlanFrom when the new start
+  ///lies on the previously returned path and the objective's Delta from
+  ///the one the tree was built for is at most reuseMaxDelta
+  bool reuseTree;
+  Real reuseMaxDelta;
 
   //temporary state
   int iteration;
   SmartPointer<Node> root;
   vector<Node*> nodes;
+  //the objective the tree's costs were computed with, and the path last
+  //returned by PlanFrom along with the tree nodes it passes through
+  SmartPointer<PlannerObjectiveBase> treeGoal;
+  ParabolicRamp::DynamicPath treePath;
+  vector<Node*> treeBranch;
 };
 
 #endif
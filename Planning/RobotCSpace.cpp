@@ -557,14 +557,14 @@ void ActiveRobotGeodesicManifold::Integrate(const Config& a,const Vector& da,Con
 
 
 SingleRobotCSpace::SingleRobotCSpace(RobotWorld& _world,int _index,WorldPlannerSettings* _settings)
-  :world(_world),index(_index),settings(_settings),collisionPairsInitialized(false)
+  :world(_world),index(_index),settings(_settings),conservativeAdvancement(false),cacheEnvNumIDs(-1),collisionPairsInitialized(false)
 {
   Assert(settings != NULL);
   Assert((int)settings->robotSettings.size() > _index);
 }
 
 SingleRobotCSpace::SingleRobotCSpace(const SingleRobotCSpace& space)
-  :world(space.world),index(space.index),settings(space.settings),collisionPairsInitialized(false)
+  :world(space.world),index(space.index),settings(space.settings),conservativeAdvancement(space.conservativeAdvancement),cacheEnvNumIDs(-1),collisionPairsInitialized(false)
 {}
 
 int SingleRobotCSpace::NumDimensions() const
@@ -577,6 +577,34 @@ Robot* SingleRobotCSpace::GetRobot() const
   return world.robots[index];
 }
 
+Robot* SingleRobotCSpace::GetKinematicRobot() const
+{
+  if(threadRobot) return threadRobot;
+  return world.robots[index];
+}
+
+//uniform random number in [a,b], from the space's generator if it has one
+static Real RandUniform(ParabolicRamp::RandomNumberGeneratorBase* rng,Real a,Real b)
+{
+  if(!rng) return Rand(a,b);
+  return a + (b-a)*rng->Rand();
+}
+
+//uniformly distributed rotation (Shoemake's method)
+static void RandUniformRotation(ParabolicRamp::RandomNumberGeneratorBase* rng,QuaternionRotation& q)
+{
+  if(!rng) {
+    RandRotation(q);
+    return;
+  }
+  Real u1=rng->Rand(),u2=rng->Rand(),u3=rng->Rand();
+  Real r1=Sqrt(1.0-u1),r2=Sqrt(u1);
+  q.x = r1*Sin(TwoPi*u2);
+  q.y = r1*Cos(TwoPi*u2);
+  q.z = r2*Sin(TwoPi*u3);
+  q.w = r2*Cos(TwoPi*u3);
+}
+
 bool SingleRobotCSpace::CheckJointLimits(const Config& x)
 {
   Robot* robot=GetRobot();
@@ -611,27 +639,27 @@ void SingleRobotCSpace::InitializeCollisionPairs()
 
 void SingleRobotCSpace::Sample(Config& x)
 {
-  Robot* robot = GetRobot();
+  Robot* robot = GetKinematicRobot();
   const AABB3D& bb=settings->robotSettings[index].worldBounds;
   x = robot->q;
   for(size_t i=0;i<robot->joints.size();i++) {
     if(robot->joints[i].type == RobotJoint::Normal) {
       int k=robot->joints[i].linkIndex;
-      x(k) = Rand(robot->qMin(k),robot->qMax(k));
+      x(k) = RandUniform(rng,robot->qMin(k),robot->qMax(k));
     }
     else if(robot->joints[i].type == RobotJoint::Spin) {
       int k=robot->joints[i].linkIndex;
-      x(k) = Rand(0,TwoPi);
+      x(k) = RandUniform(rng,0,TwoPi);
     }
     else if(robot->joints[i].type == RobotJoint::Floating) {
       //generate a floating base
       RigidTransform T;
       QuaternionRotation qr;
-      RandRotation(qr);
+      RandUniformRotation(rng,qr);
       qr.getMatrix(T.R);
-      T.t.x = Rand(bb.bmin.x,bb.bmax.x);
-      T.t.y = Rand(bb.bmin.y,bb.bmax.y);
-      T.t.z = Rand(bb.bmin.z,bb.bmax.z);
+      T.t.x = RandUniform(rng,bb.bmin.x,bb.bmax.x);
+      T.t.y = RandUniform(rng,bb.bmin.y,bb.bmax.y);
+      T.t.z = RandUniform(rng,bb.bmin.z,bb.bmax.z);
       robot->SetJointByTransform(i,robot->joints[i].linkIndex,T);
       vector<int> indices;
       robot->GetJointIndices(i,indices);
@@ -641,7 +669,7 @@ void SingleRobotCSpace::Sample(Config& x)
   }
   for(size_t i=0;i<robot->drivers.size();i++) {
     if(robot->drivers[i].type != RobotJointDriver::Normal) {
-      Real val = Rand(robot->drivers[i].qmin,robot->drivers[i].qmax);
+      Real val = RandUniform(rng,robot->drivers[i].qmin,robot->drivers[i].qmax);
       robot->SetDriverValue(i,val);
       for(size_t j=0;j<robot->drivers[i].linkIndices.size();j++)
 	x(robot->drivers[i].linkIndices[j]) = robot->q(robot->drivers[i].linkIndices[j]);
@@ -652,16 +680,16 @@ void SingleRobotCSpace::Sample(Config& x)
 
 void SingleRobotCSpace::SampleNeighborhood(const Config& c,Real r,Config& x)
 {
-  Robot* robot = GetRobot();
+  Robot* robot = GetKinematicRobot();
   x = c;
   const Vector& w=settings->robotSettings[index].distanceWeights;
   if(w.n==0) {
     for(int i=0;i<x.n;i++) 
-      x(i) += Rand(-r,r);
+      x(i) += RandUniform(rng,-r,r);
   }
   else { 
     for(int i=0;i<x.n;i++) 
-      x(i) += Rand(-r,r)/w(i);
+      x(i) += RandUniform(rng,-r,r)/w(i);
   }
   for(size_t i=0;i<robot->joints.size();i++) {
     if(robot->joints[i].type == RobotJoint::Weld) {
@@ -680,7 +708,7 @@ void SingleRobotCSpace::SampleNeighborhood(const Config& c,Real r,Config& x)
 	  scale += Sqr(w(robot->drivers[i].linkIndices[j]));
 	scale = Sqrt(scale);
       }
-      robot->SetDriverValue(i,val + scale*Rand(-r,r));
+      robot->SetDriverValue(i,val + scale*RandUniform(rng,-r,r));
       for(size_t j=0;j<robot->drivers[i].linkIndices.size();j++)
 	x(robot->drivers[i].linkIndices[j]) = robot->q(robot->drivers[i].linkIndices[j]);
     }
@@ -742,12 +770,17 @@ bool SingleRobotCSpace::IsFeasible(const Config& x,int constraint)
 
 bool SingleRobotCSpace::IsFeasible(const Config& x)
 {
-  if(!CheckJointLimits(x)) {
-    return false;
+  if(feasibilityCache) {
+    SyncFeasibilityCache();
+    int res = feasibilityCache->LookupFeasible(x);
+    if(res >= 0) return (res != 0);
   }
-  //this is already called in CheckJointLimits
-  //robot->UpdateConfig(x);
-  return CheckCollisionFree();
+  bool feasible;
+  if(workspace) feasible = IsFeasible(x,*workspace);
+  //CheckJointLimits updates the robot's configuration
+  else feasible = (CheckJointLimits(x) && CheckCollisionFree());
+  if(feasibilityCache) feasibilityCache->InsertFeasible(x,feasible);
+  return feasible;
 }
 
 bool SingleRobotCSpace::CheckCollisionFree()
@@ -777,17 +810,501 @@ bool SingleRobotCSpace::CheckCollisionFree()
     if((int)i != index)
       idothers.push_back(world.RobotID(i));
   }
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  vector<int> ids;
+  GetGeometries(world,idrobot,geoms,ids);
+  size_t n1 = geoms.size();
+  GetGeometries(world,idothers,geoms,ids);
+  //environment collision check
+  if(n1 > 0 && n1 < geoms.size()) {
+    if(settings->CheckCollision(broadPhase,geoms,ids,n1).first >= 0) return false;
+  }
+  //self collision check
+  geoms.resize(n1);
+  ids.resize(n1);
+  if(settings->CheckCollision(broadPhase,geoms,ids,n1).first >= 0) return false;
+  return true;
+}
+
+//the world IDs of everything the robot is checked against
+void GetEnvironmentIDs(RobotWorld& world,int index,vector<int>& idothers)
+{
+  idothers.resize(0);
+  for(size_t i=0;i<world.terrains.size();i++)
+    idothers.push_back(world.TerrainID(i));
+  for(size_t i=0;i<world.rigidObjects.size();i++)
+    idothers.push_back(world.RigidObjectID(i));
+  for(size_t i=0;i<world.robots.size();i++) {
+    if((int)i != index)
+      idothers.push_back(world.RobotID(i));
+  }
+}
+
+void SingleRobotCSpace::InitWorkspace(SingleRobotCSpaceWorkspace& ws)
+{
+  Robot* robot = GetRobot();
+  ws.T.resize(robot->links.size());
+  ws.geometry.clear();
+  ws.geometry.resize(robot->links.size());
+  ws.robotGeoms.resize(0);
+  ws.robotIds.resize(0);
+  for(size_t j=0;j<robot->links.size();j++) {
+    Geometry::AnyCollisionGeometry3D* g = robot->geometry[j];
+    if(!g || g->Empty()) continue;
+    ws.geometry[j] = new Geometry::AnyCollisionGeometry3D(*g);
+    if(!ws.geometry[j]->CollisionDataInitialized())
+      ws.geometry[j]->InitCollisionData();
+    ws.robotGeoms.push_back(ws.geometry[j]);
+    ws.robotIds.push_back(world.RobotLinkID(index,j));
+  }
+  vector<int> idothers;
+  GetEnvironmentIDs(world,index,idothers);
+  ws.envGeoms.resize(0);
+  ws.envIds.resize(0);
+  GetGeometries(world,idothers,ws.envGeoms,ws.envIds);
+  //collision data is otherwise initialized lazily by the first query, which
+  //would modify the shared geometries from several threads
+  for(size_t i=0;i<ws.envGeoms.size();i++)
+    if(!ws.envGeoms[i]->CollisionDataInitialized())
+      ws.envGeoms[i]->InitCollisionData();
+  ws.broadPhase.Clear();
+}
+
+bool SingleRobotCSpace::IsFeasible(const Config& x,SingleRobotCSpaceWorkspace& ws) const
+{
+  if(!CheckJointLimits(x,ws)) return false;
+  return CheckCollisionFree(x,ws);
+}
+
+//same as Robot::GetDriverValue, but for the configuration x
+Real GetDriverValue(const Robot& robot,const Config& x,int d)
+{
+  const RobotJointDriver& driver = robot.drivers[d];
+  if(driver.type == RobotJointDriver::Affine) {
+    Real vavg = 0;
+    for(size_t i=0;i<driver.linkIndices.size();i++)
+      vavg += (x(driver.linkIndices[i]) - driver.affOffset[i])/driver.affScaling[i];
+    return vavg / driver.linkIndices.size();
+  }
+  return x(driver.linkIndices[0]);
+}
+
+bool SingleRobotCSpace::CheckJointLimits(const Config& x,SingleRobotCSpaceWorkspace& ws) const
+{
+  Robot* robot=GetRobot();
+  for(size_t i=0;i<robot->joints.size();i++) {
+    if(robot->joints[i].type == RobotJoint::Normal || robot->joints[i].type == RobotJoint::Weld) {
+      int k=robot->joints[i].linkIndex;
+      if(x(k) < robot->qMin(k) || x(k) > robot->qMax(k))
+	return false;
+    }
+  }
+  for(size_t i=0;i<robot->drivers.size();i++) {
+    Real v=::GetDriverValue(*robot,x,i);
+    if(v < robot->drivers[i].qmin || v > robot->drivers[i].qmax)
+      return false;
+  }
+  return true;
+}
+
+void SingleRobotCSpace::UpdateWorkspace(const Config& x,SingleRobotCSpaceWorkspace& ws) const
+{
+  Robot* robot = GetRobot();
+  //forward kinematics into the workspace, as in Robot::UpdateFrames
+  for(size_t j=0;j<robot->links.size();j++) {
+    robot->links[j].GetLocalTransform(x(j),ws.T[j]);
+    if(robot->parents[j] >= 0)
+      ws.T[j] = ws.T[robot->parents[j]]*ws.T[j];
+    if(ws.geometry[j]) ws.geometry[j]->SetTransform(ws.T[j]);
+  }
+  ws.geoms = ws.robotGeoms;
+  ws.ids = ws.robotIds;
+  ws.geoms.insert(ws.geoms.end(),ws.envGeoms.begin(),ws.envGeoms.end());
+  ws.ids.insert(ws.ids.end(),ws.envIds.begin(),ws.envIds.end());
+}
+
+bool SingleRobotCSpace::CheckCollisionFree(const Config& x,SingleRobotCSpaceWorkspace& ws) const
+{
+  UpdateWorkspace(x,ws);
   //environment collision check
-  pair<int,int> res = settings->CheckCollision(world,idrobot,idothers);
-  if(res.first >= 0) return false;
+  if(!ws.envGeoms.empty() && !ws.robotGeoms.empty()) {
+    if(settings->CheckCollision(ws.broadPhase,ws.geoms,ws.ids,ws.robotGeoms.size()).first >= 0) return false;
+  }
   //self collision check
-  res = settings->CheckCollision(world,idrobot);
-  if(res.first >= 0) return false;
+  if(settings->CheckCollision(ws.broadPhase,ws.robotGeoms,ws.robotIds,ws.robotGeoms.size()).first >= 0) return false;
   return true;
 }
 
+void SingleRobotCSpace::ClearanceLowerBound(const Config& x,SingleRobotCSpaceWorkspace& ws,Real& envDist,Real& selfDist,Real envBound,Real selfBound) const
+{
+  UpdateWorkspace(x,ws);
+  envDist = envBound;
+  if(!ws.envGeoms.empty() && !ws.robotGeoms.empty())
+    envDist = settings->DistanceLowerBound(ws.broadPhase,ws.geoms,ws.ids,ws.robotGeoms.size(),0,envBound);
+  selfDist = settings->DistanceLowerBound(ws.broadPhase,ws.robotGeoms,ws.robotIds,ws.robotGeoms.size(),0,selfBound);
+}
+
+SingleRobotCSpace* SingleRobotCSpace::CloneForThread(ParabolicRamp::RandomNumberGeneratorBase* _rng)
+{
+  SingleRobotCSpace* space = new SingleRobotCSpace(*this);
+  space->workspace = new SingleRobotCSpaceWorkspace;
+  InitWorkspace(*space->workspace);
+  space->threadRobot = new Robot;
+  *space->threadRobot = *GetRobot();
+  space->rng = _rng;
+  return space;
+}
+
+void SingleRobotCSpace::EnableParallelEdgeChecking(int numThreads)
+{
+  if(numThreads <= 1) edgeChecker = NULL;
+  else edgeChecker = new ParallelEdgeChecker(this,numThreads);
+}
+
+//maximum bisection depth of ParallelEdgeChecker, 2^16-1 samples
+const static int kMaxEdgeBisectionDepth = 16;
+//number of samples a thread takes at once
+const static int kEdgeSampleBatchSize = 4;
+
+ParallelEdgeChecker::ParallelEdgeChecker(SingleRobotCSpace* _space,int _numThreads)
+  :space(_space),numThreads(Max(_numThreads,1)),minParallelSamples(16),pool(numThreads),
+   a(NULL),b(NULL),numEdges(0),checkTime(0)
+{
+  workspaces.resize(numThreads);
+  xs.resize(numThreads);
+  for(int k=0;k<numThreads;k++)
+    space->InitWorkspace(workspaces[k]);
+}
+
+//checks sample i of the current edge, stopping the loop if it's infeasible
+struct EdgeSampleBody : public ParallelForBody
+{
+  virtual bool operator ()(int i,int thread)
+  {
+    Config& x = checker->xs[thread];
+    checker->space->Interpolate(*checker->a,*checker->b,checker->us[i],x);
+    return checker->space->IsFeasible(x,checker->workspaces[thread]);
+  }
+
+  ParallelEdgeChecker* checker;
+};
+
+bool ParallelEdgeChecker::Check(const Config& _a,const Config& _b,Real epsilon)
+{
+  Timer timer;
+  //bisect until the segments are shorter than epsilon
+  Real d = space->Distance(_a,_b);
+  int depth = 0;
+  while(d > epsilon && depth < kMaxEdgeBisectionDepth) {
+    d *= 0.5;
+    depth++;
+  }
+  //coarsest level first, as BisectionEpsilonEdgePlanner does
+  us.resize(0);
+  for(int level=1;level<=depth;level++) {
+    int n = (1<<level);
+    for(int j=1;j<n;j+=2)
+      us.push_back(Real(j)/Real(n));
+  }
+  a = &_a;
+  b = &_b;
+  EdgeSampleBody body;
+  body.checker = this;
+  bool feasible = true;
+  if(numThreads <= 1 || (int)us.size() < minParallelSamples) {
+    for(size_t i=0;i<us.size();i++)
+      if(!body((int)i,0)) { feasible = false; break; }
+  }
+  else
+    feasible = pool.ParallelFor(0,(int)us.size(),body,kEdgeSampleBatchSize);
+  a = b = NULL;
+  numEdges++;
+  checkTime += timer.ElapsedTime();
+  return feasible;
+}
+
+Real ParallelEdgeChecker::EdgesPerSecond() const
+{
+  if(checkTime <= 0) return 0;
+  return Real(numEdges)/checkTime;
+}
+
+ParallelEdgePlanner::ParallelEdgePlanner(SingleRobotCSpace* _space,const Config& _a,const Config& _b,Real _epsilon)
+  :space(_space),a(_a),b(_b),epsilon(_epsilon),checked(0)
+{}
+
+bool ParallelEdgePlanner::IsVisible()
+{
+  if(checked == 0) {
+    if(space->edgeChecker)
+      checked = (space->edgeChecker->Check(a,b,epsilon) ? 1 : -1);
+    else {
+      BisectionEpsilonEdgePlanner e(space,a,b,epsilon);
+      checked = (e.IsVisible() ? 1 : -1);
+    }
+  }
+  return checked > 0;
+}
+
+void ParallelEdgePlanner::Eval(Real u,Config& x) const
+{
+  space->Interpolate(a,b,u,x);
+}
+
+CSpace* ParallelEdgePlanner::Space() const
+{
+  return space;
+}
+
+EdgePlanner* ParallelEdgePlanner::Copy() const
+{
+  ParallelEdgePlanner* copy = new ParallelEdgePlanner(space,a,b,epsilon);
+  copy->checked = checked;
+  return copy;
+}
+
+EdgePlanner* ParallelEdgePlanner::ReverseCopy() const
+{
+  ParallelEdgePlanner* copy = new ParallelEdgePlanner(space,b,a,epsilon);
+  copy->checked = checked;
+  return copy;
+}
+
+void SingleRobotCSpace::EnableFeasibilityCache(size_t maxEntries)
+{
+  if(maxEntries == 0) {
+    feasibilityCache = NULL;
+    return;
+  }
+  if(!feasibilityCache)
+    feasibilityCache = new FeasibilityCache(settings->robotSettings[index].collisionEpsilon,maxEntries);
+  feasibilityCache->maxEntries = maxEntries;
+}
+
+//the geometries that robot index is checked against
+const vector<Geometry::AnyCollisionGeometry3D*>& SingleRobotCSpace::GetCacheEnvironment()
+{
+  //the geometries are only gathered again when elements are added to or
+  //removed from the world
+  if(world.NumIDs() != cacheEnvNumIDs) {
+    vector<int> idothers,envIds;
+    GetEnvironmentIDs(world,index,idothers);
+    cacheEnvGeoms.resize(0);
+    GetGeometries(world,idothers,cacheEnvGeoms,envIds);
+    cacheEnvNumIDs = world.NumIDs();
+  }
+  return cacheEnvGeoms;
+}
+
+void SingleRobotCSpace::SyncFeasibilityCache()
+{
+  Real res = settings->robotSettings[index].collisionEpsilon;
+  if(feasibilityCache->resolution != res) {
+    feasibilityCache->resolution = res;
+    feasibilityCache->Clear();
+  }
+  feasibilityCache->SyncEnvironment(GetCacheEnvironment());
+}
+
+void SingleRobotCSpace::EnableLazyChecking(bool enabled,size_t maxEntries)
+{
+  if(!enabled) {
+    edgeCache = NULL;
+    return;
+  }
+  if(!edgeCache)
+    edgeCache = new EdgeCheckCache(settings->robotSettings[index].collisionEpsilon,maxEntries);
+  edgeCache->maxEntries = maxEntries;
+}
+
+void SingleRobotCSpace::SyncEdgeCache()
+{
+  Real res = settings->robotSettings[index].collisionEpsilon;
+  if(edgeCache->resolution != res) {
+    edgeCache->resolution = res;
+    edgeCache->Clear();
+  }
+  edgeCache->SyncEnvironment(GetCacheEnvironment());
+}
+
+void SingleRobotCSpace::EnableConservativeAdvancement(bool enabled)
+{
+  conservativeAdvancement = enabled;
+  if(!enabled) return;
+  Robot* robot = GetRobot();
+  if(robot->lipschitzMatrix.isEmpty())
+    robot->ComputeLipschitzMatrix();
+  if(!edgeWorkspace) {
+    edgeWorkspace = new SingleRobotCSpaceWorkspace;
+    InitWorkspace(*edgeWorkspace);
+  }
+}
+
+//Bisects the rest of an edge after this many steps from each end.
+//Near-grazing edges would otherwise take ever smaller steps.
+const static int kMaxAdvancementSteps = 1000;
+
+//checks the part [ua,ub] of the edge from a to b by bisection at the
+//robot's collision epsilon.  As with BisectionEpsilonEdgePlanner, the
+//endpoints are not checked.
+static bool BisectEdge(SingleRobotCSpace* space,const Config& a,const Config& b,Real ua,Real ub)
+{
+  Config xa,xb;
+  space->Interpolate(a,b,ua,xa);
+  space->Interpolate(a,b,ub,xb);
+  BisectionEpsilonEdgePlanner e(space,xa,xb,space->settings->robotSettings[space->index].collisionEpsilon);
+  return e.IsVisible();
+}
+
+ConservativeAdvancementEdgePlanner::ConservativeAdvancementEdgePlanner(SingleRobotCSpace* _space,const Config& _a,const Config& _b)
+  :space(_space),a(_a),b(_b),checked(0),numQueries(0),bisected(false)
+{}
+
+Real ConservativeAdvancementEdgePlanner::MovementBound() const
+{
+  Robot* robot = space->GetRobot();
+  for(size_t i=0;i<robot->joints.size();i++)
+    if(robot->joints[i].type == RobotJoint::Floating || robot->joints[i].type == RobotJoint::BallAndSocket)
+      //interpolation isn't linear in the euler angles
+      return Inf;
+  if(robot->lipschitzMatrix.isEmpty()) return Inf;
+  Real M = 0;
+  for(size_t i=0;i<robot->links.size();i++) {
+    if(!robot->geometry[i] || robot->geometry[i]->Empty()) continue;
+    Real Mi = 0;
+    for(int j=(int)i;j>=0;j=robot->parents[j]) {
+      Real dq = Abs(b(j)-a(j));
+      if(dq == 0) continue;
+      Mi += dq*robot->lipschitzMatrix(j,i);
+    }
+    M = Max(M,Mi);
+  }
+  return M;
+}
+
+bool ConservativeAdvancementEdgePlanner::IsVisible()
+{
+  if(checked != 0) return checked > 0;
+  Real M = MovementBound();
+  if(!IsFinite(M)) {
+    bisected = true;
+    checked = (BisectEdge(space,a,b,0,1) ? 1 : -1);
+    return checked > 0;
+  }
+  checked = 1;
+  if(M == 0) return true;
+  if(!space->workspace && !space->edgeWorkspace)
+    space->EnableConservativeAdvancement();
+  SingleRobotCSpaceWorkspace* ws = (space->workspace ? &*space->workspace : &*space->edgeWorkspace);
+  //[ua,ub] is the part of the edge that isn't certified free yet.  No point
+  //on a link moves more than M*du, so at clearance d from the environment
+  //the robot is free for |du| < d/M, and at self-clearance d for
+  //|du| < d/2M, since two links may approach each other.  At zero
+  //clearance the robot may be touching without colliding, so the
+  //feasibility test decides, and the rest of the edge is bisected.
+  Real ua = 0, ub = 1;
+  Config x;
+  Real envDist,selfDist;
+  for(int steps=0;steps<kMaxAdvancementSteps;steps++) {
+    space->Interpolate(a,b,ua,x);
+    space->ClearanceLowerBound(x,*ws,envDist,selfDist,M*(ub-ua),2*M*(ub-ua));
+    numQueries++;
+    Real du = Min(envDist/M,selfDist/(2*M));
+    if(du <= 0) {
+      if(!space->CheckCollisionFree(x,*ws)) { checked = -1; return false; }
+      break;
+    }
+    ua += du;
+    if(ua >= ub) return true;
+
+    space->Interpolate(a,b,ub,x);
+    space->ClearanceLowerBound(x,*ws,envDist,selfDist,M*(ub-ua),2*M*(ub-ua));
+    numQueries++;
+    du = Min(envDist/M,selfDist/(2*M));
+    if(du <= 0) {
+      if(!space->CheckCollisionFree(x,*ws)) { checked = -1; return false; }
+      break;
+    }
+    ub -= du;
+    if(ua >= ub) return true;
+  }
+  //too close to call by clearance
+  bisected = true;
+  checked = (BisectEdge(space,a,b,ua,ub) ? 1 : -1);
+  return checked > 0;
+}
+
+void ConservativeAdvancementEdgePlanner::Eval(Real u,Config& x) const
+{
+  space->Interpolate(a,b,u,x);
+}
+
+CSpace* ConservativeAdvancementEdgePlanner::Space() const
+{
+  return space;
+}
+
+EdgePlanner* ConservativeAdvancementEdgePlanner::Copy() const
+{
+  ConservativeAdvancementEdgePlanner* copy = new ConservativeAdvancementEdgePlanner(space,a,b);
+  copy->checked = checked;
+  copy->bisected = bisected;
+  return copy;
+}
+
+EdgePlanner* ConservativeAdvancementEdgePlanner::ReverseCopy() const
+{
+  ConservativeAdvancementEdgePlanner* copy = new ConservativeAdvancementEdgePlanner(space,b,a);
+  copy->checked = checked;
+  copy->bisected = bisected;
+  return copy;
+}
+
+//checks configuration i with the workspace of the calling thread
+struct FeasibilityBody : public ParallelForBody
+{
+  virtual bool operator ()(int i,int thread)
+  {
+    (*feasible)[i] = space->IsFeasible((*configs)[i],workspaces[thread]);
+    return true;
+  }
+
+  const SingleRobotCSpace* space;
+  vector<SingleRobotCSpaceWorkspace> workspaces;
+  const vector<Config>* configs;
+  vector<char>* feasible;
+};
+
+void ParallelIsFeasible(SingleRobotCSpace& space,const vector<Config>& configs,vector<bool>& feasible,ThreadPool& pool)
+{
+  const static int kChunkSize = 16;
+  //vector<bool> packs bits, so the threads write to a byte per config
+  vector<char> res(configs.size(),0);
+  FeasibilityBody body;
+  body.space = &space;
+  body.workspaces.resize(pool.NumThreads());
+  for(int k=0;k<pool.NumThreads();k++)
+    space.InitWorkspace(body.workspaces[k]);
+  body.configs = &configs;
+  body.feasible = &res;
+  pool.ParallelFor(0,(int)configs.size(),body,kChunkSize);
+  feasible.resize(configs.size());
+  for(size_t i=0;i<configs.size();i++)
+    feasible[i] = (res[i] != 0);
+}
+
+void ParallelIsFeasible(SingleRobotCSpace& space,const vector<Config>& configs,vector<bool>& feasible,int numThreads)
+{
+  ThreadPool pool(numThreads);
+  ParallelIsFeasible(space,configs,feasible,pool);
+}
+
 void SingleRobotCSpace::CheckObstacles(const Config& x,vector<bool>& infeasible)
 {
+  if(feasibilityCache) {
+    SyncFeasibilityCache();
+    if(feasibilityCache->LookupObstacles(x,infeasible)) return;
+  }
   infeasible.resize(NumObstacles(),false);
   Robot* robot=GetRobot();
   robot->UpdateConfig(x);
@@ -812,6 +1329,7 @@ void SingleRobotCSpace::CheckObstacles(const Config& x,vector<bool>& infeasible)
   if(!collisionPairsInitialized) InitializeCollisionPairs();
   for(size_t i=0;i<collisionQueries.size();i++) 
     infeasible[i+(int)robot->joints.size()]=collisionQueries[i].Collide();
+  if(feasibilityCache) feasibilityCache->InsertObstacles(x,infeasible);
 }
 
 
@@ -821,12 +1339,25 @@ EdgePlanner* SingleRobotCSpace::LocalPlanner(const Config& a,const Config& b,int
     return new TrueEdgePlanner(this,a,b);
   }
   SingleObstacleCSpace* ospace = new SingleObstacleCSpace(this,obstacle);
-  return new EdgePlannerWithCSpaceContainer(ospace,new BisectionEpsilonEdgePlanner(ospace,a,b,settings->robotSettings[index].collisionEpsilon));
+  EdgePlanner* e = new EdgePlannerWithCSpaceContainer(ospace,new BisectionEpsilonEdgePlanner(ospace,a,b,settings->robotSettings[index].collisionEpsilon));
+  if(edgeCache) {
+    SyncEdgeCache();
+    return new CachedEdgePlanner(e,&*edgeCache,obstacle);
+  }
+  return e;
 }
 
 EdgePlanner* SingleRobotCSpace::LocalPlanner(const Config& a,const Config& b)
 {
-  return new BisectionEpsilonEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  EdgePlanner* e;
+  if(conservativeAdvancement) e = new ConservativeAdvancementEdgePlanner(this,a,b);
+  else if(edgeChecker) e = new ParallelEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  else e = new BisectionEpsilonEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  if(edgeCache) {
+    SyncEdgeCache();
+    return new CachedEdgePlanner(e,&*edgeCache);
+  }
+  return e;
   //uncomment this if you need an explicit edge planner
   //return new BisectionEpsilonExplicitEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
   //return new ExplicitEdgePlanner(this,a,b);
@@ -836,7 +1367,7 @@ Real SingleRobotCSpace::Distance(const Config& x, const Config& y)
 {
   //Real sum = 0;
   Real vmax = 0;
-  Robot* robot = world.robots[index];
+  Robot* robot = GetKinematicRobot();
   const Vector& w=settings->robotSettings[index].distanceWeights;
   for(size_t i=0;i<robot->joints.size();i++) {
     switch(robot->joints[i].type) {
@@ -853,6 +1384,16 @@ Real SingleRobotCSpace::Distance(const Config& x, const Config& y)
 	  vmax = Max(vmax,w(l)*Abs(x(l)-y(l)));
       }
       break;
+    case RobotJoint::Spin:
+      {
+	int l=robot->joints[i].linkIndex;
+	Real d=Abs(AngleDiff(AngleNormalize(x(l)),AngleNormalize(y(l))));
+	if(w.n==0)
+	  vmax = Max(vmax,d);
+	else
+	  vmax = Max(vmax,w(l)*d);
+      }
+      break;
     case RobotJoint::Floating:
       {
 	vector<int> indices;
@@ -891,7 +1432,7 @@ Real SingleRobotCSpace::Distance(const Config& x, const Config& y)
 
 void SingleRobotCSpace::Interpolate(const Config& x,const Config& y,Real u,Config& out)
 {
-  Robot* robot = world.robots[index];
+  Robot* robot = GetKinematicRobot();
   ::Interpolate(*robot,x,y,u,out);
 }
 
@@ -902,7 +1443,7 @@ void SingleRobotCSpace::Midpoint(const Config& x,const Config& y,Config& out)
 
 void SingleRobotCSpace::Properties(PropertyMap& map) const
 {
-  Robot* robot = world.robots[index];
+  Robot* robot = GetKinematicRobot();
   int euclidean = 1;
   Real v = 1;
   int dim = robot->q.n;
@@ -1186,7 +1727,15 @@ EdgePlanner* SingleRobotCSpace2::LocalPlanner(const Config& a,const Config& b,in
 
 EdgePlanner* SingleRobotCSpace2::LocalPlanner(const Config& a,const Config& b)
 {
-  return new BisectionEpsilonExplicitEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  EdgePlanner* e;
+  if(conservativeAdvancement) e = new ConservativeAdvancementEdgePlanner(this,a,b);
+  else if(edgeChecker) e = new ParallelEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  else e = new BisectionEpsilonExplicitEdgePlanner(this,a,b,settings->robotSettings[index].collisionEpsilon);
+  if(edgeCache) {
+    SyncEdgeCache();
+    return new CachedEdgePlanner(e,&*edgeCache);
+  }
+  return e;
   //return new ExplicitEdgePlanner(this,a,b);
 }
 
@@ -4,8 +4,13 @@
 #include "Modeling/World.h"
 #include "Modeling/GeneralizedRobot.h"
 #include "PlannerSettings.h"
+#include "EdgeCheckCache.h"
+#include "FeasibilityCache.h"
+#include "Modeling/ThreadPool.h"
+#include "Modeling/DynamicPath.h"
 #include <KrisLibrary/planning/ExplicitCSpace.h>
 #include <KrisLibrary/planning/GeodesicSpace.h>
+#include <KrisLibrary/planning/EdgePlanner.h>
 #include <KrisLibrary/utils/ArrayMapping.h>
 #include <KrisLibrary/utils/SmartPointer.h>
 
@@ -109,11 +114,96 @@ public:
 };
 
 
+/** @ingroup Planning
+ * @brief Per-thread storage for the SingleRobotCSpace feasibility tests
+ * that don't modify the shared Robot.
+ *
+ * Holds the link transforms of the tested configuration and private copies
+ * of the robot's link geometries, which are moved to those transforms,
+ * along with the broad phase cache for the collision queries.  Set it up
+ * with SingleRobotCSpace::InitWorkspace.
+ */
+struct SingleRobotCSpaceWorkspace
+{
+  vector<RigidTransform> T;   ///<link transforms
+  vector<SmartPointer<Geometry::AnyCollisionGeometry3D> > geometry; ///<copies of the link geometries
+  vector<Geometry::AnyCollisionGeometry3D*> robotGeoms,envGeoms;
+  vector<int> robotIds,envIds;
+  WorldBroadPhaseCache broadPhase;
+  //temporary storage
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  vector<int> ids;
+};
+
+class SingleRobotCSpace;
+
+/** @ingroup Planning
+ * @brief Checks straight-line edges of a SingleRobotCSpace by spreading the
+ * bisection samples over several threads.
+ *
+ * The samples that BisectionEpsilonEdgePlanner would check, the points at
+ * u=j/2^k where the segments between them are shorter than epsilon, are
+ * checked coarsest level first.  Each thread takes small batches of them
+ * in that order using its own SingleRobotCSpaceWorkspace, and all threads
+ * stop as soon as one finds a collision.  The threads and workspaces are
+ * kept between edges.  Edges with fewer than minParallelSamples samples are
+ * checked in the calling thread.
+ *
+ * Check() may be called by one thread at a time.  Like the other
+ * workspace-based tests, it requires the world geometry to be up to date.
+ */
+class ParallelEdgeChecker
+{
+public:
+  ParallelEdgeChecker(SingleRobotCSpace* space,int numThreads);
+  bool Check(const Config& a,const Config& b,Real epsilon);
+  ///Edges validated per second of checking time
+  Real EdgesPerSecond() const;
+
+  SingleRobotCSpace* space;
+  int numThreads;
+  int minParallelSamples;
+  ThreadPool pool;
+  vector<SingleRobotCSpaceWorkspace> workspaces;
+  vector<Config> xs;
+
+  //the edge being checked
+  const Config *a,*b;
+  vector<Real> us;
+
+  //statistics
+  int numEdges;
+  Real checkTime;
+};
+
 /** @ingroup Planning
  * @brief A cspace consisting of a single robot configuration in a
  * RobotWorld.  Feasibility constraints are joint and collision constraints.
  *
  * Uses WorldPlannerSettings to determine the settings for collision constraints.
+ *
+ * IsFeasible normally updates the configuration and geometry of the shared
+ * Robot, so only one thread may use it at a time.  The overloads that take a
+ * SingleRobotCSpaceWorkspace only modify the workspace, and several threads
+ * may call them at once, each with its own workspace.  This requires that
+ * the geometries of the rest of the world are up to date
+ * (world.UpdateGeometry()) and are not moved while the threads run.
+ * CloneForThread() gives a copy of the space for planners that only see
+ * the CSpace interface: IsFeasible and LocalPlanner use a private
+ * workspace, and Sample, SampleNeighborhood, Distance and Interpolate use
+ * a private copy of the robot and the copy's own random number generator.
+ * The explicit-cspace methods (CheckObstacles and the per-obstacle tests)
+ * still use the shared Robot.
+ *
+ * After EnableParallelEdgeChecking(), LocalPlanner returns
+ * ParallelEdgePlanners that check edges on several threads.
+ *
+ * Lazy mode, turned on with EnableLazyChecking(), is meant for lazy
+ * planners such as LazyRoadmapPlanner (see CreateLazyPlanner), which defer
+ * edge checks to candidate paths and prune the edges that fail.  In lazy
+ * mode LocalPlanner wraps its edges in CachedEdgePlanners so that each
+ * edge, and each edge/obstacle pair, is checked once across searches.  The
+ * cache is cleared when the environment moves.
  */
 class SingleRobotCSpace : public ExplicitCSpace
 {
@@ -147,16 +237,168 @@ class SingleRobotCSpace : public ExplicitCSpace
   bool CheckJointLimits(const Config& x);
   bool CheckCollisionFree();
   Robot* GetRobot() const;
+  ///The robot used for sampling, distance and interpolation: threadRobot
+  ///if set, otherwise the world's robot
+  Robot* GetKinematicRobot() const;
+
+  ///Sets up ws for the thread-safe feasibility tests.  Call this from one
+  ///thread; it copies the robot's geometry.
+  void InitWorkspace(SingleRobotCSpaceWorkspace& ws);
+  ///Thread-safe feasibility tests that only modify ws
+  bool IsFeasible(const Config& x,SingleRobotCSpaceWorkspace& ws) const;
+  bool CheckJointLimits(const Config& x,SingleRobotCSpaceWorkspace& ws) const;
+  bool CheckCollisionFree(const Config& x,SingleRobotCSpaceWorkspace& ws) const;
+  ///Moves the workspace geometry to the configuration x
+  void UpdateWorkspace(const Config& x,SingleRobotCSpaceWorkspace& ws) const;
+  ///Computes lower bounds on the distance between the robot at x and the
+  ///environment, and between the robot's self-colliding links.  Each
+  ///distance query stops early once it is known to exceed its bound, and
+  ///then returns the bound.  Only modifies ws.
+  void ClearanceLowerBound(const Config& x,SingleRobotCSpaceWorkspace& ws,Real& envDist,Real& selfDist,Real envBound=Inf,Real selfBound=Inf) const;
+  ///Returns a new copy of this space with its own workspace, robot copy
+  ///and random number generator, to be given to one thread.  The copy
+  ///samples with rng, which it takes ownership of, or with the global
+  ///generator if rng is NULL.  The caller deletes it.
+  SingleRobotCSpace* CloneForThread(ParabolicRamp::RandomNumberGeneratorBase* rng=NULL);
+  ///Makes LocalPlanner check edges on numThreads threads.  numThreads <= 1
+  ///turns it off.
+  void EnableParallelEdgeChecking(int numThreads);
+  ///Makes LocalPlanner return exact ConservativeAdvancementEdgePlanners.
+  ///Computes the robot's Lipschitz matrix if needed.
+  void EnableConservativeAdvancement(bool enabled=true);
+  ///Turns lazy mode on, with an edge cache of the given capacity, or off
+  void EnableLazyChecking(bool enabled=true,size_t maxEntries=100000);
+  ///Clears the edge cache if the environment has moved.  Called by
+  ///LocalPlanner in lazy mode.
+  void SyncEdgeCache();
+  ///Turns on the feasibility cache with the given capacity, or turns it off
+  ///if maxEntries = 0
+  void EnableFeasibilityCache(size_t maxEntries=10000);
+  ///Clears the feasibility cache if the environment has moved.  Called by
+  ///IsFeasible and CheckObstacles.
+  void SyncFeasibilityCache();
+  ///Returns the environment geometries that the edge and feasibility
+  ///caches are synced against.  The list is kept in cacheEnvGeoms and only
+  ///rebuilt when the number of world IDs changes.
+  const vector<Geometry::AnyCollisionGeometry3D*>& GetCacheEnvironment();
 
   RobotWorld& world;
   int index;
   WorldPlannerSettings* settings;
+  ///If non-NULL, IsFeasible(x) uses the thread-safe tests with this workspace
+  SmartPointer<SingleRobotCSpaceWorkspace> workspace;
+  ///If non-NULL, LocalPlanner returns ParallelEdgePlanners that use it
+  SmartPointer<ParallelEdgeChecker> edgeChecker;
+  ///If true, LocalPlanner returns ConservativeAdvancementEdgePlanners,
+  ///which check against workspace, or edgeWorkspace if workspace is NULL
+  bool conservativeAdvancement;
+  SmartPointer<SingleRobotCSpaceWorkspace> edgeWorkspace;
+  ///If non-NULL (lazy mode), edge results are cached here.  Not shared
+  ///with copies of the space.
+  SmartPointer<EdgeCheckCache> edgeCache;
+  ///If non-NULL, feasibility results are cached here.  Not shared with
+  ///copies of the space.
+  SmartPointer<FeasibilityCache> feasibilityCache;
+  ///The environment geometries of GetCacheEnvironment, gathered when the
+  ///world had cacheEnvNumIDs IDs
+  vector<Geometry::AnyCollisionGeometry3D*> cacheEnvGeoms;
+  int cacheEnvNumIDs;
+  ///If non-NULL, a private copy of the robot used by the methods that only
+  ///need its kinematics (see GetKinematicRobot)
+  SmartPointer<Robot> threadRobot;
+  ///If non-NULL, Sample and SampleNeighborhood draw from this instead of
+  ///the global random number generator
+  SmartPointer<ParabolicRamp::RandomNumberGeneratorBase> rng;
+  ///The broad phase cache of CheckCollisionFree()
+  WorldBroadPhaseCache broadPhase;
 
   bool collisionPairsInitialized;
   vector<pair<int,int> > collisionPairs;
   vector<Geometry::AnyCollisionQuery> collisionQueries;
 };
 
+/** @ingroup Planning
+ * @brief A straight-line edge planner for SingleRobotCSpace and
+ * SingleRobotCSpace2 that checks its samples with a ParallelEdgeChecker.
+ *
+ * As with BisectionEpsilonEdgePlanner, the endpoints are not checked.
+ */
+class ParallelEdgePlanner : public EdgePlanner
+{
+public:
+  ParallelEdgePlanner(SingleRobotCSpace* space,const Config& a,const Config& b,Real epsilon);
+  virtual ~ParallelEdgePlanner() {}
+  virtual bool IsVisible();
+  virtual void Eval(Real u,Config& x) const;
+  virtual const Config& Start() const { return a; }
+  virtual const Config& Goal() const { return b; }
+  virtual CSpace* Space() const;
+  virtual EdgePlanner* Copy() const;
+  virtual EdgePlanner* ReverseCopy() const;
+
+  SingleRobotCSpace* space;
+  Config a,b;
+  Real epsilon;
+  int checked;
+};
+
+/** @ingroup Planning
+ * @brief An exact edge planner for SingleRobotCSpace and SingleRobotCSpace2
+ * that certifies intervals of the edge free by conservative advancement.
+ *
+ * The robot's Lipschitz matrix bounds how far any point of a link moves
+ * per unit of the edge parameter, M.  At a configuration with clearance d
+ * (from WorldPlannerSettings::DistanceLowerBound) nothing can collide
+ * within parameter distance d/M, so the edge is advanced by that much from
+ * both ends until the certified intervals meet.  Steps are long far from
+ * obstacles and short near them, and no collision is missed regardless of
+ * the collision epsilon.
+ *
+ * A configuration with zero clearance is reported infeasible only if the
+ * feasibility test (CheckCollisionFree) finds a collision there, since the
+ * robot may just be touching.  The part of the edge left uncertified at
+ * such a configuration, or after a fixed number of steps from each end, is
+ * checked by bisection at the collision epsilon, as
+ * BisectionEpsilonEdgePlanner would.
+ *
+ * Robots with floating or ball-and-socket joints, or unbounded
+ * translational joints, have no finite bound, and are checked by
+ * BisectionEpsilonEdgePlanner instead.  As with that planner, the
+ * endpoints are not checked.
+ */
+class ConservativeAdvancementEdgePlanner : public EdgePlanner
+{
+public:
+  ConservativeAdvancementEdgePlanner(SingleRobotCSpace* space,const Config& a,const Config& b);
+  virtual ~ConservativeAdvancementEdgePlanner() {}
+  virtual bool IsVisible();
+  virtual void Eval(Real u,Config& x) const;
+  virtual const Config& Start() const { return a; }
+  virtual const Config& Goal() const { return b; }
+  virtual CSpace* Space() const;
+  virtual EdgePlanner* Copy() const;
+  virtual EdgePlanner* ReverseCopy() const;
+  ///Bound on the workspace movement of any link point per unit of u
+  Real MovementBound() const;
+
+  SingleRobotCSpace* space;
+  Config a,b;
+  int checked;
+  int numQueries;   ///<number of clearance queries made by IsVisible
+  bool bisected;    ///<true if IsVisible bisected part of the edge
+};
+
+/** @ingroup Planning
+ * @brief Checks the feasibility of many configurations of space on the
+ * threads of pool, each with its own SingleRobotCSpaceWorkspace.
+ * feasible[i] is set to the result for configs[i].  The second form starts
+ * a pool of numThreads threads for the call.
+ *
+ * Make sure to call world.UpdateGeometry() first.
+ */
+void ParallelIsFeasible(SingleRobotCSpace& space,const vector<Config>& configs,vector<bool>& feasible,ThreadPool& pool);
+void ParallelIsFeasible(SingleRobotCSpace& space,const vector<Config>& configs,vector<bool>& feasible,int numThreads);
+
 /** @ingroup Planning
  * @brief A slightly more sophisticated single-robot cspace.
  * Allows fixing dofs and ignoring collisions between certain object pairs.
@@ -1,5 +1,43 @@
 #include "RobotConstrainedInterpolator.h"
 
+//sets the solver's bounds to xmin,xmax on the active DOFs of f, if they
+//are given and haven't been set yet
+static void SetActiveDofBounds(RobotIKFunction& f,const Config& xmin,const Config& xmax,Optimization::NewtonRoot& solver)
+{
+  if(solver.bmin.empty() && !xmin.empty()) {
+    solver.bmin.resize(f.activeDofs.Size());
+    solver.bmax.resize(f.activeDofs.Size());
+    f.activeDofs.InvMap(xmin,solver.bmin);
+    f.activeDofs.InvMap(xmax,solver.bmax);
+  }
+}
+
+//the Jacobian of f w.r.t. its active DOFs at x
+static void ActiveDofJacobian(RobotIKFunction& f,const Config& x,Matrix& J)
+{
+  Vector xtemp(f.activeDofs.Size());
+  f.activeDofs.InvMap(x,xtemp);
+  f.PreEval(xtemp);
+  f.Jacobian(xtemp,J);
+}
+
+//projects the active DOFs of x onto f=0 with projector, starting from the
+//Jacobian estimate J, within the bounds of solver if they are set
+static bool ActiveDofProjectFrom(RobotIKFunction& f,BroydenProjector& projector,Optimization::NewtonRoot& solver,Real ftol,int maxIters,Config& x,Matrix& J)
+{
+  projector.C = &f;
+  projector.tolf = ftol;
+  if(!solver.bmin.empty()) {
+    projector.bmin.setRef(solver.bmin);
+    projector.bmax.setRef(solver.bmax);
+  }
+  Vector xtemp(f.activeDofs.Size());
+  f.activeDofs.InvMap(x,xtemp);
+  if(!projector.Solve(xtemp,J,maxIters)) return false;
+  f.activeDofs.Map(xtemp,x);
+  return true;
+}
+
 RobotConstrainedInterpolator::RobotConstrainedInterpolator(Robot& robot,const vector<IKGoal>& goals)
   :ConstrainedInterpolator(&space,&f),space(robot),manifold(robot),f(robot)
 {
@@ -20,12 +58,7 @@ bool RobotConstrainedInterpolator::Project(Config& x)
   solver.tolf = ftol;
   solver.tolx = solver.tolmin = ftol*1e-2;
   solver.verbose = 0;
-  if(solver.bmin.empty() && !xmin.empty()) {
-    solver.bmin.resize(f.activeDofs.Size());
-    solver.bmax.resize(f.activeDofs.Size());
-    f.activeDofs.InvMap(xmin,solver.bmin);
-    f.activeDofs.InvMap(xmax,solver.bmax);
-  }
+  SetActiveDofBounds(f,xmin,xmax,solver);
   int iters=maxNewtonIters;
   solver.x.resize(f.activeDofs.Size());
   f.activeDofs.InvMap(x,solver.x);
@@ -34,6 +67,17 @@ bool RobotConstrainedInterpolator::Project(Config& x)
   return true;
 }
 
+void RobotConstrainedInterpolator::ConstraintJacobian(const Config& x,Matrix& J)
+{
+  ActiveDofJacobian(f,x,J);
+}
+
+bool RobotConstrainedInterpolator::ProjectFrom(Config& x,Matrix& J)
+{
+  SetActiveDofBounds(f,xmin,xmax,solver);
+  return ActiveDofProjectFrom(f,projector,solver,ftol,maxNewtonIters,x,J);
+}
+
 
 RobotSmoothConstrainedInterpolator::RobotSmoothConstrainedInterpolator(Robot& robot,const vector<IKGoal>& goals)
   :SmoothConstrainedInterpolator(&space,&f),space(robot),manifold(robot),f(robot)
@@ -57,12 +101,7 @@ bool RobotSmoothConstrainedInterpolator::Project(Config& x)
   solver.tolf = ftol;
   solver.tolx = solver.tolmin = ftol*1e-2;
   solver.verbose = 0;
-  if(solver.bmin.empty() && !xmin.empty()) {
-    solver.bmin.resize(f.activeDofs.Size());
-    solver.bmax.resize(f.activeDofs.Size());
-    f.activeDofs.InvMap(xmin,solver.bmin);
-    f.activeDofs.InvMap(xmax,solver.bmax);
-  }
+  SetActiveDofBounds(f,xmin,xmax,solver);
   int iters=maxNewtonIters;
   solver.x.resize(f.activeDofs.Size());
   f.activeDofs.InvMap(x,solver.x);
@@ -71,6 +110,17 @@ bool RobotSmoothConstrainedInterpolator::Project(Config& x)
   return true;
 }
 
+void RobotSmoothConstrainedInterpolator::ConstraintJacobian(const Config& x,Matrix& J)
+{
+  ActiveDofJacobian(f,x,J);
+}
+
+bool RobotSmoothConstrainedInterpolator::ProjectFrom(Config& x,Matrix& J)
+{
+  SetActiveDofBounds(f,xmin,xmax,solver);
+  return ActiveDofProjectFrom(f,projector,solver,ftol,maxNewtonIters,x,J);
+}
+
 bool RobotSmoothConstrainedInterpolator::ProjectVelocity(const Config& x,Vector& v)
 {
   Vector temp,vtemp;
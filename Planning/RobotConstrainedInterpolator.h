@@ -16,6 +16,8 @@ public:
   RobotConstrainedInterpolator(Robot& robot,const vector<IKGoal>& goals);
   virtual void ConstraintValue(const Config& x,Vector& v);
   virtual bool Project(Config& x);
+  virtual void ConstraintJacobian(const Config& x,Matrix& J);
+  virtual bool ProjectFrom(Config& x,Matrix& J);
 
   RobotCSpace space;
   RobotGeodesicManifold manifold;
@@ -32,6 +34,8 @@ public:
   RobotSmoothConstrainedInterpolator(Robot& robot,const vector<IKGoal>& goals);
   virtual void ConstraintValue(const Config& x,Vector& v);
   virtual bool Project(Config& x);
+  virtual void ConstraintJacobian(const Config& x,Matrix& J);
+  virtual bool ProjectFrom(Config& x,Matrix& J);
   virtual bool ProjectVelocity(const Config& x,Vector& v);
 
   RobotCSpace space;
@@ -1,6 +1,18 @@
 #include "SelfTest.h"
 #include "RampCSpace.h"
+#include "NearestNeighborIndex.h"
+#include "LazyRoadmapPlanner.h"
+#include "RealTimeRRTPlanner.h"
+#include "TimeScaling.h"
+#include "RobotConstrainedInterpolator.h"
+#include "Modeling/MultiPath.h"
+#include "Modeling/SplineInterpolate.h"
+#include <KrisLibrary/utils/stringutils.h>
+#include <fstream>
+#include <string.h>
 #include <KrisLibrary/Timer.h>
+#include <KrisLibrary/math/random.h>
+#include <algorithm>
 #include <time.h>
 
 //tests shortcutting on randomly generated paths between a and b
@@ -133,3 +145,738 @@ void TestDynamicShortcutting(SingleRobotCSpace& freeSpace,const ParabolicRamp::D
   printf("Dynamic shortcutting with window %g made %d shortcuts, took %g seconds\n",2.0,ns,timer.ElapsedTime());
 }
 
+void TestParallelShortcutting(SingleRobotCSpace& cspace,const ParabolicRamp::DynamicPath& porig,int numIters,int maxThreads)
+{
+  Real tol = cspace.settings->robotSettings[cspace.index].collisionEpsilon;
+  cspace.world.UpdateGeometry();
+  ParabolicRamp::DynamicPath path = porig;
+  CSpaceFeasibilityChecker feas(&cspace);
+  ParabolicRamp::RampFeasibilityChecker checker(&feas,tol);
+  ParabolicRamp::SeededRandomNumberGenerator rng(1234);
+  Timer timer;
+  int ns = path.Shortcut(numIters,checker,&rng);
+  printf("Shortcut: %d shortcuts, duration %g -> %g, %g s\n",ns,porig.GetTotalTime(),path.GetTotalTime(),timer.ElapsedTime());
+
+  vector<SmartPointer<SingleRobotCSpace> > spaces(maxThreads);
+  vector<SmartPointer<CSpaceFeasibilityChecker> > feasCheckers(maxThreads);
+  vector<SmartPointer<ParabolicRamp::RampFeasibilityChecker> > checkers(maxThreads);
+  for(int k=0;k<maxThreads;k++) {
+    spaces[k] = cspace.CloneForThread();
+    feasCheckers[k] = new CSpaceFeasibilityChecker(spaces[k]);
+    checkers[k] = new ParabolicRamp::RampFeasibilityChecker(feasCheckers[k],tol);
+  }
+  for(int n=1;n<=maxThreads;n*=2) {
+    vector<ParabolicRamp::RampFeasibilityChecker*> checks(n);
+    for(int k=0;k<n;k++) checks[k] = checkers[k];
+    path = porig;
+    ParabolicRamp::SeededRandomNumberGenerator rng1(1234);
+    timer.Reset();
+    ns = path.ParallelShortcut(numIters,checks,&rng1);
+    Real t = timer.ElapsedTime();
+    ParabolicRamp::DynamicPath path2 = porig;
+    ParabolicRamp::SeededRandomNumberGenerator rng2(1234);
+    path2.ParallelShortcut(numIters,checks,&rng2);
+    printf("ParallelShortcut, %d threads: %d shortcuts, duration %g -> %g, %g s\n",n,ns,porig.GetTotalTime(),path.GetTotalTime(),t);
+    if(path2.GetTotalTime() != path.GetTotalTime() || path2.ramps.size() != path.ramps.size())
+      printf("  Error, repeated run with the same seed gave a different path\n");
+  }
+}
+bool TestBatchEvaluation(const ParabolicRamp::DynamicPath& path,int numTimes)
+{
+  Real T = path.GetTotalTime();
+  vector<Real> ts(numTimes);
+  for(int i=0;i<numTimes;i++)
+    ts[i] = T*Real(i)/Real(Max(numTimes-1,1));
+  int d = (int)path.StartConfig().size();
+  Timer timer;
+  vector<ParabolicRamp::Vector> xs(numTimes);
+  for(int i=0;i<numTimes;i++)
+    path.Evaluate(ts[i],xs[i]);
+  Real tserial = timer.ElapsedTime();
+  timer.Reset();
+  vector<Real> xbatch;
+  path.EvaluateBatch(ts,xbatch);
+  Real tbatch = timer.ElapsedTime();
+  Real err = 0;
+  for(int i=0;i<numTimes;i++)
+    for(int j=0;j<d;j++)
+      err = Max(err,Abs(xs[i][j]-xbatch[i*d+j]));
+  printf("Evaluate: %g s, EvaluateBatch: %g s for %d times, max difference %g\n",tserial,tbatch,numTimes,err);
+  if(err > 1e-8) {
+    printf("  Error, EvaluateBatch differs from Evaluate\n");
+    return false;
+  }
+  return true;
+}
+
+bool TestParallelFeasibility(SingleRobotCSpace& cspace,int numConfigs,int maxThreads)
+{
+  vector<Config> configs(numConfigs);
+  for(int i=0;i<numConfigs;i++)
+    cspace.Sample(configs[i]);
+  cspace.world.UpdateGeometry();
+
+  Timer timer;
+  vector<bool> serial(numConfigs);
+  int numFeasible = 0;
+  for(int i=0;i<numConfigs;i++) {
+    serial[i] = cspace.IsFeasible(configs[i]);
+    if(serial[i]) numFeasible++;
+  }
+  Real tserial = timer.ElapsedTime();
+  printf("Checked %d configurations serially in %g seconds, %d feasible\n",numConfigs,tserial,numFeasible);
+  cspace.world.UpdateGeometry();
+
+  vector<bool> feasible;
+  bool ok = true;
+  for(int n=1;n<=maxThreads;n*=2) {
+    ThreadPool pool(n);
+    timer.Reset();
+    ParallelIsFeasible(cspace,configs,feasible,pool);
+    Real t = timer.ElapsedTime();
+    int numMismatches = 0;
+    for(int i=0;i<numConfigs;i++)
+      if(feasible[i] != serial[i]) numMismatches++;
+    printf("%d threads: %g seconds, speedup %g",n,t,tserial/t);
+    if(numMismatches > 0) printf(", %d results differ from serial checking!",numMismatches);
+    printf("\n");
+    if(numMismatches > 0) ok = false;
+  }
+  return ok;
+}
+
+bool TestParallelEdgeChecking(SingleRobotCSpace& cspace,int numEdges,Real radius,int maxThreads)
+{
+  Real epsilon = cspace.settings->robotSettings[cspace.index].collisionEpsilon;
+  vector<Config> a(numEdges),b(numEdges);
+  for(int i=0;i<numEdges;i++) {
+    cspace.Sample(a[i]);
+    cspace.SampleNeighborhood(a[i],radius,b[i]);
+  }
+  cspace.world.UpdateGeometry();
+
+  Timer timer;
+  vector<bool> serial(numEdges);
+  int numVisible = 0;
+  for(int i=0;i<numEdges;i++) {
+    BisectionEpsilonEdgePlanner e(&cspace,a[i],b[i],epsilon);
+    serial[i] = e.IsVisible();
+    if(serial[i]) numVisible++;
+  }
+  Real tserial = timer.ElapsedTime();
+  printf("BisectionEpsilonEdgePlanner: %d edges, %d visible, %g edges/s\n",numEdges,numVisible,numEdges/tserial);
+  cspace.world.UpdateGeometry();
+
+  bool ok = true;
+  for(int n=2;n<=maxThreads;n*=2) {
+    ParallelEdgeChecker checker(&cspace,n);
+    int numMismatches = 0;
+    for(int i=0;i<numEdges;i++)
+      if(checker.Check(a[i],b[i],epsilon) != serial[i]) numMismatches++;
+    printf("ParallelEdgeChecker, %d threads: %g edges/s, speedup %g",n,checker.EdgesPerSecond(),checker.EdgesPerSecond()*tserial/numEdges);
+    if(numMismatches > 0) printf(", %d results differ from serial checking!",numMismatches);
+    printf("\n");    if(numMismatches > 0) ok = false;
+  }
+  return ok;
+}
+
+bool TestConservativeAdvancement(SingleRobotCSpace& cspace,int numEdges,Real radius)
+{
+  Real epsilon = cspace.settings->robotSettings[cspace.index].collisionEpsilon;
+  vector<Config> a(numEdges),b(numEdges);
+  for(int i=0;i<numEdges;i++) {
+    cspace.Sample(a[i]);
+    cspace.SampleNeighborhood(a[i],radius,b[i]);
+  }
+  cspace.EnableConservativeAdvancement();
+  cspace.world.UpdateGeometry();
+
+  Timer timer;
+  vector<bool> bisectVisible(numEdges,false);
+  int numVisible = 0, numSamples = 0;
+  for(int i=0;i<numEdges;i++) {
+    BisectionEpsilonEdgePlanner e(&cspace,a[i],b[i],epsilon);
+    if(e.IsVisible()) {
+      bisectVisible[i] = true;
+      numVisible++;
+      //a visible edge is checked at every bisection sample
+      Real d = cspace.Distance(a[i],b[i]);
+      int n = 1;
+      while(d > epsilon) { d *= 0.5; n *= 2; }
+      numSamples += n-1;
+    }
+  }
+  Real tbisect = timer.ElapsedTime();
+  printf("BisectionEpsilonEdgePlanner: %d of %d edges visible, %g s, %g collision queries per visible edge\n",numVisible,numEdges,tbisect,Real(numSamples)/Max(numVisible,1));
+
+  timer.Reset();
+  int numVisible2 = 0, numQueries = 0, numMissed = 0, numBisected = 0;
+  for(int i=0;i<numEdges;i++) {
+    ConservativeAdvancementEdgePlanner e(&cspace,a[i],b[i]);
+    bool visible = e.IsVisible();
+    if(e.bisected) numBisected++;
+    if(visible) {
+      numVisible2++;
+      numQueries += e.numQueries;
+      //every bisection sample lies on a certified edge, unless part of the
+      //edge was bisected at other samples
+      if(!bisectVisible[i] && !e.bisected) numMissed++;
+    }
+  }
+  printf("ConservativeAdvancementEdgePlanner: %d of %d edges visible, %g s, %g clearance queries per visible edge, %d edges partly bisected\n",numVisible2,numEdges,timer.ElapsedTime(),Real(numQueries)/Max(numVisible2,1),numBisected);
+  if(numMissed > 0) printf("%d edges rejected by bisection were accepted by conservative advancement!\n",numMissed);
+  cspace.EnableConservativeAdvancement(false);
+  return numMissed == 0;
+}
+
+//samples x until it's feasible, up to maxTries times
+static bool SampleFeasible(SingleRobotCSpace& cspace,Config& x,int maxTries=1000)
+{
+  for(int i=0;i<maxTries;i++) {
+    cspace.Sample(x);
+    if(cspace.IsFeasible(x)) return true;
+  }
+  return false;
+}
+
+bool TestLazyPlanning(SingleRobotCSpace& cspace,int numQueries,int maxIters)
+{
+  Real epsilon = cspace.settings->robotSettings[cspace.index].collisionEpsilon;
+  const char* modeNames[2] = {"lazy PRM","lazy RRT"};
+  cspace.EnableLazyChecking();
+  bool ok = true;
+  for(int mode=0;mode<2;mode++) {
+    int numSolved = 0, numInvalid = 0, numChecks = 0, numPruned = 0;
+    Timer timer;
+    for(int q=0;q<numQueries;q++) {
+      Config a,b;
+      if(!SampleFeasible(cspace,a) || !SampleFeasible(cspace,b)) {
+        printf("Could not sample feasible endpoints\n");
+        cspace.EnableLazyChecking(false);
+        return false;
+      }
+      LazyRoadmapPlanner planner(&cspace,(mode == 0 ? LazyRoadmapPlanner::PRM : LazyRoadmapPlanner::RRT));
+      planner.AddMilestone(a);
+      planner.AddMilestone(b);
+      for(int iter=0;iter<maxIters && !planner.IsSolved();iter++)
+        planner.PlanMore();
+      numChecks += planner.numEdgeChecks;
+      numPruned += planner.numPrunedEdges;
+      if(!planner.IsSolved()) continue;
+      numSolved++;
+      //recheck the path without the cache
+      MilestonePath path;
+      planner.GetPath(0,1,path);
+      for(size_t i=0;i<path.edges.size();i++) {
+        BisectionEpsilonEdgePlanner e(&cspace,path.edges[i]->Start(),path.edges[i]->Goal(),epsilon);
+        if(!e.IsVisible()) {
+          numInvalid++;
+          break;
+        }
+      }
+    }
+    printf("%s: solved %d of %d queries in %g s, %g edge checks and %g pruned edges per query\n",modeNames[mode],numSolved,numQueries,timer.ElapsedTime(),Real(numChecks)/numQueries,Real(numPruned)/numQueries);
+    if(numInvalid > 0) {
+      printf("%d solution paths have infeasible edges!\n",numInvalid);
+      ok = false;
+    }
+  }
+  cspace.EnableLazyChecking(false);
+  return ok;
+}
+
+//counts the nodes whose time and state disagree with the edge from their
+//parent, or that are marked reachable without being checked again
+struct CheckTreeCallback : public Graph::CallbackBase<DynamicHybridTreePlanner::Node*>
+{
+  CheckTreeCallback() : numErrors(0) {}
+  virtual void Visit(DynamicHybridTreePlanner::Node* n) {
+    DynamicHybridTreePlanner::Node* p = n->getParent();
+    if(!p) return;
+    if(n->reachable) numErrors++;
+    const RampEdgePlanner* e = n->edgeFromParent().e;
+    if(!FuzzyEquals(n->t,p->t+e->Duration(),1e-6) ||
+       !Vector(e->path.ramps.front().x0).isEqual(p->q,1e-5) ||
+       !Vector(e->path.ramps.front().dx0).isEqual(p->dq,1e-5) ||
+       !Vector(e->path.ramps.back().x1).isEqual(n->q,1e-5) ||
+       !Vector(e->path.ramps.back().dx1).isEqual(n->dq,1e-5))
+      numErrors++;
+  }
+  int numErrors;
+};
+
+bool TestTreeReuse(SingleRobotCSpace& cspace,int numCycles,Real cycleTime)
+{
+  Robot* robot = cspace.GetRobot();
+  Config qstart = robot->q,qgoal,qoff;
+  if(!cspace.IsFeasible(qstart) && !SampleFeasible(cspace,qstart)) {
+    printf("Could not sample a feasible start\n");
+    return false;
+  }
+  if(!SampleFeasible(cspace,qgoal) || !SampleFeasible(cspace,qoff)) {
+    printf("Could not sample a feasible goal\n");
+    return false;
+  }
+  DynamicHybridTreePlanner planner;
+  planner.Init(&cspace,robot,cspace.settings);
+  planner.SetGoal(new ConfigObjective(qgoal));
+  ParabolicRamp::DynamicPath path;
+  path.ramps.resize(1);
+  path.ramps[0].SetConstant(qstart);
+  path.xMin = planner.qMin;
+  path.xMax = planner.qMax;
+  path.velMax = planner.velMax;
+  path.accMax = planner.accMax;
+  //a path from a configuration the robot never passes through
+  ParabolicRamp::DynamicPath offPath = path;
+  offPath.ramps[0].SetConstant(qoff);
+
+  bool ok = true;
+  int numReused = 0;
+  Real t = 0;
+  Timer timer;
+  for(int cycle=0;cycle<numCycles;cycle++) {
+    planner.SetTime(t);
+    planner.PlanFrom(path,cycleTime);
+    if(path.GetTotalTime() <= cycleTime) break;
+    //the robot executes the start of the path while the next cycle plans
+    ParabolicRamp::DynamicPath before,after;
+    path.Split(cycleTime,before,after);
+    t += cycleTime;
+    planner.SetTime(t);
+    vector<DynamicHybridTreePlanner::Node*> pathNodes;
+    if(planner.RerootTree(offPath,pathNodes)) {
+      printf("Cycle %d: the tree was re-rooted at a start off the returned path\n",cycle);
+      ok = false;
+      break;
+    }
+    if(!planner.RerootTree(after,pathNodes)) {
+      printf("Cycle %d: the tree was not re-rooted at a start on the returned path\n",cycle);
+      ok = false;
+    }
+    else {
+      numReused++;
+      CheckTreeCallback check;
+      planner.root->DFS(check);
+      if(!planner.root->q.isEqual(Vector(after.ramps.front().x0),1e-5) || planner.root->t != t || check.numErrors > 0) {
+        printf("Cycle %d: the re-rooted tree has %d inconsistent nodes\n",cycle,check.numErrors);
+        ok = false;
+      }
+      if(planner.treeBranch.front() != (DynamicHybridTreePlanner::Node*)planner.root ||
+         !planner.treeBranch.back()->q.isEqual(Vector(after.ramps.back().x1),1e-5)) {
+        printf("Cycle %d: the branch does not follow the remaining path\n",cycle);
+        ok = false;
+      }
+    }
+    path = after;
+  }
+  printf("Re-rooted the tree on %d cycles, %g s, final cost %g\n",numReused,timer.ElapsedTime(),planner.EvaluatePathCost(path,t));
+
+  //the same with DynamicRRTPlanner, whose new tree should follow the
+  //remaining path
+  DynamicRRTPlanner rrtPlanner;
+  rrtPlanner.Init(&cspace,robot,cspace.settings);
+  rrtPlanner.SetGoal(new ConfigObjective(qgoal));
+  path = offPath;
+  path.ramps[0].SetConstant(qstart);
+  numReused = 0;
+  t = 0;
+  timer.Reset();
+  for(int cycle=0;cycle<numCycles;cycle++) {
+    rrtPlanner.SetTime(t);
+    rrtPlanner.PlanFrom(path,cycleTime);
+    if(path.GetTotalTime() <= cycleTime) break;
+    ParabolicRamp::DynamicPath before,after;
+    path.Split(cycleTime,before,after);
+    t += cycleTime;
+    rrtPlanner.SetTime(t);
+    if(rrtPlanner.RerootTree(offPath)) {
+      printf("Cycle %d: the RRT was re-rooted at a start off the returned path\n",cycle);
+      ok = false;
+      break;
+    }
+    if(!rrtPlanner.RerootTree(after)) {
+      printf("Cycle %d: the RRT was not re-rooted at a start on the returned path\n",cycle);
+      ok = false;
+    }
+    else {
+      numReused++;
+      const vector<RRTPlanner::Node*>& nodes = rrtPlanner.existingNodes;
+      Vector q0,q1;
+      q0.setRef(nodes.front()->x,0,1,nodes.front()->x.n/2);
+      q1.setRef(nodes.back()->x,0,1,nodes.back()->x.n/2);
+      if(nodes.size() != after.ramps.size()+1 || nodes.front() != rrtPlanner.rrt->milestones[0] ||
+         !q0.isEqual(Vector(after.ramps.front().x0),1e-5) ||
+         !q1.isEqual(Vector(after.ramps.back().x1),1e-5)) {
+        printf("Cycle %d: the RRT does not follow the remaining path\n",cycle);
+        ok = false;
+      }
+    }
+    path = after;
+  }
+  printf("Re-rooted the RRT on %d cycles, %g s, final cost %g\n",numReused,timer.ElapsedTime(),rrtPlanner.EvaluatePathCost(path,t));
+  return ok;
+}
+
+bool TestFeasibilityCache(SingleRobotCSpace& cspace,int numConfigs,int numRepeats,Real radius)
+{
+  vector<Config> configs;
+  for(int i=0;i<numConfigs;i++) {
+    Config x;
+    cspace.Sample(x);
+    configs.push_back(x);
+    for(int j=0;j<numRepeats;j++) {
+      Config y;
+      cspace.SampleNeighborhood(x,radius,y);
+      configs.push_back(y);
+    }
+  }
+  cspace.EnableFeasibilityCache(0);
+  Timer timer;
+  vector<bool> feasible(configs.size());
+  for(size_t i=0;i<configs.size();i++)
+    feasible[i] = cspace.IsFeasible(configs[i]);
+  Real tserial = timer.ElapsedTime();
+
+  cspace.EnableFeasibilityCache();
+  timer.Reset();
+  int numDisagree = 0,numMissDisagree = 0;
+  for(size_t i=0;i<configs.size();i++) {
+    int numMisses = cspace.feasibilityCache->numMisses;
+    if(cspace.IsFeasible(configs[i]) != feasible[i]) {
+      numDisagree++;
+      if(cspace.feasibilityCache->numMisses != numMisses) numMissDisagree++;
+    }
+  }
+  Real tcached = timer.ElapsedTime();
+  printf("Uncached: %g s, cached: %g s for %d configurations\n",tserial,tcached,(int)configs.size());
+  printf("Hit rate %g, %d disagreements with the uncached results\n",cspace.feasibilityCache->HitRate(),numDisagree);
+  if(numMissDisagree > 0)
+    printf("  Error, %d cache misses disagree with the uncached results\n",numMissDisagree);
+  cspace.EnableFeasibilityCache(0);
+  return numMissDisagree == 0;
+}
+
+bool TestBroadPhaseQueries(SingleRobotCSpace& cspace,int numConfigs)
+{
+  RobotWorld& world = cspace.world;
+  WorldPlannerSettings& settings = *cspace.settings;
+  Robot* robot = cspace.GetRobot();
+  vector<int> idrobot(1,world.RobotID(cspace.index)),idothers;
+  for(size_t i=0;i<world.terrains.size();i++)
+    idothers.push_back(world.TerrainID(i));
+  for(size_t i=0;i<world.rigidObjects.size();i++)
+    idothers.push_back(world.RigidObjectID(i));
+  for(size_t i=0;i<world.robots.size();i++)
+    if((int)i != cspace.index) idothers.push_back(world.RobotID(i));
+  world.UpdateGeometry();
+  vector<Geometry::AnyCollisionGeometry3D*> geoms;
+  vector<int> ids;
+  GetGeometries(world,idrobot,geoms,ids);
+  size_t n1 = geoms.size();
+  GetGeometries(world,idothers,geoms,ids);
+  if(n1 == 0 || n1 == geoms.size()) {
+    printf("Robot %d or its environment has no geometry\n",cspace.index);
+    return false;
+  }
+  vector<Config> configs(numConfigs);
+  for(int i=0;i<numConfigs;i++)
+    cspace.Sample(configs[i]);
+
+  //brute force over all enabled pairs
+  vector<bool> collides(numConfigs);
+  vector<Real> dist(numConfigs);
+  Timer timer;
+  for(int k=0;k<numConfigs;k++) {
+    robot->UpdateConfig(configs[k]);
+    robot->UpdateGeometry();
+    collides[k] = false;
+    for(size_t i=0;i<n1 && !collides[k];i++)
+      for(size_t j=n1;j<geoms.size();j++) {
+	if(!settings.collisionEnabled(ids[i],ids[j]) && !settings.collisionEnabled(ids[j],ids[i])) continue;
+	Geometry::AnyCollisionQuery q(*geoms[i],*geoms[j]);
+	if(q.Collide()) { collides[k] = true; break; }
+      }
+  }
+  Real tbruteCollision = timer.ElapsedTime();
+  timer.Reset();
+  for(int k=0;k<numConfigs;k++) {
+    robot->UpdateConfig(configs[k]);
+    robot->UpdateGeometry();
+    dist[k] = Inf;
+    for(size_t i=0;i<n1;i++)
+      for(size_t j=n1;j<geoms.size();j++) {
+	if(!settings.collisionEnabled(ids[i],ids[j])) continue;
+	Geometry::AnyCollisionQuery q(*geoms[i],*geoms[j]);
+	dist[k] = Min(dist[k],q.Distance(0.0,0.0,dist[k]));
+      }
+  }
+  Real tbruteDistance = timer.ElapsedTime();
+  printf("Brute force: %g s for collisions, %g s for distances, %d configurations, %d x %d geometries\n",tbruteCollision,tbruteDistance,numConfigs,(int)n1,(int)(geoms.size()-n1));
+
+  const char* names[2] = {"Fresh cache","Kept cache"};
+  bool ok = true;
+  WorldBroadPhaseCache keptCache;
+  for(int pass=0;pass<2;pass++) {
+    int numCollisionDiffs = 0,numDistanceDiffs = 0;
+    timer.Reset();
+    for(int k=0;k<numConfigs;k++) {
+      robot->UpdateConfig(configs[k]);
+      robot->UpdateGeometry();
+      WorldBroadPhaseCache freshCache;
+      WorldBroadPhaseCache& cache = (pass == 0 ? freshCache : keptCache);
+      if((settings.CheckCollision(cache,geoms,ids,n1).first >= 0) != collides[k]) numCollisionDiffs++;
+    }
+    Real tcollision = timer.ElapsedTime();
+    timer.Reset();
+    int numRefits = keptCache.numRefits;
+    for(int k=0;k<numConfigs;k++) {
+      robot->UpdateConfig(configs[k]);
+      robot->UpdateGeometry();
+      WorldBroadPhaseCache freshCache;
+      WorldBroadPhaseCache& cache = (pass == 0 ? freshCache : keptCache);
+      Real d = settings.DistanceLowerBound(cache,geoms,ids,n1);
+      if(Abs(d-dist[k]) > 1e-8*Max(Real(1),Abs(dist[k]))) numDistanceDiffs++;
+    }
+    Real tdistance = timer.ElapsedTime();
+    printf("%s: %g s for collisions, %g s for distances",names[pass],tcollision,tdistance);
+    if(pass == 1) printf(", %g refits per distance query",Real(keptCache.numRefits-numRefits)/numConfigs);
+    printf("\n");
+    if(numCollisionDiffs > 0 || numDistanceDiffs > 0) {
+      printf("  Error, %d collision and %d distance results differ from brute force\n",numCollisionDiffs,numDistanceDiffs);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool TestSpinJointDistance(SingleRobotCSpace& cspace,int numConfigs)
+{
+  Robot* robot = cspace.GetRobot();
+  vector<int> angles;
+  for(size_t i=0;i<robot->joints.size();i++)
+    if(robot->joints[i].type == RobotJoint::Spin)
+      angles.push_back(robot->joints[i].linkIndex);
+  sort(angles.begin(),angles.end());
+  if(angles.empty()) {
+    printf("Robot %d has no spin joints\n",cspace.index);
+    return true;
+  }
+  const Vector& w = cspace.settings->robotSettings[cspace.index].distanceWeights;
+  Vector weights(robot->q.n,One);
+  if(w.n != 0) weights = w;
+  WeightedInfNNMetric metric(weights,angles);
+  int numTurnErrors = 0,numMidpointErrors = 0,numMetricErrors = 0;
+  Config x,y,z,mid;
+  for(int k=0;k<numConfigs;k++) {
+    cspace.Sample(x);
+    y = x;
+    for(size_t i=0;i<angles.size();i++)
+      y(angles[i]) = x(angles[i]) + Rand(-3.0,3.0)*Pi;
+    Real d = cspace.Distance(x,y);
+    //extra turns don't change the distance
+    z = y;
+    for(size_t i=0;i<angles.size();i++)
+      z(angles[i]) += 2*Pi*(RandInt(5)-2);
+    if(Abs(cspace.Distance(x,z)-d) > 1e-6) numTurnErrors++;
+    //the distance is the length of the interpolated edge
+    cspace.Interpolate(x,y,0.5,mid);
+    if(Abs(cspace.Distance(x,mid)-0.5*d) > 1e-6 || Abs(cspace.Distance(mid,y)-0.5*d) > 1e-6) numMidpointErrors++;
+    if(Abs(metric.Distance(x,y)-d) > 1e-6) numMetricErrors++;
+  }
+  printf("%d spin joints, %d configurations: %d turn, %d midpoint, and %d metric errors\n",(int)angles.size(),numConfigs,numTurnErrors,numMidpointErrors,numMetricErrors);
+  return numTurnErrors == 0 && numMidpointErrors == 0 && numMetricErrors == 0;
+}
+
+bool TestNearestNeighborIndex(SingleRobotCSpace& cspace,int numConfigs,int numQueries)
+{
+  SmartPointer<NNMetric> metric = new CSpaceNNMetric(&cspace);
+  GNATIndex gnat(metric);
+  BruteForceNNIndex brute(metric);
+  vector<Config> configs(numConfigs);
+  for(int i=0;i<numConfigs;i++) {
+    cspace.Sample(configs[i]);
+    gnat.Insert(configs[i],&configs[i]);
+    brute.Insert(configs[i],&configs[i]);
+  }
+  for(int i=0;i<numConfigs;i+=3) {
+    gnat.Remove(&configs[i]);
+    brute.Remove(&configs[i]);
+  }
+  vector<Config> queries(numQueries);
+  for(int i=0;i<numQueries;i++)
+    cspace.Sample(queries[i]);
+  gnat.numDistanceEvaluations = brute.numDistanceEvaluations = 0;
+  Timer timer;
+  vector<Real> dbrute(numQueries);
+  for(int i=0;i<numQueries;i++)
+    brute.Nearest(queries[i],dbrute[i]);
+  Real tbrute = timer.ElapsedTime();
+  timer.Reset();
+  int numDisagree = 0;
+  for(int i=0;i<numQueries;i++) {
+    Real d;
+    gnat.Nearest(queries[i],d);
+    if(d != dbrute[i]) numDisagree++;
+  }
+  Real tgnat = timer.ElapsedTime();
+  printf("Brute force: %g s, %d distances; GNAT: %g s, %d distances for %d queries on %d points\n",tbrute,brute.numDistanceEvaluations,tgnat,gnat.numDistanceEvaluations,numQueries,(int)gnat.Size());
+  printf("%d disagreements with brute force\n",numDisagree);
+  return numDisagree == 0;
+}
+
+bool TestTimeScalingSolvers(Robot& robot,const char* pathFile,int maxBisections)
+{
+  ifstream in(pathFile,ios::in);
+  if(!in) {
+    fprintf(stderr,"TestTimeScalingSolvers: could not open %s\n",pathFile);
+    return false;
+  }
+  const char* ext = FileExtension(pathFile);
+  bool timed = (ext == NULL || 0 != strcmp(ext,"milestones"));
+  vector<Real> times;
+  vector<Config> milestones;
+  while(in) {
+    Real t=0;
+    Config q;
+    if(timed) in >> t;
+    in >> q;
+    if(!in) break;
+    times.push_back(t);
+    milestones.push_back(q);
+  }
+  if(milestones.size() < 2) {
+    fprintf(stderr,"TestTimeScalingSolvers: read fewer than 2 milestones from %s\n",pathFile);
+    return false;
+  }
+  GeneralizedCubicBezierSpline path;
+  if(timed) MonotonicInterpolate(milestones,times,path);
+  else MonotonicInterpolate(milestones,path);
+  printf("Read %d milestones from %s\n",(int)milestones.size(),pathFile);
+
+  Vector amin = -1.0*robot.accMax;
+  const char* names[2] = {"SLP","Reachability"};
+  TimeScaling::Solver solvers[2] = {TimeScaling::SLP,TimeScaling::Reachability};
+  bool ok = true;
+  for(int k=0;k<=maxBisections;k++) {
+    if(k > 0) {
+      GeneralizedCubicBezierSpline refined;
+      for(size_t i=0;i<path.segments.size();i++) {
+        GeneralizedCubicBezierCurve c1,c2;
+        path.segments[i].Bisect(c1,c2);
+        refined.segments.push_back(c1);
+        refined.segments.push_back(c2);
+        refined.durations.push_back(path.durations[i]*0.5);
+        refined.durations.push_back(path.durations[i]*0.5);
+      }
+      swap(path,refined);
+    }
+    int n = (int)path.segments.size();
+    //interval derivative bounds for the overload that reports active limits
+    vector<Real> divs(n+1);
+    vector<Vector> dxmins(n),dxmaxs(n),ddxmins(n),ddxmaxs(n);
+    divs[0] = 0;
+    for(int i=0;i<n;i++) {
+      divs[i+1] = divs[i]+path.durations[i];
+      path.segments[i].GetDerivBounds(dxmins[i],dxmaxs[i],ddxmins[i],ddxmaxs[i]);
+      dxmins[i] /= path.durations[i];
+      dxmaxs[i] /= path.durations[i];
+      ddxmins[i] /= Sqr(path.durations[i]);
+      ddxmaxs[i] /= Sqr(path.durations[i]);
+    }
+    Real tsolve[2],duration[2],tbounds[2];
+    bool optimal = false;
+    vector<Real> ds[2];
+    vector<pair<int,int> > velLimited[2],accLimited[2];
+    for(int s=0;s<2;s++) {
+      TimeScaling scaling;
+      Timer timer;
+      bool res = scaling.SolveMinTime(robot.velMin,robot.velMax,amin,robot.accMax,path,0.0,0.0,solvers[s]);
+      tsolve[s] = timer.ElapsedTime();
+      duration[s] = (res ? scaling.times.back() : Inf);
+      if(solvers[s] == TimeScaling::Reachability) optimal = scaling.reachabilityOptimal;
+      ds[s] = scaling.ds;
+      timer.Reset();
+      res = scaling.SolveMinTime(robot.velMin,robot.velMax,amin,robot.accMax,divs,dxmins,dxmaxs,ddxmins,ddxmaxs,0.0,0.0,&velLimited[s],&accLimited[s],solvers[s]);
+      tbounds[s] = timer.ElapsedTime();
+      if(!res) {
+        velLimited[s].resize(0);
+        accLimited[s].resize(0);
+      }
+    }
+    Real dsdiff = 0;
+    if(ds[0].size() == ds[1].size())
+      for(size_t i=0;i<ds[0].size();i++)
+        dsdiff = Max(dsdiff,Abs(ds[0][i]-ds[1][i]));
+    printf("%d segments:\n",n);
+    for(int s=0;s<2;s++)
+      printf("  %s: %g s, duration %g; interval bounds %g s, %d velocity and %d acceleration limits active\n",names[s],tsolve[s],duration[s],tbounds[s],(int)velLimited[s].size(),(int)accLimited[s].size());
+    printf("  Max difference in ds %g\n",dsdiff);
+    //reachability is exact on the same constraints that SLP iterates on,
+    //unless it reports that a limiting bound decreased with the rate
+    if(IsInf(duration[1])) {
+      printf("  Error, the reachability solver failed\n");
+      ok = false;
+    }
+    else if(duration[1] > duration[0]*(1.0+1e-3)+1e-6) {
+      if(optimal) {
+        printf("  Error, the reachability solver is slower than SLP but reports an optimal result\n");
+        ok = false;
+      }
+      else
+        printf("  The reachability solver is slower than SLP, as it may be on this grid\n");
+    }
+  }
+  return ok;
+}
+
+bool TestConstrainedInterpolation(Robot& robot,const char* pathFile,Real xtol)
+{
+  MultiPath path;
+  if(!path.Load(pathFile)) {
+    fprintf(stderr,"TestConstrainedInterpolation: could not load %s\n",pathFile);
+    return false;
+  }
+  bool ok = true;
+  Real ttotal[2] = {0,0};
+  for(size_t i=0;i<path.sections.size();i++) {
+    vector<IKGoal> goals;
+    path.GetIKProblem(goals,i);
+    if(goals.empty() || path.sections[i].milestones.size() < 2) continue;
+    printf("Section %d: %d milestones, %d IK goals\n",(int)i,(int)path.sections[i].milestones.size(),(int)goals.size());
+    bool newtonOk = false;
+    for(int k=0;k<2;k++) {
+      RobotSmoothConstrainedInterpolator interp(robot,goals);
+      interp.ftol = xtol*1e-2;
+      interp.xtol = xtol;
+      interp.reuseJacobians = (k==1);
+      GeneralizedCubicBezierSpline spline;
+      Timer timer;
+      bool res = MultiSmoothInterpolate(interp,path.sections[i].milestones,spline);
+      Real t = timer.ElapsedTime();
+      ttotal[k] += t;
+      if(!res) {
+        printf("  %s: failed after %g s\n",(k==0?"Newton":"Broyden"),t);
+        if(newtonOk) ok = false;
+        continue;
+      }
+      Real maxErr = 0;
+      Vector err;
+      for(size_t j=0;j<spline.segments.size();j++) {
+        interp.ConstraintValue(spline.segments[j].x3,err);
+        maxErr = Max(maxErr,err.maxAbsElement());
+      }
+      if(k==0)
+        printf("  Newton: %g s, %d segments, max error %g\n",t,(int)spline.segments.size(),maxErr);
+      else
+        printf("  Broyden: %g s, %d segments, max error %g, %d projections, %d fallbacks, %g iterations per projection\n",t,(int)spline.segments.size(),maxErr,interp.projector.numSolves,interp.projector.numFailures,Real(interp.projector.numIters)/Max(interp.projector.numSolves,1));
+      if(maxErr > interp.ftol) {
+        printf("  Error, a milestone violates the constraints by more than %g\n",interp.ftol);
+        ok = false;
+      }
+      else if(k==0) newtonOk = true;
+    }
+  }
+  printf("Total time: Newton %g s, Broyden %g s\n",ttotal[0],ttotal[1]);
+  return ok;
+}
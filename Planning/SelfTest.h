@@ -12,5 +12,96 @@ void TestShortcutting(SingleRobotCSpace* cspace,MotionPlannerFactory& plannerFac
 //tests the anytime shortcutting procedure
 void TestDynamicShortcutting(SingleRobotCSpace& freeSpace,const ParabolicRamp::DynamicPath& porig);
 
+//compares DynamicPath::Shortcut against ParallelShortcut with
+//1,2,4,...,maxThreads threads, and checks that ParallelShortcut gives the
+//same result on repeated runs with the same seed
+void TestParallelShortcutting(SingleRobotCSpace& cspace,const ParabolicRamp::DynamicPath& porig,int numIters,int maxThreads);
+
+//compares DynamicPath::Evaluate at numTimes evenly spaced times against
+//EvaluateBatch, reporting the timings and the largest difference.  Returns
+//false if they differ by more than 1e-8.
+bool TestBatchEvaluation(const ParabolicRamp::DynamicPath& path,int numTimes);
+
+//compares serial feasibility checking of randomly sampled configurations
+//against ParallelIsFeasible with 1,2,4,...,maxThreads threads.  Returns
+//false if any result differs.
+bool TestParallelFeasibility(SingleRobotCSpace& cspace,int numConfigs,int maxThreads);
+
+//compares the edges validated per second by BisectionEpsilonEdgePlanner
+//and ParallelEdgeChecker with 2,4,...,maxThreads threads, on random edges
+//of the given length.  Returns false if any result differs.
+bool TestParallelEdgeChecking(SingleRobotCSpace& cspace,int numEdges,Real radius,int maxThreads);
+
+//compares the queries per edge made by BisectionEpsilonEdgePlanner and
+//ConservativeAdvancementEdgePlanner on random edges of the given length.
+//The exact planner may reject edges that bisection accepts, but not the
+//reverse unless it bisected part of the edge itself; returns false if it
+//does.
+bool TestConservativeAdvancement(SingleRobotCSpace& cspace,int numEdges,Real radius);
+
+//plans between numQueries pairs of random feasible configurations with
+//LazyRoadmapPlanner in PRM and RRT modes, up to maxIters iterations each,
+//in the space's lazy mode.  Returns false if any solution path fails an
+//uncached recheck.
+bool TestLazyPlanning(SingleRobotCSpace& cspace,int numQueries,int maxIters);
+
+//plans toward a random feasible configuration with DynamicHybridTreePlanner
+//for numCycles cycles of cycleTime, moving the start along the returned
+//path between cycles as the robot would.  Checks that the tree is re-rooted
+//at each new start with node times and states that agree with their edges
+//and only the root marked reachable, and that a start off the returned path
+//is not re-rooted.  Then does the same with DynamicRRTPlanner, checking
+//that its new tree follows the remaining path.  Returns false if any check
+//fails.
+bool TestTreeReuse(SingleRobotCSpace& cspace,int numCycles,Real cycleTime);
+
+//checks numConfigs random configurations, then numRepeats perturbations of
+//each within the given radius, with and without the feasibility cache, and
+//reports the speedup, hit rate, and disagreements with the uncached results.
+//Cache hits may disagree where a grid cell straddles an obstacle boundary,
+//but misses are checked directly.  Returns false if a miss disagrees.
+bool TestFeasibilityCache(SingleRobotCSpace& cspace,int numConfigs,int numRepeats,Real radius);
+
+//checks robot 0 against the rest of the world at numConfigs random
+//configurations by brute force over all enabled geometry pairs, and with
+//the broad phase using a fresh WorldBroadPhaseCache per query and one kept
+//across queries.  Reports the timings of the collision and distance
+//queries, and returns false if the broad phase results differ from brute
+//force.
+bool TestBroadPhaseQueries(SingleRobotCSpace& cspace,int numConfigs);
+
+//inserts numConfigs random configurations into a GNATIndex and a
+//BruteForceNNIndex using the cspace's distance, removes every third one,
+//and compares the timing and results of numQueries nearest queries.
+//Returns false if any nearest distance differs.
+bool TestNearestNeighborIndex(SingleRobotCSpace& cspace,int numConfigs,int numQueries);
+
+//checks on numConfigs random pairs of configurations that differ only in
+//robot 0's spin joints that SingleRobotCSpace::Distance is unchanged by
+//turns of 2pi, that it halves at the midpoint given by Interpolate, which
+//takes the short way around, and that WeightedInfNNMetric with the spin
+//joints as angles agrees with it.  Returns false if any check fails;
+//passes trivially if the robot has no spin joints.
+bool TestSpinJointDistance(SingleRobotCSpace& cspace,int numConfigs);
+
+//time-scales the milestones in pathFile (a .milestones file, or a file of
+//timed milestones such as data/motions/athlete_flex.path) under the robot's
+//velocity and acceleration bounds, comparing the SLP and Reachability
+//solvers of TimeScaling on the interpolating spline and on grids refined by
+//1,...,maxBisections bisections.  Reports the solve times, the trajectory
+//durations, and the limits each solver reports as active.  Returns false if
+//the file can't be read, if the Reachability solver fails, or if it gives a
+//longer duration than SLP while reporting its result as optimal.
+bool TestTimeScalingSolvers(Robot& robot,const char* pathFile,int maxBisections);
+
+//interpolates each constrained section of the MultiPath in pathFile (e.g.
+//data/motions/hubo_sway_path.xml) at resolution xtol with
+//RobotSmoothConstrainedInterpolator, with and without reuseJacobians.
+//Reports the times, the number of segments, the Broyden projections and
+//fallbacks to the Newton solver, and the largest constraint error.
+//Returns false if the file can't be read, or if a section interpolated
+//with Newton projections fails with reuseJacobians or exceeds the
+//constraint tolerance.
+bool TestConstrainedInterpolation(Robot& robot,const char* pathFile,Real xtol);
 
 #endif
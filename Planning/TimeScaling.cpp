@@ -11,7 +11,12 @@
 #include "Modeling/SplineInterpolate.h"
 #include "RobotCSpace.h"
 #include <KrisLibrary/errors.h>
+#include <KrisLibrary/utils/threadutils.h>
 #include <fstream>
+#include <algorithm>
+#if HAVE_GLPK
+#include <glpk.h>
+#endif //HAVE_GLPK
 using namespace Math3D;
 using namespace Optimization;
 
@@ -207,6 +212,27 @@ bool GetActiveBounds(Vector2& l,Vector2& u,const Vector& ax,const Vector& ay,con
 }
 
 
+/** @brief Holds CustomTimeScaling::lpMutex from Lock() until it's destroyed,
+ * unless GLPK environments are thread-local.
+ *
+ * Declare it before the GLPKInterface it guards, so that the GLPK problem
+ * is deleted before the mutex is released.
+ */
+class LPLock
+{
+public:
+  LPLock() : locked(false) {}
+  ~LPLock() { if(locked) CustomTimeScaling::lpMutex.unlock(); }
+  void Lock()
+  {
+    if(locked || CustomTimeScaling::LPReentrant()) return;
+    CustomTimeScaling::lpMutex.lock();
+    locked = true;
+  }
+
+  bool locked;
+};
+
 /** @brief Defines a sequential linear program (SLP) for minimizing time over
  * squared-rate variables x[i] = ds/dt(si)^2.
  *
@@ -232,6 +258,11 @@ public:
 
   //call this to solve the problem
   bool Solve(int& maxIters,Real xtol=1e-5,Real ftol=1e-5);
+  //alternative to Solve that uses reachability analysis: a backward pass
+  //computes the interval of x[i] from which x[n] can be reached, then a
+  //forward pass takes the largest reachable x[i+1] given x[i].  Linear time
+  //in the number of variables, no LP solves.
+  bool SolveReachability(Real tol=1e-7);
   bool SolveCustom(ScalarFieldFunction* f,int& maxIters,Real xtol=1e-5,Real ftol=1e-5);
   const vector<Real>& GetVelocities() const { return ds; }
 
@@ -243,6 +274,8 @@ public:
   void ComputeObjective(const Config& x);
   //after ComputeObjective, computes the gradient and puts it in lp.c
   void ComputeGradient();
+  //gets the constraints on segment i as halfplanes h.x*x[i] + h.y*x[i+1] <= h.z
+  void GetSegmentHalfplanes(int i,vector<Vector3>& h);
 
   //debugging
   void CheckSolution();
@@ -258,13 +291,73 @@ public:
   const vector<Real>& paramdivs;
   LinearProgram_Sparse lp;
   vector<pair<int,int> > segToConstraints;
-  //filled out after Solve
+  //filled out after Solve.  lpLock is taken by InitializeGLPK.
+  LPLock lpLock;
   GLPKInterface glpk;
   Vector x;
   vector<Real> ds;
   Real T;
+  //if set, Solve starts from this point rather than from the velocity
+  //bounds, provided that it's feasible
+  Vector warmStart;
+  //if set, InitializeGLPK takes the starting basis from a previous solve,
+  //given as by GetLimitingConstraints.  Segments with no active constraints
+  //listed fall back to guessing the basis from x.
+  vector<int> basisVelocityLimited;
+  vector<vector<int> > basisActiveConstraints;
+  //filled out after SolveReachability, which doesn't have an LP basis.
+  //reachOptimal is true if the bound that limited each x[i+1] in the
+  //forward pass doesn't decrease with x[i], which makes the result optimal.
+  bool reachability,reachOptimal;
+  vector<int> reachVelocityLimited;
+  vector<vector<int> > reachActiveConstraints;
 };
 
+///Adds the constraints of the colocation points i and i+1 to segment k of
+///slp.  Returns the number of constraints before pruning, or -1 if they are
+///infeasible.
+int AddSegmentConstraints(TimeScalingSLP& slp,int k,int i,
+			  const vector<Real>& paramDivs,
+			  const vector<vector<Vector2> >& ds2ddsConstraintNormals,
+			  const vector<vector<Real> >& ds2ddsConstraintOffsets)
+{
+  //find the coefficients of the pair ds^2[i], ds^2[i+1]
+  //the start of the interval is constrained by ds2dds[i] and
+  //uses the values of ds^2[i], dds[i] = f(ds^2[i], ds^2[i+1])
+  //the end of the interval is constrained by ds2dds[i+1] and is affected by 
+  //ds^2[i+1] and dds[i]  = f(ds^2[i], ds^2[i+1])
+  bool interior = (i+2 < (int)paramDivs.size());
+  int nc = ds2ddsConstraintNormals[i].size();
+  if(interior)
+    nc += ds2ddsConstraintNormals[i+1].size();
+  Vector ai(nc),an(nc),b(nc);
+  int m=0;
+  Real scale = 0.5/(paramDivs[i+1]-paramDivs[i]);
+  for(size_t j=0;j<ds2ddsConstraintNormals[i].size();j++,m++) {
+    ai(m) = ds2ddsConstraintNormals[i][j].x - ds2ddsConstraintNormals[i][j].y*scale;
+    an(m) = ds2ddsConstraintNormals[i][j].y*scale;
+    b(m) = ds2ddsConstraintOffsets[i][j];
+  }
+  if(interior) {
+    for(size_t j=0;j<ds2ddsConstraintNormals[i+1].size();j++,m++) {
+      ai(m) = -ds2ddsConstraintNormals[i+1][j].y*scale;
+      an(m) = ds2ddsConstraintNormals[i+1][j].x + ds2ddsConstraintNormals[i+1][j].y*scale;
+      b(m) = ds2ddsConstraintOffsets[i+1][j];
+    }
+  }
+  Assert(m==nc);
+  /*
+  //TEST: add all bounds, don't do pruning
+  for(int j=0;j<nc;j++)
+    slp.AddVel2Bound(k,ai[j],an[j],b[j]);
+  */
+  if(!slp.AddVel2Bounds(k,ai,an,b)) {
+    printf("SLP bounds were found to be infeasible on segment %d\n",i);
+    return -1;
+  }
+  return nc;
+}
+
 ///Given a grid and a list of constraint normals and offsets in the ds2-dds
 ///plane, solves for the time scaling of the given trajectory 
 ///
@@ -274,14 +367,17 @@ public:
 ///sime scaling
 ///
 ///if variableLagrangeMultipliers and constraintLagrangeMultipliers are given,
-///the lagrange multipliers are returned on success.
+///the lagrange multipliers are returned on success.  Likewise for the
+///basis of the solution, given as by TimeScalingSLP::GetLimitingConstraints.
 bool SolveSLP(const vector<Real>& paramDivs,
 	      const vector<Real>& dsmaxs,
 	      const vector<vector<Vector2> >& ds2ddsConstraintNormals,
 	      const vector<vector<Real> >& ds2ddsConstraintOffsets,
 	      TimeScaledBezierCurve& traj,
         vector<Real>* variableLagrangeMultipliers=NULL,
-        vector<vector<Real > >* constraintLagrangeMultipliers=NULL)
+        vector<vector<Real > >* constraintLagrangeMultipliers=NULL,
+        vector<int>* velocityLimitedVariables=NULL,
+        vector<vector<int> >* activeSegmentConstraints=NULL)
 {
   Assert(ds2ddsConstraintNormals.size()==paramDivs.size());
   Assert(ds2ddsConstraintOffsets.size()==paramDivs.size());
@@ -290,50 +386,9 @@ bool SolveSLP(const vector<Real>& paramDivs,
     slp.SetVelBound(i,dsmaxs[i]);
   int numTotalConstraints = 0;
   for(size_t i=0;i+1<paramDivs.size();i++) {
-    //find the coefficients of the pair ds^2[i], ds^2[i+1]
-    //the start of the interval is constrained by ds2dds[i] and
-    //uses the values of ds^2[i], dds[i] = f(ds^2[i], ds^2[i+1])
-    //the end of the interval is constrained by ds2dds[i+1] and is affected by 
-    //ds^2[i+1] and dds[i]  = f(ds^2[i], ds^2[i+1])
-    int nc = ds2ddsConstraintNormals[i].size();
-    if(i+2<paramDivs.size())
-      nc += ds2ddsConstraintNormals[i+1].size();
-    Vector ai(nc),an(nc),b(nc);
-    int k=0;
-    Real scale = 0.5/(paramDivs[i+1]-paramDivs[i]);
-    for(size_t j=0;j<ds2ddsConstraintNormals[i].size();j++,k++) {
-      ai(k) = ds2ddsConstraintNormals[i][j].x - ds2ddsConstraintNormals[i][j].y*scale;
-      an(k) = ds2ddsConstraintNormals[i][j].y*scale;
-      b(k) = ds2ddsConstraintOffsets[i][j];
-    }
-    if(i+2 < paramDivs.size()) {
-      //Real scale = 0.5/(paramDivs[i+1]-paramDivs[i]);
-      for(size_t j=0;j<ds2ddsConstraintNormals[i+1].size();j++,k++) {
-	ai(k) = -ds2ddsConstraintNormals[i+1][j].y*scale;
-	an(k) = ds2ddsConstraintNormals[i+1][j].x + ds2ddsConstraintNormals[i+1][j].y*scale;
-	b(k) = ds2ddsConstraintOffsets[i+1][j];
-      }
-    }
+    int nc = AddSegmentConstraints(slp,i,i,paramDivs,ds2ddsConstraintNormals,ds2ddsConstraintOffsets);
+    if(nc < 0) return false;
     numTotalConstraints += nc;
-    Assert(k==nc);
-    /*
-    //TEST: add all bounds, don't do pruning
-    for(int j=0;j<nc;j++)
-      slp.AddVel2Bound(i,ai[j],an[j],b[j]);
-    */
-    if(!slp.AddVel2Bounds(i,ai,an,b)) {
-      printf("SLP bounds were found to be infeasible on segment %d\n",i);
-      return false;
-    }
-
-    /*
-    cout<<i<<" vmax "<<dsmaxs[i]<<endl;
-    cout<<ai<<endl;
-    cout<<an<<endl;
-    cout<<b<<endl;
-    cout<<"Total constraints: "<<slp.lp.A.m<<endl;
-    getchar();
-    */
   }
   printf("Reduced %d constraints to %d\n",numTotalConstraints,slp.lp.A.m);
   //getchar();
@@ -366,6 +421,140 @@ bool SolveSLP(const vector<Real>& paramDivs,
   if(variableLagrangeMultipliers && constraintLagrangeMultipliers) {
     slp.GetLagrangeMultipliers(*variableLagrangeMultipliers,*constraintLagrangeMultipliers);
   }
+  if(velocityLimitedVariables && activeSegmentConstraints) {
+    //GLPK isn't set up if there are no constraints
+    if(slp.lp.A.m > 0)
+      slp.GetLimitingConstraints(*velocityLimitedVariables,*activeSegmentConstraints);
+    else {
+      velocityLimitedVariables->resize(0);
+      activeSegmentConstraints->resize(0);
+    }
+  }
+  return true;
+}
+
+///Same as SolveSLP, but keeps the time scaling currently in traj up to grid
+///point istart and only solves for the rates after it, with ds[istart]
+///fixed.  The previous rates after istart warm-start the SLP when they're
+///still feasible.  The grid must match traj.timeScaling.params up to istart.
+///
+///velocityLimitedVariables and activeSegmentConstraints hold the basis of
+///the previous solve on the whole grid, which warm-starts GLPK.  Only
+///segments whose constraints are unchanged should be listed.  On success
+///they're replaced by the basis of the new solution, keeping the entries
+///before istart.
+///
+///The result is optimal for the suffix, but not necessarily for the whole
+///path: if the kept rates were held back by the constraints after istart,
+///an edit that loosens them allows a faster start.  fasterStart is set to
+///true if a larger ds[istart] would shorten the suffix and is within its
+///velocity bound, in which case a full re-solve may be faster.
+bool SolveSLPSuffix(int istart,
+		    const vector<Real>& paramDivs,
+		    const vector<Real>& dsmaxs,
+		    const vector<vector<Vector2> >& ds2ddsConstraintNormals,
+		    const vector<vector<Real> >& ds2ddsConstraintOffsets,
+		    TimeScaledBezierCurve& traj,
+		    vector<int>& velocityLimitedVariables,
+		    vector<vector<int> >& activeSegmentConstraints,
+		    bool& fasterStart,
+		    vector<Real>* variableLagrangeMultipliers=NULL,
+		    vector<vector<Real > >* constraintLagrangeMultipliers=NULL)
+{
+  fasterStart = false;
+  Assert(ds2ddsConstraintNormals.size()==paramDivs.size());
+  Assert(ds2ddsConstraintOffsets.size()==paramDivs.size());
+  Assert(istart > 0 && istart+1 < (int)paramDivs.size());
+  const vector<Real>& dsprev = traj.timeScaling.ds;
+  Assert((int)dsprev.size() > istart);
+  int n = (int)paramDivs.size()-1;
+  vector<Real> divs(paramDivs.begin()+istart,paramDivs.end());
+  TimeScalingSLP slp(divs);
+  for(int i=istart;i<(int)dsmaxs.size();i++) 
+    slp.SetVelBound(i-istart,dsmaxs[i]);
+  slp.SetFixed(0,dsprev[istart]);
+  int numTotalConstraints = 0;
+  for(int i=istart;i<n;i++) {
+    int nc = AddSegmentConstraints(slp,i-istart,i,paramDivs,ds2ddsConstraintNormals,ds2ddsConstraintOffsets);
+    if(nc < 0) return false;
+    numTotalConstraints += nc;
+  }
+  printf("Reduced %d constraints to %d on grid points %d to %d\n",numTotalConstraints,slp.lp.A.m,istart,n);
+  if((int)dsprev.size() == n+1) {
+    slp.warmStart.resize(n+1-istart);
+    for(int i=istart;i<=n;i++)
+      slp.warmStart(i-istart) = Sqr(dsprev[i]);
+  }
+  //the segment from istart is pruned against the fixed rate rather than the
+  //velocity bound, so its constraint indices may differ from the last solve
+  for(size_t i=0;i<velocityLimitedVariables.size();i++)
+    if(velocityLimitedVariables[i] > istart)
+      slp.basisVelocityLimited.push_back(velocityLimitedVariables[i]-istart);
+  if((int)activeSegmentConstraints.size() > istart+1) {
+    slp.basisActiveConstraints.resize(activeSegmentConstraints.size()-istart);
+    for(size_t i=istart+1;i<activeSegmentConstraints.size();i++)
+      slp.basisActiveConstraints[i-istart] = activeSegmentConstraints[i];
+  }
+
+  int maxIters = SLP_SOLVE_ITERS;
+  bool res = slp.Solve(maxIters);
+  if(!res) {
+    return false;
+  }
+  //output the trajectory
+  TimeScaling& ts = traj.timeScaling;
+  ts.params.resize(paramDivs.size());
+  copy(paramDivs.begin(),paramDivs.end(),ts.params.begin());
+  ts.times.resize(ts.params.size());
+  ts.ds.resize(ts.params.size());
+  const vector<Real>& ds = slp.GetVelocities();
+  for(int i=istart;i<=n;i++)
+    ts.ds[i] = ds[i-istart];
+  for(int i=istart;i<n;i++) {
+    Real dt = 2*(paramDivs[i+1]-paramDivs[i])/(ts.ds[i]+ts.ds[i+1]);
+    ts.times[i+1]=ts.times[i]+dt;
+  }
+  traj.pathSegments.resize(traj.path.durations.size()+1);
+  traj.pathSegments[0] = 0;
+  for(size_t i=0;i<traj.path.durations.size();i++)
+    traj.pathSegments[i+1] = traj.pathSegments[i]+traj.path.durations[i];
+
+  if(variableLagrangeMultipliers && constraintLagrangeMultipliers) {
+    vector<Real> vlm;
+    vector<vector<Real> > clm;
+    slp.GetLagrangeMultipliers(vlm,clm);
+    variableLagrangeMultipliers->resize(n+1,0.0);
+    constraintLagrangeMultipliers->resize(n);
+    for(int i=istart;i<=n;i++)
+      (*variableLagrangeMultipliers)[i] = vlm[i-istart];
+    for(int i=istart;i<n;i++)
+      (*constraintLagrangeMultipliers)[i] = clm[i-istart];
+  }
+
+  //keep the basis before istart and replace the rest
+  size_t nkeep = 0;
+  for(size_t i=0;i<velocityLimitedVariables.size();i++)
+    if(velocityLimitedVariables[i] < istart)
+      velocityLimitedVariables[nkeep++] = velocityLimitedVariables[i];
+  velocityLimitedVariables.resize(nkeep);
+  activeSegmentConstraints.resize(n);
+  for(int i=istart;i<n;i++)
+    activeSegmentConstraints[i].resize(0);
+  //GLPK isn't set up if there are no constraints
+  if(slp.lp.A.m > 0) {
+    vector<int> vl;
+    vector<vector<int> > ac;
+    slp.GetLimitingConstraints(vl,ac);
+    for(size_t i=0;i<vl.size();i++)
+      velocityLimitedVariables.push_back(vl[i]+istart);
+    //segment istart was pruned differently, see above
+    for(int i=istart+1;i<n;i++)
+      activeSegmentConstraints[i].swap(ac[i-istart]);
+    //x[0] is nonbasic, so its reduced cost is the change in the suffix
+    //time per unit increase of ds[istart]^2
+    if(istart < (int)dsmaxs.size() && ts.ds[istart] < dsmaxs[istart]*(1.0-1e-6))
+      fasterStart = (slp.glpk.GetVariableDual(0) < -1e-6*Abs(slp.lp.c(0)));
+  }
   return true;
 }
 
@@ -380,10 +569,17 @@ TimeScalingSLP::TimeScalingSLP(const vector<Real>& _paramdivs)
   fill(segToConstraints.begin(),segToConstraints.end(),pair<int,int>(-1,-1));
   ds.resize(n+1,0.0);
   T = Inf;
+  reachability = false;
+  reachOptimal = false;
 }
 
 void TimeScalingSLP::GetLimitingConstraints(vector<int>& velocityLimitedVariables,vector<vector<int> >& activeSegmentConstraints)
 {
+  if(reachability) {
+    velocityLimitedVariables = reachVelocityLimited;
+    activeSegmentConstraints = reachActiveConstraints;
+    return;
+  }
   int n=(int)ds.size()-1;
   velocityLimitedVariables.resize(0);
   activeSegmentConstraints.resize(n);
@@ -407,6 +603,9 @@ void TimeScalingSLP::GetLimitingConstraints(vector<int>& velocityLimitedVariable
 
 void TimeScalingSLP::GetLagrangeMultipliers(vector<double>& velocityLimits,vector<vector<double> >& segmentConstraints)
 {
+  if(reachability) {
+    fprintf(stderr,"TimeScalingSLP: Lagrange multipliers are not available from SolveReachability\n");
+  }
   int n=(int)ds.size()-1;
   velocityLimits.resize(n+1);
   segmentConstraints.resize(n);
@@ -583,6 +782,17 @@ bool TimeScalingSLP::Solve(int& maxIters,Real xtol,Real ftol)
   int n = (int)ds.size()-1;
 
   InitializeInitPoint();
+  if(warmStart.n == x.n) {
+    Vector xw = warmStart;
+    for(int i=0;i<xw.n;i++)
+      xw(i) = Clamp(xw(i),lp.l(i),lp.u(i));
+    bool feasible = true;
+    for(int i=0;i<lp.A.m && feasible;i++) {
+      Real d = lp.A.dotRow(i,xw);
+      if(d > lp.p(i)+Epsilon || d < lp.q(i)-Epsilon) feasible = false;
+    }
+    if(feasible) x = xw;
+  }
   //possible for some problems to have no constraints? 
   //GLPK aborts if this happens
   if(lp.A.m == 0) {
@@ -729,6 +939,133 @@ bool TimeScalingSLP::Solve(int& maxIters,Real xtol,Real ftol)
   return true;
 }
 
+void TimeScalingSLP::GetSegmentHalfplanes(int i,vector<Vector3>& h)
+{
+  h.resize(0);
+  int cfirst=segToConstraints[i].first;
+  int cend=segToConstraints[i].second;
+  for(int c=cfirst;c<cend;c++) {
+    Real a=0,b=0;
+    for(SparseMatrix::RowT::iterator k=lp.A.rows[c].begin();k!=lp.A.rows[c].end();k++) {
+      if(k->first == i) a = k->second;
+      else if(k->first == i+1) b = k->second;
+    }
+    if(!IsInf(lp.p(c))) h.push_back(Vector3(a,b,lp.p(c)));
+    if(!IsInf(lp.q(c))) h.push_back(Vector3(-a,-b,-lp.q(c)));
+  }
+}
+
+bool TimeScalingSLP::SolveReachability(Real tol)
+{
+  int n = (int)ds.size()-1;
+  reachability = true;
+  reachOptimal = true;
+  reachVelocityLimited.resize(0);
+  reachActiveConstraints.resize(n);
+
+  //backward pass: [lo[i],hi[i]] is the set of x[i] that satisfy the bounds
+  //and from which some x[i+1] in [lo[i+1],hi[i+1]] can be reached.  The
+  //halfplanes on (x[i],x[i+1]) are projected onto x[i] by eliminating
+  //x[i+1] from each pair of upper and lower bounds on it.
+  vector<Real> lo(n+1),hi(n+1);
+  lo[n] = lp.l(n);
+  hi[n] = lp.u(n);
+  if(lo[n] > hi[n]) {
+    fprintf(stderr,"TimeScalingSLP: end velocity bounds are infeasible\n");
+    return false;
+  }
+  vector<Vector3> h;
+  for(int i=n-1;i>=0;i--) {
+    GetSegmentHalfplanes(i,h);
+    h.push_back(Vector3(0,1,hi[i+1]));
+    h.push_back(Vector3(0,-1,-lo[i+1]));
+    lo[i] = lp.l(i);
+    hi[i] = lp.u(i);
+    size_t nh = h.size();
+    for(size_t j=0;j<nh;j++) {
+      if(IsInf(h[j].z)) continue;
+      if(h[j].y == 0) {
+        if(h[j].x > 0) hi[i] = Min(hi[i],h[j].z/h[j].x);
+        else if(h[j].x < 0) lo[i] = Max(lo[i],h[j].z/h[j].x);
+        else if(h[j].z < -tol) hi[i] = -Inf;
+        continue;
+      }
+      if(h[j].y < 0) continue;
+      for(size_t k=0;k<nh;k++) {
+        if(h[k].y >= 0 || IsInf(h[k].z)) continue;
+        //-h[k].y*(h[j]) + h[j].y*(h[k]) eliminates x[i+1]
+        Real a = -h[k].y*h[j].x + h[j].y*h[k].x;
+        Real c = -h[k].y*h[j].z + h[j].y*h[k].z;
+        if(a > 0) hi[i] = Min(hi[i],c/a);
+        else if(a < 0) lo[i] = Max(lo[i],c/a);
+        else if(c < -tol) hi[i] = -Inf;
+      }
+    }
+    if(lo[i] > hi[i]+tol*Max(1.0,Abs(hi[i]))) {
+      fprintf(stderr,"TimeScalingSLP: end of path is not reachable from grid point %d\n",i);
+      return false;
+    }
+    hi[i] = Max(lo[i],hi[i]);
+  }
+
+  //forward pass: take the greatest reachable value at each point
+  x.resize(n+1);
+  x(0) = hi[0];
+  if(IsInf(x(0))) {
+    fprintf(stderr,"TimeScalingSLP: unbounded velocity at start of path\n");
+    return false;
+  }
+  for(int i=0;i<n;i++) {
+    GetSegmentHalfplanes(i,h);
+    Real ylo=lo[i+1],yhi=hi[i+1];
+    Real yhiSlope=0;
+    for(size_t j=0;j<h.size();j++) {
+      if(h[j].y > 0) {
+        Real y = (h[j].z-h[j].x*x(i))/h[j].y;
+        if(y < yhi) { yhi = y; yhiSlope = -h[j].x/h[j].y; }
+      }
+      else if(h[j].y < 0) ylo = Max(ylo,(h[j].z-h[j].x*x(i))/h[j].y);
+    }
+    //if the limiting bound decreases with x[i], a smaller x[i] might allow
+    //a larger x[i+1], and the greedy choice may not be optimal
+    if(yhiSlope < -tol) reachOptimal = false;
+    if(IsInf(yhi)) {
+      fprintf(stderr,"TimeScalingSLP: unbounded velocity at grid point %d\n",i+1);
+      return false;
+    }
+    if(ylo > yhi+tol*Max(1.0,Abs(yhi))) {
+      fprintf(stderr,"TimeScalingSLP: numerical error in forward pass at grid point %d, %g > %g\n",i+1,ylo,yhi);
+      return false;
+    }
+    x(i+1) = Max(yhi,Max(lp.l(i+1),0.0));
+  }
+  ComputeObjective(x);
+  if(IsInf(T)) {
+    fprintf(stderr,"TimeScalingSLP: reachable velocities are zero on a segment\n");
+    return false;
+  }
+
+  //record the active bounds and constraints, as with the LP basis
+  for(int i=0;i<=n;i++) {
+    Real scale = tol*Max(1.0,Abs(x(i)));
+    if(x(i) <= lp.l(i)+scale || x(i) >= lp.u(i)-scale)
+      reachVelocityLimited.push_back(i);
+  }
+  for(int i=0;i<n;i++) {
+    reachActiveConstraints[i].resize(0);
+    int cfirst=segToConstraints[i].first;
+    int cend=segToConstraints[i].second;
+    for(int c=cfirst;c<cend;c++) {
+      Real ax = lp.A.dotRow(c,x);
+      Real scale = tol*Max(1.0,Abs(ax));
+      if(ax >= lp.p(c)-scale || ax <= lp.q(c)+scale)
+        reachActiveConstraints[i].push_back(c-cfirst);
+    }
+  }
+  printf("Reachability solve with time %g%s\n",T,(reachOptimal?"":", may not be optimal"));
+  return true;
+}
+
 bool TimeScalingSLP::SolveCustom(ScalarFieldFunction* f,int& maxIters,Real xtol,Real ftol)
 {
   int n = (int)ds.size()-1;
@@ -1081,6 +1418,7 @@ void TimeScalingSLP::InitializeInitPoint()
 
 void TimeScalingSLP::InitializeGLPK()
 {
+  lpLock.Lock();
   glpk.Set(lp);
 
   //warm up the GLPK basis
@@ -1089,6 +1427,19 @@ void TimeScalingSLP::InitializeGLPK()
   for(int i=1;i<x.n;i++) {
     int cfirst=segToConstraints[i-1].first;
     int cend=segToConstraints[i-1].second;
+    if(find(basisVelocityLimited.begin(),basisVelocityLimited.end(),i) != basisVelocityLimited.end()) {
+      glpk.SetVariableNonBasic(i,!IsInf(lp.u(i)) && x(i) > lp.l(i));
+      continue;
+    }
+    if(i-1 < (int)basisActiveConstraints.size() && !basisActiveConstraints[i-1].empty()) {
+      //as below, x[i] becomes basic in place of an active constraint
+      int c = cfirst+basisActiveConstraints[i-1].front();
+      if(c < cend) {
+	glpk.SetVariableBasic(i);
+	glpk.SetRowNonBasic(c,!IsInf(lp.p(c)));
+	continue;
+      }
+    }
     for(int c=cfirst;c<cend;c++) {
       Assert(lp.A.rows[c].numEntries()==2);
       Assert(lp.A.rows[c].find(i-1) != lp.A.rows[c].end());
@@ -1367,7 +1718,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
 			       const Vector& amin,const Vector& amax,
 			       const vector<Real>& paramdivs,
 			       const vector<Vector>& dxs,
-			       Real ds0,Real dsEnd)
+			       Real ds0,Real dsEnd,Solver solver)
 {
   Assert(paramdivs.size()==dxs.size());
   vector<Vector> dxmins(dxs.size()-1),dxmaxs(dxs.size()-1);
@@ -1381,7 +1732,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
     }
     ddxmins[i] = ddxmaxs[i] = (dxs[i+1]-dxs[i])/(paramdivs[i+1]-paramdivs[i]);
   }
-  return SolveMinTime(vmin,vmax,amin,amax,paramdivs,dxmins,dxmaxs,ddxmins,ddxmaxs,ds0,dsEnd);
+  return SolveMinTime(vmin,vmax,amin,amax,paramdivs,dxmins,dxmaxs,ddxmins,ddxmaxs,ds0,dsEnd,NULL,NULL,solver);
 }
 
 bool TimeScaling::SolveMinTimeArcLength(const Vector& vmin,const Vector& vmax,
@@ -1541,7 +1892,8 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
 			       const vector<Vector>& ddxMins,const vector<Vector>& ddxMaxs,
 			       Real ds0,Real dsEnd,
              vector<pair<int,int> >* velocityLimitedVariables,
-             vector<pair<int,int> >* accelerationLimitedSegments)
+             vector<pair<int,int> >* accelerationLimitedSegments,
+             Solver solver)
 {
   Assert(paramdivs.size() == dxMins.size()+1);
   Assert(paramdivs.size() == dxMaxs.size()+1);
@@ -1563,6 +1915,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   Assert(vmax.minElement() >= 0);
   Assert(amax.minElement() >= 0);
 
+  reachabilityOptimal = false;
   TimeScalingSLP slp(paramdivs);
   vector<Real> dsmax(dxMins.size(),Inf);
   for(size_t i=0;i<dxMins.size();i++) {  
@@ -1577,7 +1930,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   for(size_t i=0;i+1<dxMins.size();i++) {
     slp.SetVelBound(i+1,Min(dsmax[i],dsmax[i+1]));
   }
-  slp.SetVelBound(n,dsmax[n]);
+  slp.SetVelBound(n,dsmax[n-1]);
   
   //fixed endpoints
   if(ds0 >= 0)
@@ -1673,9 +2026,15 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   printf("Reduced %d constraints to %d\n",(int)dxMins.size()*d*8,slp.lp.A.m);
 
   int maxIters = SLP_SOLVE_ITERS;
-  bool res = slp.Solve(maxIters);
+  bool res;
+  if(solver == Reachability) {
+    res = slp.SolveReachability();
+    reachabilityOptimal = res && slp.reachOptimal;
+  }
+  else
+    res = slp.Solve(maxIters);
 
-  if(CHECK_SLP_BOUNDS) {
+  if(CHECK_SLP_BOUNDS && solver == SLP) {
     slp.CheckSolution();
   }
 
@@ -1847,7 +2206,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
         int param = limitingVariables[k];
         int dim=-1;
         Real dsmax = Inf;
-        int i=param;
+        int i=Min(param,n-1);
         for(int j=0;j<d;j++) {
           if(dxMaxs[i][j] >= 0 && dxMins[i][j] <= 0) continue;
           Real dsj = Max(vmax[j]/dxMaxs[i][j],vmin[j]/dxMins[i][j]);
@@ -1882,7 +2241,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
 bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
 			       const Vector& amin,const Vector& amax,
 			       const GeneralizedCubicBezierSpline& path,
-			       Real ds0,Real dsEnd)
+			       Real ds0,Real dsEnd,Solver solver)
 {
   Assert(vmin.n == vmax.n);
   Assert(vmin.n == amin.n);
@@ -1899,6 +2258,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   Assert(vmax.minElement() >= 0);
   Assert(amax.minElement() >= 0);
 
+  reachabilityOptimal = false;
   TimeScalingSLP slp(paramdivs);
   vector<Real> dsmax(n,Inf);
   Vector vmini,vmaxi,amini,amaxi;
@@ -1920,7 +2280,7 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   for(size_t i=0;i+1<n;i++) {
     slp.SetVelBound(i+1,Min(dsmax[i],dsmax[i+1]));
   }
-  slp.SetVelBound(n,dsmax[n]);
+  slp.SetVelBound(n,dsmax[n-1]);
 
   //fixed endpoints
   if(ds0 >= 0)
@@ -2002,9 +2362,15 @@ bool TimeScaling::SolveMinTime(const Vector& vmin,const Vector& vmax,
   printf("Reduced %d constraints to %d\n",n*d*numcoeffs*2,slp.lp.A.m);
 
   int maxIters = SLP_SOLVE_ITERS;
-  bool res = slp.Solve(maxIters);
+  bool res;
+  if(solver == Reachability) {
+    res = slp.SolveReachability();
+    reachabilityOptimal = res && slp.reachOptimal;
+  }
+  else
+    res = slp.Solve(maxIters);
 
-  if(CHECK_SLP_BOUNDS) {
+  if(CHECK_SLP_BOUNDS && solver == SLP) {
     slp.CheckSolution();
   }
 
@@ -2309,7 +2675,6 @@ bool TimeScaling::SolveMinTimeArcLength(const Vector& vmin,const Vector& vmax,
       fprintf(stderr,"Warning: two subsequent x variables are inititalized to be negative? %d and %d\n",i,i+1);
       fprintf(stderr,"upper bounds %g and %g\n",lp.u(i),lp.u(i+1));
       lp.Print(cout);
-      getchar();
       return false;
     }
     Assert(x[i]+x[i+1] > 0);
@@ -2325,6 +2690,8 @@ bool TimeScaling::SolveMinTimeArcLength(const Vector& vmin,const Vector& vmax,
   //printf("Initial time %g\n",T);
 
   Real xtol = 1e-5, ftol=1e-8;
+  LPLock lpLock;
+  lpLock.Lock();
   GLPKInterface glpk;
   glpk.Set(lp);
 
@@ -2384,7 +2751,6 @@ bool TimeScaling::SolveMinTimeArcLength(const Vector& vmin,const Vector& vmax,
 	  fprintf(stderr,"Warning: two subsequent x variables are forced to be zero? %d and %d\n",i,i+1);
 	  fprintf(stderr,"upper bounds %g and %g\n",lp.u(i),lp.u(i+1));	  
 	  lp.Print(cout);
-	  getchar();
 	  return false;
 	}
 	Assert(xnext[i]+xnext[i+1] > 0);
@@ -2516,11 +2882,12 @@ bool TimeScaling::SolveMinTimeArcLength(const Vector& vmin,const Vector& vmax,
 
 bool OptimizeTimeScaling(const GeneralizedCubicBezierSpline& path,
 			 const Vector& vmin,const Vector& vmax,const Vector& amin,const Vector& amax,
-			 TimeScaling& scaling)
+			 TimeScaling& scaling,
+			 TimeScaling::Solver solver)
 {
 #if POLYNOMIAL_DERIV_BOUNDS
   //new style
-  bool res=scaling.SolveMinTime(vmin,vmax,amin,amax,path,0.0,0.0);
+  bool res=scaling.SolveMinTime(vmin,vmax,amin,amax,path,0.0,0.0,solver);
   if(res) Assert(scaling.ds.front()==0.0 && scaling.ds.back()==0.0);
   return res;
 
@@ -2591,11 +2958,9 @@ bool OptimizeTimeScaling(const GeneralizedCubicBezierSpline& path,
 	printf("x0 %g, x1 %g, x2 %g, x3 %g\n",path.segments[i].x0[j],path.segments[i].x1[j],path.segments[i].x2[j],path.segments[i].x3[j]);
 	printf("duration %g\n",path.durations[i]);
 	printf("Deriv bounds %g %g, accel bounds %g %g\n",vmins[i][j],vmaxs[i][j],amins[i][j],amaxs[i][j]);
-	printf("Press enter to continue\n");
-	getchar();
       }
   }
-  bool res=scaling.SolveMinTime(vmin,vmax,amin,amax,divs,vmins,vmaxs,amins,amaxs,0.0,0.0);
+  bool res=scaling.SolveMinTime(vmin,vmax,amin,amax,divs,vmins,vmaxs,amins,amaxs,0.0,0.0,NULL,NULL,solver);
   if(res) Assert(scaling.ds.front()==0.0 && scaling.ds.back()==0.0);
   return res;
 #endif  //POLYNOMIAL_BOUNDING
@@ -2603,9 +2968,9 @@ bool OptimizeTimeScaling(const GeneralizedCubicBezierSpline& path,
 
 
 
-bool TimeScaledBezierCurve::OptimizeTimeScaling(const Vector& vmin,const Vector& vmax,const Vector& amin,const Vector& amax)
+bool TimeScaledBezierCurve::OptimizeTimeScaling(const Vector& vmin,const Vector& vmax,const Vector& amin,const Vector& amax,TimeScaling::Solver solver)
 {
-  return ::OptimizeTimeScaling(path,vmin,vmax,amin,amax,timeScaling);
+  return ::OptimizeTimeScaling(path,vmin,vmax,amin,amax,timeScaling,solver);
 }
 
 void TimeScaledBezierCurve::GetPiecewiseLinear(std::vector<Real>& times,std::vector<Config>& milestones) const
@@ -2805,8 +3170,56 @@ void TimeScaledBezierCurve::Plot(const char* fn,const Vector& vmin,const Vector&
 
 
 
+#if HAVE_GLPK
+//run on a new thread: glp_init_env returns 0 if it creates an environment
+static void* TryInitLPEnvironment(void* ptr)
+{
+  int* res = reinterpret_cast<int*>(ptr);
+  *res = glp_init_env();
+  if(*res == 0) glp_free_env();
+  return NULL;
+}
+#endif //HAVE_GLPK
+
+//With this thread's environment set up, a new thread gets an environment
+//of its own only if they're thread-local
+static bool DetectLPReentrant()
+{
+#if HAVE_GLPK
+  int created = glp_init_env();
+  int res = -1;
+  Thread thread = ThreadStart(TryInitLPEnvironment,&res);
+  ThreadJoin(thread);
+  //don't leave behind an environment that this probe created
+  if(created == 0) glp_free_env();
+  return res == 0;
+#else
+  return false;
+#endif //HAVE_GLPK
+}
+
+bool CustomTimeScaling::LPReentrant()
+{
+  static bool reentrant = DetectLPReentrant();
+  return reentrant;
+}
+
+void CustomTimeScaling::InitLPThread()
+{
+#if HAVE_GLPK
+  if(LPReentrant()) glp_init_env();
+#endif //HAVE_GLPK
+}
+
+void CustomTimeScaling::ExitLPThread()
+{
+#if HAVE_GLPK
+  if(LPReentrant()) glp_free_env();
+#endif //HAVE_GLPK
+}
+
 CustomTimeScaling::CustomTimeScaling(Robot& robot)
-  :cspace(robot),manifold(robot),saveConstraintNames(false),computeLagrangeMultipliers(false)
+  :cspace(robot),manifold(robot),saveConstraintNames(false),reuseConstraints(false),firstChangedPoint(0),numThreads(1),colocationPool(1,InitLPThread,ExitLPThread),computeLagrangeMultipliers(false)
 {
 }
 
@@ -2842,7 +3255,6 @@ bool CustomTimeScaling::IsFeasible(const vector<Real>& ds) const
             ds2dds.dot(ds2ddsConstraintNormals[i][j]),
             ds2ddsConstraintOffsets[i][j]);
           //return false;
-          getchar();
           res = false;
         }
         else {
@@ -2862,7 +3274,6 @@ bool CustomTimeScaling::IsFeasible(const vector<Real>& ds) const
             ds2dds.dot(ds2ddsConstraintNormals[i][j]),
             ds2ddsConstraintOffsets[i][j]);
           //return false;
-          getchar();
           res = false;
         }
         else {
@@ -2879,8 +3290,14 @@ bool CustomTimeScaling::IsFeasible(const vector<Real>& ds) const
 void CustomTimeScaling::SetPath(const GeneralizedCubicBezierSpline& path,const vector<Real>& paramDivs)
 {
   Assert(paramDivs.size() >= 2);
+  vector<Real> oldParamDivs = this->paramDivs;
+  vector<int> oldParamSections;
+  vector<Vector> oldxs,olddxs,oldddxs;
+  swap(oldParamSections,paramSections);
+  swap(oldxs,xs);
+  swap(olddxs,dxs);
+  swap(oldddxs,ddxs);
   this->paramDivs = paramDivs;
-  paramSections.resize(0);
   traj.path = path;
 
   //create collocation points
@@ -2893,10 +3310,7 @@ void CustomTimeScaling::SetPath(const GeneralizedCubicBezierSpline& path,const v
     path.Accel(paramDivs[i],ddxs[i]);
   }
 
-  ds2ddsConstraintNormals.resize(paramDivs.size());
-  ds2ddsConstraintOffsets.resize(paramDivs.size());
-  dsmax.resize(paramDivs.size());
-  fill(dsmax.begin(),dsmax.end(),Inf);
+  ResetConstraints(oldParamDivs,oldParamSections,oldxs,olddxs,oldddxs);
 
   if(SAVE_COLLOCATION_POINTS) {
     printf("Saving collocation points to xs.txt, dxs.txt, ddxs.txt\n");
@@ -2922,6 +3336,13 @@ void CustomTimeScaling::SetPath(const GeneralizedCubicBezierSpline& path,const v
 void CustomTimeScaling::SetPath(const MultiPath& path,const vector<Real>& paramDivs)
 {
   Assert(paramDivs.size() >= 2);
+  vector<Real> oldParamDivs = this->paramDivs;
+  vector<int> oldParamSections;
+  vector<Vector> oldxs,olddxs,oldddxs;
+  swap(oldParamSections,paramSections);
+  swap(oldxs,xs);
+  swap(olddxs,dxs);
+  swap(oldddxs,ddxs);
   this->paramDivs = paramDivs;
   paramSections.resize(paramDivs.size());
   for(size_t i=0;i<paramDivs.size();i++) {
@@ -2987,11 +3408,7 @@ void CustomTimeScaling::SetPath(const MultiPath& path,const vector<Real>& paramD
     traj.path.Accel(paramDivs[i],ddxs[i]);
   }
 
-  ds2ddsConstraintNormals.resize(paramDivs.size());
-  ds2ddsConstraintOffsets.resize(paramDivs.size());
-  if(saveConstraintNames) ds2ddsConstraintNames.resize(paramDivs.size());
-  dsmax.resize(paramDivs.size());
-  fill(dsmax.begin(),dsmax.end(),Inf);
+  ResetConstraints(oldParamDivs,oldParamSections,oldxs,olddxs,oldddxs);
 
   if(SAVE_COLLOCATION_POINTS) {
     printf("Saving collocation points to xs.txt, dxs.txt, ddxs.txt\n");
@@ -3013,6 +3430,40 @@ void CustomTimeScaling::SetPath(const MultiPath& path,const vector<Real>& paramD
   }
 }
 
+void CustomTimeScaling::ResetConstraints(const vector<Real>& oldParamDivs,const vector<int>& oldParamSections,
+					 const vector<Vector>& oldxs,const vector<Vector>& olddxs,const vector<Vector>& oldddxs)
+{
+  size_t n = paramDivs.size();
+  size_t k = 0;
+  if(reuseConstraints && ds2ddsConstraintNormals.size() == oldParamDivs.size() && oldParamSections.size() == (paramSections.empty() ? 0 : oldParamDivs.size())) {
+    size_t nmax = Min(n,oldParamDivs.size());
+    while(k < nmax) {
+      if(paramDivs[k] != oldParamDivs[k]) break;
+      if(!paramSections.empty() && paramSections[k] != oldParamSections[k]) break;
+      if(!xs[k].isEqual(oldxs[k],0) || !dxs[k].isEqual(olddxs[k],0) || !ddxs[k].isEqual(oldddxs[k],0)) break;
+      k++;
+    }
+  }
+  firstChangedPoint = (int)k;
+
+  ds2ddsConstraintNormals.resize(n);
+  ds2ddsConstraintOffsets.resize(n);
+  for(size_t i=k;i<n;i++) {
+    ds2ddsConstraintNormals[i].resize(0);
+    ds2ddsConstraintOffsets[i].resize(0);
+  }
+  if(saveConstraintNames) {
+    ds2ddsConstraintNames.resize(n);
+    for(size_t i=k;i<n;i++)
+      ds2ddsConstraintNames[i].resize(0);
+  }
+  //velocity bounds are cheap, always recompute them
+  dsmax.resize(n);
+  fill(dsmax.begin(),dsmax.end(),Inf);
+  if(k > 0)
+    printf("CustomTimeScaling: reusing the constraints of %d of %d colocation points\n",(int)k,(int)n);
+}
+
 void CustomTimeScaling::SetStartStop()
 {
   dsmax[0] = 0;
@@ -3036,7 +3487,7 @@ void CustomTimeScaling::SetDefaultBounds()
 
   //acceleration bounds
   //amin <= ddx*ds^2 + dx*dds <= amax
-  for(size_t i=0;i<paramDivs.size();i++) { 
+  for(size_t i=firstChangedPoint;i<paramDivs.size();i++) { 
     for(int j=0;j<d;j++) {
       Real dx = dxs[i][j];
       Real ddx = ddxs[i][j];
@@ -3058,12 +3509,101 @@ void CustomTimeScaling::SetDefaultBounds()
   }
 }
 
+Mutex CustomTimeScaling::lpMutex;
+
 bool CustomTimeScaling::Optimize()
 {
+  bool res;
   if(computeLagrangeMultipliers)
-    return SolveSLP(paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj,&variableLagrangeMultipliers,&constraintLagrangeMultipliers);
+    res = SolveSLP(paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj,&variableLagrangeMultipliers,&constraintLagrangeMultipliers,&solvedVelocityLimited,&solvedActiveConstraints);
   else
-    return SolveSLP(paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj);
+    res = SolveSLP(paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj,NULL,NULL,&solvedVelocityLimited,&solvedActiveConstraints);
+  if(res) {
+    SaveSolvedConstraints(NumUnchangedPoints());
+  }
+  else {
+    solvedParamDivs.resize(0);
+    solvedVelocityLimited.resize(0);
+    solvedActiveConstraints.resize(0);
+  }
+  return res;
+}
+
+void CustomTimeScaling::SaveSolvedConstraints(int first)
+{
+  size_t n = paramDivs.size();
+  solvedParamDivs.resize(n);
+  solvedDsmax.resize(n);
+  solvedConstraintNormals.resize(n);
+  solvedConstraintOffsets.resize(n);
+  for(size_t i=(size_t)Max(first,0);i<n;i++) {
+    solvedParamDivs[i] = paramDivs[i];
+    solvedDsmax[i] = dsmax[i];
+    solvedConstraintNormals[i] = ds2ddsConstraintNormals[i];
+    solvedConstraintOffsets[i] = ds2ddsConstraintOffsets[i];
+  }
+}
+
+int CustomTimeScaling::NumUnchangedPoints() const
+{
+  size_t n = Min(paramDivs.size(),solvedParamDivs.size());
+  if(solvedDsmax.size() < n || solvedConstraintNormals.size() < n || solvedConstraintOffsets.size() < n || dsmax.size() < n || ds2ddsConstraintNormals.size() < n || ds2ddsConstraintOffsets.size() < n)
+    return 0;
+  for(size_t i=0;i<n;i++) {
+    if(paramDivs[i] != solvedParamDivs[i] || dsmax[i] != solvedDsmax[i]) return (int)i;
+    const vector<Vector2>& a = ds2ddsConstraintNormals[i], &b = solvedConstraintNormals[i];
+    if(a.size() != b.size() || ds2ddsConstraintOffsets[i] != solvedConstraintOffsets[i]) return (int)i;
+    for(size_t j=0;j<a.size();j++)
+      if(a[j].x != b[j].x || a[j].y != b[j].y) return (int)i;
+  }
+  return (int)n;
+}
+
+bool CustomTimeScaling::OptimizeFrom(Real param)
+{
+  int istart = -1;
+  while(istart+1 < (int)paramDivs.size() && paramDivs[istart+1] < param)
+    istart++;
+  //the constraints must not have changed up to istart.  The segment from
+  //istart to istart+1 is re-solved, so only its start must match.
+  if(reuseConstraints && istart >= firstChangedPoint)
+    istart = firstChangedPoint-1;
+  int numUnchanged = NumUnchangedPoints();
+  if(istart >= numUnchanged)
+    istart = numUnchanged-1;
+  if(istart <= 0 || istart+1 >= (int)paramDivs.size())
+    return Optimize();
+  //check that the previous solution is usable up to istart
+  const TimeScaling& ts = traj.timeScaling;
+  if((int)ts.ds.size() <= istart || ts.params.size() != ts.ds.size() || ts.times.size() != ts.ds.size())
+    return Optimize();
+  for(int i=0;i<=istart;i++)
+    if(ts.params[i] != paramDivs[i]) return Optimize();
+
+  //the basis only carries over on segments whose constraints are unchanged
+  size_t nkeep = 0;
+  for(size_t i=0;i<solvedVelocityLimited.size();i++)
+    if(solvedVelocityLimited[i] < numUnchanged)
+      solvedVelocityLimited[nkeep++] = solvedVelocityLimited[i];
+  solvedVelocityLimited.resize(nkeep);
+  if((int)solvedActiveConstraints.size() > numUnchanged-1)
+    solvedActiveConstraints.resize(numUnchanged-1);
+
+  bool res,fasterStart;
+  if(computeLagrangeMultipliers)
+    res = SolveSLPSuffix(istart,paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj,solvedVelocityLimited,solvedActiveConstraints,fasterStart,&variableLagrangeMultipliers,&constraintLagrangeMultipliers);
+  else
+    res = SolveSLPSuffix(istart,paramDivs,dsmax,ds2ddsConstraintNormals,ds2ddsConstraintOffsets,traj,solvedVelocityLimited,solvedActiveConstraints,fasterStart);
+  if(!res) {
+    printf("CustomTimeScaling::OptimizeFrom: could not scale the path after %g from the previous solution, optimizing the whole path\n",paramDivs[istart]);
+    return Optimize();
+  }
+  if(fasterStart) {
+    printf("CustomTimeScaling::OptimizeFrom: the path after %g allows a faster start than the previous solution, optimizing the whole path\n",paramDivs[istart]);
+    return Optimize();
+  }
+  SaveSolvedConstraints(numUnchanged);
+  return true;
 }
 
 void CustomTimeScaling::PrintActiveConstraints(ostream& out)
@@ -29,6 +29,23 @@ using namespace std;
 class TimeScaling
 {
 public:
+  ///The method used by SolveMinTime.
+  ///- SLP: sequential linear programming with GLPK.  Iterates up to a fixed
+  ///  number of LP solves.
+  ///- Reachability: a backward pass computes the set of squared rates at each
+  ///  grid point from which the end of the path can be reached, then a
+  ///  forward pass greedily takes the largest reachable rate.  Takes time
+  ///  linear in the number of grid points and has no iterations, so it is
+  ///  better suited to online retiming.  The result is optimal when the
+  ///  upper bound that limits each next rate does not decrease with the
+  ///  current rate.  Acceleration bounds on a curved path can violate this
+  ///  on coarse grids, in which case the result is feasible but may be
+  ///  slower than the SLP result.  reachabilityOptimal reports which case
+  ///  occurred.
+  enum Solver { SLP, Reachability };
+
+  TimeScaling() : reachabilityOptimal(false) {}
+
   ///evaluation (params and times structures must be set up first)
   int TimeToSegment(Real t) const;
   Real TimeToParam(Real t) const;
@@ -57,6 +74,7 @@ public:
   ///- accelerationLimitedSegments (out): if != NULL, returns a list of pairs (seg,dim)
   ///  where the acceleration limit on dof dim is active over the range of s from
   ///   [params[seg],params[seg+1]]
+  ///- solver: the optimization method, see Solver
   ///
   ///Returns true if a time scaling that satisfies all constraints could be found
   bool SolveMinTime(const Vector& vmin,const Vector& vmax,
@@ -66,21 +84,22 @@ public:
 		    const vector<Vector>& ddxMins,const vector<Vector>& ddxMaxs,
 		    Real ds0=-1,Real dsEnd=-1,
         vector<pair<int,int> >* velocityLimitedVariables=NULL,
-        vector<pair<int,int> >* accelerationLimitedSegments=NULL);
+        vector<pair<int,int> >* accelerationLimitedSegments=NULL,
+        Solver solver=SLP);
 
   ///Same as above, but uses a more effective derivative bounding technique assuming
   ///a cartesian space.
   bool SolveMinTime(const Vector& vmin,const Vector& vmax,
 		    const Vector& amin,const Vector& amax,
 		    const GeneralizedCubicBezierSpline& path,
-		    Real ds0=-1,Real dsEnd=-1);
+		    Real ds0=-1,Real dsEnd=-1,Solver solver=SLP);
 
   ///convenience approximation function -- assumes all segments are monotonic
   bool SolveMinTime(const Vector& vmin,const Vector& vmax,
 		    const Vector& amin,const Vector& amax,
 		    const vector<Real>& paramdivs,
 		    const vector<Vector>& dxs,
-		    Real ds0=-1,Real dsEnd=-1);
+		    Real ds0=-1,Real dsEnd=-1,Solver solver=SLP);
 
   ///Sort of improves the conditioning of the time scaling near singularities --
   ///support is experimental
@@ -109,6 +128,10 @@ public:
 
   Spline::TimeSegmentation params,times;
   vector<Real> ds;
+  ///Set by SolveMinTime: true if the Reachability solver succeeded and its
+  ///result is known to be optimal for the constraints on the grid.  Always
+  ///false for SLP, which stops after a fixed number of iterations.
+  bool reachabilityOptimal;
 };
 
 
@@ -128,7 +151,7 @@ public:
 class TimeScaledBezierCurve
 {
 public:
-  bool OptimizeTimeScaling(const Vector& vmin,const Vector& vmax,const Vector& amin,const Vector& amax);
+  bool OptimizeTimeScaling(const Vector& vmin,const Vector& vmax,const Vector& amin,const Vector& amax,TimeScaling::Solver solver=TimeScaling::SLP);
   void GetPiecewiseLinear(std::vector<Real>& times,std::vector<Config>& milestones) const;
   void GetDiscretizedPath(Real dt,std::vector<Config>& milestones) const;
   Real EndTime() const;
@@ -154,6 +177,7 @@ public:
 bool OptimizeTimeScaling(const GeneralizedCubicBezierSpline& path,
 			 const Vector& vmin,const Vector& vmax,
 			 const Vector& amin,const Vector& amax,
-			 TimeScaling& scaling);
+			 TimeScaling& scaling,
+			 TimeScaling::Solver solver=TimeScaling::SLP);
 
 #endif
@@ -246,6 +246,12 @@ class MotionPlan:
               improve a path after a first plan is found.
             - "restart": nonzero if you wish to restart the planner to
               get progressively better paths with the remaining time.
+            - "lazy": nonzero if edges should be checked lazily: only
+              the edges of candidate paths are checked, edges that fail
+              are removed, and the search is repeated.  PRM and RRT become
+              lazy PRM and lazy RRT, PRM* becomes lazy PRM*, and RRT*
+              becomes lazy RRG*; other types raise an error.  Each plan
+              caches its edge checks.
             - "pointLocation": a string designating a point location data
               structure. "kdtree" is supported, optionally followed by a
               weight vector (used in PRM, RRT*, PRM*, LazyPRM*, LazyRRG*)
@@ -3912,6 +3912,95 @@ class Simulator(_object):
         """
         return _robotsim.Simulator_setSimStep(self, *args)
 
+    def simulateBatch(self, *args):
+        """
+        simulateBatch(Simulator self, stringVector initialStates, double duration, int numThreads=0) -> stringVector
+        simulateBatch(Simulator self, stringVector initialStates, double duration) -> stringVector
+
+        Simulates each of the given initial states (Base64 strings returned by
+        getState) for the given duration, and returns the resulting states.
+        The simulations are run in parallel on numThreads copies of this
+        simulator (numThreads<=0 uses one per hardware thread). The copies are
+        kept between calls, and are remade when numThreads changes or after a
+        call to setGravity, setSimStep, enableContactFeedback, or a SimBody's
+        setSurface or setCollisionPadding. An empty initial state starts from
+        the current state of this simulator at the time the copies were made.
+        This simulator's own state is not changed. 
+        """
+        return _robotsim.Simulator_simulateBatch(self, *args)
+
+    def batchThroughput(self):
+        """
+        batchThroughput(Simulator self) -> double
+
+        Returns the throughput, in simulations per second, of the last
+        simulateBatch call. 
+        """
+        return _robotsim.Simulator_batchThroughput(self)
+
+    def enableProfiling(self, *args):
+        """
+        enableProfiling(Simulator self, bool enabled, bool trace=False)
+        enableProfiling(Simulator self, bool enabled)
+
+        Turns the step profiler on or off. Turning it on clears previous
+        results. If trace=true, every timed interval is also recorded for
+        saveProfileTrace. 
+        """
+        return _robotsim.Simulator_enableProfiling(self, *args)
+
+    def profilePhases(self):
+        """
+        profilePhases(Simulator self) -> stringVector
+
+        Returns the names of the profiled phases and counters. 
+        """
+        return _robotsim.Simulator_profilePhases(self)
+
+    def getProfileStats(self, *args):
+        """
+        getProfileStats(Simulator self, char const * phase)
+
+        Returns the per-step statistics of a phase or counter as a list
+        [steps,mean,min,max,total]. Times are in seconds. 
+        """
+        return _robotsim.Simulator_getProfileStats(self, *args)
+
+    def getProfileHistogram(self, *args):
+        """
+        getProfileHistogram(Simulator self, char const * phase)
+
+        Returns the per-step histogram of a phase or counter as a list of
+        counts, one per bin. 
+        """
+        return _robotsim.Simulator_getProfileHistogram(self, *args)
+
+    def getProfileHistogramBins(self, *args):
+        """
+        getProfileHistogramBins(Simulator self, char const * phase)
+
+        Returns the lower bounds of the histogram bins of a phase or counter.
+
+        """
+        return _robotsim.Simulator_getProfileHistogramBins(self, *args)
+
+    def profileSummary(self):
+        """
+        profileSummary(Simulator self) -> std::string
+
+        Returns a human-readable table of the profile. 
+        """
+        return _robotsim.Simulator_profileSummary(self)
+
+    def saveProfileTrace(self, *args):
+        """
+        saveProfileTrace(Simulator self, char const * fn) -> bool
+
+        Saves the recorded intervals in the Chrome trace JSON format, viewable
+        in chrome://tracing. 
+        """
+        return _robotsim.Simulator_saveProfileTrace(self, *args)
+
     __swig_setmethods__["index"] = _robotsim.Simulator_index_set
     __swig_getmethods__["index"] = _robotsim.Simulator_index_get
     if _newclass:index = _swig_property(_robotsim.Simulator_index_get, _robotsim.Simulator_index_set)
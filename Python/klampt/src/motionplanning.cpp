@@ -3,6 +3,8 @@
 #include <KrisLibrary/planning/ExplicitCSpace.h>
 #include <KrisLibrary/planning/CSpaceHelpers.h>
 #include "pyerr.h"
+#include "Planning/EdgeCheckCache.h"
+#include "Planning/LazyRoadmapPlanner.h"
 #include <KrisLibrary/graph/IO.h>
 #include <KrisLibrary/math/random.h>
 #include <Python.h>
@@ -588,7 +590,11 @@ public:
 static vector<SmartPointer<PyCSpace> > spaces;
 static vector<SmartPointer<MotionPlannerInterface> > plans;
 static vector<SmartPointer<PyGoalSet> > goalSets;
+//in lazy mode, each plan's view of its cspace, with the plan's edge cache
+static vector<SmartPointer<CachedEdgeCSpace> > planSpaces;
 static MotionPlannerFactory factory;
+//if true, plans are created with CreateLazyPlanner
+static bool lazyPlanning = false;
 static list<int> spacesDeleteList;
 static list<int> plansDeleteList;
 
@@ -940,6 +946,8 @@ void setPlanSetting(const char* setting,double value)
     factory.shortcut = (value != 0);
   else if(0==strcmp(setting,"restart"))
     factory.restart = (value != 0);
+  else if(0==strcmp(setting,"lazy"))
+    lazyPlanning = (value != 0);
   else {
     throw PyException("Invalid setting");
   }
@@ -957,18 +965,44 @@ void setPlanSetting(const char* setting,const char* value)
 }
 
 
+//Creates plan index with the factory's settings.  In lazy mode the plan
+//gets a new edge cache over space.
+MotionPlannerInterface* CreatePlan(int index,PyCSpace* space,const Config* qstart=NULL,CSpace* goalSet=NULL)
+{
+  if(!lazyPlanning) {
+    if(index < (int)planSpaces.size())
+      planSpaces[index] = NULL;
+    if(goalSet) return factory.Create(space,*qstart,goalSet);
+    return factory.Create(space);
+  }
+  SmartPointer<CachedEdgeCSpace> planSpace(new CachedEdgeCSpace(space,space->edgeResolution));
+  MotionPlannerInterface* plan;
+  if(goalSet) plan = CreateLazyPlanner(factory,planSpace,*qstart,goalSet);
+  else plan = CreateLazyPlanner(factory,planSpace);
+  if(!plan) {
+    if(goalSet)
+      throw PyException("Lazy planning with a goal set requires planner type prm*, rrt*, or rrg*");
+    throw PyException("The planner type has no lazy version");
+  }
+  planSpaces.resize(Max(planSpaces.size(),size_t(index+1)));
+  planSpaces[index] = planSpace;
+  return plan;
+}
+
 int makeNewPlan(int cspace)
 {
   if(cspace < 0 || cspace >= (int)spaces.size() || spaces[cspace]==NULL) 
     throw PyException("Invalid cspace index");
   if(plansDeleteList.empty()) {
-    plans.push_back(factory.Create(spaces[cspace]));
-    return (int)plans.size()-1;
+    int index = (int)plans.size();
+    MotionPlannerInterface* plan = CreatePlan(index,spaces[cspace]);
+    plans.push_back(plan);
+    return index;
   }
   else {
     int index = plansDeleteList.front();
+    plans[index] = CreatePlan(index,spaces[cspace]);
     plansDeleteList.erase(plansDeleteList.begin());
-    plans[index] = factory.Create(spaces[cspace]);
     return index;
   }
 }
@@ -980,6 +1014,8 @@ void destroyPlan(int plan)
   plans[plan] = NULL;
   if(plan < (int)goalSets.size())
     goalSets[plan] = NULL;
+  if(plan < (int)planSpaces.size())
+    planSpaces[plan] = NULL;
   plansDeleteList.push_back(plan);
 }
 
@@ -1036,7 +1072,7 @@ bool PlannerInterface::setEndpoints(PyObject* start,PyObject* goal)
     if(PyCallable_Check(goal)) {
       goalSets.resize(plans.size());
       goalSets[index] = new PyGoalSet(spaces[spaceIndex],goal);
-      plans[index]=factory.Create(spaces[spaceIndex],qstart,goalSets[index]);
+      plans[index]=CreatePlan(index,spaces[spaceIndex],&qstart,goalSets[index]);
     }
     else {
       throw PyException("Invalid goal endpoint");
@@ -1135,6 +1171,10 @@ PyObject* PlannerInterface::getStats()
     throw PyException("Invalid plan index");  
   PropertyMap stats;
   plans[index]->GetStats(stats);
+  if(index < (int)planSpaces.size() && planSpaces[index]) {
+    stats.set("edgeCacheHits",planSpaces[index]->cache.numHits);
+    stats.set("edgeCacheMisses",planSpaces[index]->cache.numMisses);
+  }
   PyObject* res = PyDict_New();
   for(PropertyMap::const_iterator i=stats.begin();i!=stats.end();i++) {
     PyObject* value = PyString_FromString(i->second.c_str());
@@ -1179,4 +1219,5 @@ void destroy()
   spacesDeleteList.resize(0);
   plans.resize(0);
   plansDeleteList.resize(0);
+  planSpaces.resize(0);
 }
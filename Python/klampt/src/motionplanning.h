@@ -51,6 +51,12 @@ void setPlanSetting(const char* setting,double value);
  *   plan is found.
  * - "restart": nonzero if you wish to restart the planner to get better
  *   paths with the remaining time.
+ * - "lazy": nonzero if plans should check edges lazily: only the edges of
+ *   candidate paths are checked, edges that fail are removed, and the
+ *   search is repeated.  PRM and RRT become lazy PRM and lazy RRT, PRM*
+ *   becomes lazy PRM*, and RRT* becomes lazy RRG*; other types raise an
+ *   error.  Each plan caches its edge checks, so each edge is checked at
+ *   most once per plan.
  * 
  * Valid string values are:
  * - "pointLocation": a string designating a point location data structure.
@@ -8,6 +8,7 @@
 #include "Control/LoggingController.h"
 #include "Planning/RobotCSpace.h"
 #include "Simulation/WorldSimulation.h"
+#include "Simulation/WorldSimulationPool.h"
 #include "Modeling/Interpolate.h"
 #include "IO/XmlWorld.h"
 #include "IO/XmlODE.h"
@@ -41,6 +42,12 @@ struct WorldData
 struct SimData
 {
   WorldSimulation sim;
+  //clones for simulateBatch, rebuilt when the thread count or the settings
+  //copied into the clones change
+  SmartPointer<WorldSimulationPool> pool;
+  int poolThreads;
+
+  SimData() : poolThreads(0) {}
 };
 
 
@@ -274,6 +281,10 @@ inline MyController* MakeController(Robot* robot)
   ManualOverrideController* lc=new ManualOverrideController(*robot,MakeDefaultController(robot));
   return lc;
 }
+SmartPointer<RobotController> MakePoolController(Robot* robot)
+{
+  return MakeController(robot);
+}
 inline PolynomialPathController* GetPathController(RobotController* controller)
 {
   MyController* mc=dynamic_cast<MyController*>(controller);
@@ -2804,6 +2815,113 @@ void Simulator::simulate(double t)
   sim->UpdateModel();
 }
 
+//Drops the simulateBatch clones of the given simulator after a change to
+//settings that the clones copy
+static void ResetBatchPool(int index)
+{
+  sims[index]->pool = NULL;
+}
+
+std::vector<std::string> Simulator::simulateBatch(const std::vector<std::string>& initialStates,double duration,int numThreads)
+{
+  SmartPointer<WorldSimulationPool>& pool = sims[index]->pool;
+  if(!pool || sims[index]->poolThreads != numThreads) {
+    pool = new WorldSimulationPool;
+    pool->Init(*sim,numThreads,MakePoolController);
+    sims[index]->poolThreads = numThreads;
+  }
+  vector<SimulationJob> jobs(initialStates.size());
+  for(size_t i=0;i<jobs.size();i++) {
+    if(!initialStates[i].empty())
+      jobs[i].initialState = FromBase64(initialStates[i]);
+    jobs[i].duration = duration;
+  }
+  vector<SimulationJobResult> results;
+  pool->Run(jobs,results);
+  vector<string> res(results.size());
+  for(size_t i=0;i<results.size();i++) {
+    if(!results[i].ok) {
+      stringstream ss;
+      ss<<"simulateBatch: could not read initial state "<<i;
+      throw PyException(ss.str().c_str());
+    }
+    res[i] = ToBase64(results[i].finalState);
+  }
+  return res;
+}
+
+double Simulator::batchThroughput()
+{
+  if(!sims[index]->pool) return 0;
+  return sims[index]->pool->JobsPerSecond();
+}
+
+void Simulator::enableProfiling(bool enabled,bool trace)
+{
+  if(enabled && !sim->profiler.enabled) sim->profiler.Clear();
+  sim->profiler.enabled = enabled;
+  sim->profiler.traceEnabled = trace;
+}
+
+std::vector<std::string> Simulator::profilePhases()
+{
+  vector<string> res;
+  for(map<string,SimulationProfileStat>::const_iterator i=sim->profiler.stats.begin();i!=sim->profiler.stats.end();i++)
+    res.push_back(i->first);
+  return res;
+}
+
+const SimulationProfileStat& GetProfileStat(WorldSimulation* sim,const char* phase)
+{
+  map<string,SimulationProfileStat>::const_iterator i=sim->profiler.stats.find(phase);
+  if(i == sim->profiler.stats.end()) {
+    stringstream ss;
+    ss<<"Profile phase "<<phase<<" was not recorded";
+    throw PyException(ss.str().c_str());
+  }
+  return i->second;
+}
+
+void Simulator::getProfileStats(const char* phase,std::vector<double>& out)
+{
+  const SimulationProfileStat& s = GetProfileStat(sim,phase);
+  out.resize(5);
+  out[0] = s.numSteps;
+  out[1] = s.Mean();
+  out[2] = (s.numSteps > 0 ? s.minimum : 0);
+  out[3] = (s.numSteps > 0 ? s.maximum : 0);
+  out[4] = s.total;
+}
+
+void Simulator::getProfileHistogram(const char* phase,std::vector<double>& out)
+{
+  const SimulationProfileStat& s = GetProfileStat(sim,phase);
+  out.resize(s.histogram.size());
+  for(size_t i=0;i<s.histogram.size();i++)
+    out[i] = s.histogram[i];
+}
+
+void Simulator::getProfileHistogramBins(const char* phase,std::vector<double>& out)
+{
+  const SimulationProfileStat& s = GetProfileStat(sim,phase);
+  out.resize(s.NumBins());
+  Real hi;
+  for(int i=0;i<s.NumBins();i++)
+    s.BinRange(i,out[i],hi);
+}
+
+std::string Simulator::profileSummary()
+{
+  stringstream ss;
+  sim->profiler.Print(ss);
+  return ss.str();
+}
+
+bool Simulator::saveProfileTrace(const char* fn)
+{
+  return sim->profiler.SaveChromeTrace(fn);
+}
+
 void Simulator::fakeSimulate(double t)
 {
   sim->AdvanceFake(t);
@@ -2920,10 +3038,12 @@ void Simulator::meanContactForce(int aid,int bid,double out[3])
 void Simulator::enableContactFeedback(int obj1,int obj2)
 {
   sim->EnableContactFeedback(obj1,obj2);
+  ResetBatchPool(index);
 }
 
 void Simulator::enableContactFeedbackAll()
 {
+  ResetBatchPool(index);
   //setup feedback
   RobotWorld& rworld=*worlds[world.index]->world;
   //world-object
@@ -2970,11 +3090,13 @@ void Simulator::enableContactFeedbackAll()
 void Simulator::setGravity(const double g[3])
 {
   sim->odesim.SetGravity(Vector3(g));
+  ResetBatchPool(index);
 }
 
 void Simulator::setSimStep(double dt)
 {
   sim->simStep = dt;
+  ResetBatchPool(index);
 }
 
 SimRobotController Simulator::getController(int robot)
@@ -3113,6 +3235,7 @@ void SimBody::setCollisionPadding(double padding)
 {
   if(!geometry) return;
   geometry->SetPadding(padding);
+  ResetBatchPool(sim->index);
 }
 
 double SimBody::getCollisionPadding()
@@ -3125,6 +3248,7 @@ void SimBody::setCollisionPreshrink(bool shrinkVisualization)
 {
   if(!geometry) return;
   geometry->SetPaddingWithPreshrink(geometry->GetPadding(),shrinkVisualization);
+  ResetBatchPool(sim->index);
 }
 
 ContactParameters SimBody::getSurface()
@@ -3151,6 +3275,7 @@ void SimBody::setSurface(const ContactParameters& res)
   params->kRestitution=res.kRestitution;
   params->kStiffness=res.kStiffness;
   params->kDamping=res.kDamping;
+  ResetBatchPool(sim->index);
 }
 
 
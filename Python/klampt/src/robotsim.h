@@ -337,6 +337,40 @@ class Simulator
   /// Sets the internal simulation substep.  Values < 0.01 are recommended.
   void setSimStep(double dt);
 
+  /// Simulates each of the given initial states (Base64 strings returned by
+  /// getState) for the given duration, and returns the resulting states.
+  /// The simulations are run in parallel on numThreads copies of this
+  /// simulator (numThreads<=0 uses one per hardware thread).  The copies
+  /// are kept between calls, and are remade when numThreads changes or
+  /// after a call to setGravity, setSimStep, enableContactFeedback, or a
+  /// SimBody's setSurface or setCollisionPadding.  An empty initial state
+  /// starts from the current state of this simulator at the time the
+  /// copies were made.  This simulator's own state is not changed.
+  std::vector<std::string> simulateBatch(const std::vector<std::string>& initialStates,double duration,int numThreads=0);
+  /// Returns the throughput, in simulations per second, of the last
+  /// simulateBatch call.
+  double batchThroughput();
+
+  /// Turns the step profiler on or off.  Turning it on clears previous
+  /// results.  If trace=true, every timed interval is also recorded for
+  /// saveProfileTrace.
+  void enableProfiling(bool enabled,bool trace=false);
+  /// Returns the names of the profiled phases and counters
+  std::vector<std::string> profilePhases();
+  /// Returns the per-step statistics of a phase or counter as a list
+  /// [steps,mean,min,max,total].  Times are in seconds.
+  void getProfileStats(const char* phase,std::vector<double>& out);
+  /// Returns the per-step histogram of a phase or counter as a list of
+  /// counts, one per bin
+  void getProfileHistogram(const char* phase,std::vector<double>& out);
+  /// Returns the lower bounds of the histogram bins of a phase or counter
+  void getProfileHistogramBins(const char* phase,std::vector<double>& out);
+  /// Returns a human-readable table of the profile
+  std::string profileSummary();
+  /// Saves the recorded intervals in the Chrome trace JSON format, viewable
+  /// in chrome://tracing.
+  bool saveProfileTrace(const char* fn);
+
   int index;
   WorldModel world;
   WorldSimulation* sim;
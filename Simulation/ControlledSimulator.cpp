@@ -1,4 +1,5 @@
 #include "ControlledSimulator.h"
+#include "WorldSimulation.h"
 #include "Control/JointSensors.h"
 
 //Set these values to 0 to get all warnings
@@ -173,6 +174,8 @@ void ControlledRobotSimulator::GetActuatorTorques(Vector& t) const
 void ControlledRobotSimulator::Step(Real dt,WorldSimulation* sim)
 {
   Real endOfTimeStep = curTime + dt;
+  SimulationProfiler* profiler = (sim ? &sim->profiler : NULL);
+  Real start = (profiler ? profiler->Begin() : 0);
 
   //process sensors, which don't operate on the same loop as the controller,
   //necessarily.
@@ -201,8 +204,10 @@ void ControlledRobotSimulator::Step(Real dt,WorldSimulation* sim)
       nextSenseTime[i] += delay;
     }
   }
+  if(profiler && !sensors.sensors.empty()) profiler->End("sensors",start);
 
   if(controller) {
+    if(profiler) start = profiler->Begin();
     //the controller update happens less often than the PID update loop
     if(nextControlTime < endOfTimeStep) {
       //update controller
@@ -267,6 +272,7 @@ void ControlledRobotSimulator::Step(Real dt,WorldSimulation* sim)
     else if(cmd.kI*cmd.iterm < d.tmin) { cmd.iterm = d.tmin/cmd.kI; }
       }
     }
+    if(profiler) profiler->End("controller",start);
   }
 
   curTime = endOfTimeStep;
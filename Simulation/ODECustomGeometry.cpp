@@ -26,7 +26,17 @@ const static bool gDoTriangleTriangleCollisionDetection = false;
 //doesn't consider unique contact points if they are between this tolerance
 const static Real cptol=1e-5;
 
-static bool gCustomGeometryMeshesIntersect = false;
+//the reliability flag is kept per-thread so that several simulators can
+//run collision detection concurrently
+#ifdef _MSC_VER
+#define CUSTOM_GEOMETRY_THREAD_LOCAL __declspec(thread)
+#else
+#define CUSTOM_GEOMETRY_THREAD_LOCAL __thread
+#endif //_MSC_VER
+static CUSTOM_GEOMETRY_THREAD_LOCAL bool gCustomGeometryMeshesIntersect = false;
+//if false, the collider assumes that the geometry transforms were set
+//beforehand with dCustomGeometryUpdateTransform
+static CUSTOM_GEOMETRY_THREAD_LOCAL bool gCustomGeometryUpdateTransforms = true;
 
 int gdCustomGeometryClass = 0;
 
@@ -865,6 +875,17 @@ int GeometryGeometryCollide(Geometry::AnyCollisionGeometry3D& g1,Real outerMargi
   return 0;
 }
 
+void dCustomGeometryUpdateTransform(dGeomID o)
+{
+  if(dGeomGetClass(o) != gdCustomGeometryClass) return;
+  CustomGeometryData* d = dGetCustomGeometryData(o);
+  RigidTransform T;
+  CopyMatrix(T.R,dGeomGetRotation(o));
+  CopyVector(T.t,dGeomGetPosition(o));
+  T.t += T.R*d->odeOffset;
+  d->geometry->SetTransform(T);
+}
+
 int dCustomGeometryCollide (dGeomID o1, dGeomID o2, int flags,
 			   dContactGeom *contact, int skip)
 {
@@ -873,16 +894,10 @@ int dCustomGeometryCollide (dGeomID o1, dGeomID o2, int flags,
   //printf("CustomGeometry collide\n");
   CustomGeometryData* d1 = dGetCustomGeometryData(o1);
   CustomGeometryData* d2 = dGetCustomGeometryData(o2);
-  RigidTransform T1;
-  RigidTransform T2;
-  CopyMatrix(T1.R,dGeomGetRotation(o1));
-  CopyVector(T1.t,dGeomGetPosition(o1));
-  CopyMatrix(T2.R,dGeomGetRotation(o2));
-  CopyVector(T2.t,dGeomGetPosition(o2));
-  T1.t += T1.R*d1->odeOffset;
-  T2.t += T2.R*d2->odeOffset;
-  d1->geometry->SetTransform(T1);
-  d2->geometry->SetTransform(T2);
+  if(gCustomGeometryUpdateTransforms) {
+    dCustomGeometryUpdateTransform(o1);
+    dCustomGeometryUpdateTransform(o2);
+  }
 
   int n=GeometryGeometryCollide(*d1->geometry,d1->outerMargin,*d2->geometry,d2->outerMargin,contact,m);
 
@@ -905,11 +920,7 @@ void dCustomGeometryAABB(dGeomID o,dReal aabb[6])
 {
   CustomGeometryData* d = dGetCustomGeometryData(o);
   AABB3D bb;
-  RigidTransform T;
-  CopyMatrix(T.R,dGeomGetRotation(o));
-  CopyVector(T.t,dGeomGetPosition(o));  
-  T.t += T.R*d->odeOffset;
-  d->geometry->SetTransform(T);
+  dCustomGeometryUpdateTransform(o);
   bb = d->geometry->GetAABB();
   bb.bmin -= Vector3(d->outerMargin,d->outerMargin,d->outerMargin);
   bb.bmax += Vector3(d->outerMargin,d->outerMargin,d->outerMargin);
@@ -947,3 +958,8 @@ void ClearCustomGeometryCollisionReliableFlag()
 {
   gCustomGeometryMeshesIntersect = false;
 }
+
+void SetCustomGeometryTransformUpdate(bool update)
+{
+  gCustomGeometryUpdateTransforms = update;
+}
@@ -23,9 +23,18 @@ struct CustomGeometryData
 dGeomID dCreateCustomGeometry(AnyCollisionGeometry3D* geom,Real outerMargin=0);
 CustomGeometryData* dGetCustomGeometryData(dGeomID o);
 void InitODECustomGeometry();
+///Sets the transform of the underlying geometry from the pose of the ODE
+///geom.  Does nothing if o is not a custom geometry.
+void dCustomGeometryUpdateTransform(dGeomID o);
+
+///By default the collider sets the transforms of both geometries before
+///testing them.  If several threads collide pairs that share a geometry,
+///call dCustomGeometryUpdateTransform on each geom beforehand and turn this
+///off (thread-local) in the colliding threads.
+void SetCustomGeometryTransformUpdate(bool update);
 
 ///if the underlying meshes had a collision, the result is flagged as
-///unreliable in a global flag.
+///unreliable in a thread-local flag.
 bool GetCustomGeometryCollisionReliableFlag();
 ///Resets the reliability flag to true
 void ClearCustomGeometryCollisionReliableFlag();
@@ -2,48 +2,37 @@
 #include "ODECommon.h"
 #include "ODECustomGeometry.h"
 #include "Settings.h"
+#include "SimulationProfiler.h"
 #include <list>
+#include <algorithm>
 #include <fstream>
+#include <mutex>
+#include <string.h>
 //#include "Geometry/Clusterize.h"
 #include <KrisLibrary/geometry/ConvexHull2D.h>
-#include <KrisLibrary/statistics/KMeans.h>
 #include <KrisLibrary/statistics/HierarchicalClustering.h>
 #include <KrisLibrary/utils/EquivalenceMap.h>
 #include <KrisLibrary/utils/permutation.h>
 #include <ode/ode.h>
 #include <KrisLibrary/Timer.h>
 #include <KrisLibrary/myfile.h>
+#include "Modeling/ThreadPool.h"
 #ifndef WIN32
 #include <unistd.h>
 #endif //WIN32
 
 #define TEST_READ_WRITE_STATE 0
-#define DO_TIMING 0
 
 const static size_t gMaxKMeansSize = 5000;
 const static size_t gMaxHClusterSize = 2000;
-static size_t gPreclusterContacts = 0;
-static double gClusterTime = 0;
-static double gContactDetectTime = 0;
 
 //if at the beginning of the timestep, the two objects are touching with depth d in the boundary layer
 //of size m, but after the timestep, they are penetrating the boundary layer, the sim will roll back
 //until the new depth d' gives a remaining margin of (m-d') >= c*(m-d) where c<1 is this fraction.
 const static double gRollbackPenetrationFraction = 0.5;  
 
-//stuff for contact detection callbacks
-struct ODEContactResult
-{
-  dGeomID o1,o2;
-  vector<dContactGeom> contacts;
-  vector<dJointFeedback> feedback;
-  bool meshOverlap;
-};
-
+//maximum number of contacts generated by a single geom pair
 const static int max_contacts = 1000;
-static dContactGeom gContactTemp[max_contacts];
-static list<ODEContactResult> gContacts;
-static vector<ODEContactResult*> gContactsVector;
 
 
 //Method for identifying objects via dGeomSetData/dGeomGetData
@@ -80,6 +69,177 @@ ODEObjectID GeomDataToObjectID(void* p)
   return ODEObjectID();
 }
 
+//Grows v to hold at least n elements.  The buffers are never shrunk, so
+//the size of v is also its capacity.  Returns true if memory was allocated.
+template <class T>
+bool GrowBuffer(vector<T>& v,size_t n)
+{
+  if(n <= v.size()) return false;
+  bool allocated = false;
+  if(n > v.capacity()) {
+    v.reserve(Max(n,2*v.capacity()));
+    allocated = true;
+  }
+  v.resize(v.capacity());
+  return allocated;
+}
+
+//Resizes v to n elements, keeping its capacity.  Returns true if memory was
+//allocated.
+template <class T>
+bool ResizeBuffer(vector<T>& v,size_t n)
+{
+  bool allocated = false;
+  if(n > v.capacity()) {
+    v.reserve(Max(n,2*v.capacity()));
+    allocated = true;
+  }
+  v.resize(n);
+  return allocated;
+}
+
+ODEContactArena::ODEContactArena()
+  :numContacts(0),numBufferGrowths(0)
+{}
+
+void ODEContactArena::Clear()
+{
+  results.resize(0);
+  numContacts = 0;
+}
+
+dContactGeom* ODEContactArena::Reserve(int n)
+{
+  Assert(n > 0);
+  if(GrowBuffer(contacts,numContacts+n)) numBufferGrowths++;
+  return &contacts[numContacts];
+}
+
+void ODEContactArena::AddResult(dGeomID o1,dGeomID o2,int n,bool meshOverlap)
+{
+  Assert(numContacts+n <= (int)contacts.size());
+  if(results.size() == results.capacity()) numBufferGrowths++;
+  ODEContactResult res;
+  res.o1 = o1;
+  res.o2 = o2;
+  res.contactStart = numContacts;
+  res.numContacts = n;
+  res.meshOverlap = meshOverlap;
+  results.push_back(res);
+  numContacts += n;
+}
+
+void ODEContactArena::SetupFeedback()
+{
+  if(GrowBuffer(feedback,numContacts+1)) numBufferGrowths++;
+}
+
+ODEContactCache::ODEContactCache()
+  :numContactsUsed(0),numContactsFree(0),numBufferGrowths(0)
+{}
+
+void ODEContactCache::Clear()
+{
+  index.resize(0);
+  entries.resize(0);
+  freeSlots.resize(0);
+  numContactsUsed = numContactsFree = 0;
+}
+
+void ODEContactCache::Copy(const ODEContactCache& cache)
+{
+  if(ResizeBuffer(index,cache.index.size())) numBufferGrowths++;
+  copy(cache.index.begin(),cache.index.end(),index.begin());
+  if(ResizeBuffer(entries,cache.entries.size())) numBufferGrowths++;
+  copy(cache.entries.begin(),cache.entries.end(),entries.begin());
+  if(ResizeBuffer(freeSlots,cache.freeSlots.size())) numBufferGrowths++;
+  copy(cache.freeSlots.begin(),cache.freeSlots.end(),freeSlots.begin());
+  if(ResizeBuffer(contacts,cache.numContactsUsed)) numBufferGrowths++;
+  copy(cache.contacts.begin(),cache.contacts.begin()+cache.numContactsUsed,contacts.begin());
+  numContactsUsed = cache.numContactsUsed;
+  numContactsFree = cache.numContactsFree;
+}
+
+int ODEContactCache::Lookup(const Key& key,int pass)
+{
+  vector<pair<Key,int> >::iterator i=lower_bound(index.begin(),index.end(),pair<Key,int>(key,-1));
+  int slot;
+  if(i != index.end() && !(key < i->first)) 
+    slot = i->second;
+  else {
+    if(freeSlots.empty()) {
+      slot = (int)entries.size();
+      if(ResizeBuffer(entries,entries.size()+1)) numBufferGrowths++;
+    }
+    else {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    entries[slot] = ODEContactCacheEntry();
+    if(index.size() == index.capacity()) numBufferGrowths++;
+    index.insert(i,pair<Key,int>(key,slot));
+  }
+  entries[slot].lastUsed = pass;
+  return slot;
+}
+
+ODECachedContact* ODEContactCache::Reserve(ODEContactCacheEntry& e,int n)
+{
+  if(n > e.contactCapacity) {
+    //the old space is left unused until the next compaction
+    numContactsFree += e.contactCapacity;
+    e.contactStart = numContactsUsed;
+    e.contactCapacity = n;
+    numContactsUsed += n;
+    if(ResizeBuffer(contacts,numContactsUsed)) numBufferGrowths++;
+  }
+  return &contacts[e.contactStart];
+}
+
+//Orders cache slots by the start of their contacts
+struct ContactStartOrder
+{
+  ContactStartOrder(const vector<ODEContactCacheEntry>& _entries) : entries(_entries) {}
+  bool operator ()(int a,int b) const { return entries[a].contactStart < entries[b].contactStart; }
+  const vector<ODEContactCacheEntry>& entries;
+};
+
+void ODEContactCache::DropUnused(int pass)
+{
+  size_t k=0;
+  for(size_t i=0;i<index.size();i++) {
+    ODEContactCacheEntry& e = entries[index[i].second];
+    if(e.lastUsed == pass) {
+      index[k++] = index[i];
+      continue;
+    }
+    numContactsFree += e.contactCapacity;
+    e.contactCapacity = 0;
+    if(freeSlots.size() == freeSlots.capacity()) numBufferGrowths++;
+    freeSlots.push_back(index[i].second);
+  }
+  index.resize(k);
+  //compact the contacts of the remaining entries once half of the buffer
+  //is unused.  Moving the entries down in order of their start never
+  //overwrites contacts that have not been moved yet.
+  if(numContactsFree == 0 || 2*numContactsFree < numContactsUsed) return;
+  if(ResizeBuffer(compactOrder,index.size())) numBufferGrowths++;
+  for(size_t i=0;i<index.size();i++)
+    compactOrder[i] = index[i].second;
+  sort(compactOrder.begin(),compactOrder.end(),ContactStartOrder(entries));
+  int n = 0;
+  for(size_t i=0;i<compactOrder.size();i++) {
+    ODEContactCacheEntry& e = entries[compactOrder[i]];
+    copy(contacts.begin()+e.contactStart,contacts.begin()+e.contactStart+e.contactCapacity,contacts.begin()+n);
+    e.contactStart = n;
+    n += e.contactCapacity;
+  }
+  Assert(n == numContactsUsed-numContactsFree);
+  contacts.resize(n);
+  numContactsUsed = n;
+  numContactsFree = 0;
+}
+
 template <class T>
 bool TestReadWriteState(T& obj,const char* name="")
 {
@@ -150,6 +310,14 @@ ODESimulatorSettings::ODESimulatorSettings()
 
   maxContacts = 20;
   clusterNormalScale = 0.1;
+  collisionThreads = gCollisionThreads;
+  contactCaching = gContactCaching;
+  contactCacheTranslationTolerance = gContactCacheTranslationTolerance;
+  contactCacheRotationTolerance = gContactCacheRotationTolerance;
+  autoDisable = gAutoDisable;
+  autoDisableLinearThreshold = gAutoDisableLinearThreshold;
+  autoDisableAngularThreshold = gAutoDisableAngularThreshold;
+  autoDisableTime = gAutoDisableTime;
 
   errorReductionParameter = 0.95;
   dampedLeastSquaresParameter = 1e-6;
@@ -167,27 +335,32 @@ inline Real CFMFromSpring(Real timestep,Real kP,Real kD)
 
 
 
+//ODE is initialized by the first ODESimulator.  Simulators may be
+//constructed on several threads at once, so Init() runs the initialization
+//under a once-flag.
 struct ODEObject 
 {
   bool gODEInitialized;
+  std::once_flag initFlag;
   ODEObject () : gODEInitialized(false) {}
   void Init() {
-    if(!gODEInitialized) {
-      #ifdef dDOUBLE
-      if(dCheckConfiguration("ODE_double_precision")!=1) {
-	FatalError("ODE is compiled with single precision but Klamp't is compiled with double, either reconfigure ODE with --enable-double-precision or recompile Klamp't with dDOUBLE");
-      }
-      #else
-      if(dCheckConfiguration("ODE_single_precision")!=1) {
-	FatalError("ODE is compiled with double precision but Klamp't is compiled with single, either reconfigure ODE without --enable-double-precision or recompile Klamp't with dSINGLE");
-      }
-      #endif
-
-      printf("Initializing ODE...\n");
-      dInitODE();
-      InitODECustomGeometry();
-      gODEInitialized = true;
+    std::call_once(initFlag,&ODEObject::DoInit,this);
+  }
+  void DoInit() {
+    #ifdef dDOUBLE
+    if(dCheckConfiguration("ODE_double_precision")!=1) {
+      FatalError("ODE is compiled with single precision but Klamp't is compiled with double, either reconfigure ODE with --enable-double-precision or recompile Klamp't with dDOUBLE");
+    }
+    #else
+    if(dCheckConfiguration("ODE_single_precision")!=1) {
+      FatalError("ODE is compiled with double precision but Klamp't is compiled with single, either reconfigure ODE without --enable-double-precision or recompile Klamp't with dSINGLE");
     }
+    #endif
+
+    printf("Initializing ODE...\n");
+    dInitODE();
+    InitODECustomGeometry();
+    gODEInitialized = true;
   }
   ~ODEObject() { 
     if(gODEInitialized) {
@@ -208,6 +381,11 @@ ODESimulator::ODESimulator()
   simTime = 0;
   timestep = 0;
   lastStateTimestep = 0;
+  detectionPass = 0;
+  contactJointPeak = contactJointGrowths = 0;
+  profiler = NULL;
+  collisionPool = NULL;
+  contactCacheHits = contactCacheMisses = 0;
 
   g_ODE_object.Init();
   worldID = dWorldCreate();
@@ -241,6 +419,7 @@ void ODESimulator::SetCFM(double cfm)
 
 ODESimulator::~ODESimulator()
 {
+  delete collisionPool;
   dJointGroupDestroy(contactGroupID);
   for(size_t i=0;i<terrainGeoms.size();i++)
     delete terrainGeoms[i];
@@ -339,7 +518,9 @@ void GetCurrentCollisionStatus(ODESimulator* sim,
 {
   marginsRemaining.clear();
   concernedObjects.resize(0);
-  for(list<ODEContactResult>::iterator i=gContacts.begin();i!=gContacts.end();i++) {
+  const ODEContactArena& arena = sim->contactArena;
+  for(size_t r=0;r<arena.results.size();r++) {
+    const ODEContactResult* i = &arena.results[r];
     CollisionPair collpair(GeomDataToObjectID(dGeomGetData(i->o1)),GeomDataToObjectID(dGeomGetData(i->o2)));
     if(collpair.second < collpair.first) 
       swap(collpair.first,collpair.second);
@@ -360,8 +541,9 @@ void GetCurrentCollisionStatus(ODESimulator* sim,
       double margin = g1->outerMargin + g2->outerMargin;
       double depth = 0;
       string id1=sim->ObjectName(collpair.first),id2=sim->ObjectName(collpair.second);
-      for(size_t j=0;j<i->contacts.size();j++)
-        depth = Max(depth,(double)i->contacts[j].depth);
+      const dContactGeom* contacts = arena.Contacts(*i);
+      for(int j=0;j<i->numContacts;j++)
+        depth = Max(depth,(double)contacts[j].depth);
       //printf("ODESimulation: normal penetration depth between bodies %s and %s is %g/%g\n",id1.c_str(),id2.c_str(),depth,margin);
       double oldmargin = (sim->lastMarginsRemaining.count(collpair) == 0 ? margin : sim->lastMarginsRemaining[collpair]);
       if((margin - depth) < gRollbackPenetrationFraction*oldmargin) {
@@ -421,20 +603,14 @@ void PrintStatus(ODESimulator* sim,const vector<CollisionPair >& concernedObject
 void ODESimulator::Step(Real dt)
 {
   Assert(timestep == 0);
-
-#if DO_TIMING
-  Timer timer;
-  double collisionTime,stepTime,updateTime;
-  gContactDetectTime = gClusterTime = 0;
-  gPreclusterContacts = 0;
-#endif // DO_TIMING
+  contactArena.numBufferGrowths = 0;
+  contactCache.numBufferGrowths = 0;
+  contactJointGrowths = 0;
+  contactCacheHits = contactCacheMisses = 0;
+  UpdateSleepActivity();
+  if(profiler) profiler->AddCount("rollbacks",0);
 
   if(settings.adaptiveTimeStepping) {
-#if DO_TIMING
-    collisionTime = 0;
-    stepTime = 0;
-#endif
-
     //normal adaptive time step method:
     //ATS(dt)
     //1. valid_time <- 0, timestep <- dt, desired_time = dt
@@ -481,10 +657,6 @@ void ODESimulator::Step(Real dt)
   		bool didRollback = false;
   		while(true) {
   		  DetectCollisions();
-  	#if DO_TIMING
-  		  collisionTime += timer.ElapsedTime();
-  		  timer.Reset();
-  	#endif // DO_TIMING
   		  //determine whether to rollback
         bool rollback = false;
         map<CollisionPair,double> marginsRemaining;
@@ -515,7 +687,7 @@ void ODESimulator::Step(Real dt)
             }
           }
         }
-  		  if(rollback && !lastState.IsOpen()) {
+  		  if(rollback && lastState.IsEmpty()) {
           //printf("ODESimulation: Rollback rejected because last state not saved\n");
           getchar();
           rollback = false;
@@ -543,8 +715,7 @@ void ODESimulator::Step(Real dt)
           Assert(temp.IsOpen());
           WriteState(temp);
           
-          lastState.Seek(0,FILESEEKSTART);
-          ReadState(lastState);
+          RestoreSnapshot(lastState);
           printf("STARTING CONFIGURATION:\n");
           PrintStatus(this,concernedObjects,"Concerned objects originally","had");
           DetectCollisions();
@@ -581,8 +752,8 @@ void ODESimulator::Step(Real dt)
           //PrintStatus(this,concernedObjects,"Backing up colliding objects","from");
           
           didRollback = true;
-          lastState.Seek(0,FILESEEKSTART);
-          ReadState(lastState);
+          if(profiler) profiler->AddCount("rollbacks");
+          RestoreSnapshot(lastState);
           timestep *= 0.5;
 
           //PrintStatus(this,concernedObjects,"Backed up colliding objects","to previous");
@@ -602,11 +773,7 @@ void ODESimulator::Step(Real dt)
   		  }
   		  else {
           //accept prior step
-          lastState.Close();
-          bool res = lastState.OpenData(FILEREAD | FILEWRITE);
-          Assert(res);
-          Assert(lastState.IsOpen());
-          WriteState(lastState);
+          SaveSnapshot(lastState);
           for(size_t i=0;i<concernedObjects.size();i++) {
             if(marginsRemaining.count(concernedObjects[i]) == 0) {
               //printf("ODESimulation: collision %s - %s erased entirely\n",ObjectName(concernedObjects[i].first).c_str(),ObjectName(concernedObjects[i].second).c_str());
@@ -652,14 +819,11 @@ void ODESimulator::Step(Real dt)
   		//first step
   		timestep=dt;
   		DetectCollisions();
-  	#if DO_TIMING
-  		collisionTime += timer.ElapsedTime();
-  		timer.Reset();
-  	#endif // DO_TIMING
   		//determine whether to rollback
   		bool rollback = false;
   		map<CollisionPair,double> marginsRemaining;
-  		for(list<ODEContactResult>::iterator i=gContacts.begin();i!=gContacts.end();i++) {
+  		for(size_t r=0;r<contactArena.results.size();r++) {
+  		  const ODEContactResult* i = &contactArena.results[r];
   		  CollisionPair collpair(GeomDataToObjectID(dGeomGetData(i->o1)),GeomDataToObjectID(dGeomGetData(i->o2)));
   		  if(i->meshOverlap) { 
   		    rollback = true;
@@ -672,8 +836,9 @@ void ODESimulator::Step(Real dt)
           CustomGeometryData* g2 = dGetCustomGeometryData(i->o2);
           double margin = g1->outerMargin + g2->outerMargin;
           double depth = 0;
-          for(size_t j=0;j<i->contacts.size();j++)
-            depth = Max(depth,(double)i->contacts[j].depth);
+          const dContactGeom* contacts = contactArena.Contacts(*i);
+          for(int j=0;j<i->numContacts;j++)
+            depth = Max(depth,(double)contacts[j].depth);
           marginsRemaining[collpair] = margin - depth;
         }
   		}
@@ -693,10 +858,7 @@ void ODESimulator::Step(Real dt)
   		}
       
   		//save state
-  		lastState.Close();
-  		bool res = lastState.OpenData(FILEREAD | FILEWRITE);
-  		Assert(lastState.IsOpen());
-  		WriteState(lastState);
+  		SaveSnapshot(lastState);
   		lastMarginsRemaining = marginsRemaining;
   	}
     //do the prospective time step for the next call
@@ -708,42 +870,33 @@ void ODESimulator::Step(Real dt)
   else {
     //plain old constant time-stepping
 
-    gContacts.clear();
-    gContactsVector.resize(0);
+    contactArena.Clear();
     
     timestep=dt;
     DetectCollisions();
     SetupContactResponse();
 
-  //printf("  %d contacts detected\n",gContacts.size());
-
-#if DO_TIMING
-    collisionTime = timer.ElapsedTime();
-    timer.Reset();
-#endif // DO_TIMING
+  //printf("  %d contacts detected\n",contactArena.numContacts);
 
     StepDynamics(dt);
     simTime += dt;
-
-#if DO_TIMING
-    stepTime = timer.ElapsedTime();
-    timer.Reset();
-#endif // DO_TIMING
   }
 
   //copy out feedback forces
+  Real feedbackStart = (profiler ? profiler->Begin() : 0);
   for(map<CollisionPair,ODEContactList>::iterator i=contactList.begin();i!=contactList.end();i++) {  
     ODEContactList& cl=i->second;
     cl.forces.clear();
     cl.penetrating = false;
     for(size_t j=0;j<cl.feedbackIndices.size();j++) {
       int k=cl.feedbackIndices[j];
-      Assert(k >= 0 && k < (int)gContactsVector.size());
-      ODEContactResult* cres = gContactsVector[k];
+      Assert(k >= 0 && k < (int)contactArena.results.size());
+      const ODEContactResult* cres = &contactArena.results[k];
       if(cres->meshOverlap) cl.penetrating = true;
+      const dJointFeedback* feedback = contactArena.Feedback(*cres);
       Vector3 temp;
-      for(size_t i=0;i<cres->feedback.size();i++) {
-	CopyVector(temp,cres->feedback[i].f1);
+      for(int i=0;i<cres->numContacts;i++) {
+	CopyVector(temp,feedback[i].f1);
 	cl.forces.push_back(temp);
 	/*
 	if(!cl.points.back().isValidForce(-temp)) {
@@ -756,27 +909,13 @@ void ODESimulator::Step(Real dt)
     if(!cl.feedbackIndices.empty())
       Assert(cl.points.size() == cl.forces.size());
   }
+  if(profiler) profiler->End("feedback",feedbackStart);
 
+  UpdateSleeping(dt);
   timestep = 0;
 
-#if DO_TIMING
-  updateTime = timer.ElapsedTime();
-#endif //DO_TIMING
-
-#if DO_TIMING
-  ofstream out("odesimulator_timing.csv",ios::app);
-  if(out.tellp()==0) {
-    cout<<"Saving to odesimulator_timing.csv"<<endl;
-    out<<"total,#preclusterContacts,#contacts,collision detection,contact detect,clustering,dynamics step,misc update"<<endl;
-  }
-  size_t nc = 0;
-  for(list<ODEContactResult>::iterator i=gContacts.begin();i!=gContacts.end();i++)
-    nc += i->contacts.size();
-  out<<collisionTime+stepTime+updateTime<<","<<gPreclusterContacts<<","<<nc<<","<<collisionTime<<","<<gContactDetectTime<<","<<gClusterTime<<","<<stepTime<<","<<updateTime<<endl;
-#endif
-
   //KH: commented this out so GetContacts() would work for ContactSensor simulation.  Be careful about loading state
-  //gContacts.clear();
+  //contactArena.Clear();
 }
 
 
@@ -975,79 +1114,110 @@ void ClusterContactsMerge(vector<dContactGeom>& contacts,int maxClusters,Real cl
   }
 }
 
-void ClusterContactsKMeans(vector<dContactGeom>& contacts,int maxClusters,Real clusterNormalScale)
+//Lloyd's k-means on the contacts of r, treated as 7-D points (position,
+//scaled normal, depth).  Works in place using the scratch space of the
+//arena.  The initial centers are picked deterministically.
+void ClusterContactsKMeans(ODEContactArena& arena,ODEContactResult& r,int maxClusters,Real clusterNormalScale)
 {
-  if((int)contacts.size() <= maxClusters) return;
-  vector<Vector> pts(contacts.size());
-  for(size_t i=0;i<pts.size();i++) {
-    pts[i].resize(7);
-    pts[i][0] = contacts[i].pos[0];
-    pts[i][1] = contacts[i].pos[1];
-    pts[i][2] = contacts[i].pos[2];
-    pts[i][3] = contacts[i].normal[0]*clusterNormalScale;
-    pts[i][4] = contacts[i].normal[1]*clusterNormalScale;
-    pts[i][5] = contacts[i].normal[2]*clusterNormalScale;
-    pts[i][6] = contacts[i].depth;
-  }
+  const int d = 7;
+  int n = r.numContacts;
+  if(n <= maxClusters) return;
+  dContactGeom* contacts = arena.Contacts(r);
+  if(GrowBuffer(arena.clusterPoints,n*d)) arena.numBufferGrowths++;
+  if(GrowBuffer(arena.clusterLabels,n)) arena.numBufferGrowths++;
+  if(GrowBuffer(arena.clusterCenters,maxClusters*d)) arena.numBufferGrowths++;
+  if(GrowBuffer(arena.clusterCounts,maxClusters)) arena.numBufferGrowths++;
+  double* pts = &arena.clusterPoints[0];
+  int* labels = &arena.clusterLabels[0];
+  double* centers = &arena.clusterCenters[0];
+  int* counts = &arena.clusterCounts[0];
+  for(int i=0;i<n;i++) {
+    double* p = pts+i*d;
+    p[0] = contacts[i].pos[0];
+    p[1] = contacts[i].pos[1];
+    p[2] = contacts[i].pos[2];
+    p[3] = contacts[i].normal[0]*clusterNormalScale;
+    p[4] = contacts[i].normal[1]*clusterNormalScale;
+    p[5] = contacts[i].normal[2]*clusterNormalScale;
+    p[6] = contacts[i].depth;
+    labels[i] = -1;
+  }
+  for(int c=0;c<maxClusters;c++)
+    copy(pts+((c*n)/maxClusters)*d,pts+((c*n)/maxClusters+1)*d,centers+c*d);
 
-  Statistics::KMeans kmeans(pts,maxClusters);
-  //randomized
-  //kmeans.RandomInitialCenters();
-  //deterministic
-  for(size_t i=0;i<kmeans.centers.size();i++)
-    kmeans.centers[i] = kmeans.data[(i*pts.size())/kmeans.centers.size()];
   int iters=20;
-  kmeans.Iterate(iters);
-  contacts.resize(kmeans.centers.size());
-  vector<int> degenerate;
-  for(size_t i=0;i<contacts.size();i++) {
-    contacts[i].pos[0] = kmeans.centers[i][0];
-    contacts[i].pos[1] = kmeans.centers[i][1];
-    contacts[i].pos[2] = kmeans.centers[i][2];
-    contacts[i].normal[0] = kmeans.centers[i][3]/clusterNormalScale;
-    contacts[i].normal[1] = kmeans.centers[i][4]/clusterNormalScale;
-    contacts[i].normal[2] = kmeans.centers[i][5]/clusterNormalScale;
-    contacts[i].depth = kmeans.centers[i][6];
-    Real len = Vector3(contacts[i].normal[0],contacts[i].normal[1],contacts[i].normal[2]).length();
-    if(FuzzyZero(len) || !IsFinite(len)) {
-      printf("ODESimulator: Warning, clustered normal became zero/infinite\n");
-      //pick any in the cluster
-      int found = -1;
-      for(size_t k=0;k<kmeans.labels.size();k++) {
-	if(kmeans.labels[k] == (int)i) {
-	  found = (int)k;
-	  break;
+  for(int iter=0;iter<iters;iter++) {
+    bool changed = false;
+    for(int i=0;i<n;i++) {
+      const double* p = pts+i*d;
+      int best = 0;
+      double bestDist = Inf;
+      for(int c=0;c<maxClusters;c++) {
+	const double* m = centers+c*d;
+	double dist = 0;
+	for(int k=0;k<d;k++) dist += Sqr(p[k]-m[k]);
+	if(dist < bestDist) {
+	  bestDist = dist;
+	  best = c;
 	}
       }
-      if(found < 0) {
-	//strange -- degenerate cluster?
-	degenerate.push_back(i);
-	continue;
+      if(labels[i] != best) {
+	labels[i] = best;
+	changed = true;
       }
-      contacts[i].pos[0] = pts[found][0];
-      contacts[i].pos[1] = pts[found][1];
-      contacts[i].pos[2] = pts[found][2];
-      contacts[i].normal[0] = pts[found][3];
-      contacts[i].normal[1] = pts[found][4];
-      contacts[i].normal[2] = pts[found][5];
-      Real len = Vector3(contacts[i].normal[0],contacts[i].normal[1],contacts[i].normal[2]).length();
-      contacts[i].normal[0] /= len;
-      contacts[i].normal[1] /= len;
-      contacts[i].normal[2] /= len;
-      contacts[i].depth = pts[found][6];
-      continue;
     }
-    contacts[i].normal[0] /= len;
-    contacts[i].normal[1] /= len;
-    contacts[i].normal[2] /= len;
-    //cout<<"Clustered contact "<<contacts[i].pos[0]<<" "<<contacts[i].pos[1]<<" "<<contacts[i].pos[2]<<endl;
-    //cout<<"Clustered normal "<<contacts[i].normal[0]<<" "<<contacts[i].normal[1]<<" "<<contacts[i].normal[2]<<endl;
-    contacts[i].depth = kmeans.centers[i][6];
-  }
-  reverse(degenerate.begin(),degenerate.end());
-  for(size_t i=0;i<degenerate.size();i++) {
-    contacts.erase(contacts.begin()+degenerate[i]);
+    if(!changed) break;
+    fill(centers,centers+maxClusters*d,0.0);
+    fill(counts,counts+maxClusters,0);
+    for(int i=0;i<n;i++) {
+      double* m = centers+labels[i]*d;
+      for(int k=0;k<d;k++) m[k] += pts[i*d+k];
+      counts[labels[i]]++;
+    }
+    for(int c=0;c<maxClusters;c++)
+      if(counts[c] > 0)
+	for(int k=0;k<d;k++) centers[c*d+k] /= counts[c];
+  }
+
+  //read out the clusters, dropping empty ones
+  fill(counts,counts+maxClusters,0);
+  for(int i=0;i<n;i++) counts[labels[i]]++;
+  int numClusters = 0;
+  for(int c=0;c<maxClusters;c++) {
+    if(counts[c] == 0) continue;
+    const double* m = centers+c*d;
+    dContactGeom& x = contacts[numClusters];
+    numClusters++;
+    x.pos[0] = m[0];
+    x.pos[1] = m[1];
+    x.pos[2] = m[2];
+    x.normal[0] = m[3]/clusterNormalScale;
+    x.normal[1] = m[4]/clusterNormalScale;
+    x.normal[2] = m[5]/clusterNormalScale;
+    x.depth = m[6];
+    Real len = Vector3(x.normal[0],x.normal[1],x.normal[2]).length();
+    if(FuzzyZero(len) || !IsFinite(len)) {
+      printf("ODESimulator: Warning, clustered normal became zero/infinite\n");
+      //pick any in the cluster
+      int found = 0;
+      while(labels[found] != c) found++;
+      const double* p = pts+found*d;
+      x.pos[0] = p[0];
+      x.pos[1] = p[1];
+      x.pos[2] = p[2];
+      x.normal[0] = p[3];
+      x.normal[1] = p[4];
+      x.normal[2] = p[5];
+      x.depth = p[6];
+      len = Vector3(x.normal[0],x.normal[1],x.normal[2]).length();
+    }
+    x.normal[0] /= len;
+    x.normal[1] /= len;
+    x.normal[2] /= len;
+    //cout<<"Clustered contact "<<x.pos[0]<<" "<<x.pos[1]<<" "<<x.pos[2]<<endl;
+    //cout<<"Clustered normal "<<x.normal[0]<<" "<<x.normal[1]<<" "<<x.normal[2]<<endl;
   }
+  r.numContacts = numClusters;
 }
 
 
@@ -1057,35 +1227,23 @@ bool depthGreater(const dContactGeom& a,const dContactGeom& b)
 }
 
 
-void ClusterContacts(vector<dContactGeom>& contacts,int maxClusters,Real clusterNormalScale)
+void ClusterContacts(ODEContactArena& arena,ODEContactResult& r,int maxClusters,Real clusterNormalScale)
 {
-  gPreclusterContacts += contacts.size();
-
   //for really big contact sets, do a subsampling
-  if(contacts.size()*maxClusters > gMaxKMeansSize && contacts.size()*contacts.size() > gMaxHClusterSize) {
+  size_t n = (size_t)r.numContacts;
+  if(n*maxClusters > gMaxKMeansSize && n*n > gMaxHClusterSize) {
     int minsize = Max((int)gMaxKMeansSize/maxClusters,(int)Sqrt(Real(gMaxHClusterSize)));
-    printf("ClusterContacts: subsampling %d to %d contacts\n",(int)contacts.size(),minsize);
-    vector<dContactGeom> subcontacts(minsize);
-    //random subsample
-    /*
-    vector<int> subsample(contacts.size());
-    RandomPermutation(subsample);
-    subsample.resize(minsize);
-    for(size_t i=0;i<subsample.size();i++)
-      subcontacts[i] = contacts[subsample[i]];
-    */
-    //deterministic subsample
+    printf("ClusterContacts: subsampling %d to %d contacts\n",(int)n,minsize);
+    //deterministic subsample, in place (the source index is never greater
+    //than the destination)
+    dContactGeom* contacts = arena.Contacts(r);
     for(int i=0;i<minsize;i++) {
-      subcontacts[i] = contacts[(i*minsize)/contacts.size()];
+      contacts[i] = contacts[(i*minsize)/n];
     }
-    swap(subcontacts,contacts);
+    r.numContacts = minsize;
   }
-  size_t hclusterSize = contacts.size()*contacts.size();
-  size_t kmeansSize = contacts.size()*maxClusters;
-  //if(hclusterSize < gMaxHClusterSize)
   //ClusterContactsMerge(contacts,maxClusters,clusterNormalScale);
-  //else 
-  ClusterContactsKMeans(contacts,maxClusters,clusterNormalScale);
+  ClusterContactsKMeans(arena,r,maxClusters,clusterNormalScale);
   /*
   //TEST: contact depth sorting
   if(contacts.size() > maxClusters) {
@@ -1119,8 +1277,19 @@ void MergeContacts(vector<dContactGeom>& contacts,double posTolerance,double ori
   swap(contacts,res);
 }
 
+//Merges the n contacts in place.  Merging never adds contacts.
+void MergeContacts(dContactGeom* contacts,int& n,double posTolerance,double oriTolerance)
+{
+  vector<dContactGeom> temp(contacts,contacts+n);
+  MergeContacts(temp,posTolerance,oriTolerance);
+  Assert((int)temp.size() <= n);
+  copy(temp.begin(),temp.end(),contacts);
+  n = (int)temp.size();
+}
+
 void collisionCallback(void *data, dGeomID o1, dGeomID o2)
 {
+  ODESimulator* sim = reinterpret_cast<ODESimulator*>(data);
   Assert(!dGeomIsSpace(o1) && !dGeomIsSpace(o2));
 
   dBodyID b1 = dGeomGetBody(o1);
@@ -1134,53 +1303,14 @@ void collisionCallback(void *data, dGeomID o1, dGeomID o2)
   if( b1 && b2 && !dBodyIsEnabled(b1) && !dBodyIsEnabled(b2) )
    return; // both b1 and b2 are disabled
   
-  ClearCustomGeometryCollisionReliableFlag();
-  int num = dCollide (o1,o2,max_contacts,gContactTemp,sizeof(dContactGeom));
-  vector<dContactGeom> vcontact(num);
-  int numOk = 0;
-  for(int i=0;i<num;i++) {
-    if(gContactTemp[i].g1 == o2 && gContactTemp[i].g2 == o1) {
-      printf("Swapping contact\n");
-      std::swap(gContactTemp[i].g1,gContactTemp[i].g2);
-      for(int k=0;k<3;k++) gContactTemp[i].normal[k]*=-1.0;
-      std::swap(gContactTemp[i].side1,gContactTemp[i].side2);
-    }
-    Assert(gContactTemp[i].g1 == o1);
-    Assert(gContactTemp[i].g2 == o2);
-    vcontact[numOk] = gContactTemp[i];
-    const dReal* n=vcontact[numOk].normal;
-    if(Sqr(n[0])+Sqr(n[1])+Sqr(n[2]) < 0.9 || Sqr(n[0])+Sqr(n[1])+Sqr(n[2]) > 1.2) {
-      //GIMPACT will report this
-      //printf("Warning, degenerate contact with normal %f %f %f\n",vcontact[numOk].normal[0],vcontact[numOk].normal[1],vcontact[numOk].normal[2]);
-      continue;
-    }
-    numOk++;
-  }
-  vcontact.resize(numOk);
-  
-  if(vcontact.size() > 0) {
-    gContacts.push_back(ODEContactResult());
-    gContacts.back().o1 = o1;
-    gContacts.back().o2 = o2;
-    swap(gContacts.back().contacts,vcontact);
-    gContacts.back().meshOverlap = !GetCustomGeometryCollisionReliableFlag();
-  }
-  else {
-    if(!GetCustomGeometryCollisionReliableFlag()) {
-      printf("collision callback: meshes overlapped, but no contacts were generated?\n");
-      gContacts.push_back(ODEContactResult());
-      gContacts.back().o1 = o1;
-      gContacts.back().o2 = o2;
-      swap(gContacts.back().contacts,vcontact);
-      gContacts.back().meshOverlap = !GetCustomGeometryCollisionReliableFlag();
-    }
-  }
+  sim->candidatePairs.push_back(pair<dGeomID,dGeomID>(o1,o2));
 }
 
 void selfCollisionCallback(void *data, dGeomID o1, dGeomID o2)
 {
-  ODERobot* robot = reinterpret_cast<ODERobot*>(data);
+  ODESimulator* sim = reinterpret_cast<ODESimulator*>(data);
   Assert(!dGeomIsSpace(o1) && !dGeomIsSpace(o2));
+  ODERobot* robot = sim->robot(GeomDataToRobotIndex(dGeomGetData(o1)));
   int link1 = GeomDataToRobotLinkIndex(dGeomGetData(o1));
   int link2 = GeomDataToRobotLinkIndex(dGeomGetData(o2));
   Assert(link1 >= 0 && link1 < (int)robot->robot.links.size());
@@ -1188,61 +1318,329 @@ void selfCollisionCallback(void *data, dGeomID o1, dGeomID o2)
   if(robot->robot.selfCollisions(link1,link2)==NULL) {
     return;
   }
+  //the links of a sleeping robot are all disabled
+  dBodyID b1 = dGeomGetBody(o1);
+  if(b1 && !dBodyIsEnabled(b1)) return;
   
+  sim->candidatePairs.push_back(pair<dGeomID,dGeomID>(o1,o2));
+}
+
+//Generates the contacts between o1 and o2 into contacts, which must have
+//room for max_contacts.  Returns the number of contacts to keep, or -1 if
+//there is nothing to report for this pair.
+int CollideGeomPair(dGeomID o1,dGeomID o2,bool selfCollision,dContactGeom* contacts,bool& meshOverlap)
+{
   ClearCustomGeometryCollisionReliableFlag();
-  int num = dCollide (o1,o2,max_contacts,gContactTemp,sizeof(dContactGeom));
-  vector<dContactGeom> vcontact(num);
+  int num = dCollide (o1,o2,max_contacts,contacts,sizeof(dContactGeom));
   int numOk = 0;
   for(int i=0;i<num;i++) {
-    if(gContactTemp[i].g1 == o2 && gContactTemp[i].g2 == o1) {
+    if(contacts[i].g1 == o2 && contacts[i].g2 == o1) {
       printf("Swapping contact\n");
-      std::swap(gContactTemp[i].g1,gContactTemp[i].g2);
-      for(int k=0;k<3;k++) gContactTemp[i].normal[k]*=-1.0;
-      std::swap(gContactTemp[i].side1,gContactTemp[i].side2);
+      std::swap(contacts[i].g1,contacts[i].g2);
+      for(int k=0;k<3;k++) contacts[i].normal[k]*=-1.0;
+      std::swap(contacts[i].side1,contacts[i].side2);
     }
-    Assert(gContactTemp[i].g1 == o1);
-    Assert(gContactTemp[i].g2 == o2);
-    vcontact[numOk] = gContactTemp[i];
-    const dReal* n=vcontact[numOk].normal;
+    Assert(contacts[i].g1 == o1);
+    Assert(contacts[i].g2 == o2);
+    const dReal* n=contacts[i].normal;
     if(Sqr(n[0])+Sqr(n[1])+Sqr(n[2]) < 0.9 || Sqr(n[0])+Sqr(n[1])+Sqr(n[2]) > 1.2) {
-      printf("Warning, degenerate contact with normal %f %f %f\n",vcontact[numOk].normal[0],vcontact[numOk].normal[1],vcontact[numOk].normal[2]);
-      //continue;
+      if(!selfCollision) {
+	//GIMPACT will report this
+	//printf("Warning, degenerate contact with normal %f %f %f\n",n[0],n[1],n[2]);
+	continue;
+      }
+      printf("Warning, degenerate contact with normal %f %f %f\n",n[0],n[1],n[2]);
     }
+    if(numOk != i) contacts[numOk] = contacts[i];
     numOk++;
   }
-  //TEMP: printing self collisions
-  //if(numOk > 0) printf("%d self collision contacts between links %d and %d\n",numOk,(int)link1,(int)link2);
-  vcontact.resize(numOk);
-  
-  if(kMergeContacts && numOk > 0) {
-    MergeContacts(vcontact,kContactPosMergeTolerance,kContactOriMergeTolerance);
+  meshOverlap = !GetCustomGeometryCollisionReliableFlag();
+
+  if(selfCollision) {
+    //TEMP: printing self collisions
+    //if(numOk > 0) printf("%d self collision contacts between links %d and %d\n",numOk,(int)link1,(int)link2);
+    int numMerged = numOk;
+    if(kMergeContacts && numOk > 0) {
+      MergeContacts(contacts,numMerged,kContactPosMergeTolerance,kContactOriMergeTolerance);
+    }
+    if(numOk != numMerged)
+      cout<<numOk<<" contacts between link "<<GeomDataToRobotLinkIndex(dGeomGetData(o2))<<" and link "<<GeomDataToRobotLinkIndex(dGeomGetData(o1))<<"  (clustered to "<<numMerged<<")"<<endl;
+    return (numMerged > 0 ? numMerged : -1);
+  }
+  if(numOk == 0 && meshOverlap) {
+    printf("collision callback: meshes overlapped, but no contacts were generated?\n");
+    return 0;
+  }
+  return (numOk > 0 ? numOk : -1);
+}
+
+inline void GetGeomTransform(dGeomID o,RigidTransform& T)
+{
+  CopyMatrix(T.R,dGeomGetRotation(o));
+  CopyVector(T.t,dGeomGetPosition(o));
+}
+
+//Returns true if the cached contacts of (o1,o2) can be used at the geoms'
+//current poses
+bool ContactCacheHit(const ODEContactCacheEntry& entry,dGeomID o1,dGeomID o2,const ODESimulatorSettings& settings)
+{
+  if(entry.numContacts < -1) return false;
+  RigidTransform T1,T2,Trel,Tdiff;
+  GetGeomTransform(o1,T1);
+  GetGeomTransform(o2,T2);
+  Trel.mulInverseA(T1,T2);
+  Tdiff.mulInverseA(entry.relativeTransform,Trel);
+  if(Tdiff.t.norm() > settings.contactCacheTranslationTolerance) return false;
+  Real cosangle = Half*(Tdiff.R.trace()-One);
+  return cosangle >= Cos(settings.contactCacheRotationTolerance);
+}
+
+//Writes the cached contacts of (o1,o2) at the current pose of o1, and
+//returns their number (-1 if the pair has nothing to report).  The depth of
+//each contact is updated by how far its points on o1 and o2 have moved
+//toward each other along the normal, and contacts whose points have moved
+//apart by more than their depth are dropped.
+int ReadContactCache(const ODEContactCache& cache,const ODEContactCacheEntry& entry,dGeomID o1,dGeomID o2,dContactGeom* contacts)
+{
+  if(entry.numContacts <= 0) return entry.numContacts;
+  RigidTransform T1,T2;
+  GetGeomTransform(o1,T1);
+  GetGeomTransform(o2,T2);
+  const ODECachedContact* localContacts = cache.Contacts(entry);
+  Vector3 x,n,x1,x2,n1;
+  int num = 0;
+  for(int i=0;i<entry.numContacts;i++) {
+    const dContactGeom& c = localContacts[i].contact;
+    CopyVector(x,c.pos);
+    CopyVector(n,c.normal);
+    x1 = T1*x;
+    x2 = T2*localContacts[i].point2;
+    n1 = T1.R*n;
+    //moving o1 along the normal by depth separates the geoms
+    Real depth = c.depth + n1.dot(x2-x1);
+    if(depth < 0) continue;
+    contacts[num] = c;
+    CopyVector3(contacts[num].pos,x1);
+    CopyVector3(contacts[num].normal,n1);
+    contacts[num].depth = depth;
+    contacts[num].g1 = o1;
+    contacts[num].g2 = o2;
+    num++;
+  }
+  return (num > 0 ? num : -1);
+}
+
+//Stores the n contacts generated for (o1,o2).  Overlapping meshes are not
+//cached, so that the overlap is detected again on the next pass.
+void WriteContactCache(ODEContactCache& cache,ODEContactCacheEntry& entry,dGeomID o1,dGeomID o2,const dContactGeom* contacts,int n,bool meshOverlap)
+{
+  if(meshOverlap) {
+    entry.numContacts = -2;
+    return;
   }
+  RigidTransform T1,T2;
+  GetGeomTransform(o1,T1);
+  GetGeomTransform(o2,T2);
+  entry.relativeTransform.mulInverseA(T1,T2);
+  entry.numContacts = n;
+  if(n <= 0) return;
+  ODECachedContact* localContacts = cache.Reserve(entry,n);
+  Vector3 x,n1;
+  for(int i=0;i<n;i++) {
+    localContacts[i].contact = contacts[i];
+    CopyVector(x,contacts[i].pos);
+    CopyVector(n1,contacts[i].normal);
+    Vector3 xlocal,nlocal;
+    T1.mulInverse(x,xlocal);
+    T1.R.mulTranspose(n1,nlocal);
+    CopyVector3(localContacts[i].contact.pos,xlocal);
+    CopyVector3(localContacts[i].contact.normal,nlocal);
+    T2.mulInverse(x,localContacts[i].point2);
+  }
+}
 
-  if(vcontact.size() > 0) {
-    if(numOk != (int)vcontact.size())
-    	//// The int type is not guaranteed to be big enough, use intptr_t
-		//cout<<numOk<<" contacts between env "<<(int)dGeomGetData(o2)<<" and body "<<(int)dGeomGetData(o1)<<"  (clustered to "<<vcontact.size()<<")"<<endl;
-      cout<<numOk<<" contacts between link "<<GeomDataToRobotLinkIndex(dGeomGetData(o2))<<" and link "<<GeomDataToRobotLinkIndex(dGeomGetData(o1))<<"  (clustered to "<<vcontact.size()<<")"<<endl;
-    gContacts.push_back(ODEContactResult());
-    gContacts.back().o1 = o1;
-    gContacts.back().o2 = o2;
-    swap(gContacts.back().contacts,vcontact);
-    gContacts.back().meshOverlap = !GetCustomGeometryCollisionReliableFlag();
+//Generates the contacts of candidate pair i into the contact buffer of the
+//calling thread
+struct CollideCandidateBody : public ParallelForBody
+{
+  CollideCandidateBody(ODESimulator* _sim,bool _selfCollisions,bool _profile)
+    :sim(_sim),selfCollisions(_selfCollisions),profile(_profile)
+  {}
+  virtual bool operator ()(int i,int thread)
+  {
+    //contacts of this pair are read from the cache during the merge
+    if(sim->candidateThreads[i] == -1) return true;
+    vector<dContactGeom>& buffer = sim->threadContacts[thread];
+    int& used = sim->threadContactsUsed[thread];
+    if(GrowBuffer(buffer,used+max_contacts)) sim->threadBufferGrowths[thread]++;
+    ODEContactResult& res = sim->candidateResults[i];
+    res.o1 = sim->candidatePairs[i].first;
+    res.o2 = sim->candidatePairs[i].second;
+    res.contactStart = used;
+    if(profile) {
+      Timer timer;
+      res.numContacts = CollideGeomPair(res.o1,res.o2,selfCollisions,&buffer[used],res.meshOverlap);
+      sim->candidateTimes[i] = timer.ElapsedTime();
+    }
+    else
+      res.numContacts = CollideGeomPair(res.o1,res.o2,selfCollisions,&buffer[used],res.meshOverlap);
+    if(res.numContacts > 0) used += res.numContacts;
+    sim->candidateThreads[i] = thread;
+    return true;
   }
+
+  ODESimulator* sim;
+  bool selfCollisions,profile;
+};
+
+//ODE keeps some collider data per thread.  The transforms are set by
+//CollideCandidatePairs before the loop, and may be read by several threads
+//at once, so the pool threads never update them.
+static void collision_thread_init()
+{
+  dAllocateODEDataForThread(dAllocateMaskAll);
+  SetCustomGeometryTransformUpdate(false);
+}
+
+static void collision_thread_exit()
+{
+  dCleanupODEAllDataForThread();
+}
+
+int ODESimulator::LookupContactCache(dGeomID o1,dGeomID o2)
+{
+  CollisionPair key(GeomDataToObjectID(dGeomGetData(o1)),GeomDataToObjectID(dGeomGetData(o2)));
+  return contactCache.Lookup(key,detectionPass);
 }
 
-void ProcessContacts(list<ODEContactResult>::iterator start,list<ODEContactResult>::iterator end,const ODESimulatorSettings& settings,bool aggregateCount=true)
+//The profiler phase of the narrow phase of a geom pair
+string NarrowPhaseName(dGeomID o1,dGeomID o2)
+{
+  const char* t1 = dGetCustomGeometryData(o1)->geometry->TypeName();
+  const char* t2 = dGetCustomGeometryData(o2)->geometry->TypeName();
+  if(strcmp(t1,t2) > 0) swap(t1,t2);
+  return string("narrowphase ")+t1+"-"+t2;
+}
+
+void ODESimulator::CollideCandidatePairs(bool selfCollisions)
+{
+  SimulationProfileScope scope(profiler,"narrowphase");
+  bool profile = (profiler && profiler->enabled);
+  int numThreads = Min(settings.collisionThreads,(int)candidatePairs.size());
+  if(numThreads <= 1) {
+    for(size_t i=0;i<candidatePairs.size();i++) {
+      dGeomID o1 = candidatePairs[i].first, o2 = candidatePairs[i].second;
+      Real pairStart = (profile ? profiler->Time() : 0);
+      bool meshOverlap = false;
+      dContactGeom* contacts = contactArena.Reserve(max_contacts);
+      int n;
+      if(settings.contactCaching) {
+	ODEContactCacheEntry& entry = contactCache.Entry(LookupContactCache(o1,o2));
+	if(ContactCacheHit(entry,o1,o2,settings)) {
+	  n = ReadContactCache(contactCache,entry,o1,o2,contacts);
+	  contactCacheHits++;
+	}
+	else {
+	  n = CollideGeomPair(o1,o2,selfCollisions,contacts,meshOverlap);
+	  WriteContactCache(contactCache,entry,o1,o2,contacts,n,meshOverlap);
+	  contactCacheMisses++;
+	}
+      }
+      else
+	n = CollideGeomPair(o1,o2,selfCollisions,contacts,meshOverlap);
+      if(n >= 0)
+	contactArena.AddResult(o1,o2,n,meshOverlap);
+      if(profile) profiler->AddTime(NarrowPhaseName(o1,o2),profiler->Time()-pairStart);
+    }
+    candidatePairs.resize(0);
+    return;
+  }
+
+  //the geometries are shared between pairs, so their transforms are set
+  //once here rather than by each thread
+  for(size_t i=0;i<candidatePairs.size();i++) {
+    dCustomGeometryUpdateTransform(candidatePairs[i].first);
+    dCustomGeometryUpdateTransform(candidatePairs[i].second);
+  }
+  if(GrowBuffer(candidateResults,candidatePairs.size())) contactArena.numBufferGrowths++;
+  if(GrowBuffer(candidateThreads,candidatePairs.size())) contactArena.numBufferGrowths++;
+  if(profile && GrowBuffer(candidateTimes,candidatePairs.size())) contactArena.numBufferGrowths++;
+  //the cache map is not touched by the threads: entries are looked up here,
+  //and pairs that hit the cache are marked with thread -1
+  if(settings.contactCaching) {
+    if(GrowBuffer(candidateCacheEntries,candidatePairs.size())) contactArena.numBufferGrowths++;
+    for(size_t i=0;i<candidatePairs.size();i++) {
+      dGeomID o1 = candidatePairs[i].first, o2 = candidatePairs[i].second;
+      candidateCacheEntries[i] = LookupContactCache(o1,o2);
+      candidateThreads[i] = (ContactCacheHit(contactCache.Entry(candidateCacheEntries[i]),o1,o2,settings) ? -1 : -2);
+    }
+  }
+  else
+    fill(candidateThreads.begin(),candidateThreads.begin()+candidatePairs.size(),-2);
+  //the pool is sized by the setting rather than by the number of pairs, so
+  //that it is not restarted as the pair count changes
+  if(!collisionPool)
+    collisionPool = new ThreadPool(settings.collisionThreads,collision_thread_init,collision_thread_exit);
+  else
+    collisionPool->Resize(settings.collisionThreads);
+  int poolThreads = collisionPool->NumThreads();
+  if((int)threadContacts.size() < poolThreads) {
+    threadContacts.resize(poolThreads);
+    threadContactsUsed.resize(poolThreads);
+    threadBufferGrowths.resize(poolThreads);
+    contactArena.numBufferGrowths++;
+  }
+  fill(threadContactsUsed.begin(),threadContactsUsed.end(),0);
+  fill(threadBufferGrowths.begin(),threadBufferGrowths.end(),0);
+  CollideCandidateBody body(this,selfCollisions,profile);
+  //the calling thread acts as thread 0
+  SetCustomGeometryTransformUpdate(false);
+  collisionPool->ParallelFor(0,(int)candidatePairs.size(),body);
+  SetCustomGeometryTransformUpdate(true);
+  for(int k=0;k<poolThreads;k++)
+    contactArena.numBufferGrowths += threadBufferGrowths[k];
+
+  //merge in candidate order
+  for(size_t i=0;i<candidatePairs.size();i++) {
+    if(candidateThreads[i] == -1) {
+      const ODEContactCacheEntry& entry = contactCache.Entry(candidateCacheEntries[i]);
+      dGeomID o1 = candidatePairs[i].first, o2 = candidatePairs[i].second;
+      contactCacheHits++;
+      if(entry.numContacts < 0) continue;
+      dContactGeom* contacts = contactArena.Reserve(Max(entry.numContacts,1));
+      int n = ReadContactCache(contactCache,entry,o1,o2,contacts);
+      if(n >= 0) contactArena.AddResult(o1,o2,n,false);
+      continue;
+    }
+    const ODEContactResult& res = candidateResults[i];
+    const dContactGeom* src = &threadContacts[candidateThreads[i]][res.contactStart];
+    if(profile) profiler->AddTime(NarrowPhaseName(res.o1,res.o2),candidateTimes[i]);
+    if(settings.contactCaching) {
+      WriteContactCache(contactCache,contactCache.Entry(candidateCacheEntries[i]),res.o1,res.o2,src,res.numContacts,res.meshOverlap);
+      contactCacheMisses++;
+    }
+    if(res.numContacts < 0) continue;
+    dContactGeom* contacts = contactArena.Reserve(Max(res.numContacts,1));
+    copy(src,src+res.numContacts,contacts);
+    contactArena.AddResult(res.o1,res.o2,res.numContacts,res.meshOverlap);
+  }
+  candidatePairs.resize(0);
+}
+
+//Reduces the contacts of the results from start on to fit within
+//settings.maxContacts
+void ProcessContacts(ODEContactArena& arena,size_t start,const ODESimulatorSettings& settings,bool aggregateCount=true)
 {
   if(kMergeContacts) {
-    for(list<ODEContactResult>::iterator j=start;j!=end;j++) 
-      MergeContacts(j->contacts,kContactPosMergeTolerance,kContactOriMergeTolerance);
+    for(size_t j=start;j<arena.results.size();j++) 
+      MergeContacts(arena.Contacts(arena.results[j]),arena.results[j].numContacts,kContactPosMergeTolerance,kContactOriMergeTolerance);
   }
 
   static bool warnedContacts = false;
   if(aggregateCount) {
     int numContacts = 0;
-    for(list<ODEContactResult>::iterator j=start;j!=end;j++) 
-      numContacts += (int)j->contacts.size();
+    for(size_t j=start;j<arena.results.size();j++) 
+      numContacts += arena.results[j].numContacts;
     if(numContacts > settings.maxContacts) {
       //printf("Warning: %d robot-env contacts > maximum %d, may crash\n",numContacts,settings.maxContacts);
       if(settings.maxContacts > 50) {
@@ -1253,25 +1651,23 @@ void ProcessContacts(list<ODEContactResult>::iterator start,list<ODEContactResul
 	warnedContacts = true;
       }
       Real scale = Real(settings.maxContacts)/numContacts;
-      for(list<ODEContactResult>::iterator j=start;j!=end;j++) {
-	int n=(int)Ceil(Real(j->contacts.size())*scale);
-	//printf("Clustering %d->%d\n",j->contacts.size(),n);
-	ClusterContacts(j->contacts,n,settings.clusterNormalScale);
+      for(size_t j=start;j<arena.results.size();j++) {
+	int n=(int)Ceil(Real(arena.results[j].numContacts)*scale);
+	//printf("Clustering %d->%d\n",arena.results[j].numContacts,n);
+	ClusterContacts(arena,arena.results[j],n,settings.clusterNormalScale);
       }
     }
   }
   else {
-    for(list<ODEContactResult>::iterator j=start;j!=end;j++) {
-      if(settings.maxContacts > 50) {
-	if(!warnedContacts) {
-	  printf("Max contacts > 50, may crash.  Press enter to continue...\n");
-	  getchar();
-	}
-	warnedContacts = true;
-      }
-      for(list<ODEContactResult>::iterator j=start;j!=end;j++) {
-	ClusterContacts(j->contacts,settings.maxContacts,settings.clusterNormalScale);
+    if(start < arena.results.size() && settings.maxContacts > 50) {
+      if(!warnedContacts) {
+	printf("Max contacts > 50, may crash.  Press enter to continue...\n");
+	getchar();
       }
+      warnedContacts = true;
+    }
+    for(size_t j=start;j<arena.results.size();j++) {
+      ClusterContacts(arena,arena.results[j],settings.maxContacts,settings.clusterNormalScale);
     }
   }
 }
@@ -1333,39 +1729,62 @@ void ODESimulator::GetSurfaceParameters(const ODEObjectID& a,const ODEObjectID&
   }
 }
 
+void ODESimulator::ProcessContacts(size_t start,bool aggregateCount)
+{
+  SimulationProfileScope scope(profiler,"clustering");
+  if(profiler && profiler->enabled) {
+    int n = 0;
+    for(size_t i=start;i<contactArena.results.size();i++)
+      n += contactArena.results[i].numContacts;
+    profiler->AddCount("contacts",n);
+  }
+  ::ProcessContacts(contactArena,start,settings,aggregateCount);
+}
+
 void ODESimulator::SetupContactResponse()
 {
+  SimulationProfileScope scope(profiler,"contact response");
   //clear feedback structure
   ClearContactFeedback();
   //clear global ODE collider feedback stuff
   dJointGroupEmpty(contactGroupID);
 
-  int index=0;
-  gContactsVector.resize(gContacts.size());
-  for(list<ODEContactResult>::iterator i=gContacts.begin();i!=gContacts.end();i++) {
-    gContactsVector[index] = &(*i);
-    SetupContactResponse(GeomDataToObjectID(dGeomGetData(i->o1)),GeomDataToObjectID(dGeomGetData(i->o2)),index,*i);
-    index++;
+  contactArena.SetupFeedback();
+  for(size_t i=0;i<contactArena.results.size();i++) {
+    ODEContactResult& c = contactArena.results[i];
+    SetupContactResponse(GeomDataToObjectID(dGeomGetData(c.o1)),GeomDataToObjectID(dGeomGetData(c.o2)),(int)i,c);
+  }
+  //the joints are allocated from the joint group's arenas, which grow only
+  //when a step needs more joints than any before it
+  if(contactArena.numContacts > contactJointPeak) {
+    contactJointPeak = contactArena.numContacts;
+    contactJointGrowths++;
   }
 }
 
+int ODESimulator::NumBufferGrowths() const
+{
+  return contactArena.numBufferGrowths+contactCache.numBufferGrowths+contactJointGrowths;
+}
+
 void ODESimulator::SetupContactResponse(const ODEObjectID& a,const ODEObjectID& b,int feedbackIndex,ODEContactResult& c)
 {
   dContact contact;
   GetSurfaceParameters(a,b,contact.surface);
   dBodyID b1 = dGeomGetBody(c.o1);
   dBodyID b2 = dGeomGetBody(c.o2);
-  c.feedback.resize(c.contacts.size());
-  for(size_t k=0;k<c.contacts.size();k++) {
+  const dContactGeom* contacts = contactArena.Contacts(c);
+  dJointFeedback* feedback = contactArena.Feedback(c);
+  for(int k=0;k<c.numContacts;k++) {
     //add contact joint to joint group
-    contact.geom = c.contacts[k];
+    contact.geom = contacts[k];
     Assert(contact.geom.g1 == c.o1 || contact.geom.g1 == c.o2);
     Assert(contact.geom.g2 == c.o1 || contact.geom.g2 == c.o2);
     Assert(contact.geom.depth >= 0);
     
     Assert(contact.geom.g1 == c.o1);
     dJointID joint = dJointCreateContact(worldID,contactGroupID,&contact);
-    dJointSetFeedback(joint,&c.feedback[k]);
+    dJointSetFeedback(joint,&feedback[k]);
     //if(b2==0)
     //dJointAttach(joint,b2,b1);
       //else
@@ -1406,129 +1825,85 @@ void ODESimulator::SetupContactResponse(const ODEObjectID& a,const ODEObjectID&
   if(cl) {
     //user requested contact feedback, now copy it out
     size_t start=cl->points.size();
-    cl->points.resize(start+c.contacts.size());
-    for(size_t k=0;k<c.contacts.size();k++) {
+    cl->points.resize(start+c.numContacts);
+    for(int k=0;k<c.numContacts;k++) {
       Assert(k+start < cl->points.size());
-      CopyVector(cl->points[k+start].x,c.contacts[k].pos);
-      CopyVector(cl->points[k+start].n,c.contacts[k].normal);
+      CopyVector(cl->points[k+start].x,contacts[k].pos);
+      CopyVector(cl->points[k+start].n,contacts[k].normal);
       cl->points[k+start].kFriction = contact.surface.mu;
       if(reverse)
 	cl->points[k+start].n.inplaceNegative();
     }
-    Assert(feedbackIndex >= 0 && feedbackIndex < (int)gContacts.size());
+    Assert(feedbackIndex >= 0 && feedbackIndex < (int)contactArena.results.size());
     cl->feedbackIndices.push_back(feedbackIndex);
   }
 }
 
 void ODESimulator::DetectCollisions()
 {
-#if DO_TIMING
-  Timer timer;
-#endif //DO_TIMING
-
-  gContacts.clear();
-  gContactsVector.resize(0);
+  contactArena.Clear();
+  candidatePairs.resize(0);
+  detectionPass++;
 
   CollisionPair cindex;
   int jcount=0;
   if(settings.rigidObjectCollisions) {
     //call the collision routine between objects and the world
+    Real start = (profiler ? profiler->Begin() : 0);
     dSpaceCollide(envSpaceID,(void*)this,collisionCallback);
-
-#if DO_TIMING
-    gContactDetectTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
-    
-    ProcessContacts(gContacts.begin(),gContacts.end(),settings,false);
-
-#if DO_TIMING
-    gClusterTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
+    if(profiler) profiler->End("broadphase",start);
+    CollideCandidatePairs(false);
+    ProcessContacts(0,false);
   }
 
   //do robot-environment collisions
   for(size_t i=0;i<robots.size();i++) {
-#if DO_TIMING
-    timer.Reset();
-#endif //DO_TIMING
-
     //call the collision routine between the robot and the world
-	bool gContactsEmpty = gContacts.empty();
-	list<ODEContactResult>::iterator gContactStart;
-	if(!gContactsEmpty) gContactStart = --gContacts.end();
-	dSpaceCollide2((dxGeom *)robots[i]->space(),(dxGeom *)envSpaceID,(void*)this,collisionCallback);
-	if(!gContactsEmpty) ++gContactStart;
-	else gContactStart = gContacts.begin();
-
-#if DO_TIMING
-    gContactDetectTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
-
-    ProcessContacts(gContactStart,gContacts.end(),settings);
-
-#if DO_TIMING
-    gClusterTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
+    size_t contactStart = contactArena.results.size();
+    Real start = (profiler ? profiler->Begin() : 0);
+    dSpaceCollide2((dxGeom *)robots[i]->space(),(dxGeom *)envSpaceID,(void*)this,collisionCallback);
+    if(profiler) profiler->End("broadphase",start);
+    CollideCandidatePairs(false);
+    ProcessContacts(contactStart);
 
     if(settings.robotSelfCollisions) {
       robots[i]->EnableSelfCollisions(true);
 
-#if DO_TIMING
-      timer.Reset();
-#endif
-
-      gContactsEmpty = gContacts.empty();
-	  if(!gContactsEmpty) gContactStart = --gContacts.end();
+      contactStart = contactArena.results.size();
       //call the self collision routine for the robot
-      dSpaceCollide(robots[i]->space(),(void*)robots[i],selfCollisionCallback);
-      if(!gContactsEmpty) ++gContactStart;
-	  else gContactStart = gContacts.begin();
-
-#if DO_TIMING
-    gContactDetectTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
-      
-      ProcessContacts(gContactStart,gContacts.end(),settings);
-
-#if DO_TIMING
-    gClusterTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
+      start = (profiler ? profiler->Begin() : 0);
+      dSpaceCollide(robots[i]->space(),(void*)this,selfCollisionCallback);
+      if(profiler) profiler->End("broadphase",start);
+      CollideCandidatePairs(true);
+      ProcessContacts(contactStart);
     }
 
     if(settings.robotRobotCollisions) {    
       for(size_t k=i+1;k<robots.size();k++) {
 	cindex.second = ODEObjectID(1,k);
 
-#if DO_TIMING
-    timer.Reset();
-#endif //DO_TIMING
-
-	gContactsEmpty = gContacts.empty();
-	if(!gContactsEmpty) gContactStart = --gContacts.end();
+	contactStart = contactArena.results.size();
+	start = (profiler ? profiler->Begin() : 0);
 	dSpaceCollide2((dxGeom *)robots[i]->space(),(dxGeom *)robots[k]->space(),(void*)this,collisionCallback);
-	if(!gContactsEmpty) ++gContactStart;
-	else gContactStart = gContacts.begin();
-
-#if DO_TIMING
-    gContactDetectTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
-
-	ProcessContacts(gContactStart,gContacts.end(),settings);
-
-#if DO_TIMING
-    gClusterTime += timer.ElapsedTime();
-    timer.Reset();
-#endif //DO_TIMING
+	if(profiler) profiler->End("broadphase",start);
+	CollideCandidatePairs(false);
+	ProcessContacts(contactStart);
       }
     }
   }
+
+  if(settings.autoDisable && WakeTouchedIslands()) {
+    //contacts between the woken bodies and sleeping or static geometry were
+    //skipped, so detect them again
+    DetectCollisions();
+    return;
+  }
+
+  //drop the cached contacts of pairs that are no longer in contact range
+  if(settings.contactCaching)
+    contactCache.DropUnused(detectionPass);
+  else if(!contactCache.IsEmpty())
+    contactCache.Clear();
 }
 
 void ODESimulator::EnableContactFeedback(const ODEObjectID& a,const ODEObjectID& b)
@@ -1574,25 +1949,28 @@ bool HasContact(dBodyID a)
 }
 
 ///Will produce bogus o1 and o2 vectors
-void GetContacts(dBodyID a,vector<ODEContactList>& contacts)
+void ODESimulator::GetContacts(dBodyID a,vector<ODEContactList>& contacts) const
 {
   if(a == 0) return;
 
   contacts.resize(0);
-  for(list<ODEContactResult>::iterator i=gContacts.begin();i!=gContacts.end();i++) {
+  for(size_t r=0;r<contactArena.results.size();r++) {
+    const ODEContactResult* i = &contactArena.results[r];
     if(a == dGeomGetBody(i->o1) || a == dGeomGetBody(i->o2)) {
+      const dContactGeom* icontacts = contactArena.Contacts(*i);
+      const dJointFeedback* ifeedback = contactArena.Feedback(*i);
       dBodyID b = dGeomGetBody(i->o2);
       bool reverse = false;
       if(b == a) { b = dGeomGetBody(i->o1); reverse = true; }
       contacts.resize(contacts.size()+1);
       contacts.back().penetrating = i->meshOverlap;
-      contacts.back().points.resize(i->contacts.size());
-      contacts.back().forces.resize(i->feedback.size());
-      for(size_t j=0;j<i->feedback.size();j++) {
-	CopyVector(contacts.back().forces[j],i->feedback[j].f1);
-	CopyVector(contacts.back().points[j].x,i->contacts[j].pos);
-	CopyVector(contacts.back().points[j].n,i->contacts[j].normal);
-	//contacts.back().points[j].kFriction = i->contacts[j].surface.mu;
+      contacts.back().points.resize(i->numContacts);
+      contacts.back().forces.resize(i->numContacts);
+      for(int j=0;j<i->numContacts;j++) {
+	CopyVector(contacts.back().forces[j],ifeedback[j].f1);
+	CopyVector(contacts.back().points[j].x,icontacts[j].pos);
+	CopyVector(contacts.back().points[j].n,icontacts[j].normal);
+	//contacts.back().points[j].kFriction = icontacts[j].surface.mu;
 	contacts.back().points[j].kFriction = 0;
 	if(reverse) {
 	  contacts.back().forces[j].inplaceNegative();
@@ -1691,6 +2069,7 @@ bool ODESimulator::InContact(const ODEObjectID& a,const ODEObjectID& b) const
 
 void ODESimulator::StepDynamics(Real dt)
 {
+  SimulationProfileScope scope(profiler,"solver");
   dWorldStep(worldID,dt);
   //dWorldQuickStep(worldID,dt);
 }
@@ -1717,7 +2096,32 @@ bool ODESimulator::ReadState(File& f)
       return false;
     }
   }
+  //the sleep state is only written when auto-disable is on, so that states
+  //saved without sleeping, including those of older versions, still load
+  if(settings.autoDisable) {
+    int n;
+    if(!ReadFile(f,n)) return false;
+    if(n != 0 && n != NumSleepNodes()) {
+      fprintf(stderr,"ODESimulator::ReadState(): sleep state has %d entries, simulator has %d\n",n,NumSleepNodes());
+      return false;
+    }
+    idleTime.resize(n);
+    sleepIsland.resize(n);
+    for(int i=0;i<n;i++) {
+      if(!ReadFile(f,idleTime[i])) return false;
+      if(!ReadFile(f,sleepIsland[i])) return false;
+    }
+    for(int i=0;i<NumSleepNodes();i++)
+      SetSleepNodeEnabled(i,i >= n || sleepIsland[i] < 0);
+  }
+  else {
+    for(size_t i=0;i<sleepIsland.size();i++)
+      if(sleepIsland[i] >= 0) WakeIsland(sleepIsland[i]);
+    fill(idleTime.begin(),idleTime.end(),0);
+  }
   ClearContactFeedback();
+  //the cached contacts belong to the poses before the read
+  contactCache.Clear();
   return true;
 }
 
@@ -1730,11 +2134,306 @@ void ODESimulator::ClearContactFeedback()
   }
 }
 
+//number of dReals saved per body: position, quaternion, angular velocity,
+//linear velocity, force, torque
+const static int kSnapshotBodySize = 19;
+
+inline void SaveBodySnapshot(dBodyID body,dReal* x)
+{
+  memcpy(x,dBodyGetPosition(body),3*sizeof(dReal));
+  memcpy(x+3,dBodyGetQuaternion(body),4*sizeof(dReal));
+  memcpy(x+7,dBodyGetAngularVel(body),3*sizeof(dReal));
+  memcpy(x+10,dBodyGetLinearVel(body),3*sizeof(dReal));
+  memcpy(x+13,dBodyGetForce(body),3*sizeof(dReal));
+  memcpy(x+16,dBodyGetTorque(body),3*sizeof(dReal));
+}
+
+inline void RestoreBodySnapshot(dBodyID body,const dReal* x)
+{
+  dBodySetPosition(body,x[0],x[1],x[2]);
+  dBodySetQuaternion(body,x+3);
+  dBodySetAngularVel(body,x[7],x[8],x[9]);
+  dBodySetLinearVel(body,x[10],x[11],x[12]);
+  dBodySetForce(body,x[13],x[14],x[15]);
+  dBodySetTorque(body,x[16],x[17],x[18]);
+}
+
+void ODESimulator::SaveSnapshot(ODESimulatorSnapshot& snapshot) const
+{
+  size_t n = objects.size();
+  for(size_t i=0;i<robots.size();i++)
+    for(size_t j=0;j<robots[i]->robot.links.size();j++)
+      if(robots[i]->body(j)) n++;
+  snapshot.state.resize(n*kSnapshotBodySize);
+  snapshot.idleTime = idleTime;
+  snapshot.sleepIsland = sleepIsland;
+  if(n == 0) return;
+  dReal* x = &snapshot.state[0];
+  for(size_t i=0;i<robots.size();i++) {
+    for(size_t j=0;j<robots[i]->robot.links.size();j++) {
+      if(!robots[i]->body(j)) continue;
+      SaveBodySnapshot(robots[i]->body(j),x);
+      x += kSnapshotBodySize;
+    }
+  }
+  for(size_t i=0;i<objects.size();i++) {
+    SaveBodySnapshot(objects[i]->body(),x);
+    x += kSnapshotBodySize;
+  }
+}
+
+bool ODESimulator::RestoreSnapshot(const ODESimulatorSnapshot& snapshot)
+{
+  size_t n = objects.size();
+  for(size_t i=0;i<robots.size();i++)
+    for(size_t j=0;j<robots[i]->robot.links.size();j++)
+      if(robots[i]->body(j)) n++;
+  if(snapshot.state.size() != n*kSnapshotBodySize) {
+    fprintf(stderr,"ODESimulator::RestoreSnapshot(): snapshot has %d bodies, simulator has %d\n",(int)snapshot.state.size()/kSnapshotBodySize,(int)n);
+    return false;
+  }
+  if(n > 0) {
+    const dReal* x = &snapshot.state[0];
+    for(size_t i=0;i<robots.size();i++) {
+      for(size_t j=0;j<robots[i]->robot.links.size();j++) {
+	if(!robots[i]->body(j)) continue;
+	RestoreBodySnapshot(robots[i]->body(j),x);
+	x += kSnapshotBodySize;
+      }
+    }
+    for(size_t i=0;i<objects.size();i++) {
+      RestoreBodySnapshot(objects[i]->body(),x);
+      x += kSnapshotBodySize;
+    }
+  }
+  idleTime = snapshot.idleTime;
+  sleepIsland = snapshot.sleepIsland;
+  for(int i=0;i<NumSleepNodes();i++)
+    SetSleepNodeEnabled(i,i >= (int)sleepIsland.size() || sleepIsland[i] < 0);
+  ClearContactFeedback();
+  return true;
+}
+
 bool ODESimulator::WriteState(File& f) const
 {
   for(size_t i=0;i<robots.size();i++) 
     if(!robots[i]->WriteState(f)) return false;
   for(size_t i=0;i<objects.size();i++) 
     if(!objects[i]->WriteState(f)) return false;
+  if(settings.autoDisable) {
+    int n = (int)sleepIsland.size();
+    if(!WriteFile(f,n)) return false;
+    for(int i=0;i<n;i++) {
+      if(!WriteFile(f,idleTime[i])) return false;
+      if(!WriteFile(f,sleepIsland[i])) return false;
+    }
+  }
   return true;
 }
+
+
+int ODESimulator::SleepNode(const ODEObjectID& obj) const
+{
+  if(obj.IsRobot()) return obj.index;
+  if(obj.IsRigidObject()) return (int)robots.size()+obj.index;
+  return -1;
+}
+
+int ODESimulator::SleepNode(dGeomID geom) const
+{
+  return SleepNode(GeomDataToObjectID(dGeomGetData(geom)));
+}
+
+void ODESimulator::SetSleepNodeEnabled(int node,bool enabled)
+{
+  if(node < (int)robots.size()) {
+    ODERobot* robot = robots[node];
+    for(size_t j=0;j<robot->robot.links.size();j++) {
+      dBodyID b = robot->body(j);
+      if(!b) continue;
+      if(enabled) dBodyEnable(b);
+      else dBodyDisable(b);
+    }
+  }
+  else {
+    dBodyID b = objects[node-robots.size()]->body();
+    if(enabled) dBodyEnable(b);
+    else dBodyDisable(b);
+  }
+}
+
+inline bool IsNonzero(const dReal* x)
+{
+  return x[0] != 0 || x[1] != 0 || x[2] != 0;
+}
+
+inline bool BodyActuated(dBodyID b)
+{
+  return IsNonzero(dBodyGetForce(b)) || IsNonzero(dBodyGetTorque(b));
+}
+
+inline bool BodyStill(dBodyID b,const ODESimulatorSettings& settings)
+{
+  Vector3 v,w;
+  CopyVector(v,dBodyGetLinearVel(b));
+  CopyVector(w,dBodyGetAngularVel(b));
+  return v.normSquared() <= Sqr(settings.autoDisableLinearThreshold) && w.normSquared() <= Sqr(settings.autoDisableAngularThreshold);
+}
+
+bool ODESimulator::SleepNodeActuated(int node) const
+{
+  if(node < (int)robots.size()) {
+    ODERobot* robot = robots[node];
+    for(size_t j=0;j<robot->robot.links.size();j++) {
+      dBodyID b = robot->body(j);
+      if(b && BodyActuated(b)) return true;
+      //joints driven by SetLinkFixedVelocity
+      dJointID joint = robot->joint(j);
+      if(!joint) continue;
+      if(dJointGetType(joint) == dJointTypeHinge && dJointGetHingeParam(joint,dParamVel) != 0) return true;
+      if(dJointGetType(joint) == dJointTypeSlider && dJointGetSliderParam(joint,dParamVel) != 0) return true;
+    }
+    return false;
+  }
+  return BodyActuated(objects[node-robots.size()]->body());
+}
+
+bool ODESimulator::SleepNodeStill(int node) const
+{
+  if(node < (int)robots.size()) {
+    ODERobot* robot = robots[node];
+    for(size_t j=0;j<robot->robot.links.size();j++) {
+      dBodyID b = robot->body(j);
+      if(b && !BodyStill(b,settings)) return false;
+    }
+    return true;
+  }
+  return BodyStill(objects[node-robots.size()]->body(),settings);
+}
+
+void ODESimulator::WakeIsland(int island)
+{
+  for(size_t i=0;i<sleepIsland.size();i++) {
+    if(sleepIsland[i] != island) continue;
+    sleepIsland[i] = -1;
+    idleTime[i] = 0;
+    SetSleepNodeEnabled(i,true);
+  }
+}
+
+void ODESimulator::WakeObject(const ODEObjectID& obj)
+{
+  int node = SleepNode(obj);
+  if(node < 0 || node >= (int)sleepIsland.size()) return;
+  if(sleepIsland[node] >= 0) WakeIsland(sleepIsland[node]);
+  else idleTime[node] = 0;
+}
+
+bool ODESimulator::IsAsleep(const ODEObjectID& obj) const
+{
+  int node = SleepNode(obj);
+  if(node < 0 || node >= (int)sleepIsland.size()) return false;
+  return sleepIsland[node] >= 0;
+}
+
+bool ODESimulator::WakeTouchedIslands()
+{
+  bool woke = false;
+  for(size_t r=0;r<contactArena.results.size();r++) {
+    const ODEContactResult& res = contactArena.results[r];
+    int n1 = SleepNode(res.o1), n2 = SleepNode(res.o2);
+    int i1 = (n1 >= 0 && n1 < (int)sleepIsland.size() ? sleepIsland[n1] : -1);
+    int i2 = (n2 >= 0 && n2 < (int)sleepIsland.size() ? sleepIsland[n2] : -1);
+    //sleeping pairs are culled by the collision callback, so at most one
+    //side is asleep
+    if(i1 >= 0 && i1 != i2) { WakeIsland(i1); woke = true; }
+    else if(i2 >= 0 && i1 != i2) { WakeIsland(i2); woke = true; }
+  }
+  return woke;
+}
+
+void ODESimulator::UpdateSleepActivity()
+{
+  int n = NumSleepNodes();
+  if((int)sleepIsland.size() != n) {
+    //robots or objects were added or removed
+    for(int i=0;i<n;i++) SetSleepNodeEnabled(i,true);
+    sleepIsland.resize(0);
+    sleepIsland.resize(n,-1);
+    idleTime.resize(0);
+    idleTime.resize(n,0);
+  }
+  if(!settings.autoDisable) return;
+  sleepActuated.resize(n);
+  for(int i=0;i<n;i++) {
+    sleepActuated[i] = SleepNodeActuated(i);
+    if(sleepActuated[i] && sleepIsland[i] >= 0)
+      WakeIsland(sleepIsland[i]);
+  }
+}
+
+//union-find root with path halving
+inline int SleepUnionFind(vector<int>& parent,int i)
+{
+  while(parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+void ODESimulator::UpdateSleeping(Real dt)
+{
+  int n = NumSleepNodes();
+  if(!settings.autoDisable) {
+    for(int i=0;i<(int)sleepIsland.size();i++)
+      if(sleepIsland[i] >= 0) WakeIsland(sleepIsland[i]);
+    return;
+  }
+  Assert((int)sleepIsland.size() == n && (int)sleepActuated.size() == n);
+  for(int i=0;i<n;i++) {
+    if(sleepIsland[i] >= 0) continue;
+    if(!sleepActuated[i] && SleepNodeStill(i)) idleTime[i] += dt;
+    else idleTime[i] = 0;
+  }
+  //group the nodes into islands by their contacts.  Terrains are static
+  //and do not join islands.
+  sleepUnion.resize(n);
+  for(int i=0;i<n;i++) sleepUnion[i] = i;
+  for(size_t r=0;r<contactArena.results.size();r++) {
+    const ODEContactResult& res = contactArena.results[r];
+    int n1 = SleepNode(res.o1), n2 = SleepNode(res.o2);
+    if(n1 < 0 || n2 < 0 || n1 == n2) continue;
+    n1 = SleepUnionFind(sleepUnion,n1);
+    n2 = SleepUnionFind(sleepUnion,n2);
+    if(n1 != n2) sleepUnion[Max(n1,n2)] = Min(n1,n2);
+  }
+  //an island may sleep only if all of its members are awake and idle
+  sleepIslandAwake.resize(0);
+  sleepIslandAwake.resize(n,false);
+  for(int i=0;i<n;i++) {
+    sleepUnion[i] = SleepUnionFind(sleepUnion,i);
+    if(sleepIsland[i] >= 0 || idleTime[i] < settings.autoDisableTime)
+      sleepIslandAwake[sleepUnion[i]] = true;
+  }
+  for(int i=0;i<n;i++) {
+    int root = sleepUnion[i];
+    if(sleepIsland[i] >= 0 || sleepIslandAwake[root]) continue;
+    //zero the velocities so the island does not drift when woken
+    if(i < (int)robots.size()) {
+      for(size_t j=0;j<robots[i]->robot.links.size();j++) {
+	dBodyID b = robots[i]->body(j);
+	if(!b) continue;
+	dBodySetLinearVel(b,0,0,0);
+	dBodySetAngularVel(b,0,0,0);
+      }
+    }
+    else {
+      dBodyID b = objects[i-robots.size()]->body();
+      dBodySetLinearVel(b,0,0,0);
+      dBodySetAngularVel(b,0,0,0);
+    }
+    sleepIsland[i] = root;
+    SetSleepNodeEnabled(i,false);
+  }
+}
@@ -10,9 +10,199 @@
 #include <ode/contact.h>
 #include <map>
 
-struct ODEObjectID;
 struct ODEContactList;
-struct ODEContactResult;
+class SimulationProfiler;
+class ThreadPool;
+
+/** @ingroup Simulation
+ * @brief An index that identifies some ODE object in the world.
+ * Environments, robots, robot bodies, or rigid objects are supported.
+ */
+struct ODEObjectID
+{
+  inline ODEObjectID(int _t=-1,int _i=-1,int _b=-1)
+    :type(_t),index(_i),bodyIndex(_b) {}
+  inline void SetEnv(int _index=0) { type = 0; index = _index; }
+  inline void SetRobot(int _index=0) { type = 1; index = _index; bodyIndex = -1; }
+  inline void SetRobotBody(int _index,int _bodyIndex=-1) { type = 1; index = _index; bodyIndex = _bodyIndex; }
+  inline void SetRigidObject(int _index=0) { type = 2; index = _index; }
+  inline bool IsEnv() const { return type == 0; }
+  inline bool IsRobot() const { return type == 1; }
+  inline bool IsRigidObject() const { return type == 2; }
+  inline bool operator == (const ODEObjectID& rhs) const {
+    if(type != rhs.type) return false;
+    if(index != rhs.index) return false;
+    if(type == 1 && bodyIndex!=rhs.bodyIndex) return false;
+    return true;
+  }
+  inline bool operator < (const ODEObjectID& rhs) const {
+    if(type < rhs.type) return true;
+    else if(type > rhs.type) return false;
+    if(index < rhs.index) return true;
+    else if(index > rhs.index) return false;
+    return (bodyIndex<rhs.bodyIndex);
+  }
+
+  int type;       //0: static environment, 1: robot, 2: movable object
+  int index;      //index in world
+  int bodyIndex;  //for robots, this identifies a link
+};
+
+/** @ingroup Simulation
+ * @brief The raw contacts detected between two ODE geoms on the current
+ * step.  The contacts (and their joint feedback) are the numContacts
+ * entries of the simulator's ODEContactArena starting at contactStart.
+ * Used internally by ODESimulator.
+ */
+struct ODEContactResult
+{
+  dGeomID o1,o2;
+  int contactStart,numContacts;
+  bool meshOverlap;
+};
+
+/** @ingroup Simulation
+ * @brief Storage for the contacts detected on the current step.  Used
+ * internally by ODESimulator.
+ *
+ * The contacts of all geom pairs are kept in one contiguous array, with
+ * a parallel array of joint feedback.  Clear() resets the arena without
+ * freeing anything, so once the buffers have grown to fit the scene, the
+ * contact buffers, the clustering scratch space, and the per-thread
+ * collision buffers are not reallocated.
+ *
+ * numBufferGrowths counts the times one of these buffers had to grow, and
+ * is reset at the start of every ODESimulator::Step().  See
+ * ODESimulator::NumBufferGrowths() for a count that also covers the
+ * contact cache and ODE's contact joints.
+ */
+struct ODEContactArena
+{
+  ODEContactArena();
+  ///Forgets all results, keeping the buffers
+  void Clear();
+  ///Returns space for n contacts after the contacts in use.  It is only
+  ///valid until the next call to Reserve().
+  dContactGeom* Reserve(int n);
+  ///Adds a result whose n contacts were written to the space returned by
+  ///the last Reserve()
+  void AddResult(dGeomID o1,dGeomID o2,int n,bool meshOverlap);
+  ///Sizes the feedback array to match the contacts.  Pointers into it stay
+  ///valid until the next Clear().
+  void SetupFeedback();
+  inline dContactGeom* Contacts(const ODEContactResult& r) { return &contacts[r.contactStart]; }
+  inline const dContactGeom* Contacts(const ODEContactResult& r) const { return &contacts[r.contactStart]; }
+  inline dJointFeedback* Feedback(const ODEContactResult& r) { return &feedback[r.contactStart]; }
+  inline const dJointFeedback* Feedback(const ODEContactResult& r) const { return &feedback[r.contactStart]; }
+
+  vector<ODEContactResult> results;
+  vector<dContactGeom> contacts;
+  int numContacts;
+  vector<dJointFeedback> feedback;
+  //scratch space for contact clustering
+  vector<double> clusterPoints,clusterCenters;
+  vector<int> clusterLabels,clusterCounts;
+  int numBufferGrowths;
+};
+
+/** @ingroup Simulation
+ * @brief A contact kept in an ODEContactCache.  The point and normal of
+ * the contact are in the frame of the first geom, and point2 is the same
+ * point in the frame of the second geom, so that the depth can be updated
+ * as the geoms move.
+ */
+struct ODECachedContact
+{
+  dContactGeom contact;
+  Vector3 point2;
+};
+
+/** @ingroup Simulation
+ * @brief The contacts last generated for a geom pair, kept across steps
+ * when contact caching is enabled.  Used internally by ODESimulator.
+ */
+struct ODEContactCacheEntry
+{
+  ODEContactCacheEntry() : contactStart(0),contactCapacity(0),numContacts(-2),lastUsed(-1) {}
+
+  ///The pose of the second geom relative to the first when the contacts
+  ///were generated
+  RigidTransform relativeTransform;
+  ///The contacts are the numContacts entries of the cache's contact buffer
+  ///starting at contactStart.  The entry owns contactCapacity entries of
+  ///the buffer.
+  int contactStart,contactCapacity;
+  ///The number of contacts, -1 if the pair had nothing to report, or -2 if
+  ///the entry must be regenerated
+  int numContacts;
+  ///The collision detection pass in which the entry was last used
+  int lastUsed;
+};
+
+/** @ingroup Simulation
+ * @brief The contact cache of an ODESimulator, mapping geom pairs (by
+ * object ID) to their last generated contacts.  Used internally by
+ * ODESimulator.
+ *
+ * The entries live in a flat array of slots, found through an index sorted
+ * by pair, and their contacts live in one shared buffer.  Dropped entries
+ * return their slots to a free list, and the contact buffer is compacted
+ * in place once half of it is unused, so once the buffers have grown to
+ * fit the scene, looking up, rewriting, and dropping entries allocates
+ * nothing.  numBufferGrowths counts the times one of the buffers had to
+ * grow.  Slot numbers stay valid until the entry is dropped.
+ */
+struct ODEContactCache
+{
+  typedef pair<ODEObjectID,ODEObjectID> Key;
+
+  ODEContactCache();
+  ///Drops all entries, keeping the buffers
+  void Clear();
+  bool IsEmpty() const { return index.empty(); }
+  ///Copies the entries and contacts of another cache into this one's
+  ///buffers
+  void Copy(const ODEContactCache& cache);
+  ///Returns the slot of the entry of the given pair, adding an empty entry
+  ///if there is none, and marks it as used in the given pass.
+  int Lookup(const Key& key,int pass);
+  inline ODEContactCacheEntry& Entry(int slot) { return entries[slot]; }
+  inline const ODEContactCacheEntry& Entry(int slot) const { return entries[slot]; }
+  inline const ODECachedContact* Contacts(const ODEContactCacheEntry& e) const { return &contacts[e.contactStart]; }
+  ///Returns space for n contacts in the given entry.  Its old contacts are
+  ///lost.  The result is only valid until the next call to Reserve().
+  ODECachedContact* Reserve(ODEContactCacheEntry& e,int n);
+  ///Drops the entries that were not used in the given pass
+  void DropUnused(int pass);
+
+  vector<pair<Key,int> > index;        ///< (pair, slot), sorted by pair
+  vector<ODEContactCacheEntry> entries;
+  vector<int> freeSlots;
+  vector<ODECachedContact> contacts;
+  int numContactsUsed,numContactsFree;
+  vector<int> compactOrder;            ///< scratch space for compaction
+  int numBufferGrowths;
+};
+
+/** @ingroup Simulation
+ * @brief A raw copy of the dynamic state of the bodies of an ODESimulator.
+ *
+ * Each body's position, orientation, velocities, and accumulated force and
+ * torque are copied into a flat buffer.  Unlike Read/WriteState nothing is
+ * serialized, and once the buffer has been sized by the first save no
+ * memory is allocated.  A snapshot can only be restored into the simulator
+ * it was saved from, or one with the same robots and objects.  The sleep
+ * state of the robots and objects is saved as well.
+ */
+struct ODESimulatorSnapshot
+{
+  bool IsEmpty() const { return state.empty(); }
+  void Clear() { state.resize(0); idleTime.resize(0); sleepIsland.resize(0); }
+
+  vector<dReal> state;
+  vector<Real> idleTime;
+  vector<int> sleepIsland;
+};
 
 /** @ingroup Simulation
  * @brief Global simulator settings.
@@ -35,6 +225,22 @@ struct ODESimulatorSettings
   //contact detection settings
   int maxContacts;
   double clusterNormalScale;;
+  //number of threads used to generate contacts between candidate geom
+  //pairs.  1 runs narrow-phase collision detection serially.
+  int collisionThreads;
+  //if true, the contacts of a geom pair are reused while the pair's relative
+  //pose stays within these tolerances (in m and radians) of the pose at
+  //which they were generated.
+  bool contactCaching;
+  double contactCacheTranslationTolerance;
+  double contactCacheRotationTolerance;
+  //if true, islands of touching robots and rigid objects are put to sleep
+  //(their bodies are disabled) once every member has moved slower than the
+  //linear and angular velocity thresholds for autoDisableTime seconds.
+  bool autoDisable;
+  double autoDisableLinearThreshold;
+  double autoDisableAngularThreshold;
+  double autoDisableTime;
 
   //ODE constants, mostly relevant to tightness of robot constraints
   double errorReductionParameter;
@@ -53,11 +259,52 @@ struct ODESimulatorSettings
  * detection structures.  This probably should not be used externally.
  *
  * Read/WriteState can be used to serialize state to binary.
+ * Save/RestoreSnapshot copy the same state into memory, much faster; the
+ * adaptive time stepper uses them to roll back.
  *
  * To get contact force information from the simulator, use the
  * EnableContactFeedback() function to initialize feedback, and then call
  * GetContactFeedback() to get a pointer to the feedback data structure.
  * Contact forces are updated after Step().
+ *
+ * All contact detection state is stored in the simulator instance, so
+ * separate ODESimulators (built from separate RobotWorlds) may be stepped
+ * concurrently from different threads.
+ *
+ * DetectCollisions() first gathers the candidate geom pairs from ODE's
+ * broad phase, then generates their contacts.  If
+ * settings.collisionThreads > 1, the candidate pairs are split among that
+ * many threads, each with its own contact buffer.  The threads are kept in
+ * a pool that is started on the first parallel pass.  The results are merged
+ * in candidate order, so the contacts do not depend on the number of
+ * threads.
+ *
+ * If settings.contactCaching is true, the raw contacts of each geom pair
+ * are cached, keyed by the pair's object IDs.  While the relative pose of
+ * the pair stays within the cache tolerances, the narrow phase is skipped
+ * and the cached contacts are moved with the first geom.  Their depths are
+ * updated by the relative motion of the contact points on the two geoms
+ * along the normal, and contacts whose points have separated are dropped.
+ * Pairs whose meshes overlap are always recomputed, as are pairs that leave
+ * the broad phase.  Only contact generation is reused: dWorldStep's LCP
+ * solver takes no initial guess, so the contact forces are solved from
+ * scratch on each step.  ReadState clears the cache, and RestoreSnapshot leaves it alone, so
+ * that a rollback of the adaptive time stepper keeps it.
+ * WorldSimulation::Snapshot() saves a copy of it.
+ *
+ * If settings.autoDisable is true, robots and rigid objects are grouped into
+ * islands by their contacts after each step, and an island whose members
+ * have all been still for settings.autoDisableTime is put to sleep: its
+ * bodies are disabled, so ODE neither integrates them nor collides them
+ * with each other or with the terrain.  A sleeping island is woken as a
+ * whole when one of its bodies touches an awake body, when a force or
+ * torque is applied to one of its bodies (e.g., by a hook or controller)
+ * before Step(), when a robot joint is driven at a nonzero velocity, or
+ * when WakeObject() is called.  Robots under active control are never
+ * idle.  The sleep state is saved by SaveSnapshot, and by WriteState when
+ * settings.autoDisable is true.  A state written with auto-disable on can
+ * only be read by a simulator that also has it on; other states load as
+ * before, with every island awake.
  */
 class ODESimulator
 {
@@ -76,6 +323,12 @@ class ODESimulator
   void StepDynamics(Real dt);
   bool ReadState(File& f);
   bool WriteState(File& f) const;
+  void SaveSnapshot(ODESimulatorSnapshot& snapshot) const;
+  bool RestoreSnapshot(const ODESimulatorSnapshot& snapshot);
+  ///Wakes the sleeping island containing the given robot or object.  Call
+  ///this after teleporting a body that may be asleep.
+  void WakeObject(const ODEObjectID& obj);
+  bool IsAsleep(const ODEObjectID& obj) const;
 
   size_t numTerrains() const { return terrains.size(); }
   size_t numRobots() const { return robots.size(); }
@@ -90,6 +343,32 @@ class ODESimulator
   dBodyID ObjectBody(const ODEObjectID& obj) const;
   dGeomID ObjectGeom(const ODEObjectID& obj) const;
   void DetectCollisions();
+  ///Returns the number of times a buffer used for collision detection or
+  ///contact response had to grow during the last Step(): those of the
+  ///contact arena and the contact cache, and the memory of ODE's contact
+  ///joints.  The adaptive time stepper's margin maps and the contact
+  ///feedback lists are not counted.
+  int NumBufferGrowths() const;
+  ///Generates the contacts for candidatePairs and appends the nonempty
+  ///results to contactArena, in candidate order.  Used internally by
+  ///DetectCollisions().
+  void CollideCandidatePairs(bool selfCollisions);
+  ///Wakes the sleeping islands touched by awake bodies in the current
+  ///contacts.  Returns true if any island was woken.
+  bool WakeTouchedIslands();
+  ///Wakes sleeping islands whose bodies have applied forces or velocities,
+  ///and marks the actuated awake robots and objects as not idle.  Called at
+  ///the start of Step().
+  void UpdateSleepActivity();
+  ///Advances the idle times by dt and puts still islands to sleep.  Called
+  ///at the end of Step().
+  void UpdateSleeping(Real dt);
+  ///Returns the slot of the contact cache entry of the pair, marking it as
+  ///used in the current detection pass.
+  int LookupContactCache(dGeomID o1,dGeomID o2);
+  ///Clusters the contacts of the results from start on.  Used internally
+  ///by DetectCollisions().
+  void ProcessContacts(size_t start,bool aggregateCount=true);
   void SetupContactResponse(); 
   void ClearCollisions();
   void EnableContactFeedback(const ODEObjectID& a,const ODEObjectID& b);
@@ -98,12 +377,28 @@ class ODESimulator
   void ClearContactFeedback();
   bool InContact(const ODEObjectID& a) const;
   bool InContact(const ODEObjectID& a,const ODEObjectID& b) const;
+  ///Returns the contacts on body a detected on the last step.  The o1 and
+  ///o2 members of the result are not filled in.
+  void GetContacts(dBodyID a,vector<ODEContactList>& contacts) const;
   void SetupContactResponse(const ODEObjectID& a,const ODEObjectID& b,int feedbackIndex,ODEContactResult& c);
     
   //overload this to have custom parameters for surface pairs
   virtual void GetSurfaceParameters(const ODEObjectID& a,const ODEObjectID& b,dSurfaceParameters& surface) const;
 
  private:
+  //not copyable: the simulator owns its ODE world, bodies, and thread pool
+  ODESimulator(const ODESimulator&);
+  const ODESimulator& operator = (const ODESimulator&);
+
+  //robots and rigid objects are indexed as sleep nodes, robots first
+  int SleepNode(const ODEObjectID& obj) const;
+  int SleepNode(dGeomID geom) const;
+  int NumSleepNodes() const { return (int)(robots.size()+objects.size()); }
+  void SetSleepNodeEnabled(int node,bool enabled);
+  bool SleepNodeActuated(int node) const;
+  bool SleepNodeStill(int node) const;
+  void WakeIsland(int island);
+
   ODESimulatorSettings settings;
   dWorldID worldID;
   dSpaceID envSpaceID;
@@ -118,46 +413,44 @@ class ODESimulator
 
 public:
   //for adaptive time stepping
-  File lastState;
+  ODESimulatorSnapshot lastState;
   Real lastStateTimestep;
   map<pair<ODEObjectID,ODEObjectID>,double> lastMarginsRemaining;
-};
 
+  ///If not NULL, the phases of Step() are timed by this profiler
+  SimulationProfiler* profiler;
 
-/** @ingroup Simulation
- * @brief An index that identifies some ODE object in the world.
- * Environments, robots, robot bodies, or rigid objects are supported.
- */
-struct ODEObjectID
-{
-  inline ODEObjectID(int _t=-1,int _i=-1,int _b=-1)
-    :type(_t),index(_i),bodyIndex(_b) {}
-  inline void SetEnv(int _index=0) { type = 0; index = _index; }
-  inline void SetRobot(int _index=0) { type = 1; index = _index; bodyIndex = -1; }
-  inline void SetRobotBody(int _index,int _bodyIndex=-1) { type = 1; index = _index; bodyIndex = _bodyIndex; }
-  inline void SetRigidObject(int _index=0) { type = 2; index = _index; }
-  inline bool IsEnv() const { return type == 0; }
-  inline bool IsRobot() const { return type == 1; }
-  inline bool IsRigidObject() const { return type == 2; }
-  inline bool operator == (const ODEObjectID& rhs) const {
-    if(type != rhs.type) return false;
-    if(index != rhs.index) return false;
-    if(type == 1 && bodyIndex!=rhs.bodyIndex) return false;
-    return true;
-  }
-  inline bool operator < (const ODEObjectID& rhs) const {
-    if(type < rhs.type) return true;
-    else if(type > rhs.type) return false;
-    if(index < rhs.index) return true;
-    else if(index > rhs.index) return false;
-    return (bodyIndex<rhs.bodyIndex);
-  }
+  //contact detection results for the current step, used internally
+  ODEContactArena contactArena;
+  //the most contact joints created by one step.  ODE's joint group keeps
+  //its memory when it is emptied, so only a step that creates more joints
+  //than this may allocate, and it is counted as a growth.
+  int contactJointPeak,contactJointGrowths;
+  vector<pair<dGeomID,dGeomID> > candidatePairs;
+  //per-candidate results of parallel collision detection, indexing into
+  //the contact buffer of the thread given by candidateThreads
+  vector<ODEContactResult> candidateResults;
+  vector<int> candidateThreads;
+  vector<Real> candidateTimes;   ///< narrow phase time, when profiling
+  vector<vector<dContactGeom> > threadContacts;
+  vector<int> threadContactsUsed,threadBufferGrowths;
+  ThreadPool* collisionPool;     ///< started on the first parallel pass
 
-  int type;       //0: static environment, 1: robot, 2: movable object
-  int index;      //index in world
-  int bodyIndex;  //for robots, this identifies a link
+  //contact caching across steps
+  ODEContactCache contactCache;
+  vector<int> candidateCacheEntries;   ///< cache slots of the candidates
+  int detectionPass;
+  int contactCacheHits,contactCacheMisses;  ///< counts for the last Step()
+
+  //island sleeping, indexed by sleep node.  sleepIsland is -1 for awake
+  //nodes, otherwise an id shared by the members of the sleeping island
+  vector<Real> idleTime;
+  vector<int> sleepIsland;
+  vector<bool> sleepActuated,sleepIslandAwake;
+  vector<int> sleepUnion;
 };
 
+
 /** @ingroup Simulation
  * @brief A list of contacts between two objects, returned as feedback 
  * from the simulation.
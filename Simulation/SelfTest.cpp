@@ -0,0 +1,184 @@
+#include "SelfTest.h"
+#include "WorldSimulationPool.h"
+#include <KrisLibrary/Timer.h>
+
+bool TestConcurrentSimulation(WorldSimulation& sim,int numJobs,Real duration,int numThreads)
+{
+  //jobs of different lengths, so that a result stored for the wrong job
+  //is caught
+  vector<SimulationJob> jobs(numJobs);
+  for(int i=0;i<numJobs;i++)
+    jobs[i].duration = duration*Real(1+i%3)/3.0;
+  WorldSimulationPool serialPool,parallelPool;
+  serialPool.Init(sim,1);
+  parallelPool.Init(sim,numThreads);
+  vector<SimulationJobResult> serial,parallel;
+  Timer timer;
+  serialPool.Run(jobs,serial);
+  Real tserial = timer.ElapsedTime();
+  timer.Reset();
+  parallelPool.Run(jobs,parallel);
+  Real tparallel = timer.ElapsedTime();
+  printf("%d rollouts: %g s on 1 thread, %g s on %d threads\n",numJobs,tserial,tparallel,numThreads);
+  int numMismatches = 0;
+  for(int i=0;i<numJobs;i++) {
+    if(!serial[i].ok || !parallel[i].ok) {
+      printf("  Error, job %d failed\n",i);
+      numMismatches++;
+    }
+    else if(serial[i].finalState != parallel[i].finalState) {
+      printf("  Error, job %d (run by worker %d) ended in a different state\n",i,parallel[i].worker);
+      numMismatches++;
+    }
+  }
+  if(numMismatches == 0)
+    printf("All final states are identical\n");
+  return numMismatches == 0;
+}
+
+void TestSimulationPoolScaling(WorldSimulation& sim,int numJobs,Real duration,int maxThreads)
+{
+  vector<SimulationJob> jobs(numJobs);
+  for(int i=0;i<numJobs;i++)
+    jobs[i].duration = duration;
+  vector<SimulationJobResult> results;
+  Real base = 0;
+  for(int n=1;n<=maxThreads;n*=2) {
+    WorldSimulationPool pool;
+    pool.Init(sim,n);
+    pool.Run(jobs,results);
+    if(n == 1) base = pool.JobsPerSecond();
+    printf("%d workers: %g jobs/s, speedup %g, %d steals\n",n,pool.JobsPerSecond(),pool.JobsPerSecond()/base,pool.numSteals);
+  }
+}
+
+bool TestSimulationSnapshots(WorldSimulation& sim,int numReps,Real duration)
+{
+  Timer timer;
+  File f;
+  f.OpenData(FILEREAD | FILEWRITE);
+  for(int i=0;i<numReps;i++) {
+    f.Seek(0,FILESEEKSTART);
+    sim.odesim.WriteState(f);
+    f.Seek(0,FILESEEKSTART);
+    sim.odesim.ReadState(f);
+  }
+  Real tfile = timer.ElapsedTime();
+  timer.Reset();
+  ODESimulatorSnapshot odeSnapshot;
+  for(int i=0;i<numReps;i++) {
+    sim.odesim.SaveSnapshot(odeSnapshot);
+    sim.odesim.RestoreSnapshot(odeSnapshot);
+  }
+  Real tsnapshot = timer.ElapsedTime();
+  printf("ODESimulator: Write/ReadState %g us, Save/RestoreSnapshot %g us per round trip, speedup %g\n",tfile*1e6/numReps,tsnapshot*1e6/numReps,tfile/tsnapshot);
+
+  timer.Reset();
+  string state;
+  for(int i=0;i<numReps;i++) {
+    sim.WriteState(state);
+    sim.ReadState(state);
+  }
+  tfile = timer.ElapsedTime();
+  timer.Reset();
+  WorldSimulationSnapshot snapshot;
+  for(int i=0;i<numReps;i++) {
+    sim.Snapshot(snapshot);
+    sim.Restore(snapshot);
+  }
+  tsnapshot = timer.ElapsedTime();
+  printf("WorldSimulation: Write/ReadState %g us, Snapshot/Restore %g us per round trip, speedup %g\n",tfile*1e6/numReps,tsnapshot*1e6/numReps,tfile/tsnapshot);
+
+  //branch from a snapshot
+  sim.Snapshot(snapshot);
+  sim.Advance(duration);
+  string original,branch;
+  sim.WriteState(original);
+  sim.Restore(snapshot);
+  sim.Advance(duration);
+  sim.WriteState(branch);
+  if(original != branch) {
+    printf("  Error, the restored simulation ended in a different state\n");
+    return false;
+  }
+  printf("The restored simulation ended in the same state\n");
+  return true;
+}
+
+bool TestContactCaching(WorldSimulation& sim,Real duration)
+{
+  string start;
+  sim.WriteState(start);
+  bool oldCaching = sim.odesim.GetSettings().contactCaching;
+  int numSteps = (int)Ceil(duration/sim.simStep);
+  vector<vector<Config> > qfinal(2);
+  for(int caching=0;caching<2;caching++) {
+    sim.odesim.GetSettings().contactCaching = (caching != 0);
+    sim.ReadState(start);
+    int hits=0,misses=0;
+    Timer timer;
+    for(int i=0;i<numSteps;i++) {
+      sim.Advance(sim.simStep);
+      hits += sim.odesim.contactCacheHits;
+      misses += sim.odesim.contactCacheMisses;
+    }
+    Real t = timer.ElapsedTime();
+    qfinal[caching].resize(sim.odesim.numRobots());
+    for(size_t r=0;r<sim.odesim.numRobots();r++)
+      sim.odesim.robot(r)->GetConfig(qfinal[caching][r]);
+    if(caching)
+      printf("Caching on: %g s, %d hits, %d misses, hit rate %g\n",t,hits,misses,Real(hits)/Max(hits+misses,1));
+    else
+      printf("Caching off: %g s\n",t);
+  }
+  Real err = 0;
+  for(size_t r=0;r<qfinal[0].size();r++)
+    err = Max(err,qfinal[0][r].distance(qfinal[1][r]));
+  printf("Largest difference in final robot configurations: %g\n",err);
+
+  //the cache must be restored with the rest of the state
+  sim.ReadState(start);
+  for(int i=0;i<numSteps/2;i++)
+    sim.Advance(sim.simStep);
+  WorldSimulationSnapshot snapshot;
+  sim.Snapshot(snapshot);
+  for(int i=numSteps/2;i<numSteps;i++)
+    sim.Advance(sim.simStep);
+  string original,branch;
+  sim.WriteState(original);
+  sim.Restore(snapshot);
+  for(int i=numSteps/2;i<numSteps;i++)
+    sim.Advance(sim.simStep);
+  sim.WriteState(branch);
+  sim.odesim.GetSettings().contactCaching = oldCaching;
+  if(original != branch) {
+    printf("  Error, the branch restored with caching on ended in a different state\n");
+    return false;
+  }
+  printf("The branch restored with caching on ended in the same state\n");
+  return true;
+}
+
+bool TestStepAllocations(WorldSimulation& sim,Real duration)
+{
+  bool oldCaching = sim.odesim.GetSettings().contactCaching;
+  sim.odesim.GetSettings().contactCaching = true;
+  WorldSimulationSnapshot snapshot;
+  sim.Snapshot(snapshot);
+  int numSteps = (int)Ceil(duration/sim.simStep);
+  int growths[2] = {0,0};
+  for(int run=0;run<2;run++) {
+    if(run > 0) sim.Restore(snapshot);
+    for(int i=0;i<numSteps;i++) {
+      sim.Advance(sim.simStep);
+      growths[run] += sim.odesim.NumBufferGrowths();
+    }
+  }
+  sim.odesim.GetSettings().contactCaching = oldCaching;
+  printf("Buffer growths: %d on the first run, %d on the replay\n",growths[0],growths[1]);
+  if(growths[1] != 0) {
+    printf("  Error, the replay grew the contact buffers\n");
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,38 @@
+#ifndef SIMULATION_SELF_TEST_H
+#define SIMULATION_SELF_TEST_H
+
+#include "WorldSimulation.h"
+
+//runs numJobs rollouts of the given duration from sim's current state,
+//first one at a time on a single cloned simulator, then concurrently on
+//numThreads clones, and checks that each job's final state is the same
+//bit for bit.  Returns false if any state differs.
+bool TestConcurrentSimulation(WorldSimulation& sim,int numJobs,Real duration,int numThreads);
+
+//runs numJobs rollouts of the given duration from sim's current state on a
+//WorldSimulationPool with 1,2,4,...,maxThreads workers, and reports the
+//throughput, speedup, and steals of each
+void TestSimulationPoolScaling(WorldSimulation& sim,int numJobs,Real duration,int maxThreads);
+
+//times numReps save/restore round trips of sim's state, through the
+//Read/WriteState memory File path and through snapshots, for both the
+//ODESimulator alone and the whole WorldSimulation.  Then checks that a
+//simulation restored from a snapshot and advanced by duration ends in the
+//same state as the original.  Returns false if it does not.
+bool TestSimulationSnapshots(WorldSimulation& sim,int numReps,Real duration);
+
+//simulates sim from its current state for the given duration with contact
+//caching off and on, and reports the times, the cache hit rate, and the
+//largest difference in the final robot configurations.  Then checks that
+//with caching on, a branch restored from a snapshot halfway through ends in
+//the same state as the original run.  Returns false if it does not.
+bool TestContactCaching(WorldSimulation& sim,Real duration);
+
+//simulates sim from its current state for the given duration with contact
+//caching on, then restores the starting snapshot and replays the same
+//steps.  Reports ODESimulator::NumBufferGrowths() summed over each run, and
+//returns false if the replay, whose buffers already fit the scene, grew
+//any of them.
+bool TestStepAllocations(WorldSimulation& sim,Real duration);
+
+#endif
@@ -23,5 +23,17 @@ const static bool gRigidObjectCollisionsEnabled = true;
 const static bool gRobotSelfCollisionsEnabled = true;
 const static bool gRobotRobotCollisionsEnabled = true;
 const static bool gAdaptiveTimeStepping = true;
+//Number of threads used for narrow-phase collision detection
+const static int gCollisionThreads = 1;
+//Reuse contacts across steps for geom pairs that barely moved relative to
+//each other
+const static bool gContactCaching = false;
+const static double gContactCacheTranslationTolerance = 1e-4;
+const static double gContactCacheRotationTolerance = 1e-3;
+//Put islands of resting robots and objects to sleep
+const static bool gAutoDisable = false;
+const static double gAutoDisableLinearThreshold = 0.01;
+const static double gAutoDisableAngularThreshold = 0.01;
+const static double gAutoDisableTime = 0.5;
 
 #endif
@@ -0,0 +1,173 @@
+#include "SimulationProfiler.h"
+#include <stdio.h>
+#include <iomanip>
+#include <math.h>
+
+//lower bound of the first time bin after the underflow bin
+const static Real kTimeBinStart = 1e-6;
+const static int kTimeBinsPerDecade = 4;
+
+SimulationProfileStat::SimulationProfileStat(bool _isCount,int _numCountBins)
+  :isCount(_isCount),numCountBins(Max(_numCountBins,1))
+{
+  Clear();
+}
+
+void SimulationProfileStat::Clear()
+{
+  active = false;
+  current = 0;
+  numSteps = 0;
+  total = 0;
+  minimum = Inf;
+  maximum = -Inf;
+  histogram.resize(0);
+  histogram.resize((isCount ? numCountBins : kNumTimeBins),0);
+}
+
+int SimulationProfileStat::Bin(Real value) const
+{
+  if(isCount) {
+    int bin = (int)value;
+    if(bin < 0) return 0;
+    return Min(bin,numCountBins-1);
+  }
+  if(value < kTimeBinStart) return 0;
+  int bin = 1+(int)floor(log10(value/kTimeBinStart)*kTimeBinsPerDecade);
+  return Min(bin,kNumTimeBins-1);
+}
+
+void SimulationProfileStat::BinRange(int bin,Real& lo,Real& hi) const
+{
+  if(isCount) {
+    lo = bin;
+    hi = (bin+1 == numCountBins ? Inf : bin+1);
+    return;
+  }
+  lo = (bin == 0 ? 0 : kTimeBinStart*pow(10.0,Real(bin-1)/kTimeBinsPerDecade));
+  hi = (bin+1 == kNumTimeBins ? Inf : kTimeBinStart*pow(10.0,Real(bin)/kTimeBinsPerDecade));
+}
+
+void SimulationProfileStat::AddStep(Real value)
+{
+  numSteps++;
+  total += value;
+  minimum = Min(minimum,value);
+  maximum = Max(maximum,value);
+  histogram[Bin(value)]++;
+}
+
+
+
+SimulationProfiler::SimulationProfiler()
+  :enabled(false),traceEnabled(false),maxTraceEvents(1000000),numCountBins(SimulationProfileStat::kDefaultNumCountBins),stepStart(0),numSteps(0)
+{}
+
+void SimulationProfiler::Clear()
+{
+  stats.clear();
+  trace.clear();
+  numSteps = 0;
+  stepStart = 0;
+  timer.Reset();
+}
+
+void SimulationProfiler::BeginStep()
+{
+  if(!enabled) return;
+  stepStart = timer.ElapsedTime();
+}
+
+void SimulationProfiler::EndStep()
+{
+  if(!enabled) return;
+  End("step",stepStart);
+  for(map<string,SimulationProfileStat>::iterator i=stats.begin();i!=stats.end();i++) {
+    if(!i->second.active) continue;
+    i->second.AddStep(i->second.current);
+    i->second.current = 0;
+    i->second.active = false;
+  }
+  numSteps++;
+}
+
+void SimulationProfiler::End(const char* phase,Real start,int thread)
+{
+  if(!enabled) return;
+  Real t = timer.ElapsedTime();
+  SimulationProfileStat& s = stats[phase];
+  s.active = true;
+  s.current += t-start;
+  if(traceEnabled && trace.size() < maxTraceEvents) {
+    trace.resize(trace.size()+1);
+    trace.back().name = phase;
+    trace.back().start = start;
+    trace.back().duration = t-start;
+    trace.back().thread = thread;
+  }
+}
+
+void SimulationProfiler::AddTime(const string& phase,Real duration)
+{
+  if(!enabled) return;
+  SimulationProfileStat& s = stats[phase];
+  s.active = true;
+  s.current += duration;
+}
+
+void SimulationProfiler::AddCount(const char* counter,int count)
+{
+  if(!enabled) return;
+  map<string,SimulationProfileStat>::iterator i=stats.find(counter);
+  if(i == stats.end())
+    i = stats.insert(make_pair(string(counter),SimulationProfileStat(true,numCountBins))).first;
+  i->second.active = true;
+  i->second.current += count;
+}
+
+void SimulationProfiler::Print(ostream& out) const
+{
+  out<<"Simulation profile over "<<numSteps<<" steps"<<endl;
+  out<<setw(40)<<left<<"phase"<<right<<setw(8)<<"steps"<<setw(12)<<"mean"<<setw(12)<<"min"<<setw(12)<<"max"<<setw(12)<<"total"<<endl;
+  for(map<string,SimulationProfileStat>::const_iterator i=stats.begin();i!=stats.end();i++) {
+    const SimulationProfileStat& s = i->second;
+    if(s.numSteps == 0) continue;
+    out<<setw(40)<<left<<i->first<<right<<setw(8)<<s.numSteps;
+    if(s.isCount)
+      out<<setw(12)<<s.Mean()<<setw(12)<<s.minimum<<setw(12)<<s.maximum<<setw(12)<<s.total<<endl;
+    else
+      out<<setw(10)<<s.Mean()*1000<<"ms"<<setw(10)<<s.minimum*1000<<"ms"<<setw(10)<<s.maximum*1000<<"ms"<<setw(11)<<s.total<<"s"<<endl;
+  }
+}
+
+//escapes the characters of a phase name that are special in JSON strings
+void WriteJSONString(FILE* f,const string& s)
+{
+  fputc('"',f);
+  for(size_t i=0;i<s.length();i++) {
+    if(s[i] == '"' || s[i] == '\\') fputc('\\',f);
+    if((unsigned char)s[i] < 0x20) continue;
+    fputc(s[i],f);
+  }
+  fputc('"',f);
+}
+
+bool SimulationProfiler::SaveChromeTrace(const char* fn) const
+{
+  FILE* f = fopen(fn,"w");
+  if(!f) {
+    fprintf(stderr,"SimulationProfiler::SaveChromeTrace: could not open %s for writing\n",fn);
+    return false;
+  }
+  fprintf(f,"{\"traceEvents\":[\n");
+  for(size_t i=0;i<trace.size();i++) {
+    fprintf(f,"{\"name\":");
+    WriteJSONString(f,trace[i].name);
+    fprintf(f,",\"cat\":\"simulation\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",trace[i].thread,trace[i].start*1e6,trace[i].duration*1e6);
+    if(i+1 < trace.size()) fprintf(f,",");
+    fprintf(f,"\n");
+  }
+  fprintf(f,"],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(f);
+  return true;
+}
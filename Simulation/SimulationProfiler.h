@@ -0,0 +1,140 @@
+#ifndef SIMULATION_PROFILER_H
+#define SIMULATION_PROFILER_H
+
+#include <KrisLibrary/math/math.h>
+#include <KrisLibrary/Timer.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+using namespace Math;
+using namespace std;
+
+/** @ingroup Simulation
+ * @brief Per-step statistics of a profiled phase or counter.
+ *
+ * The time spent in a phase (or the count of a counter) is accumulated over
+ * a simulation step in current, and the step total is added to the
+ * statistics at the end of the step.  Only the steps in which the phase ran
+ * are counted.
+ *
+ * Times are binned on a log scale, four bins per decade from 1us to 1s,
+ * with one underflow and one overflow bin.  Counts are binned by value into
+ * numCountBins bins, with the last bin holding all counts >=
+ * numCountBins-1.
+ */
+struct SimulationProfileStat
+{
+  enum { kNumTimeBins = 26, kDefaultNumCountBins = 32 };
+
+  SimulationProfileStat(bool isCount=false,int numCountBins=kDefaultNumCountBins);
+  void Clear();
+  void AddStep(Real value);
+  Real Mean() const { return (numSteps > 0 ? total/numSteps : 0); }
+  int NumBins() const { return (int)histogram.size(); }
+  int Bin(Real value) const;
+  ///Returns the range [lo,hi) of the given histogram bin
+  void BinRange(int bin,Real& lo,Real& hi) const;
+
+  bool isCount;
+  int numCountBins;
+  bool active;     ///< true if the phase ran during the current step
+  Real current;    ///< the accumulated value in the current step
+  int numSteps;
+  Real total,minimum,maximum;
+  vector<int> histogram;
+};
+
+/** @ingroup Simulation
+ * @brief A timed interval recorded for the Chrome trace.
+ */
+struct SimulationTraceEvent
+{
+  string name;
+  Real start,duration;  ///< in seconds since the profiler was cleared
+  int thread;
+};
+
+/** @ingroup Simulation
+ * @brief A runtime profiler for the phases of a simulation step.
+ *
+ * WorldSimulation owns one and passes it to its ODESimulator and
+ * controlled robot simulators.  Nothing is measured unless enabled is
+ * true, and the disabled profiler costs one branch per phase.
+ *
+ * Phases are timed with Begin() / End(), or with a SimulationProfileScope.
+ * The phases measured by WorldSimulation are:
+ * - "controller": controller updates and actuator torques
+ * - "sensors": sensor simulation
+ * - "hooks": WorldSimulationHook::Step
+ * - "broadphase": ODE space collision, gathering the candidate geom pairs
+ * - "narrowphase": contact generation for the candidate pairs, further
+ *   broken down into "narrowphase A-B" for each pair of geometry types
+ * - "clustering": contact clustering
+ * - "contact response": contact joint setup
+ * - "solver": ODE's dWorldStep
+ * - "feedback": copying out and accumulating contact feedback
+ * - "step": the whole step
+ * along with the counters "rollbacks" (adaptive time stepping rollbacks)
+ * and "contacts" (the number of contacts before clustering).
+ *
+ * A counter's histogram has numCountBins bins, set when the counter is
+ * first added, and the last bin collects every larger count.  The default
+ * of 32 is too few for "contacts" in most scenes, so raise it before
+ * profiling if the contact histogram is needed.
+ *
+ * If traceEnabled is true, each timed interval is also recorded as an
+ * event, and SaveChromeTrace() writes them in the Chrome trace event
+ * format, viewable in chrome://tracing.  At most maxTraceEvents events are
+ * kept.
+ */
+class SimulationProfiler
+{
+public:
+  SimulationProfiler();
+  ///Clears all statistics and trace events and restarts the clock
+  void Clear();
+  ///Seconds since the profiler was cleared
+  Real Time() { return timer.ElapsedTime(); }
+  void BeginStep();
+  void EndStep();
+  ///Returns the start time to be passed to End()
+  Real Begin() { return (enabled ? timer.ElapsedTime() : 0); }
+  void End(const char* phase,Real start,int thread=0);
+  ///Adds time to a phase without recording a trace event
+  void AddTime(const string& phase,Real duration);
+  void AddCount(const char* counter,int count=1);
+  ///Writes the statistics in a human readable table
+  void Print(ostream& out) const;
+  bool SaveChromeTrace(const char* fn) const;
+
+  bool enabled;
+  bool traceEnabled;
+  size_t maxTraceEvents;
+  int numCountBins;
+
+  Timer timer;
+  Real stepStart;
+  int numSteps;
+  map<string,SimulationProfileStat> stats;
+  vector<SimulationTraceEvent> trace;
+};
+
+/** @ingroup Simulation
+ * @brief Times the enclosing scope as a phase of a SimulationProfiler.
+ * The profiler may be NULL.
+ */
+class SimulationProfileScope
+{
+public:
+  SimulationProfileScope(SimulationProfiler* _profiler,const char* _phase)
+    :profiler(_profiler && _profiler->enabled ? _profiler : NULL),phase(_phase),start(0)
+  { if(profiler) start = profiler->Begin(); }
+  ~SimulationProfileScope() { if(profiler) profiler->End(phase,start); }
+
+  SimulationProfiler* profiler;
+  const char* phase;
+  Real start;
+};
+
+#endif
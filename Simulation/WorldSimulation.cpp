@@ -224,7 +224,9 @@ bool ReadFile(File& f,ContactFeedbackInfo& info)
 
 WorldSimulation::WorldSimulation()
   :time(0),simStep(0.001),fakeSimulation(false)
-{}
+{
+  odesim.profiler = &profiler;
+}
 
 void WorldSimulation::Init(RobotWorld* _world)
 {
@@ -357,10 +359,13 @@ void WorldSimulation::Advance(Real dt)
   //printf("Advance %g -> %g\n",time,time+dt);
   while(timeLeft > 0.0) {
     Real step = Min(timeLeft,simStep);
+    profiler.BeginStep();
     for(size_t i=0;i<controlSimulators.size();i++) 
       controlSimulators[i].Step(step,this);
+    Real start = profiler.Begin();
     for(size_t i=0;i<hooks.size();i++)
       hooks[i]->Step(step);
+    if(!hooks.empty()) profiler.End("hooks",start);
 
     //update viscous friction approximation as dry friction from current velocity
     for(size_t i=0;i<controlSimulators.size();i++) {
@@ -383,6 +388,7 @@ void WorldSimulation::Advance(Real dt)
     numSteps++;
 
     //accumulate contact information
+    start = profiler.Begin();
     for(ContactFeedbackMap::iterator i=contactFeedback.begin();i!=contactFeedback.end();i++) {
       if(i->second.accum || i->second.accumFull) {
 	ODEContactList* list = odesim.GetContactFeedback(i->first.first,i->first.second);
@@ -427,6 +433,8 @@ void WorldSimulation::Advance(Real dt)
 	}
       }
     }
+    if(!contactFeedback.empty()) profiler.End("feedback",start);
+    profiler.EndStep();
   }
   time += dt;
   UpdateModel();
@@ -626,6 +634,66 @@ bool WorldSimulation::WriteState(string& s) const
   return true;
 }
 
+bool WorldSimulation::Snapshot(WorldSimulationSnapshot& s) const
+{
+  s.time = time;
+  odesim.SaveSnapshot(s.odeState);
+  s.odeLastState = odesim.lastState;
+  s.odeLastStateTimestep = odesim.lastStateTimestep;
+  s.odeLastMarginsRemaining = odesim.lastMarginsRemaining;
+  s.odeContactCache.Copy(odesim.contactCache);
+  if(!s.controlState.IsOpen()) {
+    if(!s.controlState.OpenData(FILEREAD | FILEWRITE)) return false;
+  }
+  s.controlState.Seek(0,FILESEEKSTART);
+  //controlSimulators will write the robotControllers' states
+  for(size_t i=0;i<controlSimulators.size();i++) {
+    if(!controlSimulators[i].WriteState(s.controlState)) {
+      fprintf(stderr,"WorldSimulation::Snapshot: Control simulator %d failed to write\n",(int)i);
+      return false;
+    }
+  }
+  for(size_t i=0;i<hooks.size();i++) {
+    if(!hooks[i]->WriteState(s.controlState)) {
+      fprintf(stderr,"WorldSimulation::Snapshot: Hook %d failed to write\n",(int)i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WorldSimulation::Restore(WorldSimulationSnapshot& s)
+{
+  if(!s.controlState.IsOpen()) {
+    fprintf(stderr,"WorldSimulation::Restore: snapshot was never saved\n");
+    return false;
+  }
+  if(!odesim.RestoreSnapshot(s.odeState)) {
+    fprintf(stderr,"WorldSimulation::Restore: ODE sim failed to restore\n");
+    return false;
+  }
+  time = s.time;
+  odesim.lastState = s.odeLastState;
+  odesim.lastStateTimestep = s.odeLastStateTimestep;
+  odesim.lastMarginsRemaining = s.odeLastMarginsRemaining;
+  odesim.contactCache.Copy(s.odeContactCache);
+  s.controlState.Seek(0,FILESEEKSTART);
+  for(size_t i=0;i<controlSimulators.size();i++) {
+    if(!controlSimulators[i].ReadState(s.controlState)) {
+      fprintf(stderr,"WorldSimulation::Restore: Control simulator %d failed to read\n",(int)i);
+      return false;
+    }
+  }
+  for(size_t i=0;i<hooks.size();i++) {
+    if(!hooks[i]->ReadState(s.controlState)) {
+      fprintf(stderr,"WorldSimulation::Restore: Hook %d failed to read\n",(int)i);
+      return false;
+    }
+  }
+  UpdateModel();
+  return true;
+}
+
 void WorldSimulation::EnableContactFeedback(int aid,int bid,bool accum,bool accumFull)
 {
   ContactFeedbackInfo f;
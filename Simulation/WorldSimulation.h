@@ -4,6 +4,7 @@
 #include "Modeling/World.h"
 #include "ODESimulator.h"
 #include "ControlledSimulator.h"
+#include "SimulationProfiler.h"
 #include <map>
 
 /** @brief Container for information about contacts regarding a certain
@@ -55,7 +56,12 @@ class WorldSimulationHook
   bool autokill;
 };
 
+struct WorldSimulationSnapshot;
+
 /** @brief A physical simulator for a RobotWorld.
+ *
+ * Set profiler.enabled to time the phases of each sub-step (see
+ * SimulationProfiler).
  */
 class WorldSimulation
 {
@@ -81,6 +87,14 @@ public:
   bool WriteState(File& f) const;
   bool ReadState(const string& data);
   bool WriteState(string& data) const;
+  ///Fast in-memory save/restore, for branching simulations.  The same
+  ///requirements on controllers and hooks apply as for ReadState.
+  ///Reusing a snapshot object avoids reallocating its buffers.
+  ///Contact feedback is not saved, since Advance resets it: until the next
+  ///Advance after a Restore, the contact queries report the last Advance
+  ///call made before it.
+  bool Snapshot(WorldSimulationSnapshot& snapshot) const;
+  bool Restore(WorldSimulationSnapshot& snapshot);
 
   //contact querying routines
   ///Enables contact feedback between the two objects.  This must be called
@@ -128,6 +142,34 @@ public:
   vector<SmartPointer<WorldSimulationHook> > hooks;
   typedef map<pair<ODEObjectID,ODEObjectID>,ContactFeedbackInfo> ContactFeedbackMap;
   ContactFeedbackMap contactFeedback;
+  SimulationProfiler profiler;
+
+private:
+  //not copyable, since odesim isn't.  Use WorldSimulationPool or Init to
+  //make independent simulators.
+  WorldSimulation(const WorldSimulation&);
+  const WorldSimulation& operator = (const WorldSimulation&);
+};
+
+/** @brief An in-memory copy of the state of a WorldSimulation, made by
+ * WorldSimulation::Snapshot().
+ *
+ * The ODE bodies are copied raw, along with the state of the adaptive time
+ * stepper and the contact cache, so a restored simulation continues exactly
+ * as the original would have.  Controllers, sensors, and hooks are saved
+ * through their WriteState methods into a memory buffer that is reused by
+ * later snapshots.  The contact feedback summaries are left out; they only
+ * describe the last Advance call and are reset by the next one.
+ */
+struct WorldSimulationSnapshot
+{
+  Real time;
+  ODESimulatorSnapshot odeState;
+  ODESimulatorSnapshot odeLastState;
+  Real odeLastStateTimestep;
+  map<pair<ODEObjectID,ODEObjectID>,double> odeLastMarginsRemaining;
+  ODEContactCache odeContactCache;
+  File controlState;
 };
 
 /** @brief A hook that adds a constant force to a body
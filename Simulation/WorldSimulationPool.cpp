@@ -0,0 +1,310 @@
+#include "WorldSimulationPool.h"
+#include "ODECommon.h"
+#include <KrisLibrary/utils/threadutils.h>
+#include <KrisLibrary/Timer.h>
+#include <tinyxml.h>
+#include <ode/ode.h>
+#include <deque>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif //WIN32
+
+static int NumHardwareThreads()
+{
+#ifdef WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if(n <= 0) return 1;
+  return (int)n;
+#endif //WIN32
+}
+
+//Copies the world so that a simulator can run on it independently of a.
+//CopyWorld shares the collision geometries, whose transforms are set during
+//collision detection, so each one is replaced with a copy.
+static void CloneWorldForSimulation(const RobotWorld& a,RobotWorld& b)
+{
+  CopyWorld(a,b);
+  for(size_t i=0;i<b.robots.size();i++) {
+    Robot* robot = b.robots[i];
+    for(size_t j=0;j<robot->geometry.size();j++) {
+      if(!a.robots[i]->geometry[j]) continue;
+      robot->geomManagers[j].CreateEmpty();
+      *robot->geomManagers[j] = *a.robots[i]->geometry[j];
+      robot->geometry[j] = robot->geomManagers[j];
+    }
+  }
+  for(size_t i=0;i<b.terrains.size();i++) {
+    if(!a.terrains[i]->geometry) continue;
+    b.terrains[i]->geometry.CreateEmpty();
+    *b.terrains[i]->geometry = *a.terrains[i]->geometry;
+  }
+  for(size_t i=0;i<b.rigidObjects.size();i++) {
+    if(!a.rigidObjects[i]->geometry) continue;
+    b.rigidObjects[i]->geometry.CreateEmpty();
+    *b.rigidObjects[i]->geometry = *a.rigidObjects[i]->geometry;
+  }
+}
+
+//Copies the ODE settings that are not part of the simulation state
+static void CopyODESettings(ODESimulator& a,ODESimulator& b)
+{
+  const ODESimulatorSettings& s = a.GetSettings();
+  b.SetGravity(Vector3(s.gravity[0],s.gravity[1],s.gravity[2]));
+  b.SetERP(s.errorReductionParameter);
+  b.SetCFM(s.dampedLeastSquaresParameter);
+  for(size_t i=0;i<a.numTerrains();i++) {
+    b.terrainGeom(i)->surf() = a.terrainGeom(i)->surf();
+    b.terrainGeom(i)->SetPadding(a.terrainGeom(i)->GetPadding());
+  }
+  for(size_t i=0;i<a.numObjects();i++) {
+    b.object(i)->triMesh()->surf() = a.object(i)->triMesh()->surf();
+    b.object(i)->triMesh()->SetPadding(a.object(i)->triMesh()->GetPadding());
+  }
+  for(size_t i=0;i<a.numRobots();i++) {
+    for(size_t j=0;j<a.robot(i)->robot.links.size();j++) {
+      if(!a.robot(i)->triMesh(j)) continue;
+      b.robot(i)->triMesh(j)->surf() = a.robot(i)->triMesh(j)->surf();
+      b.robot(i)->triMesh(j)->SetPadding(a.robot(i)->triMesh(j)->GetPadding());
+    }
+  }
+}
+
+SimulationJob::SimulationJob()
+  :duration(0),traceDt(0)
+{}
+
+SimulationJobResult::SimulationJobResult()
+  :ok(false),worker(-1),computationTime(0)
+{}
+
+static void RecordTrace(WorldSimulation& sim,Real t,SimulationJobResult& result)
+{
+  result.times.push_back(t);
+  result.robotConfigs.resize(result.robotConfigs.size()+1);
+  result.robotConfigs.back().resize(sim.odesim.numRobots());
+  for(size_t i=0;i<sim.odesim.numRobots();i++)
+    sim.odesim.robot(i)->GetConfig(result.robotConfigs.back()[i]);
+  result.objectTransforms.resize(result.objectTransforms.size()+1);
+  result.objectTransforms.back().resize(sim.odesim.numObjects());
+  for(size_t i=0;i<sim.odesim.numObjects();i++)
+    sim.odesim.object(i)->GetTransform(result.objectTransforms.back()[i]);
+}
+
+bool RunSimulationJob(WorldSimulation& sim,const string& defaultState,const SimulationJob& job,SimulationJobResult& result)
+{
+  Timer timer;
+  result.times.clear();
+  result.robotConfigs.clear();
+  result.objectTransforms.clear();
+  result.finalState.clear();
+  //the adaptive time stepper keeps the last accepted state across steps;
+  //forget it so that the job behaves like a freshly initialized simulator
+  sim.odesim.lastState.Clear();
+  sim.odesim.lastStateTimestep = 0;
+  sim.odesim.lastMarginsRemaining.clear();
+  if(!sim.ReadState(job.initialState.empty() ? defaultState : job.initialState)) {
+    fprintf(stderr,"RunSimulationJob: could not read initial state\n");
+    result.ok = false;
+    return false;
+  }
+  for(size_t i=0;i<job.controllerSettings.size() && i<sim.robotControllers.size();i++) {
+    if(!sim.robotControllers[i]) continue;
+    for(size_t j=0;j<job.controllerSettings[i].size();j++) {
+      if(!sim.robotControllers[i]->SetSetting(job.controllerSettings[i][j].first,job.controllerSettings[i][j].second))
+        fprintf(stderr,"RunSimulationJob: robot %d controller rejected setting %s\n",(int)i,job.controllerSettings[i][j].first.c_str());
+    }
+  }
+  for(size_t i=0;i<job.controllerCommands.size() && i<sim.robotControllers.size();i++) {
+    if(!sim.robotControllers[i]) continue;
+    for(size_t j=0;j<job.controllerCommands[i].size();j++) {
+      if(!sim.robotControllers[i]->SendCommand(job.controllerCommands[i][j].first,job.controllerCommands[i][j].second))
+        fprintf(stderr,"RunSimulationJob: robot %d controller rejected command %s\n",(int)i,job.controllerCommands[i][j].first.c_str());
+    }
+  }
+  Real t = 0;
+  if(job.traceDt > 0) {
+    RecordTrace(sim,t,result);
+    while(t < job.duration) {
+      Real dt = Min(job.traceDt,job.duration-t);
+      sim.Advance(dt);
+      t += dt;
+      RecordTrace(sim,t,result);
+    }
+  }
+  else if(job.duration > 0)
+    sim.Advance(job.duration);
+  sim.WriteState(result.finalState);
+  result.ok = true;
+  result.computationTime = timer.ElapsedTime();
+  return true;
+}
+
+
+
+/** @brief Per-worker job queues for the work-stealing scheduler.
+ *
+ * A worker pops jobs from the front of its own queue and steals from the
+ * back of the other queues, so the owner and thieves rarely contend for
+ * the same end.
+ */
+struct SimulationJobQueues
+{
+  SimulationJobQueues(int numWorkers);
+  ~SimulationJobQueues();
+  bool Next(int worker,int& job,bool& stolen);
+
+  std::vector<std::deque<int> > queues;
+  Mutex* mutexes;
+};
+
+SimulationJobQueues::SimulationJobQueues(int numWorkers)
+  :queues(numWorkers)
+{
+  mutexes = new Mutex[numWorkers];
+}
+
+SimulationJobQueues::~SimulationJobQueues()
+{
+  delete [] mutexes;
+}
+
+bool SimulationJobQueues::Next(int worker,int& job,bool& stolen)
+{
+  stolen = false;
+  {
+    ScopedLock lock(mutexes[worker]);
+    if(!queues[worker].empty()) {
+      job = queues[worker].front();
+      queues[worker].pop_front();
+      return true;
+    }
+  }
+  int n = (int)queues.size();
+  for(int k=1;k<n;k++) {
+    int victim = (worker+k)%n;
+    ScopedLock lock(mutexes[victim]);
+    if(!queues[victim].empty()) {
+      job = queues[victim].back();
+      queues[victim].pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+struct SimulationWorkerData
+{
+  WorldSimulationPool* pool;
+  int worker;
+  SimulationJobQueues* queues;
+  const std::vector<SimulationJob>* jobs;
+  std::vector<SimulationJobResult>* results;
+  int numJobs;
+  int numSteals;
+};
+
+static void* simulation_worker_func(void* ptr)
+{
+  SimulationWorkerData* data = reinterpret_cast<SimulationWorkerData*>(ptr);
+  WorldSimulation& sim = *data->pool->sims[data->worker];
+  //ODE keeps some collider data per thread
+  dAllocateODEDataForThread(dAllocateMaskAll);
+  int job;
+  bool stolen;
+  while(data->queues->Next(data->worker,job,stolen)) {
+    SimulationJobResult& res = (*data->results)[job];
+    RunSimulationJob(sim,data->pool->initialState,(*data->jobs)[job],res);
+    res.worker = data->worker;
+    data->numJobs++;
+    if(stolen) data->numSteals++;
+  }
+  dCleanupODEAllDataForThread();
+  return NULL;
+}
+
+
+
+WorldSimulationPool::WorldSimulationPool()
+  :numJobs(0),numSteals(0),runTime(0)
+{}
+
+void WorldSimulationPool::Init(WorldSimulation& sim,int numWorkers,ControllerMaker makeController)
+{
+  if(numWorkers <= 0) numWorkers = NumHardwareThreads();
+  sim.WriteState(initialState);
+  worlds.resize(numWorkers);
+  sims.resize(numWorkers);
+  for(int k=0;k<numWorkers;k++) {
+    worlds[k] = new RobotWorld;
+    CloneWorldForSimulation(*sim.world,*worlds[k]);
+    sims[k] = new WorldSimulation;
+    WorldSimulation& s = *sims[k];
+    s.odesim.GetSettings() = sim.odesim.GetSettings();
+    s.simStep = sim.simStep;
+    s.Init(worlds[k]);
+    CopyODESettings(sim.odesim,s.odesim);
+    s.robotControllers.resize(worlds[k]->robots.size());
+    for(size_t i=0;i<worlds[k]->robots.size();i++) {
+      if(i < sim.robotControllers.size() && sim.robotControllers[i])
+        s.SetController(i,makeController(worlds[k]->robots[i]));
+      TiXmlElement e("sensors");
+      sim.controlSimulators[i].sensors.SaveSettings(&e);
+      s.controlSimulators[i].sensors.sensors.clear();
+      if(!s.controlSimulators[i].sensors.LoadSettings(&e))
+        fprintf(stderr,"WorldSimulationPool: could not copy the sensors of robot %d\n",(int)i);
+    }
+    for(ContactFeedbackMap::const_iterator i=sim.contactFeedback.begin();i!=sim.contactFeedback.end();i++) {
+      s.contactFeedback[i->first] = i->second;
+      s.odesim.EnableContactFeedback(i->first.first,i->first.second);
+    }
+  }
+}
+
+void WorldSimulationPool::Run(const std::vector<SimulationJob>& jobs,std::vector<SimulationJobResult>& results)
+{
+  Assert(!sims.empty());
+  Timer timer;
+  int n = (int)sims.size();
+  results.resize(jobs.size());
+  SimulationJobQueues queues(n);
+  for(size_t i=0;i<jobs.size();i++)
+    queues.queues[i%n].push_back((int)i);
+
+  std::vector<SimulationWorkerData> data(n);
+  for(int k=0;k<n;k++) {
+    data[k].pool = this;
+    data[k].worker = k;
+    data[k].queues = &queues;
+    data[k].jobs = &jobs;
+    data[k].results = &results;
+    data[k].numJobs = 0;
+    data[k].numSteals = 0;
+  }
+  std::vector<Thread> threads(n);
+  for(int k=0;k<n;k++)
+    threads[k] = ThreadStart(simulation_worker_func,&data[k]);
+  for(int k=0;k<n;k++)
+    ThreadJoin(threads[k]);
+
+  numJobs = (int)jobs.size();
+  numSteals = 0;
+  workerJobCounts.resize(n);
+  for(int k=0;k<n;k++) {
+    numSteals += data[k].numSteals;
+    workerJobCounts[k] = data[k].numJobs;
+  }
+  runTime = timer.ElapsedTime();
+}
+
+Real WorldSimulationPool::JobsPerSecond() const
+{
+  if(runTime <= 0) return 0;
+  return Real(numJobs)/runTime;
+}
@@ -0,0 +1,95 @@
+#ifndef WORLD_SIMULATION_POOL_H
+#define WORLD_SIMULATION_POOL_H
+
+#include "WorldSimulation.h"
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <string>
+#include <vector>
+
+/** @ingroup Simulation
+ * @brief A single rollout to be run by a WorldSimulationPool.
+ *
+ * The simulation is started from initialState (a string produced by
+ * WorldSimulation::WriteState on a simulator with the same world and
+ * controller types).  If initialState is empty, the pool's initial state is
+ * used.  After the state is loaded, the controller settings and commands
+ * for each robot are applied, in that order.
+ *
+ * If traceDt > 0, the robot configurations and rigid object transforms are
+ * recorded every traceDt seconds.  Otherwise only the final state is
+ * returned.
+ */
+struct SimulationJob
+{
+  SimulationJob();
+
+  std::string initialState;
+  std::vector<std::vector<std::pair<std::string,std::string> > > controllerSettings;
+  std::vector<std::vector<std::pair<std::string,std::string> > > controllerCommands;
+  Real duration;
+  Real traceDt;
+};
+
+/** @ingroup Simulation
+ * @brief The result of a SimulationJob.
+ */
+struct SimulationJobResult
+{
+  SimulationJobResult();
+
+  bool ok;                   ///< false if the initial state could not be loaded
+  std::string finalState;    ///< the state at the end of the job, from WorldSimulation::WriteState
+  std::vector<Real> times;   ///< trace times, if traceDt > 0
+  std::vector<std::vector<Config> > robotConfigs;  ///< indexed by [trace step][robot]
+  std::vector<std::vector<RigidTransform> > objectTransforms;  ///< indexed by [trace step][object]
+  int worker;                ///< the worker that ran the job
+  Real computationTime;      ///< wall clock time spent on the job
+};
+
+/** @ingroup Simulation
+ * @brief Runs batches of independent simulations in parallel.
+ *
+ * Init() clones the world and simulation settings of a source simulator
+ * into one WorldSimulation per worker thread.  Each clone has its own
+ * robots, objects, and collision geometry instances, so the workers never
+ * touch shared state.  Controllers are created for the clones with the
+ * given controller maker (MakeDefaultController by default), and sensors
+ * are copied through their XML settings.
+ *
+ * Run() distributes a batch of jobs over the workers with a work-stealing
+ * scheduler: each worker gets an initial share of the jobs in its own
+ * queue, pops from the front of it, and when it runs out it steals from the
+ * back of the other workers' queues.  Results are stored in job order, and
+ * each job's result does not depend on which worker ran it.
+ */
+class WorldSimulationPool
+{
+public:
+  typedef SmartPointer<RobotController> (*ControllerMaker)(Robot* robot);
+
+  WorldSimulationPool();
+  ///Clones sim into numWorkers simulators.  If numWorkers <= 0, one worker
+  ///is created per hardware thread.
+  void Init(WorldSimulation& sim,int numWorkers=0,ControllerMaker makeController=MakeDefaultController);
+  int NumWorkers() const { return (int)sims.size(); }
+  ///Runs all jobs and blocks until they are done
+  void Run(const std::vector<SimulationJob>& jobs,std::vector<SimulationJobResult>& results);
+  ///Throughput of the last Run() call
+  Real JobsPerSecond() const;
+
+  std::string initialState;
+  std::vector<SmartPointer<RobotWorld> > worlds;
+  std::vector<SmartPointer<WorldSimulation> > sims;
+
+  //statistics for the last Run() call
+  int numJobs;
+  int numSteals;
+  Real runTime;
+  std::vector<int> workerJobCounts;
+};
+
+///Runs a single job on the given simulator (which must have been set up
+///like the simulator that produced job.initialState).
+bool RunSimulationJob(WorldSimulation& sim,const std::string& defaultState,const SimulationJob& job,SimulationJobResult& result);
+
+#endif